@@ -22,6 +22,8 @@
 
 namespace llvm {
 class LoopInfo;
+template<class FType, class BType> class ProfileInfoT;
+typedef ProfileInfoT<Function, BasicBlock> ProfileInfo;
 class raw_ostream;
 
 /// \brief Analysis pass providing branch probability information.
@@ -125,6 +127,9 @@ private:
   /// \brief Handle to the LoopInfo analysis.
   LoopInfo *LI;
 
+  /// \brief Handle to the execution counts loaded from a profile, if any.
+  ProfileInfo *PI;
+
   /// \brief Track the last function we run over for printing.
   Function *LastF;
 
@@ -135,6 +140,7 @@ private:
   uint32_t getSumForBlock(const BasicBlock *BB) const;
 
   bool calcUnreachableHeuristics(BasicBlock *BB);
+  bool calcProfileWeights(BasicBlock *BB);
   bool calcMetadataWeights(BasicBlock *BB);
   bool calcPointerHeuristics(BasicBlock *BB);
   bool calcLoopBranchHeuristics(BasicBlock *BB);
@@ -260,7 +260,8 @@ public:
     SK_Broadcast,       ///< Broadcast element 0 to all other elements.
     SK_Reverse,         ///< Reverse the order of the vector.
     SK_InsertSubvector, ///< InsertSubvector. Index indicates start offset.
-    SK_ExtractSubvector ///< ExtractSubvector Index indicates start offset.
+    SK_ExtractSubvector,///< ExtractSubvector Index indicates start offset.
+    SK_Alternate        ///< Choose alternate elements from two vectors.
   };
 
   /// \brief Additonal information about an operand's possible values.
@@ -283,6 +284,10 @@ public:
   /// and the number of execution units in the CPU.
   virtual unsigned getMaximumUnrollFactor() const;
 
+  /// \return The size of a data cache line in bytes. Loop transformations use
+  /// this to decide whether consecutive iterations touch the same line.
+  virtual unsigned getCacheLineSize() const;
+
   /// \return The expected cost of arithmetic ops, such as mul, xor, fsub, etc.
   virtual unsigned getArithmeticInstrCost(unsigned Opcode, Type *Ty,
                                   OperandValueKind Opd1Info = OK_AnyValue,
@@ -317,6 +322,14 @@ public:
                                    unsigned Alignment,
                                    unsigned AddressSpace) const;
 
+  /// \return The cost of an interleaved load of \p Factor vectors of type
+  /// \p VecTy: a single wide load of Factor times as many elements, followed
+  /// by the shuffles that pick every Factor'th element out of it.
+  virtual unsigned getInterleavedMemoryOpCost(unsigned Opcode, Type *VecTy,
+                                              unsigned Factor,
+                                              unsigned Alignment,
+                                              unsigned AddressSpace) const;
+
   /// \returns The cost of Intrinsic instructions.
   virtual unsigned getIntrinsicInstrCost(Intrinsic::ID ID, Type *RetTy,
                                          ArrayRef<Type *> Tys) const;
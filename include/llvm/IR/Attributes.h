@@ -104,6 +104,11 @@ public:
     UWTable,               ///< Function must be in a unwind table
     ZExt,                  ///< Zero extended before/after call
 
+    // Bitcode stores the values of these enumerators, so new attributes go
+    // here rather than in alphabetical order.
+    Cold,                  ///< Function is rarely executed
+    Hot,                   ///< Function is frequently executed
+
     EndAttrKinds           ///< Sentinal value useful for loops
   };
 private:
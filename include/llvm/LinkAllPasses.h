@@ -97,6 +97,8 @@ namespace {
       (void) llvm::createLoopUnrollPass();
       (void) llvm::createLoopUnswitchPass();
       (void) llvm::createLoopIdiomPass();
+      (void) llvm::createLoopInterchangePass();
+      (void) llvm::createLoopTilingPass();
       (void) llvm::createLoopRotatePass();
       (void) llvm::createLowerExpectIntrinsicPass();
       (void) llvm::createLowerInvokePass();
@@ -144,6 +146,8 @@ namespace {
       (void) llvm::createGVNPass();
       (void) llvm::createMemCpyOptPass();
       (void) llvm::createLoopDeletionPass();
+      (void) llvm::createLoopDistributePass();
+      (void) llvm::createLoopFusePass();
       (void) llvm::createPostDomTree();
       (void) llvm::createInstructionNamerPass();
       (void) llvm::createMetaRenamerPass();
@@ -154,6 +158,9 @@ namespace {
       (void) llvm::createPrintBasicBlockPass(0);
       (void) llvm::createModuleDebugInfoPrinterPass();
       (void) llvm::createPartialInliningPass();
+      (void) llvm::createHotColdSplittingPass();
+      (void) llvm::createFunctionHotnessPass();
+      (void) llvm::createWholeProgramDevirtPass();
       (void) llvm::createLintPass();
       (void) llvm::createSinkingPass();
       (void) llvm::createLowerAtomicPass();
@@ -19,6 +19,7 @@
 
 namespace llvm {
 
+class FunctionPass;
 class ModulePass;
 class Pass;
 class Function;
@@ -183,6 +184,25 @@ ModulePass *createMergeFunctionsPass();
 /// createPartialInliningPass - This pass inlines parts of functions.
 ///
 ModulePass *createPartialInliningPass();
+
+//===----------------------------------------------------------------------===//
+/// createHotColdSplittingPass - This pass outlines cold regions of functions
+/// into separate functions.
+///
+FunctionPass *createHotColdSplittingPass();
+
+//===----------------------------------------------------------------------===//
+/// createFunctionHotnessPass - This pass marks functions hot or cold based on
+/// the execution counts of a loaded profile.
+///
+ModulePass *createFunctionHotnessPass();
+
+//===----------------------------------------------------------------------===//
+/// createWholeProgramDevirtPass - This pass turns calls through constant tables
+/// of function pointers, like C++ vtables, into direct calls when the whole
+/// program is in the module.
+///
+ModulePass *createWholeProgramDevirtPass();
   
 //===----------------------------------------------------------------------===//
 // createMetaRenamerPass - Rename everything with metasyntatic names.
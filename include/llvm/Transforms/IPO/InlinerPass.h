@@ -17,12 +17,19 @@
 #ifndef LLVM_TRANSFORMS_IPO_INLINERPASS_H
 #define LLVM_TRANSFORMS_IPO_INLINERPASS_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Analysis/CallGraphSCCPass.h"
 
 namespace llvm {
+  class BasicBlock;
   class CallSite;
   class DataLayout;
+  class Function;
   class InlineCost;
+  class Instruction;
+  template<class FType, class BType>
+  class ProfileInfoT;
+  typedef ProfileInfoT<Function, BasicBlock> ProfileInfo;
   template<class PtrType, unsigned SmallSize>
   class SmallPtrSet;
 
@@ -55,7 +62,8 @@ struct Inliner : public CallGraphSCCPass {
   /// Calculate the inline threshold for given Caller. This threshold is lower
   /// if the caller is marked with OptimizeForSize and -inline-threshold is not
   /// given on the comand line. It is higher if the callee is marked with the
-  /// inlinehint attribute.
+  /// inlinehint attribute. When execution counts are available, it is raised
+  /// for hot call sites and lowered for cold ones.
   ///
   unsigned getInlineThreshold(CallSite CS) const;
 
@@ -74,6 +82,13 @@ struct Inliner : public CallGraphSCCPass {
   /// deal with that subset of the functions.
   bool removeDeadFunctions(CallGraph &CG, bool AlwaysInlineOnly = false);
 
+protected:
+  /// setProfileInfo - Use the execution counts in PI to tune the threshold of
+  /// each call site.  Subclasses that want profile-guided inlining call this
+  /// before running the common inliner logic.  A null PI, or one without any
+  /// counts, leaves the static heuristics alone.
+  void setProfileInfo(ProfileInfo *PI);
+
 private:
   // InlineThreshold - Cache the value here for easy access.
   unsigned InlineThreshold;
@@ -81,6 +96,21 @@ private:
   // InsertLifetime - Insert @llvm.lifetime intrinsics.
   bool InsertLifetime;
 
+  // PI - Execution counts for the module, or null if none were loaded.
+  ProfileInfo *PI;
+
+  // MaxBlockCount - The execution count of the hottest block in the module,
+  // or a negative value if the profile has not been scanned yet.
+  double MaxBlockCount;
+
+  // CallSiteCounts - Execution counts of the call sites in the current SCC,
+  // recorded before inlining starts splitting their blocks.
+  DenseMap<const Instruction*, double> CallSiteCounts;
+
+  /// getCallSiteCount - Return the execution count of the call site, or
+  /// ProfileInfo::MissingValue if the profile does not cover it.
+  double getCallSiteCount(CallSite CS) const;
+
   /// shouldInline - Return true if the inliner should attempt to
   /// inline at the given CallSite.
   bool shouldInline(CallSite CS);
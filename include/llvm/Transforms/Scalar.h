@@ -150,6 +150,35 @@ Pass *createLoopRotatePass();
 // LoopIdiom - This pass recognizes and replaces idioms in loops.
 //
 Pass *createLoopIdiomPass();
+
+//===----------------------------------------------------------------------===//
+//
+// LoopInterchange - This pass swaps perfectly nested loops when the inner loop
+// then accesses memory with a shorter stride.
+//
+Pass *createLoopInterchangePass();
+
+//===----------------------------------------------------------------------===//
+//
+// LoopTiling - This pass strip-mines the inner loop of a perfect loop nest and
+// moves the strip loop outward, so that cache lines are reused within a tile.
+//
+Pass *createLoopTilingPass();
+
+//===----------------------------------------------------------------------===//
+//
+// LoopDistribute - This pass splits a loop so that the stores which carry a
+// dependence across iterations end up in a different loop than those that do
+// not, letting the latter be vectorized.
+//
+Pass *createLoopDistributePass();
+
+//===----------------------------------------------------------------------===//
+//
+// LoopFuse - This pass merges adjacent loops that run the same number of
+// iterations and access the same memory.
+//
+Pass *createLoopFusePass();
   
 //===----------------------------------------------------------------------===//
 //
@@ -14,6 +14,7 @@
 #include "llvm/Analysis/BranchProbabilityInfo.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
@@ -27,6 +28,7 @@ using namespace llvm;
 INITIALIZE_PASS_BEGIN(BranchProbabilityInfo, "branch-prob",
                       "Branch Probability Analysis", false, true)
 INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_AG_DEPENDENCY(ProfileInfo)
 INITIALIZE_PASS_END(BranchProbabilityInfo, "branch-prob",
                     "Branch Probability Analysis", false, true)
 
@@ -155,6 +157,45 @@ bool BranchProbabilityInfo::calcUnreachableHeuristics(BasicBlock *BB) {
   return true;
 }
 
+// Use the edge counts of a loaded profile when it has them for this block.
+// Real execution counts beat both metadata and the static heuristics below.
+bool BranchProbabilityInfo::calcProfileWeights(BasicBlock *BB) {
+  TerminatorInst *TI = BB->getTerminator();
+  if (TI->getNumSuccessors() < 2)
+    return false;
+
+  // The profile has a single count for all edges from BB to the same
+  // successor, so share it evenly among them.
+  SmallDenseMap<BasicBlock *, unsigned, 4> NumEdgesTo;
+  for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i)
+    ++NumEdgesTo[TI->getSuccessor(i)];
+
+  SmallVector<double, 4> Counts;
+  Counts.reserve(TI->getNumSuccessors());
+  double MaxCount = 0;
+  for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i) {
+    BasicBlock *Succ = TI->getSuccessor(i);
+    double Count = PI->getEdgeWeight(ProfileInfo::getEdge(BB, Succ));
+    if (Count == ProfileInfo::MissingValue)
+      return false;
+    Counts.push_back(Count / NumEdgesTo[Succ]);
+    MaxCount = std::max(MaxCount, Counts.back());
+  }
+
+  // A block the profile never reached says nothing about its branches; leave
+  // it to the heuristics.
+  if (MaxCount == 0)
+    return false;
+
+  // Scale the counts down into the weight range if needed. Every weight is
+  // kept at or above MIN_WEIGHT so that no edge looks impossible.
+  double Scale = std::min(1.0, getMaxWeightFor(BB) / MaxCount);
+  for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i)
+    setEdgeWeight(BB, i, std::max<uint32_t>(MIN_WEIGHT, Counts[i] * Scale));
+
+  return true;
+}
+
 // Propagate existing explicit probabilities from either profile data or
 // 'expect' intrinsic processing.
 bool BranchProbabilityInfo::calcMetadataWeights(BasicBlock *BB) {
@@ -390,12 +431,14 @@ bool BranchProbabilityInfo::calcInvokeHeuristics(BasicBlock *BB) {
 
 void BranchProbabilityInfo::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<LoopInfo>();
+  AU.addRequired<ProfileInfo>();
   AU.setPreservesAll();
 }
 
 bool BranchProbabilityInfo::runOnFunction(Function &F) {
   LastF = &F; // Store the last function we ran on for printing.
   LI = &getAnalysis<LoopInfo>();
+  PI = &getAnalysis<ProfileInfo>();
   assert(PostDominatedByUnreachable.empty());
 
   // Walk the basic blocks in post-order so that we can build up state about
@@ -406,6 +449,8 @@ bool BranchProbabilityInfo::runOnFunction(Function &F) {
     DEBUG(dbgs() << "Computing probabilities for " << I->getName() << "\n");
     if (calcUnreachableHeuristics(*I))
       continue;
+    if (calcProfileWeights(*I))
+      continue;
     if (calcMetadataWeights(*I))
       continue;
     if (calcLoopBranchHeuristics(*I))
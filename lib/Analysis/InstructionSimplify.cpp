@@ -59,6 +59,9 @@ static Value *SimplifyOrInst(Value *, Value *, const Query &, unsigned);
 static Value *SimplifyXorInst(Value *, Value *, const Query &, unsigned);
 static Value *SimplifyTruncInst(Value *, Type *, const Query &, unsigned);
 
+// MatchPeepholePatterns, generated from InstSimplifyPatterns.td.
+#include "InstSimplifyPatterns.inc"
+
 /// getFalse - For a boolean type, or a vector of boolean type, return false, or
 /// a vector with every element false, as appropriate for the type.
 static Constant *getFalse(Type *Ty) {
@@ -606,22 +609,9 @@ static Value *SimplifyAddInst(Value *Op0, Value *Op1, bool isNSW, bool isNUW,
   if (match(Op1, m_Undef()))
     return Op1;
 
-  // X + 0 -> X
-  if (match(Op1, m_Zero()))
-    return Op0;
-
-  // X + (Y - X) -> Y
-  // (Y - X) + X -> Y
-  // Eg: X + -X -> 0
-  Value *Y = 0;
-  if (match(Op1, m_Sub(m_Value(Y), m_Specific(Op0))) ||
-      match(Op0, m_Sub(m_Value(Y), m_Specific(Op1))))
-    return Y;
-
-  // X + ~X -> -1   since   ~X = -X-1
-  if (match(Op0, m_Not(m_Specific(Op1))) ||
-      match(Op1, m_Not(m_Specific(Op0))))
-    return Constant::getAllOnesValue(Op0->getType());
+  // Try the structural simplifications from InstSimplifyPatterns.td.
+  if (Value *V = MatchPeepholePatterns(Instruction::Add, Op0, Op1))
+    return V;
 
   /// i1 add -> xor.
   if (MaxRecurse && Op0->getType()->isIntegerTy(1))
@@ -744,20 +734,11 @@ static Value *SimplifySubInst(Value *Op0, Value *Op1, bool isNSW, bool isNUW,
   if (match(Op0, m_Undef()) || match(Op1, m_Undef()))
     return UndefValue::get(Op0->getType());
 
-  // X - 0 -> X
-  if (match(Op1, m_Zero()))
-    return Op0;
-
-  // X - X -> 0
-  if (Op0 == Op1)
-    return Constant::getNullValue(Op0->getType());
+  // Try the structural simplifications from InstSimplifyPatterns.td.
+  if (Value *V = MatchPeepholePatterns(Instruction::Sub, Op0, Op1))
+    return V;
 
-  // (X*2) - X -> X
-  // (X<<1) - X -> X
   Value *X = 0;
-  if (match(Op0, m_Mul(m_Specific(Op1), m_ConstantInt<2>())) ||
-      match(Op0, m_Shl(m_Specific(Op1), m_One())))
-    return Op1;
 
   // (X + Y) - Z -> X + (Y - Z) or Y + (X - Z) if everything simplifies.
   // For example, (X + Y) - Y -> X; (Y + X) - Y -> X
@@ -987,13 +968,9 @@ static Value *SimplifyMulInst(Value *Op0, Value *Op1, const Query &Q,
   if (match(Op1, m_Undef()))
     return Constant::getNullValue(Op0->getType());
 
-  // X * 0 -> 0
-  if (match(Op1, m_Zero()))
-    return Op1;
-
-  // X * 1 -> X
-  if (match(Op1, m_One()))
-    return Op0;
+  // Try the structural simplifications from InstSimplifyPatterns.td.
+  if (Value *V = MatchPeepholePatterns(Instruction::Mul, Op0, Op1))
+    return V;
 
   // (X / Y) * Y -> X if the division is exact.
   Value *X = 0;
@@ -1435,33 +1412,9 @@ static Value *SimplifyAndInst(Value *Op0, Value *Op1, const Query &Q,
   if (match(Op1, m_Undef()))
     return Constant::getNullValue(Op0->getType());
 
-  // X & X = X
-  if (Op0 == Op1)
-    return Op0;
-
-  // X & 0 = 0
-  if (match(Op1, m_Zero()))
-    return Op1;
-
-  // X & -1 = X
-  if (match(Op1, m_AllOnes()))
-    return Op0;
-
-  // A & ~A  =  ~A & A  =  0
-  if (match(Op0, m_Not(m_Specific(Op1))) ||
-      match(Op1, m_Not(m_Specific(Op0))))
-    return Constant::getNullValue(Op0->getType());
-
-  // (A | ?) & A = A
-  Value *A = 0, *B = 0;
-  if (match(Op0, m_Or(m_Value(A), m_Value(B))) &&
-      (A == Op1 || B == Op1))
-    return Op1;
-
-  // A & (A | ?) = A
-  if (match(Op1, m_Or(m_Value(A), m_Value(B))) &&
-      (A == Op0 || B == Op0))
-    return Op0;
+  // Try the structural simplifications from InstSimplifyPatterns.td.
+  if (Value *V = MatchPeepholePatterns(Instruction::And, Op0, Op1))
+    return V;
 
   // A & (-A) = A if A is a power of two or zero.
   if (match(Op0, m_Neg(m_Specific(Op1))) ||
@@ -1534,43 +1487,9 @@ static Value *SimplifyOrInst(Value *Op0, Value *Op1, const Query &Q,
   if (match(Op1, m_Undef()))
     return Constant::getAllOnesValue(Op0->getType());
 
-  // X | X = X
-  if (Op0 == Op1)
-    return Op0;
-
-  // X | 0 = X
-  if (match(Op1, m_Zero()))
-    return Op0;
-
-  // X | -1 = -1
-  if (match(Op1, m_AllOnes()))
-    return Op1;
-
-  // A | ~A  =  ~A | A  =  -1
-  if (match(Op0, m_Not(m_Specific(Op1))) ||
-      match(Op1, m_Not(m_Specific(Op0))))
-    return Constant::getAllOnesValue(Op0->getType());
-
-  // (A & ?) | A = A
-  Value *A = 0, *B = 0;
-  if (match(Op0, m_And(m_Value(A), m_Value(B))) &&
-      (A == Op1 || B == Op1))
-    return Op1;
-
-  // A | (A & ?) = A
-  if (match(Op1, m_And(m_Value(A), m_Value(B))) &&
-      (A == Op0 || B == Op0))
-    return Op0;
-
-  // ~(A & ?) | A = -1
-  if (match(Op0, m_Not(m_And(m_Value(A), m_Value(B)))) &&
-      (A == Op1 || B == Op1))
-    return Constant::getAllOnesValue(Op1->getType());
-
-  // A | ~(A & ?) = -1
-  if (match(Op1, m_Not(m_And(m_Value(A), m_Value(B)))) &&
-      (A == Op0 || B == Op0))
-    return Constant::getAllOnesValue(Op0->getType());
+  // Try the structural simplifications from InstSimplifyPatterns.td.
+  if (Value *V = MatchPeepholePatterns(Instruction::Or, Op0, Op1))
+    return V;
 
   // Try some generic simplifications for associative operations.
   if (Value *V = SimplifyAssociativeBinOp(Instruction::Or, Op0, Op1, Q,
@@ -1628,18 +1547,9 @@ static Value *SimplifyXorInst(Value *Op0, Value *Op1, const Query &Q,
   if (match(Op1, m_Undef()))
     return Op1;
 
-  // A ^ 0 = A
-  if (match(Op1, m_Zero()))
-    return Op0;
-
-  // A ^ A = 0
-  if (Op0 == Op1)
-    return Constant::getNullValue(Op0->getType());
-
-  // A ^ ~A  =  ~A ^ A  =  -1
-  if (match(Op0, m_Not(m_Specific(Op1))) ||
-      match(Op1, m_Not(m_Specific(Op0))))
-    return Constant::getAllOnesValue(Op0->getType());
+  // Try the structural simplifications from InstSimplifyPatterns.td.
+  if (Value *V = MatchPeepholePatterns(Instruction::Xor, Op0, Op1))
+    return V;
 
   // Try some generic simplifications for associative operations.
   if (Value *V = SimplifyAssociativeBinOp(Instruction::Xor, Op0, Op1, Q,
@@ -149,6 +149,10 @@ unsigned TargetTransformInfo::getMaximumUnrollFactor() const {
   return PrevTTI->getMaximumUnrollFactor();
 }
 
+unsigned TargetTransformInfo::getCacheLineSize() const {
+  return PrevTTI->getCacheLineSize();
+}
+
 unsigned TargetTransformInfo::getArithmeticInstrCost(unsigned Opcode,
                                                 Type *Ty,
                                                 OperandValueKind Op1Info,
@@ -187,6 +191,15 @@ unsigned TargetTransformInfo::getMemoryOpCost(unsigned Opcode, Type *Src,
   ;
 }
 
+unsigned
+TargetTransformInfo::getInterleavedMemoryOpCost(unsigned Opcode, Type *VecTy,
+                                                unsigned Factor,
+                                                unsigned Alignment,
+                                                unsigned AddressSpace) const {
+  return PrevTTI->getInterleavedMemoryOpCost(Opcode, VecTy, Factor, Alignment,
+                                             AddressSpace);
+}
+
 unsigned
 TargetTransformInfo::getIntrinsicInstrCost(Intrinsic::ID ID,
                                            Type *RetTy,
@@ -497,6 +510,10 @@ struct NoTTI : ImmutablePass, TargetTransformInfo {
     return 1;
   }
 
+  unsigned getCacheLineSize() const {
+    return 64;
+  }
+
   unsigned getArithmeticInstrCost(unsigned Opcode, Type *Ty, OperandValueKind,
                                   OperandValueKind) const {
     return 1;
@@ -532,6 +549,12 @@ struct NoTTI : ImmutablePass, TargetTransformInfo {
     return 1;
   }
 
+  unsigned getInterleavedMemoryOpCost(unsigned Opcode, Type *VecTy,
+                                      unsigned Factor, unsigned Alignment,
+                                      unsigned AddressSpace) const {
+    return 1;
+  }
+
   unsigned getIntrinsicInstrCost(Intrinsic::ID ID,
                                  Type *RetTy,
                                  ArrayRef<Type*> Tys) const {
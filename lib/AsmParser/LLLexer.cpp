@@ -564,6 +564,8 @@ lltok::Kind LLLexer::LexIdentifier() {
 
   KEYWORD(alwaysinline);
   KEYWORD(byval);
+  KEYWORD(cold);
+  KEYWORD(hot);
   KEYWORD(inlinehint);
   KEYWORD(inreg);
   KEYWORD(minsize);
@@ -96,6 +96,8 @@ namespace lltok {
     kw_alwaysinline,
     kw_sanitize_address,
     kw_byval,
+    kw_cold,
+    kw_hot,
     kw_inlinehint,
     kw_inreg,
     kw_minsize,
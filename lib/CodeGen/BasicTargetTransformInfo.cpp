@@ -100,6 +100,10 @@ public:
   virtual unsigned getMemoryOpCost(unsigned Opcode, Type *Src,
                                    unsigned Alignment,
                                    unsigned AddressSpace) const;
+  virtual unsigned getInterleavedMemoryOpCost(unsigned Opcode, Type *VecTy,
+                                              unsigned Factor,
+                                              unsigned Alignment,
+                                              unsigned AddressSpace) const;
   virtual unsigned getIntrinsicInstrCost(Intrinsic::ID, Type *RetTy,
                                          ArrayRef<Type*> Tys) const;
   virtual unsigned getNumberOfParts(Type *Tp) const;
@@ -388,6 +392,27 @@ unsigned BasicTTI::getMemoryOpCost(unsigned Opcode, Type *Src,
   return LT.first;
 }
 
+unsigned BasicTTI::getInterleavedMemoryOpCost(unsigned Opcode, Type *VecTy,
+                                              unsigned Factor,
+                                              unsigned Alignment,
+                                              unsigned AddressSpace) const {
+  VectorType *VT = cast<VectorType>(VecTy);
+  unsigned NumElts = VT->getNumElements();
+  Type *WideTy = VectorType::get(VT->getElementType(), NumElts * Factor);
+
+  unsigned Cost = TopTTI->getMemoryOpCost(Opcode, WideTy, Alignment,
+                                          AddressSpace);
+
+  // We don't know how the target lowers the strided shuffles. Assume that
+  // each of the Factor vectors is assembled element by element.
+  for (unsigned i = 0; i < NumElts * Factor; ++i)
+    Cost += TopTTI->getVectorInstrCost(Instruction::ExtractElement, WideTy, i);
+  for (unsigned i = 0; i < Factor; ++i)
+    Cost += getScalarizationOverhead(VecTy, true, false);
+
+  return Cost;
+}
+
 unsigned BasicTTI::getIntrinsicInstrCost(Intrinsic::ID IID, Type *RetTy,
                                          ArrayRef<Type *> Tys) const {
   unsigned ISD = 0;
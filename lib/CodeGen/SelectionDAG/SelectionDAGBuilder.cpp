@@ -2108,6 +2108,31 @@ static APInt ComputeRange(const APInt &First, const APInt &Last) {
   return (LastExt - FirstExt + 1ULL);
 }
 
+/// isDenseForJumpTable - Return true if TSize case values spread over Range
+/// values are dense enough for a jump table.  The density is TSize / Range,
+/// and we require at least 40%.
+static bool isDenseForJumpTable(const APInt &TSize, const APInt &Range) {
+  // It should not be possible for IntTSize to saturate for sane code, but make
+  // sure we handle Range saturation correctly.
+  uint64_t IntRange = Range.getLimitedValue(UINT64_MAX/10);
+  uint64_t IntTSize = TSize.getLimitedValue(UINT64_MAX/10);
+  return IntTSize * 10 >= IntRange * 4;
+}
+
+/// isSuitableForBitTests - Return true if cases from Low to High that go to
+/// NumDests unique destinations and would take NumCmps comparisons are better
+/// lowered as a series of bit tests.
+static bool isSuitableForBitTests(unsigned NumDests, size_t NumCmps,
+                                  const APInt &Low, const APInt &High,
+                                  unsigned IntPtrBits) {
+  APInt CmpRange = High - Low;
+  if (NumDests > 3 || CmpRange.uge(IntPtrBits))
+    return false;
+  return (NumDests == 1 && NumCmps >= 3) ||
+         (NumDests == 2 && NumCmps >= 5) ||
+         (NumDests >= 3 && NumCmps >= 6);
+}
+
 /// handleJTSwitchCase - Emit jumptable for current switch case range
 bool SelectionDAGBuilder::handleJTSwitchCase(CaseRec &CR,
                                              CaseRecVector &WorkList,
@@ -2128,12 +2153,7 @@ bool SelectionDAGBuilder::handleJTSwitchCase(CaseRec &CR,
     return false;
 
   APInt Range = ComputeRange(First, Last);
-  // The density is TSize / Range. Require at least 40%.
-  // It should not be possible for IntTSize to saturate for sane code, but make
-  // sure we handle Range saturation correctly.
-  uint64_t IntRange = Range.getLimitedValue(UINT64_MAX/10);
-  uint64_t IntTSize = TSize.getLimitedValue(UINT64_MAX/10);
-  if (IntTSize * 10 < IntRange * 4)
+  if (!isDenseForJumpTable(TSize, Range))
     return false;
 
   DEBUG(dbgs() << "Lowering jump table\n"
@@ -2220,26 +2240,12 @@ bool SelectionDAGBuilder::handleJTSwitchCase(CaseRec &CR,
   return true;
 }
 
-/// handleBTSplitSwitchCase - emit comparison and split binary search tree into
-/// 2 subtrees.
-bool SelectionDAGBuilder::handleBTSplitSwitchCase(CaseRec& CR,
-                                                  CaseRecVector& WorkList,
-                                                  const Value* SV,
-                                                  MachineBasicBlock *Default,
-                                                  MachineBasicBlock *SwitchBB) {
-  // Get the MachineFunction which holds the current MBB.  This is used when
-  // inserting any additional MBBs necessary to represent the switch.
-  MachineFunction *CurMF = FuncInfo.MF;
-
-  // Figure out which block is immediately after the current one.
-  MachineFunction::iterator BBI = CR.CaseBB;
-  ++BBI;
-
-  Case& FrontCase = *CR.Range.first;
-  Case& BackCase  = *(CR.Range.second-1);
-  const BasicBlock *LLVMBB = CR.CaseBB->getBasicBlock();
-
-  // Size is the number of Cases represented by this range.
+/// getDensityPivot - Select the pivot that splits CR into the two densest
+/// halves, which (heuristically) allows us to emit jump tables later.
+SelectionDAGBuilder::CaseItr
+SelectionDAGBuilder::getDensityPivot(const CaseRec &CR) {
+  const Case &FrontCase = *CR.Range.first;
+  const Case &BackCase  = *(CR.Range.second-1);
   unsigned Size = CR.Range.second - CR.Range.first;
 
   const APInt &First = cast<ConstantInt>(FrontCase.Low)->getValue();
@@ -2247,8 +2253,6 @@ bool SelectionDAGBuilder::handleBTSplitSwitchCase(CaseRec& CR,
   double FMetric = 0;
   CaseItr Pivot = CR.Range.first + Size/2;
 
-  // Select optimal pivot, maximizing sum density of LHS and RHS. This will
-  // (heuristically) allow us to emit JumpTable's later.
   APInt TSize(First.getBitWidth(), 0);
   for (CaseItr I = CR.Range.first, E = CR.Range.second;
        I!=E; ++I)
@@ -2297,6 +2301,75 @@ bool SelectionDAGBuilder::handleBTSplitSwitchCase(CaseRec& CR,
     Pivot = CR.Range.first + Size/2;
   }
 
+  return Pivot;
+}
+
+/// getBalancedClusterPivot - Return the first case of the cluster that splits
+/// the clusters from Begin to End into two halves of about the same branch
+/// weight, so that the likely cases are reached with fewer comparisons.
+/// Without any weights, each cluster counts the same.
+SelectionDAGBuilder::CaseItr
+SelectionDAGBuilder::getBalancedClusterPivot(CaseItr Begin, CaseItr End) {
+  uint64_t TotalWeight = 0;
+  unsigned NumClusters = 0;
+  for (CaseItr I = Begin; I != End; ++I) {
+    TotalWeight += I->ExtraWeight;
+    if (I == Begin || I->Cluster != (I-1)->Cluster)
+      ++NumClusters;
+  }
+  bool UseWeights = TotalWeight != 0;
+  if (!UseWeights)
+    TotalWeight = NumClusters;
+
+  CaseItr Pivot = End;
+  uint64_t LeftWeight = 0, BestDiff = UINT64_MAX;
+  for (CaseItr I = Begin; I != End; ++I) {
+    bool StartsCluster = I == Begin || I->Cluster != (I-1)->Cluster;
+    if (StartsCluster && I != Begin) {
+      uint64_t RightWeight = TotalWeight - LeftWeight;
+      uint64_t Diff = LeftWeight > RightWeight ? LeftWeight - RightWeight
+                                               : RightWeight - LeftWeight;
+      if (Diff < BestDiff) {
+        Pivot = I;
+        BestDiff = Diff;
+      }
+    }
+    LeftWeight += UseWeights ? I->ExtraWeight : StartsCluster;
+  }
+  assert(Pivot != End && "Range has a single cluster!");
+  return Pivot;
+}
+
+/// handleBTSplitSwitchCase - emit comparison and split binary search tree into
+/// 2 subtrees.
+bool SelectionDAGBuilder::handleBTSplitSwitchCase(CaseRec& CR,
+                                                  CaseRecVector& WorkList,
+                                                  const Value* SV,
+                                                  MachineBasicBlock *Default,
+                                                  MachineBasicBlock *SwitchBB) {
+  // Get the MachineFunction which holds the current MBB.  This is used when
+  // inserting any additional MBBs necessary to represent the switch.
+  MachineFunction *CurMF = FuncInfo.MF;
+
+  // Figure out which block is immediately after the current one.
+  MachineFunction::iterator BBI = CR.CaseBB;
+  ++BBI;
+
+  Case& FrontCase = *CR.Range.first;
+  Case& BackCase  = *(CR.Range.second-1);
+  const BasicBlock *LLVMBB = CR.CaseBB->getBasicBlock();
+
+  CaseItr Pivot;
+  if (FrontCase.Cluster != BackCase.Cluster) {
+    // Split between clusters, so that each of them is still lowered in one
+    // piece further down the tree.
+    Pivot = getBalancedClusterPivot(CR.Range.first, CR.Range.second);
+    DEBUG(dbgs() << "Splitting clusters at: "
+                 << cast<ConstantInt>(Pivot->Low)->getValue() << '\n');
+  } else {
+    Pivot = getDensityPivot(CR);
+  }
+
   CaseRange LHSR(CR.Range.first, Pivot);
   CaseRange RHSR(Pivot, CR.Range.second);
   const Constant *C = Pivot->Low;
@@ -2402,10 +2475,8 @@ bool SelectionDAGBuilder::handleBitTestsSwitchCase(CaseRec& CR,
                << "Low bound: " << minValue << '\n'
                << "High bound: " << maxValue << '\n');
 
-  if (cmpRange.uge(IntPtrBits) ||
-      (!(Dests.size() == 1 && numCmps >= 3) &&
-       !(Dests.size() == 2 && numCmps >= 5) &&
-       !(Dests.size() >= 3 && numCmps >= 6)))
+  if (!isSuitableForBitTests(Dests.size(), numCmps, minValue, maxValue,
+                             IntPtrBits))
     return false;
 
   DEBUG(dbgs() << "Emitting bit tests\n");
@@ -2529,6 +2600,71 @@ size_t SelectionDAGBuilder::Clusterify(CaseVector& Cases,
   return numCmps;
 }
 
+/// PartitionCases - Split the sorted Cases into the fewest clusters that can
+/// each be lowered with a single jump table, a single set of bit tests, or a
+/// single comparison, and record the cluster of each case.  The binary search
+/// tree that visitSwitch builds then only splits between clusters.  Returns
+/// the number of clusters.
+unsigned SelectionDAGBuilder::PartitionCases(CaseVector &Cases) {
+  size_t N = Cases.size();
+  bool JTsAllowed = areJTsAllowed(TLI);
+  // If target does not have legal shift left, do not emit bit tests at all.
+  bool BTsAllowed = TLI.isOperationLegal(ISD::SHL, TLI.getPointerTy());
+  unsigned IntPtrBits = TLI.getPointerTy().getSizeInBits();
+  unsigned MinJTEntries = TLI.getMinimumJumpTableEntries();
+
+  // MinPartitions[i] is the smallest number of clusters that Cases[i..N) can
+  // be split into, and LastInCluster[i] is the last case of the first of
+  // those clusters.  Longer clusters win ties.
+  std::vector<unsigned> MinPartitions(N + 1), LastInCluster(N);
+  MinPartitions[N] = 0;
+  // The number of case values in Cases[i..N) bounds the range that a jump
+  // table starting at Cases[i] can span, which keeps sparse switches from
+  // taking quadratic time.
+  uint64_t RemainingValues = 0;
+  for (size_t i = N; i-- != 0; ) {
+    MinPartitions[i] = MinPartitions[i + 1] + 1;
+    LastInCluster[i] = i;
+
+    const APInt &First = cast<ConstantInt>(Cases[i].Low)->getValue();
+    APInt TSize = Cases[i].size();
+    RemainingValues = std::min(RemainingValues +
+                                 TSize.getLimitedValue(UINT64_MAX/20),
+                               UINT64_MAX/20);
+    size_t NumCmps = Cases[i].Low == Cases[i].High ? 1 : 2;
+    SmallSet<MachineBasicBlock*, 4> Dests;
+    Dests.insert(Cases[i].BB);
+    for (size_t j = i + 1; j != N; ++j) {
+      const APInt &Last = cast<ConstantInt>(Cases[j].High)->getValue();
+      APInt Range = ComputeRange(First, Last);
+      if (Range.ugt(IntPtrBits) &&
+          Range.getLimitedValue(UINT64_MAX/10) * 4 > RemainingValues * 10)
+        break;
+
+      TSize += Cases[j].size();
+      NumCmps += Cases[j].Low == Cases[j].High ? 1 : 2;
+      if (Dests.size() <= 3)
+        Dests.insert(Cases[j].BB);
+
+      bool IsCluster =
+        (JTsAllowed && TSize.uge(MinJTEntries) &&
+         isDenseForJumpTable(TSize, Range)) ||
+        (BTsAllowed &&
+         isSuitableForBitTests(Dests.size(), NumCmps, First, Last, IntPtrBits));
+      if (IsCluster && MinPartitions[j + 1] + 1 <= MinPartitions[i]) {
+        MinPartitions[i] = MinPartitions[j + 1] + 1;
+        LastInCluster[i] = j;
+      }
+    }
+  }
+
+  unsigned NumClusters = 0;
+  for (size_t i = 0; i != N; ++NumClusters)
+    for (size_t e = LastInCluster[i] + 1; i != e; ++i)
+      Cases[i].Cluster = NumClusters;
+  return NumClusters;
+}
+
 void SelectionDAGBuilder::UpdateSplitBlock(MachineBasicBlock *First,
                                            MachineBasicBlock *Last) {
   // Update JTCases.
@@ -2573,6 +2709,10 @@ void SelectionDAGBuilder::visitSwitch(const SwitchInst &SI) {
                << ". Total compares: " << numCmps << '\n');
   (void)numCmps;
 
+  unsigned NumClusters = PartitionCases(Cases);
+  DEBUG(dbgs() << "Partitioned into " << NumClusters << " clusters\n");
+  (void)NumClusters;
+
   // Get the Value to be switched on and default basic blocks, which will be
   // inserted into CaseBlock records, representing basic blocks in the binary
   // search tree.
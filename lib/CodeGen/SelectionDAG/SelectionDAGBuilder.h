@@ -133,11 +133,15 @@ private:
     const Constant *High;
     MachineBasicBlock* BB;
     uint32_t ExtraWeight;
+    /// Cluster - The index of the cluster that PartitionCases put this case
+    /// in.  Each cluster is lowered as one jump table, one set of bit tests,
+    /// or a single comparison.
+    unsigned Cluster;
 
-    Case() : Low(0), High(0), BB(0), ExtraWeight(0) { }
+    Case() : Low(0), High(0), BB(0), ExtraWeight(0), Cluster(0) { }
     Case(const Constant *low, const Constant *high, MachineBasicBlock *bb,
          uint32_t extraweight) : Low(low), High(high), BB(bb),
-         ExtraWeight(extraweight) { }
+         ExtraWeight(extraweight), Cluster(0) { }
 
     APInt size() const {
       const APInt &rHigh = cast<ConstantInt>(High)->getValue();
@@ -189,6 +193,9 @@ private:
   };
 
   size_t Clusterify(CaseVector &Cases, const SwitchInst &SI);
+  unsigned PartitionCases(CaseVector &Cases);
+  CaseItr getDensityPivot(const CaseRec &CR);
+  static CaseItr getBalancedClusterPivot(CaseItr Begin, CaseItr End);
 
   /// CaseBlock - This structure is used to communicate between
   /// SelectionDAGBuilder and SDISel for the code generation of additional basic
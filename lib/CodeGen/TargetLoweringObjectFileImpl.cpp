@@ -233,6 +233,19 @@ static const char *getSectionPrefixForGlobal(SectionKind Kind) {
 }
 
 
+/// getTextSectionPrefix - Return the prefix of the section that the function
+/// GV goes in: ".text.hot" or ".text.unlikely" when it is marked hot or cold,
+/// so that the linker groups the hot and the cold code, or ".text" otherwise.
+static StringRef getTextSectionPrefix(const GlobalValue *GV) {
+  if (const Function *F = dyn_cast<Function>(GV)) {
+    if (F->hasFnAttribute(Attribute::Hot))
+      return ".text.hot";
+    if (F->hasFnAttribute(Attribute::Cold))
+      return ".text.unlikely";
+  }
+  return ".text";
+}
+
 const MCSection *TargetLoweringObjectFileELF::
 SelectSectionForGlobal(const GlobalValue *GV, SectionKind Kind,
                        Mangler *Mang, const TargetMachine &TM) const {
@@ -248,10 +261,13 @@ SelectSectionForGlobal(const GlobalValue *GV, SectionKind Kind,
   // into a 'uniqued' section name, create and return the section now.
   if ((GV->isWeakForLinker() || EmitUniquedSection) &&
       !Kind.isCommon()) {
-    const char *Prefix;
-    Prefix = getSectionPrefixForGlobal(Kind);
-
-    SmallString<128> Name(Prefix, Prefix+strlen(Prefix));
+    SmallString<128> Name;
+    if (Kind.isText()) {
+      Name = getTextSectionPrefix(GV);
+      Name += '.';
+    } else {
+      Name = getSectionPrefixForGlobal(Kind);
+    }
     MCSymbol *Sym = Mang->getSymbol(GV);
     Name.append(Sym->getName().begin(), Sym->getName().end());
     StringRef Group = "";
@@ -266,7 +282,14 @@ SelectSectionForGlobal(const GlobalValue *GV, SectionKind Kind,
                                       Flags, Kind, 0, Group);
   }
 
-  if (Kind.isText()) return TextSection;
+  if (Kind.isText()) {
+    StringRef Prefix = getTextSectionPrefix(GV);
+    if (Prefix == ".text")
+      return TextSection;
+    return getContext().getELFSection(Prefix, ELF::SHT_PROGBITS,
+                                      ELF::SHF_EXECINSTR | ELF::SHF_ALLOC,
+                                      Kind);
+  }
 
   if (Kind.isMergeable1ByteCString() ||
       Kind.isMergeable2ByteCString() ||
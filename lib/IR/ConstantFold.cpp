@@ -867,6 +867,126 @@ Constant *llvm::ConstantFoldInsertValueInstruction(Constant *Agg,
 }
 
 
+/// FoldIntDataElement - Fold one element of an integer binary operator over
+/// ConstantDataVectors.  Return false if the result is not a plain integer
+/// (e.g. division by zero or an oversized shift), which the elementwise folder
+/// turns into undef or leaves unfolded.
+static bool FoldIntDataElement(unsigned Opcode, const APInt &C1V,
+                               const APInt &C2V, APInt &Res) {
+  switch (Opcode) {
+  default:
+    return false;
+  case Instruction::Add: Res = C1V + C2V; return true;
+  case Instruction::Sub: Res = C1V - C2V; return true;
+  case Instruction::Mul: Res = C1V * C2V; return true;
+  case Instruction::And: Res = C1V & C2V; return true;
+  case Instruction::Or:  Res = C1V | C2V; return true;
+  case Instruction::Xor: Res = C1V ^ C2V; return true;
+  case Instruction::UDiv:
+  case Instruction::URem:
+    if (!C2V)
+      return false;
+    Res = Opcode == Instruction::UDiv ? C1V.udiv(C2V) : C1V.urem(C2V);
+    return true;
+  case Instruction::SDiv:
+  case Instruction::SRem:
+    if (!C2V || (C2V.isAllOnesValue() && C1V.isMinSignedValue()))
+      return false;
+    Res = Opcode == Instruction::SDiv ? C1V.sdiv(C2V) : C1V.srem(C2V);
+    return true;
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr: {
+    if (C2V.uge(C1V.getBitWidth()))
+      return false;
+    unsigned ShiftAmt = C2V.getZExtValue();
+    if (Opcode == Instruction::Shl)
+      Res = C1V.shl(ShiftAmt);
+    else if (Opcode == Instruction::LShr)
+      Res = C1V.lshr(ShiftAmt);
+    else
+      Res = C1V.ashr(ShiftAmt);
+    return true;
+  }
+  }
+}
+
+template <typename T>
+static Constant *FoldIntDataVector(unsigned Opcode, ConstantDataVector *CV1,
+                                   ConstantDataVector *CV2) {
+  unsigned BitWidth = CV1->getElementType()->getIntegerBitWidth();
+  SmallVector<T, 16> Elts;
+  Elts.reserve(CV1->getNumElements());
+  APInt Res;
+  for (unsigned i = 0, e = CV1->getNumElements(); i != e; ++i) {
+    APInt C1V(BitWidth, CV1->getElementAsInteger(i));
+    APInt C2V(BitWidth, CV2->getElementAsInteger(i));
+    if (!FoldIntDataElement(Opcode, C1V, C2V, Res))
+      return 0;
+    Elts.push_back(T(Res.getZExtValue()));
+  }
+  return ConstantDataVector::get(CV1->getContext(), Elts);
+}
+
+template <typename T>
+static Constant *FoldFPDataVector(unsigned Opcode, ConstantDataVector *CV1,
+                                  ConstantDataVector *CV2) {
+  SmallVector<T, 16> Elts;
+  Elts.reserve(CV1->getNumElements());
+  for (unsigned i = 0, e = CV1->getNumElements(); i != e; ++i) {
+    APFloat C3V = CV1->getElementAsAPFloat(i);
+    APFloat C2V = CV2->getElementAsAPFloat(i);
+    switch (Opcode) {
+    default:
+      return 0;
+    case Instruction::FAdd:
+      (void)C3V.add(C2V, APFloat::rmNearestTiesToEven);
+      break;
+    case Instruction::FSub:
+      (void)C3V.subtract(C2V, APFloat::rmNearestTiesToEven);
+      break;
+    case Instruction::FMul:
+      (void)C3V.multiply(C2V, APFloat::rmNearestTiesToEven);
+      break;
+    case Instruction::FDiv:
+      (void)C3V.divide(C2V, APFloat::rmNearestTiesToEven);
+      break;
+    case Instruction::FRem:
+      (void)C3V.mod(C2V, APFloat::rmNearestTiesToEven);
+      break;
+    }
+    if (sizeof(T) == sizeof(float))
+      Elts.push_back(C3V.convertToFloat());
+    else
+      Elts.push_back(C3V.convertToDouble());
+  }
+  return ConstantDataVector::get(CV1->getContext(), Elts);
+}
+
+/// FoldDataVectorBinaryInstruction - Fold a binary operator whose operands are
+/// both ConstantDataVectors directly on their element data.  Unlike the
+/// elementwise path through ConstantExpr::get, this only creates the final
+/// result constant rather than uniquing a scalar constant for every input and
+/// output element.  Return null if the operator can't be folded this way.
+static Constant *FoldDataVectorBinaryInstruction(unsigned Opcode,
+                                                 ConstantDataVector *CV1,
+                                                 ConstantDataVector *CV2) {
+  Type *EltTy = CV1->getElementType();
+  if (EltTy->isIntegerTy(8))
+    return FoldIntDataVector<uint8_t>(Opcode, CV1, CV2);
+  if (EltTy->isIntegerTy(16))
+    return FoldIntDataVector<uint16_t>(Opcode, CV1, CV2);
+  if (EltTy->isIntegerTy(32))
+    return FoldIntDataVector<uint32_t>(Opcode, CV1, CV2);
+  if (EltTy->isIntegerTy(64))
+    return FoldIntDataVector<uint64_t>(Opcode, CV1, CV2);
+  if (EltTy->isFloatTy())
+    return FoldFPDataVector<float>(Opcode, CV1, CV2);
+  if (EltTy->isDoubleTy())
+    return FoldFPDataVector<double>(Opcode, CV1, CV2);
+  return 0;
+}
+
 Constant *llvm::ConstantFoldBinaryInstruction(unsigned Opcode,
                                               Constant *C1, Constant *C2) {
   // Handle UndefValue up front.
@@ -1133,6 +1253,12 @@ Constant *llvm::ConstantFoldBinaryInstruction(unsigned Opcode,
       }
     }
   } else if (VectorType *VTy = dyn_cast<VectorType>(C1->getType())) {
+    // Fold the common case of two ConstantDataVectors in bulk.
+    if (ConstantDataVector *CV1 = dyn_cast<ConstantDataVector>(C1))
+      if (ConstantDataVector *CV2 = dyn_cast<ConstantDataVector>(C2))
+        if (Constant *Res = FoldDataVectorBinaryInstruction(Opcode, CV1, CV2))
+          return Res;
+
     // Perform elementwise folding.
     SmallVector<Constant*, 16> Result;
     Type *Ty = IntegerType::get(VTy->getContext(), 32);
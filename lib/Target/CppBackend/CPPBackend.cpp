@@ -510,6 +510,8 @@ void CppWriter::printAttributes(const AttributeSet &PAL,
       HANDLE_ATTR(UWTable);
       HANDLE_ATTR(NonLazyBind);
       HANDLE_ATTR(MinSize);
+      HANDLE_ATTR(Cold);
+      HANDLE_ATTR(Hot);
 #undef HANDLE_ATTR
 
       if (attrs.contains(Attribute::StackAlignment)) {
@@ -0,0 +1,176 @@
+//===- FunctionHotness.cpp - Mark hot and cold functions from a profile ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass uses the execution counts of a loaded profile to mark functions
+// 'hot' or 'cold'.  The code generator places such functions in .text.hot and
+// .text.unlikely on ELF targets, which keeps the working set of a large
+// program on fewer pages.  A function is hot when its hottest block runs at
+// least -hot-function-ratio times as often as the hottest block in the module,
+// and cold when it runs at most -cold-function-ratio times as often, which
+// includes functions that never ran.  Attributes that are already there are
+// left alone.
+//
+// With -function-order-file, the names of the hot functions are also written
+// to a file, hottest first, one per line, for the linker's symbol ordering
+// option.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "function-hotness"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ProfileInfo.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumHot,  "Number of functions marked hot");
+STATISTIC(NumCold, "Number of functions marked cold");
+
+static cl::opt<double>
+HotFunctionRatio("hot-function-ratio", cl::Hidden, cl::init(0.01),
+                 cl::desc("Functions whose hottest block runs at least this "
+                          "fraction of the hottest block's count are hot"));
+
+static cl::opt<double>
+ColdFunctionRatio("cold-function-ratio", cl::Hidden, cl::init(0.0001),
+                  cl::desc("Functions whose hottest block runs at most this "
+                           "fraction of the hottest block's count are cold"));
+
+static cl::opt<std::string>
+FunctionOrderFile("function-order-file", cl::Hidden,
+                  cl::value_desc("filename"),
+                  cl::desc("Write the names of the hot functions, hottest "
+                           "first, to this file"));
+
+namespace {
+  struct FunctionHotness : public ModulePass {
+    static char ID; // Pass identification, replacement for typeid
+    FunctionHotness() : ModulePass(ID) {
+      initializeFunctionHotnessPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnModule(Module &M);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<ProfileInfo>();
+      AU.addPreserved<ProfileInfo>();
+    }
+  };
+
+  typedef std::pair<double, Function*> CountAndFunction;
+
+  /// HotterThan - Sort the hottest functions first, and functions with the
+  /// same count in module order.
+  struct HotterThan {
+    bool operator()(const CountAndFunction &LHS,
+                    const CountAndFunction &RHS) const {
+      return LHS.first > RHS.first;
+    }
+  };
+}
+
+char FunctionHotness::ID = 0;
+INITIALIZE_PASS_BEGIN(FunctionHotness, "function-hotness",
+                      "Mark hot and cold functions from a profile",
+                      false, false)
+INITIALIZE_AG_DEPENDENCY(ProfileInfo)
+INITIALIZE_PASS_END(FunctionHotness, "function-hotness",
+                    "Mark hot and cold functions from a profile",
+                    false, false)
+
+ModulePass *llvm::createFunctionHotnessPass() {
+  return new FunctionHotness();
+}
+
+/// getMaxBlockCount - Return the execution count of the hottest block in F,
+/// or ProfileInfo::MissingValue if the profile does not cover F.
+static double getMaxBlockCount(const Function &F, ProfileInfo &PI) {
+  double Count = PI.getExecutionCount(&F);
+  if (Count == ProfileInfo::MissingValue || Count == 0)
+    return Count;
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    Count = std::max(Count, PI.getExecutionCount(BB));
+  return Count;
+}
+
+bool FunctionHotness::runOnModule(Module &M) {
+  ProfileInfo &PI = getAnalysis<ProfileInfo>();
+
+  SmallVector<CountAndFunction, 64> Counts;
+  double Max = 0;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+    double Count = getMaxBlockCount(*F, PI);
+    if (Count == ProfileInfo::MissingValue)
+      continue;
+    Counts.push_back(std::make_pair(Count, &*F));
+    Max = std::max(Max, Count);
+  }
+  // Without any counts there is nothing to compare against.
+  if (Max == 0)
+    return false;
+
+  std::stable_sort(Counts.begin(), Counts.end(), HotterThan());
+
+  bool Changed = false;
+  SmallVector<Function*, 16> Hot;
+  for (unsigned i = 0, e = Counts.size(); i != e; ++i) {
+    double Count = Counts[i].first;
+    Function *F = Counts[i].second;
+    if (F->hasFnAttribute(Attribute::Hot)) {
+      Hot.push_back(F);
+      continue;
+    }
+    if (F->hasFnAttribute(Attribute::Cold))
+      continue;
+
+    if (Count >= Max * HotFunctionRatio) {
+      DEBUG(dbgs() << "function-hotness: " << F->getName() << " is hot ("
+                   << Count << ")\n");
+      F->addFnAttr(Attribute::Hot);
+      Hot.push_back(F);
+      ++NumHot;
+      Changed = true;
+    } else if (Count <= Max * ColdFunctionRatio) {
+      DEBUG(dbgs() << "function-hotness: " << F->getName() << " is cold ("
+                   << Count << ")\n");
+      F->addFnAttr(Attribute::Cold);
+      ++NumCold;
+      Changed = true;
+    }
+  }
+
+  if (!FunctionOrderFile.empty()) {
+    std::string ErrorInfo;
+    raw_fd_ostream File(FunctionOrderFile.c_str(), ErrorInfo);
+    if (!ErrorInfo.empty()) {
+      errs() << "error opening '" << FunctionOrderFile << "' for writing: "
+             << ErrorInfo << '\n';
+      return Changed;
+    }
+    // A leading \1 means "use this name as is"; it is not part of the symbol.
+    for (unsigned i = 0, e = Hot.size(); i != e; ++i) {
+      StringRef Name = Hot[i]->getName();
+      if (Name.startswith("\1"))
+        Name = Name.substr(1);
+      if (!Name.empty())
+        File << Name << '\n';
+    }
+  }
+
+  return Changed;
+}
@@ -32,6 +32,7 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/GetElementPtrTypeIterator.h"
@@ -39,6 +40,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetLibraryInfo.h"
 #include <algorithm>
+#include <map>
 using namespace llvm;
 
 STATISTIC(NumMarked    , "Number of globals marked constant");
@@ -57,6 +59,12 @@ STATISTIC(NumNestRemoved   , "Number of nest attributes removed");
 STATISTIC(NumAliasesResolved, "Number of global aliases resolved");
 STATISTIC(NumAliasesRemoved, "Number of global aliases eliminated");
 STATISTIC(NumCXXDtorsRemoved, "Number of global C++ destructors removed");
+STATISTIC(NumCallsMemoized , "Number of calls evaluated from memoized results");
+
+static cl::opt<unsigned>
+EvalBudget("globalopt-eval-budget", cl::Hidden, cl::init(100000),
+           cl::desc("Maximum number of instructions to interpret when "
+                    "evaluating a static constructor (default = 100000)"));
 
 namespace {
   struct GlobalStatus;
@@ -2465,7 +2473,7 @@ namespace {
 class Evaluator {
 public:
   Evaluator(const DataLayout *TD, const TargetLibraryInfo *TLI)
-    : TD(TD), TLI(TLI) {
+    : StepsLeft(EvalBudget), MemoryAccesses(0), TD(TD), TLI(TLI) {
     ValueStack.push_back(new DenseMap<Value*, Constant*>);
   }
 
@@ -2516,6 +2524,9 @@ public:
 
 private:
   Constant *ComputeLoadResult(Constant *P);
+  bool getLeafPointers(Constant *Ptr, SmallVectorImpl<Constant*> &Leaves);
+  bool EvaluateMemSet(Constant *Dest, Constant *Val, Constant *Len);
+  bool EvaluateMemTransfer(Constant *Dest, Constant *Src, Constant *Len);
 
   /// ValueStack - As we compute SSA register values, we store their contents
   /// here. The back of the vector contains the current function and the stack
@@ -2545,6 +2556,20 @@ private:
   /// simple enough to live in a static initializer of a global.
   SmallPtrSet<Constant*, 8> SimpleConstants;
 
+  /// StepsLeft - The number of instructions that may still be interpreted
+  /// before we give up.  This is what bounds loops.
+  unsigned StepsLeft;
+
+  /// MemoryAccesses - The number of loads, stores and allocas interpreted so
+  /// far.  A call that does not change it only depends on its arguments.
+  unsigned MemoryAccesses;
+
+  /// MemoizedCalls - The results of calls that only depend on their
+  /// arguments, so that small helper functions called over and over again
+  /// are only interpreted once per set of arguments.
+  typedef std::pair<Function*, std::vector<Constant*> > CallKey;
+  std::map<CallKey, Constant*> MemoizedCalls;
+
   const DataLayout *TD;
   const TargetLibraryInfo *TLI;
 };
@@ -2579,6 +2604,123 @@ Constant *Evaluator::ComputeLoadResult(Constant *P) {
   return 0;  // don't know how to evaluate.
 }
 
+/// getLeafPointers - Add to Leaves a pointer to each scalar element of the
+/// memory that Ptr points to, in the same canonical form as the pointers that
+/// loads and stores use.  Each leaf costs one step of the budget; return false
+/// if we run out.
+bool Evaluator::getLeafPointers(Constant *Ptr,
+                                SmallVectorImpl<Constant*> &Leaves) {
+  Type *Ty = cast<PointerType>(Ptr->getType())->getElementType();
+  if (Ty->isSingleValueType()) {
+    if (StepsLeft == 0)
+      return false;
+    --StepsLeft;
+    Leaves.push_back(Ptr);
+    return true;
+  }
+
+  uint64_t NumElts;
+  if (StructType *STy = dyn_cast<StructType>(Ty))
+    NumElts = STy->getNumElements();
+  else if (ArrayType *ATy = dyn_cast<ArrayType>(Ty))
+    NumElts = ATy->getNumElements();
+  else
+    return false;
+  if (NumElts > StepsLeft)
+    return false;
+
+  Type *Int32Ty = Type::getInt32Ty(Ptr->getContext());
+  for (uint64_t i = 0; i != NumElts; ++i) {
+    Constant *Idxs[] = {
+      ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, i)
+    };
+    Constant *Elt = ConstantExpr::getInBoundsGetElementPtr(Ptr, Idxs);
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(Elt))
+      Elt = ConstantFoldConstantExpression(CE, TD, TLI);
+    if (!getLeafPointers(Elt, Leaves))
+      return false;
+  }
+  return true;
+}
+
+/// EvaluateMemSet - Evaluate a memset of Len bytes of value Val to Dest, which
+/// must cover a whole global or element of one.  Each scalar in it is stored
+/// to separately, so that later loads see them.
+bool Evaluator::EvaluateMemSet(Constant *Dest, Constant *Val, Constant *Len) {
+  ConstantInt *Byte = dyn_cast<ConstantInt>(Val);
+  ConstantInt *Size = dyn_cast<ConstantInt>(Len);
+  if (!TD || !Byte || !Size)
+    return false;
+
+  Dest = cast<Constant>(Dest->stripPointerCasts());
+  Type *Ty = cast<PointerType>(Dest->getType())->getElementType();
+  if (!Ty->isSized() || Size->getZExtValue() != TD->getTypeAllocSize(Ty))
+    return false;
+
+  SmallVector<Constant*, 32> Leaves;
+  if (!getLeafPointers(Dest, Leaves))
+    return false;
+
+  SmallVector<Constant*, 32> Vals;
+  for (unsigned i = 0, e = Leaves.size(); i != e; ++i) {
+    if (!isSimpleEnoughPointerToCommit(Leaves[i]))
+      return false;
+    Type *LeafTy = cast<PointerType>(Leaves[i]->getType())->getElementType();
+    if (Byte->isZero()) {
+      Vals.push_back(Constant::getNullValue(LeafTy));
+      continue;
+    }
+    // Other bytes can only be splatted into integers.
+    IntegerType *IT = dyn_cast<IntegerType>(LeafTy);
+    if (!IT || IT->getBitWidth() % 8 != 0)
+      return false;
+    Vals.push_back(ConstantInt::get(IT,
+      APInt::getSplat(IT->getBitWidth(), Byte->getValue())));
+  }
+
+  for (unsigned i = 0, e = Leaves.size(); i != e; ++i)
+    MutatedMemory[Leaves[i]] = Vals[i];
+  ++MemoryAccesses;
+  return true;
+}
+
+/// EvaluateMemTransfer - Evaluate a memcpy or memmove of Len bytes from Src to
+/// Dest, which must point to the same type and be copied whole.  All of Src is
+/// read before anything is written, so overlap does not matter.
+bool Evaluator::EvaluateMemTransfer(Constant *Dest, Constant *Src,
+                                    Constant *Len) {
+  ConstantInt *Size = dyn_cast<ConstantInt>(Len);
+  if (!TD || !Size)
+    return false;
+
+  Dest = cast<Constant>(Dest->stripPointerCasts());
+  Src = cast<Constant>(Src->stripPointerCasts());
+  if (Dest->getType() != Src->getType())
+    return false;
+  Type *Ty = cast<PointerType>(Dest->getType())->getElementType();
+  if (!Ty->isSized() || Size->getZExtValue() != TD->getTypeAllocSize(Ty))
+    return false;
+
+  SmallVector<Constant*, 32> DestLeaves, SrcLeaves;
+  if (!getLeafPointers(Dest, DestLeaves) || !getLeafPointers(Src, SrcLeaves))
+    return false;
+  assert(DestLeaves.size() == SrcLeaves.size() && "Same type, same leaves!");
+
+  SmallVector<Constant*, 32> Vals;
+  for (unsigned i = 0, e = SrcLeaves.size(); i != e; ++i) {
+    Constant *V = ComputeLoadResult(SrcLeaves[i]);
+    if (!V || !isSimpleEnoughPointerToCommit(DestLeaves[i]) ||
+        !isSimpleEnoughValueToCommit(V, SimpleConstants, TD))
+      return false;
+    Vals.push_back(V);
+  }
+
+  for (unsigned i = 0, e = DestLeaves.size(); i != e; ++i)
+    MutatedMemory[DestLeaves[i]] = Vals[i];
+  ++MemoryAccesses;
+  return true;
+}
+
 /// EvaluateBlock - Evaluate all instructions in block BB, returning true if
 /// successful, false if we can't evaluate it.  NewBB returns the next BB that
 /// control flows into, or null upon return.
@@ -2588,6 +2730,12 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
   while (1) {
     Constant *InstResult = 0;
 
+    if (StepsLeft == 0) {
+      DEBUG(dbgs() << "Evaluation budget exhausted. Can not evaluate.\n");
+      return false;
+    }
+    --StepsLeft;
+
     DEBUG(dbgs() << "Evaluating Instruction: " << *CurInst << "\n");
 
     if (StoreInst *SI = dyn_cast<StoreInst>(CurInst)) {
@@ -2663,6 +2811,7 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
       }
 
       MutatedMemory[Ptr] = Val;
+      ++MemoryAccesses;
     } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(CurInst)) {
       InstResult = ConstantExpr::get(BO->getOpcode(),
                                      getVal(BO->getOperand(0)),
@@ -2687,6 +2836,35 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
                                            getVal(SI->getOperand(2)));
       DEBUG(dbgs() << "Found a Select! Simplifying: " << *InstResult
             << "\n");
+    } else if (ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(CurInst)) {
+      InstResult = ConstantExpr::getExtractValue(
+                     getVal(EVI->getAggregateOperand()), EVI->getIndices());
+      DEBUG(dbgs() << "Found an ExtractValueInst! Simplifying: " << *InstResult
+            << "\n");
+    } else if (InsertValueInst *IVI = dyn_cast<InsertValueInst>(CurInst)) {
+      InstResult = ConstantExpr::getInsertValue(
+                     getVal(IVI->getAggregateOperand()),
+                     getVal(IVI->getInsertedValueOperand()), IVI->getIndices());
+      DEBUG(dbgs() << "Found an InsertValueInst! Simplifying: " << *InstResult
+            << "\n");
+    } else if (ExtractElementInst *EEI =
+                 dyn_cast<ExtractElementInst>(CurInst)) {
+      InstResult = ConstantExpr::getExtractElement(getVal(EEI->getOperand(0)),
+                                                   getVal(EEI->getOperand(1)));
+      DEBUG(dbgs() << "Found an ExtractElementInst! Simplifying: "
+            << *InstResult << "\n");
+    } else if (InsertElementInst *IEI = dyn_cast<InsertElementInst>(CurInst)) {
+      InstResult = ConstantExpr::getInsertElement(getVal(IEI->getOperand(0)),
+                                                  getVal(IEI->getOperand(1)),
+                                                  getVal(IEI->getOperand(2)));
+      DEBUG(dbgs() << "Found an InsertElementInst! Simplifying: "
+            << *InstResult << "\n");
+    } else if (ShuffleVectorInst *SVI = dyn_cast<ShuffleVectorInst>(CurInst)) {
+      InstResult = ConstantExpr::getShuffleVector(getVal(SVI->getOperand(0)),
+                                                  getVal(SVI->getOperand(1)),
+                                                  getVal(SVI->getOperand(2)));
+      DEBUG(dbgs() << "Found a ShuffleVectorInst! Simplifying: "
+            << *InstResult << "\n");
     } else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(CurInst)) {
       Constant *P = getVal(GEP->getOperand(0));
       SmallVector<Constant*, 8> GEPOps;
@@ -2717,6 +2895,7 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
               "\n");
         return false; // Could not evaluate load.
       }
+      ++MemoryAccesses;
 
       DEBUG(dbgs() << "Evaluated load: " << *InstResult << "\n");
     } else if (AllocaInst *AI = dyn_cast<AllocaInst>(CurInst)) {
@@ -2730,6 +2909,7 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
                                               UndefValue::get(Ty),
                                               AI->getName()));
       InstResult = AllocaTmps.back();
+      ++MemoryAccesses;
       DEBUG(dbgs() << "Found an alloca. Result: " << *InstResult << "\n");
     } else if (isa<CallInst>(CurInst) || isa<InvokeInst>(CurInst)) {
       CallSite CS(CurInst);
@@ -2757,12 +2937,35 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
           Constant *Ptr = getVal(MSI->getDest());
           Constant *Val = getVal(MSI->getValue());
           Constant *DestVal = ComputeLoadResult(getVal(Ptr));
+          ++MemoryAccesses;
           if (Val->isNullValue() && DestVal && DestVal->isNullValue()) {
             // This memset is a no-op.
             DEBUG(dbgs() << "Ignoring no-op memset.\n");
             ++CurInst;
             continue;
           }
+          if (EvaluateMemSet(Ptr, Val, getVal(MSI->getLength()))) {
+            DEBUG(dbgs() << "Evaluated memset.\n");
+            ++CurInst;
+            continue;
+          }
+        }
+
+        if (MemTransferInst *MTI = dyn_cast<MemTransferInst>(II)) {
+          if (!MTI->isVolatile() &&
+              EvaluateMemTransfer(getVal(MTI->getRawDest()),
+                                  getVal(MTI->getRawSource()),
+                                  getVal(MTI->getLength()))) {
+            DEBUG(dbgs() << "Evaluated memcpy or memmove.\n");
+            ++CurInst;
+            continue;
+          }
+        }
+
+        if (II->getIntrinsicID() == Intrinsic::expect) {
+          setVal(II, getVal(II->getArgOperand(0)));
+          ++CurInst;
+          continue;
         }
 
         if (II->getIntrinsicID() == Intrinsic::lifetime_start ||
@@ -2781,6 +2984,7 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
           }
           ConstantInt *Size = cast<ConstantInt>(II->getArgOperand(0));
           Value *PtrArg = getVal(II->getArgOperand(1));
+          ++MemoryAccesses;
           Value *Ptr = PtrArg->stripPointerCasts();
           if (GlobalVariable *GV = dyn_cast<GlobalVariable>(Ptr)) {
             Type *ElemTy = cast<PointerType>(GV->getType())->getElementType();
@@ -2800,8 +3004,12 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
           continue;
         }
 
-        DEBUG(dbgs() << "Unknown intrinsic. Can not evaluate.\n");
-        return false;
+        // Intrinsics that the constant folder knows about are evaluated like
+        // calls to library functions below.
+        if (!canConstantFoldCallTo(II->getCalledFunction())) {
+          DEBUG(dbgs() << "Unknown intrinsic. Can not evaluate.\n");
+          return false;
+        }
       }
 
       // Resolve function pointers.
@@ -2831,15 +3039,29 @@ bool Evaluator::EvaluateBlock(BasicBlock::iterator CurInst,
           return false;
         }
 
-        Constant *RetVal = 0;
-        // Execute the call, if successful, use the return value.
-        ValueStack.push_back(new DenseMap<Value*, Constant*>);
-        if (!EvaluateFunction(Callee, RetVal, Formals)) {
-          DEBUG(dbgs() << "Failed to evaluate function.\n");
-          return false;
+        // If we have already made this call, and it did not touch memory,
+        // reuse the result.
+        CallKey Key(Callee, std::vector<Constant*>(Formals.begin(),
+                                                   Formals.end()));
+        std::map<CallKey, Constant*>::iterator Memo = MemoizedCalls.find(Key);
+        if (Memo != MemoizedCalls.end()) {
+          DEBUG(dbgs() << "Reusing the result of an earlier call.\n");
+          ++NumCallsMemoized;
+          InstResult = Memo->second;
+        } else {
+          Constant *RetVal = 0;
+          unsigned AccessesBefore = MemoryAccesses;
+          // Execute the call, if successful, use the return value.
+          ValueStack.push_back(new DenseMap<Value*, Constant*>);
+          if (!EvaluateFunction(Callee, RetVal, Formals)) {
+            DEBUG(dbgs() << "Failed to evaluate function.\n");
+            return false;
+          }
+          delete ValueStack.pop_back_val();
+          InstResult = RetVal;
+          if (MemoryAccesses == AccessesBefore)
+            MemoizedCalls[Key] = RetVal;
         }
-        delete ValueStack.pop_back_val();
-        InstResult = RetVal;
 
         if (InstResult != NULL) {
           DEBUG(dbgs() << "Successfully evaluated function. Result: " <<
@@ -2927,11 +3149,6 @@ bool Evaluator::EvaluateFunction(Function *F, Constant *&RetVal,
        ++AI, ++ArgNo)
     setVal(AI, ActualArgs[ArgNo]);
 
-  // ExecutedBlocks - We only handle non-looping, non-recursive code.  As such,
-  // we can only evaluate any one basic block at most once.  This set keeps
-  // track of what we have executed so we can detect recursive cases etc.
-  SmallPtrSet<BasicBlock*, 32> ExecutedBlocks;
-
   // CurBB - The current basic block we're evaluating.
   BasicBlock *CurBB = F->begin();
 
@@ -2954,19 +3171,19 @@ bool Evaluator::EvaluateFunction(Function *F, Constant *&RetVal,
       return true;
     }
 
-    // Okay, we succeeded in evaluating this control flow.  See if we have
-    // executed the new block before.  If so, we have a looping function,
-    // which we cannot evaluate in reasonable time.
-    if (!ExecutedBlocks.insert(NextBB))
-      return false;  // looped!
-
-    // Okay, we have never been in this block before.  Check to see if there
-    // are any PHI nodes.  If so, evaluate them with information about where
-    // we came from.
+    // Okay, we succeeded in evaluating this control flow.  Loops are fine:
+    // the step budget in EvaluateBlock keeps them from running forever.
+    // Check to see if there are any PHI nodes.  If so, evaluate them with
+    // information about where we came from.  All of them read the values from
+    // before the edge was taken, so set them only after reading them all.
+    SmallVector<std::pair<PHINode*, Constant*>, 8> PHIValues;
     PHINode *PN = 0;
     for (CurInst = NextBB->begin();
          (PN = dyn_cast<PHINode>(CurInst)); ++CurInst)
-      setVal(PN, getVal(PN->getIncomingValueForBlock(CurBB)));
+      PHIValues.push_back(std::make_pair(PN,
+                            getVal(PN->getIncomingValueForBlock(CurBB))));
+    for (unsigned i = 0, e = PHIValues.size(); i != e; ++i)
+      setVal(PHIValues[i].first, PHIValues[i].second);
 
     // Advance to the next block.
     CurBB = NextBB;
@@ -0,0 +1,290 @@
+//===- HotColdSplitting.cpp - Outline cold regions of functions -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass moves rarely executed code, like error handling and logging, out
+// of the functions that contain it.  Blocks are cold when their frequency is
+// a small fraction of the entry block's, which takes into account a loaded
+// profile as well as the static branch heuristics (paths that end in
+// unreachable are cold).  Each single-entry region of cold blocks is handed
+// to the CodeExtractor, and the new function is kept out of line and
+// optimized for size.  On ELF targets it is also placed in .text.unlikely, so
+// that the hot code left behind is packed more densely.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "hotcoldsplit"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+using namespace llvm;
+
+STATISTIC(NumColdRegions, "Number of cold regions outlined");
+
+static cl::opt<unsigned>
+ColdRatio("hotcoldsplit-cold-ratio", cl::Hidden, cl::init(100),
+          cl::desc("Blocks executed at most 1/N times as often as the "
+                   "function entry are cold (default = 100)"));
+
+static cl::opt<unsigned>
+MinColdSize("hotcoldsplit-min-size", cl::Hidden, cl::init(3),
+            cl::desc("Minimum number of instructions in an outlined cold "
+                     "region (default = 3)"));
+
+static cl::opt<std::string>
+ColdSection("hotcoldsplit-section", cl::Hidden, cl::init(".text.unlikely"),
+            cl::desc("Section for outlined cold code on ELF targets"));
+
+namespace {
+  // Like the loop extractor, this is a function pass that adds functions to
+  // the module as it goes; the ones it adds are left alone.
+  struct HotColdSplitting : public FunctionPass {
+    static char ID; // Pass identification, replacement for typeid
+    HotColdSplitting() : FunctionPass(ID) {
+      initializeHotColdSplittingPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+    virtual bool doFinalization(Module &M) {
+      Outlined.clear();
+      return false;
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<BlockFrequencyInfo>();
+      AU.addRequired<DominatorTree>();
+    }
+
+  private:
+    /// The functions created by this pass.
+    SmallPtrSet<const Function*, 16> Outlined;
+
+    void growRegion(BasicBlock *Header, DominatorTree &DT,
+                    const SmallPtrSet<BasicBlock*, 16> &Cold,
+                    SmallVectorImpl<BasicBlock*> &Region);
+  };
+}
+
+char HotColdSplitting::ID = 0;
+INITIALIZE_PASS_BEGIN(HotColdSplitting, "hotcoldsplit",
+                      "Hot Cold Splitting", false, false)
+INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfo)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_END(HotColdSplitting, "hotcoldsplit",
+                    "Hot Cold Splitting", false, false)
+
+FunctionPass *llvm::createHotColdSplittingPass() {
+  return new HotColdSplitting();
+}
+
+/// isOutlinable - Return true if BB may be moved into another function.  The
+/// CodeExtractor gives up on a whole region for some of these, so leave them
+/// out of the region instead.
+static bool isOutlinable(const BasicBlock *BB) {
+  if (BB->isLandingPad() || isa<ReturnInst>(BB->getTerminator()))
+    return false;
+
+  for (BasicBlock::const_iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+    if (isa<AllocaInst>(I) || isa<InvokeInst>(I))
+      return false;
+    if (const IntrinsicInst *II = dyn_cast<IntrinsicInst>(I))
+      if (II->getIntrinsicID() == Intrinsic::vastart)
+        return false;
+    if (const CallInst *CI = dyn_cast<CallInst>(I))
+      if (CI->canReturnTwice())
+        return false;
+  }
+  return true;
+}
+
+static bool hasReturn(const Function &F) {
+  for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    if (isa<ReturnInst>(BB->getTerminator()))
+      return true;
+  return false;
+}
+
+/// markNoReturn - The region never leaves, typically because it ends in a
+/// call to abort.  Say so, and replace the dummy return that the extractor
+/// put after the call with unreachable.
+static void markNoReturn(Function *NewF) {
+  NewF->addFnAttr(Attribute::NoReturn);
+  CallInst *CI = cast<CallInst>(*NewF->use_begin());
+  CI->setDoesNotReturn();
+  TerminatorInst *TI = CI->getParent()->getTerminator();
+  if (isa<ReturnInst>(TI)) {
+    new UnreachableInst(TI->getContext(), TI);
+    TI->eraseFromParent();
+  }
+}
+
+/// growRegion - Collect the cold blocks dominated by Header into Region, with
+/// Header first, and drop those that can be entered from outside the region.
+void HotColdSplitting::growRegion(BasicBlock *Header, DominatorTree &DT,
+                                  const SmallPtrSet<BasicBlock*, 16> &Cold,
+                                  SmallVectorImpl<BasicBlock*> &Region) {
+  SmallPtrSet<BasicBlock*, 16> InRegion;
+  SmallVector<DomTreeNode*, 8> Worklist;
+  Worklist.push_back(DT.getNode(Header));
+  while (!Worklist.empty()) {
+    DomTreeNode *N = Worklist.pop_back_val();
+    BasicBlock *BB = N->getBlock();
+    if (!Cold.count(BB) || !isOutlinable(BB))
+      continue;
+    Region.push_back(BB);
+    InRegion.insert(BB);
+    Worklist.append(N->begin(), N->end());
+  }
+
+  // Only the header may have predecessors outside the region.  Removing a
+  // block can expose others, so iterate until nothing changes.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (unsigned i = 1; i < Region.size(); ++i) {
+      BasicBlock *BB = Region[i];
+      for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE;
+           ++PI)
+        if (!InRegion.count(*PI)) {
+          InRegion.erase(BB);
+          Region.erase(Region.begin() + i--);
+          Changed = true;
+          break;
+        }
+    }
+  }
+
+  // The extractor can only rewrite a PHI in an exit block when a single
+  // edge from the region reaches it.
+  SmallVector<BasicBlock*, 4> Exiting;
+  for (unsigned i = 0, e = Region.size(); i != e; ++i) {
+    TerminatorInst *TI = Region[i]->getTerminator();
+    for (unsigned s = 0, se = TI->getNumSuccessors(); s != se; ++s) {
+      BasicBlock *Exit = TI->getSuccessor(s);
+      if (InRegion.count(Exit))
+        continue;
+      if (Exiting.empty() || Exiting.back() != Region[i])
+        Exiting.push_back(Region[i]);
+      if (!isa<PHINode>(Exit->begin()))
+        continue;
+      unsigned NumEdges = 0;
+      for (pred_iterator PI = pred_begin(Exit), PE = pred_end(Exit); PI != PE;
+           ++PI)
+        NumEdges += InRegion.count(*PI);
+      if (NumEdges > 1) {
+        Region.clear();
+        return;
+      }
+    }
+  }
+
+  // Values used after the region are stored to memory by the extracted
+  // function on the way out, so they must be available on every way out.
+  for (unsigned i = 0, e = Region.size(); i != e; ++i)
+    for (BasicBlock::iterator I = Region[i]->begin(), IE = Region[i]->end();
+         I != IE; ++I)
+      for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+           UI != UE; ++UI) {
+        if (InRegion.count(cast<Instruction>(*UI)->getParent()))
+          continue;
+        for (unsigned x = 0, xe = Exiting.size(); x != xe; ++x)
+          if (!DT.dominates(Region[i], Exiting[x])) {
+            Region.clear();
+            return;
+          }
+      }
+
+  unsigned Size = 0;
+  for (unsigned i = 0, e = Region.size(); i != e; ++i)
+    for (BasicBlock::iterator I = Region[i]->getFirstNonPHI(),
+           E = Region[i]->end(); I != E; ++I)
+      if (!isa<DbgInfoIntrinsic>(I))
+        ++Size;
+  if (Size < MinColdSize)
+    Region.clear();
+}
+
+bool HotColdSplitting::runOnFunction(Function &F) {
+  if (F.hasFnAttribute(Attribute::Naked) || Outlined.count(&F))
+    return false;
+
+  BlockFrequencyInfo &BFI = getAnalysis<BlockFrequencyInfo>();
+  uint64_t EntryFreq = BFI.getBlockFreq(&F.getEntryBlock()).getFrequency();
+  // Divide rather than multiply the block frequency, which can overflow.
+  uint64_t ColdFreq = ColdRatio ? EntryFreq / ColdRatio : EntryFreq;
+  SmallPtrSet<BasicBlock*, 16> Cold;
+  for (Function::iterator BB = llvm::next(F.begin()), E = F.end(); BB != E;
+       ++BB)
+    if (BFI.getBlockFreq(BB).getFrequency() <= ColdFreq)
+      Cold.insert(BB);
+  if (Cold.empty())
+    return false;
+
+  // Regions are grown from the outermost cold blocks in the dominator tree,
+  // and must not overlap.
+  DominatorTree &DT = getAnalysis<DominatorTree>();
+  std::vector<SmallVector<BasicBlock*, 8> > Regions;
+  for (df_iterator<DomTreeNode*> I = df_begin(DT.getRootNode()),
+         E = df_end(DT.getRootNode()); I != E; ++I) {
+    BasicBlock *BB = I->getBlock();
+    if (!Cold.count(BB))
+      continue;
+
+    SmallVector<BasicBlock*, 8> Region;
+    growRegion(BB, DT, Cold, Region);
+    if (Region.empty())
+      continue;
+    for (unsigned i = 0, e = Region.size(); i != e; ++i)
+      Cold.erase(Region[i]);
+    Regions.push_back(Region);
+  }
+
+  // The dominator tree is not kept up to date by the extractor, so don't
+  // hand it over.
+  bool UseSection = !ColdSection.empty() &&
+    Triple(F.getParent()->getTargetTriple()).isOSBinFormatELF();
+  bool Changed = false;
+  for (unsigned i = 0, e = Regions.size(); i != e; ++i) {
+    CodeExtractor CE(Regions[i]);
+    if (!CE.isEligible())
+      continue;
+    Function *NewF = CE.extractCodeRegion();
+    if (!NewF)
+      continue;
+
+    NewF->addFnAttr(Attribute::Cold);
+    NewF->addFnAttr(Attribute::NoInline);
+    NewF->addFnAttr(Attribute::OptimizeForSize);
+    if (!hasReturn(*NewF))
+      markNoReturn(NewF);
+    if (UseSection)
+      NewF->setSection(ColdSection);
+    Outlined.insert(NewF);
+    DEBUG(dbgs() << "hotcoldsplit: outlined " << Regions[i].size()
+                 << " blocks of " << F.getName() << " into "
+                 << NewF->getName() << '\n');
+    ++NumColdRegions;
+    Changed = true;
+  }
+  return Changed;
+}
@@ -19,6 +19,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/ProfileInfo.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -50,16 +51,37 @@ static cl::opt<int>
 HintThreshold("inlinehint-threshold", cl::Hidden, cl::init(325),
               cl::desc("Threshold for inlining functions with inline hint"));
 
+static cl::opt<int>
+HotThreshold("inline-hot-threshold", cl::Hidden, cl::init(1000),
+             cl::desc("Threshold for inlining call sites that the profile "
+                      "shows to be hot"));
+
+static cl::opt<int>
+ColdThreshold("inline-cold-threshold", cl::Hidden, cl::init(0),
+              cl::desc("Threshold for inlining call sites that the profile "
+                       "shows to be cold"));
+
+static cl::opt<double>
+HotCallSiteRatio("inline-hot-callsite-ratio", cl::Hidden, cl::init(0.1),
+                 cl::desc("Call sites executed at least this fraction of the "
+                          "hottest block's count are hot"));
+
+static cl::opt<double>
+ColdCallSiteRatio("inline-cold-callsite-ratio", cl::Hidden, cl::init(0.0001),
+                  cl::desc("Call sites executed at most this fraction of the "
+                           "hottest block's count are cold"));
+
 // Threshold to use when optsize is specified (and there is no -inline-limit).
 const int OptSizeThreshold = 75;
 
 Inliner::Inliner(char &ID) 
-  : CallGraphSCCPass(ID), InlineThreshold(InlineLimit), InsertLifetime(true) {}
+  : CallGraphSCCPass(ID), InlineThreshold(InlineLimit), InsertLifetime(true),
+    PI(0), MaxBlockCount(-1) {}
 
 Inliner::Inliner(char &ID, int Threshold, bool InsertLifetime)
   : CallGraphSCCPass(ID), InlineThreshold(InlineLimit.getNumOccurrences() > 0 ?
                                           InlineLimit : Threshold),
-    InsertLifetime(InsertLifetime) {}
+    InsertLifetime(InsertLifetime), PI(0), MaxBlockCount(-1) {}
 
 /// getAnalysisUsage - For this class, we declare that we require and preserve
 /// the call graph.  If the derived class implements this method, it should
@@ -249,14 +271,63 @@ unsigned Inliner::getInlineThreshold(CallSite CS) const {
   bool InlineHint = Callee && !Callee->isDeclaration() &&
     Callee->getAttributes().hasAttribute(AttributeSet::FunctionIndex,
                                          Attribute::InlineHint);
-  if (InlineHint && HintThreshold > thres
-      && !Caller->getAttributes().hasAttribute(AttributeSet::FunctionIndex,
-                                               Attribute::MinSize))
+  bool MinSize = Caller->getAttributes().hasAttribute(
+      AttributeSet::FunctionIndex, Attribute::MinSize);
+  if (InlineHint && HintThreshold > thres && !MinSize)
     thres = HintThreshold;
 
+  // Finally, let the profile override the static guesses.  Call sites that
+  // were never (or almost never) executed only get inlined when that does not
+  // grow the code, while hot call sites get a much larger budget unless the
+  // caller asked to be small.
+  if (MaxBlockCount <= 0)
+    return thres;
+  double Count = getCallSiteCount(CS);
+  if (Count == ProfileInfo::MissingValue)
+    return thres;
+  if (Count <= MaxBlockCount * ColdCallSiteRatio) {
+    if (ColdThreshold < thres)
+      thres = ColdThreshold;
+  } else if (Count >= MaxBlockCount * HotCallSiteRatio) {
+    if (HotThreshold > thres && !OptSize && !MinSize)
+      thres = HotThreshold;
+  }
+
   return thres;
 }
 
+void Inliner::setProfileInfo(ProfileInfo *NewPI) {
+  if (NewPI != PI)
+    MaxBlockCount = -1;
+  PI = NewPI;
+}
+
+/// getCallSiteCount - Return the execution count of the call site, or
+/// ProfileInfo::MissingValue if the profile does not cover it.
+double Inliner::getCallSiteCount(CallSite CS) const {
+  DenseMap<const Instruction*, double>::const_iterator I =
+    CallSiteCounts.find(CS.getInstruction());
+  if (I != CallSiteCounts.end())
+    return I->second;
+  return PI->getExecutionCount(CS.getInstruction()->getParent());
+}
+
+/// computeMaxBlockCount - Return the execution count of the hottest block in
+/// the module, or zero if the profile does not have any counts.
+static double computeMaxBlockCount(Module &M, ProfileInfo &PI) {
+  double Max = 0;
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
+    if (F->isDeclaration())
+      continue;
+    // A function that never ran cannot contain the hottest block.
+    if (PI.getExecutionCount(F) == 0)
+      continue;
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      Max = std::max(Max, PI.getExecutionCount(BB));
+  }
+  return Max;
+}
+
 /// shouldInline - Return true if the inliner should attempt to inline
 /// at the given CallSite.
 bool Inliner::shouldInline(CallSite CS) {
@@ -376,6 +447,10 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
   const DataLayout *TD = getAnalysisIfAvailable<DataLayout>();
   const TargetLibraryInfo *TLI = getAnalysisIfAvailable<TargetLibraryInfo>();
 
+  // Scan the profile once per module for the count that defines "hot".
+  if (PI && MaxBlockCount < 0)
+    MaxBlockCount = computeMaxBlockCount(CG.getModule(), *PI);
+
   SmallPtrSet<Function*, 8> SCCFunctions;
   DEBUG(dbgs() << "Inliner visiting SCC:");
   for (CallGraphSCC::iterator I = SCC.begin(), E = SCC.end(); I != E; ++I) {
@@ -414,6 +489,12 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
           continue;
         
         CallSites.push_back(std::make_pair(CS, -1));
+
+        // Inlining splits the block of each inlined call site, which leaves
+        // the later call sites of that block in a new block the profile knows
+        // nothing about.  Remember their counts while the blocks are intact.
+        if (MaxBlockCount > 0)
+          CallSiteCounts[CS.getInstruction()] = PI->getExecutionCount(BB);
       }
   }
 
@@ -524,6 +605,10 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
         ++NumDeleted;
       }
 
+      // The call instruction is gone; make sure a new call site allocated at
+      // the same address does not pick up its count.
+      CallSiteCounts.erase(CS.getInstruction());
+
       // Remove this call site from the list.  If possible, use 
       // swap/pop_back for efficiency, but do not use it if doing so would
       // move a call site to a function in this SCC before the
@@ -541,12 +626,14 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
     }
   } while (LocalChange);
 
+  CallSiteCounts.clear();
   return Changed;
 }
 
 // doFinalization - Remove now-dead linkonce functions at the end of
 // processing to avoid breaking the SCC traversal.
 bool Inliner::doFinalization(CallGraph &CG) {
+  MaxBlockCount = -1;
   return removeDeadFunctions(CG);
 }
 
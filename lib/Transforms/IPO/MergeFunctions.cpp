@@ -9,8 +9,8 @@
 //
 // This pass looks for equivalent functions that are mergable and folds them.
 //
-// A hash is computed from the function, based on its type and number of
-// basic blocks.
+// A hash is computed from the function, based on its type, the shape of its
+// CFG and the opcodes and operand kinds of its instructions.
 //
 // Once all hashes are computed, we perform an expensive equality comparison
 // on each function pair. This takes n^2/2 comparisons per bucket, so it's
@@ -48,6 +48,7 @@
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Constants.h"
@@ -55,11 +56,13 @@
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ValueHandle.h"
@@ -71,6 +74,19 @@ STATISTIC(NumFunctionsMerged, "Number of functions merged");
 STATISTIC(NumThunksWritten, "Number of thunks generated");
 STATISTIC(NumAliasesWritten, "Number of aliases generated");
 STATISTIC(NumDoubleWeak, "Number of new functions created");
+STATISTIC(NumComparisons, "Number of full function comparisons");
+STATISTIC(NumParamMerged, "Number of functions merged with extra parameters");
+STATISTIC(NumParamsAdded, "Number of parameters added to merged functions");
+
+static cl::opt<bool>
+EnableParamMerging("mergefunc-parametric", cl::Hidden, cl::init(false),
+  cl::desc("Merge functions that differ only in constants or callees by "
+           "passing the differing values as extra parameters"));
+
+static cl::opt<unsigned>
+MaxExtraParams("mergefunc-max-params", cl::Hidden, cl::init(4),
+  cl::desc("Maximum number of parameters added when merging functions "
+           "that differ in constants (default = 4)"));
 
 /// Returns the type id for a type to be hashed. We turn pointer types into
 /// integers here because the actual compare logic below considers pointers and
@@ -81,9 +97,45 @@ static Type::TypeID getTypeIDForHash(Type *Ty) {
   return Ty->getTypeID();
 }
 
+/// Returns the kind of an operand to be hashed. FunctionComparator::enumerate
+/// considers constants of different kinds equal, such as a null pointer and a
+/// zero integer, or a global and a bitcast of it, so all constants share one
+/// kind. Arguments, instructions and blocks only map to their own kind.
+static unsigned getValueKindForHash(const Value *V) {
+  if (isa<Constant>(V))
+    return Value::ConstantFirstVal;
+  if (isa<Instruction>(V))
+    return Value::InstructionVal;
+  return V->getValueID();
+}
+
+/// Adds the parts of an instruction that FunctionComparator requires to be
+/// identical: the opcode, the optional flags and the shape of the operands.
+static void profileInstruction(FoldingSetNodeID &ID, const Instruction *I) {
+  ID.AddInteger(I->getOpcode());
+  ID.AddInteger(getTypeIDForHash(I->getType()));
+
+  // GEPs are compared by the offset they compute, not by their operands.
+  if (isa<GetElementPtrInst>(I))
+    return;
+
+  ID.AddInteger(I->getNumOperands());
+  ID.AddInteger(I->getRawSubclassOptionalData());
+  for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i) {
+    const Value *Op = I->getOperand(i);
+    ID.AddInteger(getValueKindForHash(Op));
+    ID.AddInteger(getTypeIDForHash(Op->getType()));
+  }
+
+  if (const CmpInst *CI = dyn_cast<CmpInst>(I))
+    ID.AddInteger(CI->getPredicate());
+}
+
 /// Creates a hash-code for the function which is the same for any two
-/// functions that will compare equal, without looking at the instructions
-/// inside the function.
+/// functions that will compare equal. Besides the signature this covers the
+/// structure of the body, visited in the same CFG order that
+/// FunctionComparator uses, so that functions sharing a common type only
+/// need a full comparison when they really are likely to be equal.
 static unsigned profileFunction(const Function *F) {
   FunctionType *FTy = F->getFunctionType();
 
@@ -95,6 +147,26 @@ static unsigned profileFunction(const Function *F) {
   ID.AddInteger(getTypeIDForHash(FTy->getReturnType()));
   for (unsigned i = 0, e = FTy->getNumParams(); i != e; ++i)
     ID.AddInteger(getTypeIDForHash(FTy->getParamType(i)));
+
+  if (F->isDeclaration())
+    return ID.ComputeHash();
+
+  SmallVector<const BasicBlock *, 8> BBs;
+  SmallPtrSet<const BasicBlock *, 16> VisitedBBs;
+  BBs.push_back(&F->getEntryBlock());
+  VisitedBBs.insert(BBs[0]);
+  while (!BBs.empty()) {
+    const BasicBlock *BB = BBs.pop_back_val();
+    ID.AddInteger(BB->size());
+    for (BasicBlock::const_iterator I = BB->begin(), E = BB->end(); I != E;
+         ++I)
+      profileInstruction(ID, I);
+
+    const TerminatorInst *TI = BB->getTerminator();
+    for (unsigned i = 0, e = TI->getNumSuccessors(); i != e; ++i)
+      if (VisitedBBs.insert(TI->getSuccessor(i)))
+        BBs.push_back(TI->getSuccessor(i));
+  }
   return ID.ComputeHash();
 }
 
@@ -158,15 +230,30 @@ namespace llvm {
 
 namespace {
 
+/// ConstantDiff - An operand of an instruction in the first function whose
+/// constant differs from the one in the second function.
+struct ConstantDiff {
+  const Instruction *Inst;
+  unsigned OpNo;
+  Constant *Other;
+
+  ConstantDiff(const Instruction *Inst, unsigned OpNo, Constant *Other)
+    : Inst(Inst), OpNo(OpNo), Other(Other) {}
+};
+
 /// FunctionComparator - Compares two functions to determine whether or not
 /// they will generate machine code with the same behaviour. DataLayout is
 /// used if available. The comparator always fails conservatively (erring on the
 /// side of claiming that two functions are different).
 class FunctionComparator {
 public:
+  /// When Diffs is non-null, operands that are different constants of the
+  /// same type do not make the functions differ if they could be turned into
+  /// a parameter. They are recorded in Diffs instead.
   FunctionComparator(const DataLayout *TD, const Function *F1,
-                     const Function *F2)
-    : F1(F1), F2(F2), TD(TD) {}
+                     const Function *F2,
+                     SmallVectorImpl<ConstantDiff> *Diffs = 0)
+    : F1(F1), F2(F2), TD(TD), Diffs(Diffs) {}
 
   /// Test whether the two functions have equivalent behaviour.
   bool compare();
@@ -196,11 +283,18 @@ private:
   /// Compare two Types, treating all pointer types as equal.
   bool isEquivalentType(Type *Ty1, Type *Ty2) const;
 
+  /// Test whether operand OpNo of I could take V1 in one function and V2 in
+  /// the other if it were replaced by a parameter.
+  bool isParameterizable(const Instruction *I, unsigned OpNo, const Value *V1,
+                         const Value *V2) const;
+
   // The two functions undergoing comparison.
   const Function *F1, *F2;
 
   const DataLayout *TD;
 
+  SmallVectorImpl<ConstantDiff> *Diffs;
+
   DenseMap<const Value *, const Value *> id_map;
   DenseSet<const Value *> seen_values;
 };
@@ -349,6 +443,32 @@ bool FunctionComparator::isEquivalentOperation(const Instruction *I1,
   return true;
 }
 
+// Only constants that feed ordinary computation can become parameters: a
+// switch case, an alloca size or an intrinsic argument has to stay constant.
+bool FunctionComparator::isParameterizable(const Instruction *I, unsigned OpNo,
+                                           const Value *V1,
+                                           const Value *V2) const {
+  if (V1->getType() != V2->getType())
+    return false;
+
+  if (isa<Function>(V1) && isa<Function>(V2)) {
+    // Calls to the functions being compared are matched up by enumerate().
+    if (V1 == F1 || V1 == F2 || V2 == F1 || V2 == F2)
+      return false;
+    if (cast<Function>(V1)->isIntrinsic() || cast<Function>(V2)->isIntrinsic())
+      return false;
+  } else if (!isa<ConstantInt>(V1) || !isa<ConstantInt>(V2)) {
+    return false;
+  }
+
+  if (isa<IntrinsicInst>(I))
+    return false;
+
+  return isa<BinaryOperator>(I) || isa<CmpInst>(I) || isa<CastInst>(I) ||
+         isa<SelectInst>(I) || isa<StoreInst>(I) || isa<CallInst>(I) ||
+         isa<InvokeInst>(I) || isa<ReturnInst>(I);
+}
+
 // Determine whether two GEP operations perform the same underlying arithmetic.
 bool FunctionComparator::isEquivalentGEP(const GEPOperator *GEP1,
                                          const GEPOperator *GEP2) {
@@ -448,8 +568,11 @@ bool FunctionComparator::compare(const BasicBlock *BB1, const BasicBlock *BB2) {
         Value *OpF1 = F1I->getOperand(i);
         Value *OpF2 = F2I->getOperand(i);
 
-        if (!enumerate(OpF1, OpF2))
-          return false;
+        if (!enumerate(OpF1, OpF2)) {
+          if (!Diffs || !isParameterizable(F1I, i, OpF1, OpF2))
+            return false;
+          Diffs->push_back(ConstantDiff(F1I, i, cast<Constant>(OpF2)));
+        }
 
         if (OpF1->getValueID() != OpF2->getValueID() ||
             !isEquivalentType(OpF1->getType(), OpF2->getType()))
@@ -593,6 +716,16 @@ private:
   /// Replace G with an alias to F. Deletes G.
   void writeAlias(Function *F, Function *G);
 
+  /// Merge functions that are equal except for some constant operands into
+  /// one body that takes those operands as extra parameters.
+  bool mergeParametric(Module &M);
+
+  /// Move the body of Members[0] into a new function with a parameter for
+  /// each distinct column of Values, and redirect all of Members to it.
+  void mergeWithParams(ArrayRef<Function *> Members,
+                       ArrayRef<std::pair<const Instruction *, unsigned> > Ops,
+                       ArrayRef<SmallVector<Constant *, 4> > Values);
+
   /// The set of all distinct functions. Use the insert() and remove() methods
   /// to modify it.
   FnSetType FnSet;
@@ -662,6 +795,9 @@ bool MergeFunctions::runOnModule(Module &M) {
 
   FnSet.clear();
 
+  if (EnableParamMerging)
+    Changed |= mergeParametric(M);
+
   return Changed;
 }
 
@@ -673,6 +809,11 @@ bool DenseMapInfo<ComparableFunction>::isEqual(const ComparableFunction &LHS,
   if (!LHS.getFunc() || !RHS.getFunc())
     return false;
 
+  // Functions with different hashes can never compare equal; they only meet
+  // here because their buckets collide.
+  if (LHS.getHash() != RHS.getHash())
+    return false;
+
   // One of these is a special "underlying pointer comparison only" object.
   if (LHS.getTD() == ComparableFunction::LookupOnly ||
       RHS.getTD() == ComparableFunction::LookupOnly)
@@ -681,6 +822,7 @@ bool DenseMapInfo<ComparableFunction>::isEqual(const ComparableFunction &LHS,
   assert(LHS.getTD() == RHS.getTD() &&
          "Comparing functions for different targets");
 
+  ++NumComparisons;
   return FunctionComparator(LHS.getTD(), LHS.getFunc(),
                             RHS.getFunc()).compare();
 }
@@ -882,3 +1024,298 @@ void MergeFunctions::removeUsers(Value *V) {
     }
   }
 }
+
+namespace {
+
+/// ParamCandidate - A function considered for merging with extra parameters,
+/// together with the numbers that the size cost model needs.
+struct ParamCandidate {
+  Function *F;
+  unsigned Hash;
+  unsigned Size;
+  unsigned NumCalls;
+  bool NeedsThunk;
+
+  bool operator<(const ParamCandidate &RHS) const { return Hash < RHS.Hash; }
+};
+
+}
+
+// Returns true if User refers to F, directly or through a constant
+// expression. Once the body of a group is shared, such a reference inside the
+// group would keep pointing at the member whose body was kept, with that
+// member's constants.
+static bool refersTo(const Function *User, const Function *F) {
+  for (Value::const_use_iterator UI = F->use_begin(), UE = F->use_end();
+       UI != UE; ++UI) {
+    if (const Instruction *I = dyn_cast<Instruction>(*UI)) {
+      if (I->getParent()->getParent() == User)
+        return true;
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(*UI)) {
+      for (Value::const_use_iterator CUI = CE->use_begin(),
+             CUE = CE->use_end(); CUI != CUE; ++CUI)
+        if (const Instruction *I = dyn_cast<Instruction>(*CUI))
+          if (I->getParent()->getParent() == User)
+            return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if G refers to a member of the group, or a member refers to G.
+static bool refersToGroup(const Function *G,
+                          ArrayRef<const ParamCandidate *> Members) {
+  for (unsigned i = 0, e = Members.size(); i != e; ++i)
+    if (refersTo(G, Members[i]->F) || refersTo(Members[i]->F, G))
+      return true;
+  return false;
+}
+
+// Estimate how many instructions are saved by sharing the body of
+// Members[0] with the others, given NumParams extra parameters. Every direct
+// call grows by the extra arguments, and a member that cannot be deleted
+// keeps a thunk.
+static int getMergeSavings(ArrayRef<const ParamCandidate *> Members,
+                           unsigned NumParams) {
+  int Savings = 0;
+  for (unsigned i = 0, e = Members.size(); i != e; ++i) {
+    const ParamCandidate &C = *Members[i];
+    if (i != 0)
+      Savings += C.Size;
+    Savings -= NumParams * C.NumCalls;
+    if (C.NeedsThunk)
+      Savings -= C.F->arg_size() + NumParams + 2;
+  }
+  return Savings;
+}
+
+bool MergeFunctions::mergeParametric(Module &M) {
+  typedef std::pair<const Instruction *, unsigned> OperandPos;
+
+  std::vector<ParamCandidate> Candidates;
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+    if (I->isDeclaration() || I->hasAvailableExternallyLinkage() ||
+        I->mayBeOverridden() || I->isVarArg() || refersTo(I, I))
+      continue;
+
+    ParamCandidate C;
+    C.F = I;
+    C.Hash = profileFunction(I);
+    C.Size = 0;
+    for (Function::iterator BI = I->begin(), BE = I->end(); BI != BE; ++BI)
+      C.Size += BI->size();
+    C.NumCalls = 0;
+    C.NeedsThunk = !I->hasLocalLinkage();
+    for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+         UI != UE; ++UI) {
+      CallSite CS(*UI);
+      if (CS && CS.isCallee(UI))
+        ++C.NumCalls;
+      else
+        C.NeedsThunk = true;
+    }
+    Candidates.push_back(C);
+  }
+
+  // Functions that can share a body have the same hash, as the hash does not
+  // look at the values of constants.
+  std::stable_sort(Candidates.begin(), Candidates.end());
+
+  bool Changed = false;
+  for (unsigned Begin = 0, End; Begin != Candidates.size(); Begin = End) {
+    for (End = Begin + 1; End != Candidates.size() &&
+         Candidates[End].Hash == Candidates[Begin].Hash; ++End)
+      ;
+
+    std::vector<const ParamCandidate *> Pending;
+    for (unsigned i = Begin; i != End; ++i)
+      Pending.push_back(&Candidates[i]);
+
+    while (Pending.size() > 1) {
+      const ParamCandidate *Leader = Pending[0];
+      Function *F = Leader->F;
+
+      SmallVector<const ParamCandidate *, 4> Members;
+      Members.push_back(Leader);
+      SmallVector<OperandPos, 4> Ops;
+      std::vector<DenseMap<OperandPos, Constant *> > MemberOps(1);
+      int Savings = 0;
+
+      std::vector<const ParamCandidate *> Rest;
+      for (unsigned i = 1, e = Pending.size(); i != e; ++i) {
+        Function *G = Pending[i]->F;
+        SmallVector<ConstantDiff, 4> Diffs;
+        if (F->getFunctionType() != G->getFunctionType() ||
+            refersToGroup(G, Members) ||
+            !FunctionComparator(TD, F, G, &Diffs).compare()) {
+          Rest.push_back(Pending[i]);
+          continue;
+        }
+
+        SmallVector<OperandPos, 4> NewOps(Ops.begin(), Ops.end());
+        DenseMap<OperandPos, Constant *> GOps;
+        for (unsigned j = 0, je = Diffs.size(); j != je; ++j) {
+          OperandPos Pos(Diffs[j].Inst, Diffs[j].OpNo);
+          GOps[Pos] = Diffs[j].Other;
+          if (std::find(NewOps.begin(), NewOps.end(), Pos) == NewOps.end())
+            NewOps.push_back(Pos);
+        }
+
+        Members.push_back(Pending[i]);
+        int NewSavings = getMergeSavings(Members, NewOps.size());
+        if (NewOps.size() > MaxExtraParams || NewSavings <= Savings) {
+          Members.pop_back();
+          Rest.push_back(Pending[i]);
+          continue;
+        }
+
+        Savings = NewSavings;
+        Ops.swap(NewOps);
+        MemberOps.push_back(GOps);
+      }
+
+      if (Members.size() > 1) {
+        // Work out the value each member passes for each operand; operands
+        // that did not differ from the leader's take the leader's value.
+        SmallVector<Function *, 4> Fns;
+        std::vector<SmallVector<Constant *, 4> > Values(Members.size());
+        for (unsigned i = 0, e = Members.size(); i != e; ++i) {
+          Fns.push_back(Members[i]->F);
+          for (unsigned j = 0, je = Ops.size(); j != je; ++j) {
+            Constant *C = MemberOps[i].lookup(Ops[j]);
+            if (!C)
+              C = cast<Constant>(Ops[j].first->getOperand(Ops[j].second));
+            Values[i].push_back(C);
+          }
+        }
+        mergeWithParams(Fns, Ops, Values);
+        Changed = true;
+      }
+
+      Pending.swap(Rest);
+    }
+  }
+  return Changed;
+}
+
+void MergeFunctions::mergeWithParams(
+    ArrayRef<Function *> Members,
+    ArrayRef<std::pair<const Instruction *, unsigned> > Ops,
+    ArrayRef<SmallVector<Constant *, 4> > Values) {
+  Function *F = Members[0];
+
+  // Operands that take the same value in every member share a parameter.
+  std::vector<SmallVector<Constant *, 4> > ParamValues;
+  SmallVector<unsigned, 4> OpParam;
+  for (unsigned j = 0, je = Ops.size(); j != je; ++j) {
+    SmallVector<Constant *, 4> Column;
+    for (unsigned i = 0, e = Members.size(); i != e; ++i)
+      Column.push_back(Values[i][j]);
+    unsigned P = 0, PE = ParamValues.size();
+    while (P != PE && ParamValues[P] != Column)
+      ++P;
+    if (P == PE)
+      ParamValues.push_back(Column);
+    OpParam.push_back(P);
+  }
+
+  FunctionType *FTy = F->getFunctionType();
+  SmallVector<Type *, 8> ParamTys(FTy->param_begin(), FTy->param_end());
+  for (unsigned P = 0, PE = ParamValues.size(); P != PE; ++P)
+    ParamTys.push_back(ParamValues[P][0]->getType());
+  FunctionType *NewFTy =
+    FunctionType::get(FTy->getReturnType(), ParamTys, false);
+
+  Function *NewF = Function::Create(NewFTy, GlobalValue::InternalLinkage,
+                                    F->getName() + ".merged", F->getParent());
+  NewF->copyAttributesFrom(F);
+  NewF->setVisibility(GlobalValue::DefaultVisibility);
+
+  // Move the body of F over and rewrite the differing operands to use the
+  // new parameters.
+  NewF->getBasicBlockList().splice(NewF->begin(), F->getBasicBlockList());
+  Function::arg_iterator NewAI = NewF->arg_begin();
+  for (Function::arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+       AI != AE; ++AI, ++NewAI) {
+    NewAI->setName(AI->getName());
+    AI->replaceAllUsesWith(NewAI);
+  }
+  SmallVector<Argument *, 4> ExtraArgs;
+  for (; NewAI != NewF->arg_end(); ++NewAI)
+    ExtraArgs.push_back(NewAI);
+  for (unsigned j = 0, je = Ops.size(); j != je; ++j)
+    const_cast<Instruction *>(Ops[j].first)->setOperand(
+        Ops[j].second, ExtraArgs[OpParam[j]]);
+
+  // Call the merged function directly, passing each member's values.
+  for (unsigned i = 0, e = Members.size(); i != e; ++i) {
+    Function *G = Members[i];
+    SmallVector<Instruction *, 8> Calls;
+    for (Value::use_iterator UI = G->use_begin(), UE = G->use_end();
+         UI != UE; ++UI) {
+      CallSite CS(*UI);
+      if (CS && CS.isCallee(UI))
+        Calls.push_back(CS.getInstruction());
+    }
+
+    for (unsigned c = 0, ce = Calls.size(); c != ce; ++c) {
+      Instruction *Call = Calls[c];
+      CallSite CS(Call);
+      SmallVector<Value *, 8> Args(CS.arg_begin(), CS.arg_end());
+      for (unsigned P = 0, PE = ParamValues.size(); P != PE; ++P)
+        Args.push_back(ParamValues[P][i]);
+
+      CallSite NewCS;
+      if (InvokeInst *II = dyn_cast<InvokeInst>(Call)) {
+        NewCS = InvokeInst::Create(NewF, II->getNormalDest(),
+                                   II->getUnwindDest(), Args, "", Call);
+      } else {
+        CallInst *NewCI = CallInst::Create(NewF, Args, "", Call);
+        NewCI->setTailCall(cast<CallInst>(Call)->isTailCall());
+        NewCS = NewCI;
+      }
+      NewCS.setCallingConv(CS.getCallingConv());
+      NewCS.setAttributes(CS.getAttributes());
+      NewCS->setDebugLoc(Call->getDebugLoc());
+      NewCS->takeName(Call);
+      Call->replaceAllUsesWith(NewCS.getInstruction());
+      Call->eraseFromParent();
+    }
+  }
+
+  // Delete the members that are no longer referenced and turn the rest into
+  // thunks.
+  for (unsigned i = 0, e = Members.size(); i != e; ++i) {
+    Function *G = Members[i];
+    if (G->hasLocalLinkage() && G->use_empty()) {
+      DEBUG(dbgs() << "mergeWithParams: deleting " << G->getName() << '\n');
+      G->eraseFromParent();
+      continue;
+    }
+
+    G->dropAllReferences();
+    BasicBlock *BB = BasicBlock::Create(G->getContext(), "", G);
+    IRBuilder<false> Builder(BB);
+    SmallVector<Value *, 8> Args;
+    for (Function::arg_iterator AI = G->arg_begin(), AE = G->arg_end();
+         AI != AE; ++AI)
+      Args.push_back(AI);
+    for (unsigned P = 0, PE = ParamValues.size(); P != PE; ++P)
+      Args.push_back(ParamValues[P][i]);
+
+    CallInst *CI = Builder.CreateCall(NewF, Args);
+    CI->setTailCall();
+    CI->setCallingConv(NewF->getCallingConv());
+    if (G->getReturnType()->isVoidTy())
+      Builder.CreateRetVoid();
+    else
+      Builder.CreateRet(CI);
+    DEBUG(dbgs() << "mergeWithParams: thunk " << G->getName() << '\n');
+    ++NumThunksWritten;
+  }
+
+  DEBUG(dbgs() << "mergeWithParams: " << NewF->getName() << " with "
+               << ParamValues.size() << " extra parameters\n");
+  NumParamMerged += Members.size() - 1;
+  NumParamsAdded += ParamValues.size();
+}
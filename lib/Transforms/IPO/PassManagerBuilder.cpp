@@ -278,6 +278,11 @@ void PassManagerBuilder::populateLTOPassManager(PassManagerBase &PM,
   // Remove unused arguments from functions.
   PM.add(createDeadArgEliminationPass());
 
+  // With the whole program internalized, calls through constant tables of
+  // function pointers can often be resolved, which lets the inliner see them.
+  if (Internalize)
+    PM.add(createWholeProgramDevirtPass());
+
   // Reduce the code after globalopt and ipsccp.  Both can open up significant
   // simplification opportunities, and both can propagate functions through
   // function pointers.  When this happens, we often have to resolve varargs
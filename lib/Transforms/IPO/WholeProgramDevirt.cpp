@@ -0,0 +1,501 @@
+//===- WholeProgramDevirt.cpp - Resolve calls through constant tables -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass turns indirect calls through constant tables of function pointers,
+// like C++ virtual calls through a vtable, into direct calls.  It is meant for
+// link time, after internalize has given local linkage to everything the
+// program does not export, so that the module is the whole program.
+//
+// A function can then only be called indirectly if it is exported, if its
+// address is stored somewhere other than a constant global, or if it is an
+// entry of a constant global that holds function pointers (a "table").  A
+// table is only read through the places it is referenced from (its "address
+// points", such as the vtable pointer a constructor stores), so a callee that
+// is loaded from a vtable pointer plus a constant offset is one of the table
+// entries at that offset from an address point, unless a function of the same
+// type has escaped.  A callee loaded straight from a table is just the entry.
+//
+// A call that loads its callee straight from a table becomes a direct call.
+// Otherwise the object may come from code the module cannot see, such as a
+// factory in a shared library, whose vtables are not among the address
+// points.  So a call with up to -devirt-max-targets possible callees compares
+// the loaded pointer against each of them and calls the one that matches
+// directly, with the indirect call kept as the fallback.  Either way the
+// inliner can see the callees.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "wholeprogramdevirt"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumSingleTarget, "Number of calls with one target made direct");
+STATISTIC(NumGuarded, "Number of calls turned into guarded direct calls");
+
+static cl::opt<unsigned>
+DevirtMaxTargets("devirt-max-targets", cl::Hidden, cl::init(3),
+                 cl::desc("Maximum number of targets of a call to compare "
+                          "against before giving up (default = 3)"));
+
+namespace {
+  struct WholeProgramDevirt : public ModulePass {
+    static char ID; // Pass identification, replacement for typeid
+    WholeProgramDevirt() : ModulePass(ID) {
+      initializeWholeProgramDevirtPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnModule(Module &M);
+
+  private:
+    DataLayout *TD;
+
+    /// The types of functions that may be called through a pointer that was
+    /// not loaded from a table.
+    SmallPtrSet<FunctionType*, 16> EscapedTypes;
+
+    /// Constant globals that hold function pointers.
+    SmallPtrSet<GlobalVariable*, 16> Tables;
+
+    /// The offsets into a table that it is referenced at.
+    SmallVector<std::pair<GlobalVariable*, int64_t>, 32> AddressPoints;
+
+    /// Tables that may be read at any offset, so that any of their entries
+    /// may be loaded through a vtable pointer.
+    SmallVector<GlobalVariable*, 8> WholeTables;
+
+    void findEscapes(Module &M);
+    void noteLoadedPointer(Value *V, FunctionType *FTy);
+    void findAddressPoints(GlobalVariable *GV, Constant *C, int64_t Offset);
+    bool isEscapedType(FunctionType *FTy);
+    void addTarget(GlobalVariable *GV, int64_t Offset, FunctionType *FTy,
+                   SmallVectorImpl<Function*> &Targets);
+    bool findTargets(CallSite CS, SmallVectorImpl<Function*> &Targets,
+                     bool &Exact);
+    void makeGuardedCalls(CallInst *CI, ArrayRef<Function*> Targets);
+  };
+}
+
+char WholeProgramDevirt::ID = 0;
+INITIALIZE_PASS(WholeProgramDevirt, "wholeprogramdevirt",
+                "Whole program devirtualization", false, false)
+
+ModulePass *llvm::createWholeProgramDevirtPass() {
+  return new WholeProgramDevirt();
+}
+
+/// isCompatible - Return true if a call of type CallTy may reach a function
+/// of type FTy.  Pointer types are interchangeable, since the IR for a virtual
+/// call often passes 'this' as a pointer to a base class.
+static bool isCompatible(FunctionType *CallTy, FunctionType *FTy) {
+  if (CallTy == FTy)
+    return true;
+  if (CallTy->getNumParams() != FTy->getNumParams() ||
+      CallTy->isVarArg() != FTy->isVarArg())
+    return false;
+
+  Type *A = CallTy->getReturnType(), *B = FTy->getReturnType();
+  if (A != B && !(A->isPointerTy() && B->isPointerTy()))
+    return false;
+  for (unsigned i = 0, e = CallTy->getNumParams(); i != e; ++i) {
+    A = CallTy->getParamType(i);
+    B = FTy->getParamType(i);
+    if (A != B && !(A->isPointerTy() && B->isPointerTy()))
+      return false;
+  }
+  return true;
+}
+
+/// isOnlyCalledOrInTable - Return true if every use of V, a function or a
+/// constant built from one, calls it directly or puts it into the initializer
+/// of a constant global.
+static bool isOnlyCalledOrInTable(Value *V) {
+  for (Value::use_iterator UI = V->use_begin(), E = V->use_end(); UI != E;
+       ++UI) {
+    User *U = *UI;
+    if (isa<CallInst>(U) || isa<InvokeInst>(U)) {
+      if (!CallSite(cast<Instruction>(U)).isCallee(UI))
+        return false;
+    } else if (GlobalVariable *GV = dyn_cast<GlobalVariable>(U)) {
+      if (!GV->isConstant())
+        return false;
+    } else if (isa<ConstantArray>(U) || isa<ConstantStruct>(U) ||
+               isa<ConstantVector>(U) ||
+               (isa<ConstantExpr>(U) &&
+                cast<ConstantExpr>(U)->getOpcode() == Instruction::BitCast)) {
+      if (!isOnlyCalledOrInTable(U))
+        return false;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// containsFunction - Return true if the constant C holds a pointer to a
+/// function.
+static bool containsFunction(Constant *C) {
+  if (isa<Function>(C))
+    return true;
+  if (isa<GlobalValue>(C))
+    return false;
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+    if (containsFunction(cast<Constant>(C->getOperand(i))))
+      return true;
+  return false;
+}
+
+/// collectFunctions - Add the functions that the constant C holds pointers to
+/// to Fns.
+static void collectFunctions(Constant *C, SetVector<Function*> &Fns) {
+  if (Function *F = dyn_cast<Function>(C)) {
+    Fns.insert(F);
+    return;
+  }
+  if (isa<GlobalValue>(C))
+    return;
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+    collectFunctions(cast<Constant>(C->getOperand(i)), Fns);
+}
+
+/// getPointerAtOffset - Return the pointer that starts Offset bytes into the
+/// constant C, or null if no pointer starts there.
+static Constant *getPointerAtOffset(Constant *C, uint64_t Offset,
+                                    DataLayout &TD) {
+  Type *Ty = C->getType();
+  if (Offset == 0 && Ty->isPointerTy())
+    return C;
+
+  if (StructType *STy = dyn_cast<StructType>(Ty)) {
+    const StructLayout *SL = TD.getStructLayout(STy);
+    if (Offset >= SL->getSizeInBytes())
+      return 0;
+    unsigned Elt = SL->getElementContainingOffset(Offset);
+    Constant *Elem = C->getAggregateElement(Elt);
+    if (!Elem)
+      return 0;
+    return getPointerAtOffset(Elem, Offset - SL->getElementOffset(Elt), TD);
+  }
+
+  if (SequentialType *STy = dyn_cast<SequentialType>(Ty)) {
+    if (STy->isPointerTy())
+      return 0;
+    uint64_t EltSize = TD.getTypeAllocSize(STy->getElementType());
+    uint64_t NumElts = isa<ArrayType>(STy) ?
+      cast<ArrayType>(STy)->getNumElements() :
+      cast<VectorType>(STy)->getNumElements();
+    if (EltSize == 0 || Offset / EltSize >= NumElts)
+      return 0;
+    Constant *Elem = C->getAggregateElement(unsigned(Offset / EltSize));
+    if (!Elem)
+      return 0;
+    return getPointerAtOffset(Elem, Offset % EltSize, TD);
+  }
+
+  return 0;
+}
+
+/// noteLoadedPointer - V is a function pointer of type FTy, or a cast of one,
+/// that was loaded from memory.  It may have been loaded from a table, so if
+/// it is used for anything but a call it may be called from anywhere.
+void WholeProgramDevirt::noteLoadedPointer(Value *V, FunctionType *FTy) {
+  for (Value::use_iterator UI = V->use_begin(), E = V->use_end(); UI != E;
+       ++UI) {
+    User *U = *UI;
+    if (isa<CallInst>(U) || isa<InvokeInst>(U)) {
+      if (CallSite(cast<Instruction>(U)).isCallee(UI))
+        continue;
+    } else if (isa<ICmpInst>(U)) {
+      continue;
+    } else if (BitCastInst *BC = dyn_cast<BitCastInst>(U)) {
+      FunctionType *CastTy = 0;
+      if (PointerType *PTy = dyn_cast<PointerType>(BC->getType()))
+        CastTy = dyn_cast<FunctionType>(PTy->getElementType());
+      noteLoadedPointer(BC, CastTy ? CastTy : FTy);
+      continue;
+    }
+    EscapedTypes.insert(FTy);
+    return;
+  }
+}
+
+/// findEscapes - Find the types of the functions that may be called through
+/// something other than a table entry.
+void WholeProgramDevirt::findEscapes(Module &M) {
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isIntrinsic())
+      continue;
+    if ((!F->isDeclaration() && !F->hasLocalLinkage()) ||
+        !isOnlyCalledOrInTable(F))
+      EscapedTypes.insert(F->getFunctionType());
+
+    // A function pointer that was read from a table and then stored
+    // elsewhere may be called without going through the table.
+    for (inst_iterator I = inst_begin(F), IE = inst_end(F); I != IE; ++I)
+      if (LoadInst *LI = dyn_cast<LoadInst>(&*I))
+        if (PointerType *PTy = dyn_cast<PointerType>(LI->getType()))
+          if (FunctionType *FTy = dyn_cast<FunctionType>(PTy->getElementType()))
+            noteLoadedPointer(LI, FTy);
+  }
+}
+
+/// findAddressPoints - C is a constant that points Offset bytes into the
+/// table GV.  Record the places the table is referenced from.
+void WholeProgramDevirt::findAddressPoints(GlobalVariable *GV, Constant *C,
+                                           int64_t Offset) {
+  bool IsAddressPoint = false;
+  for (Value::use_iterator UI = C->use_begin(), E = C->use_end(); UI != E;
+       ++UI) {
+    User *U = *UI;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(U)) {
+      if (CE->getOpcode() == Instruction::BitCast) {
+        findAddressPoints(GV, CE, Offset);
+        continue;
+      }
+      APInt GEPOffset(TD->getPointerSizeInBits(), 0);
+      if (CE->getOpcode() == Instruction::GetElementPtr &&
+          CE->getOperand(0) == C &&
+          cast<GEPOperator>(CE)->accumulateConstantOffset(*TD, GEPOffset) &&
+          Offset + GEPOffset.getSExtValue() >= 0) {
+        findAddressPoints(GV, CE, Offset + GEPOffset.getSExtValue());
+        continue;
+      }
+    } else if (isa<LoadInst>(U)) {
+      // Loads straight from the table are resolved at the call.
+      continue;
+    } else if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
+      if (SI->getValueOperand() == C) {
+        IsAddressPoint = true;
+        continue;
+      }
+    } else if (isa<ConstantArray>(U) || isa<ConstantStruct>(U) ||
+               isa<ConstantVector>(U) || isa<GlobalVariable>(U)) {
+      IsAddressPoint = true;
+      continue;
+    }
+
+    // Anything else may compute any offset into the table.
+    DEBUG(dbgs() << "wholeprogramdevirt: " << GV->getName()
+                 << " may be read at any offset\n");
+    WholeTables.push_back(GV);
+    return;
+  }
+
+  if (IsAddressPoint)
+    AddressPoints.push_back(std::make_pair(GV, Offset));
+}
+
+bool WholeProgramDevirt::isEscapedType(FunctionType *FTy) {
+  for (SmallPtrSet<FunctionType*, 16>::iterator I = EscapedTypes.begin(),
+         E = EscapedTypes.end(); I != E; ++I)
+    if (isCompatible(FTy, *I))
+      return true;
+  return false;
+}
+
+/// addTarget - Add the function at Offset bytes into the table GV to Targets,
+/// if a call of type FTy may reach it.
+void WholeProgramDevirt::addTarget(GlobalVariable *GV, int64_t Offset,
+                                   FunctionType *FTy,
+                                   SmallVectorImpl<Function*> &Targets) {
+  if (Offset < 0)
+    return;
+  Constant *Entry = getPointerAtOffset(GV->getInitializer(), Offset, *TD);
+  if (!Entry)
+    return;
+  Function *F = dyn_cast<Function>(Entry->stripPointerCasts());
+  if (F && isCompatible(FTy, F->getFunctionType()) &&
+      std::find(Targets.begin(), Targets.end(), F) == Targets.end())
+    Targets.push_back(F);
+}
+
+/// findTargets - If the callee of CS is loaded from a table, put the functions
+/// it may be into Targets and return true.  Exact is set if the callee can
+/// only be one of Targets.
+bool WholeProgramDevirt::findTargets(CallSite CS,
+                                     SmallVectorImpl<Function*> &Targets,
+                                     bool &Exact) {
+  LoadInst *LI = dyn_cast<LoadInst>(CS.getCalledValue()->stripPointerCasts());
+  if (!LI || LI->isVolatile())
+    return false;
+  PointerType *CalleeTy = cast<PointerType>(CS.getCalledValue()->getType());
+  FunctionType *FTy = cast<FunctionType>(CalleeTy->getElementType());
+
+  // Split the address into a base and a constant offset.
+  APInt Offset(TD->getPointerSizeInBits(), 0);
+  Value *Base = LI->getPointerOperand();
+  for (;;) {
+    if (GEPOperator *GEP = dyn_cast<GEPOperator>(Base)) {
+      if (!GEP->accumulateConstantOffset(*TD, Offset))
+        return false;
+      Base = GEP->getPointerOperand();
+    } else if (Operator::getOpcode(Base) == Instruction::BitCast) {
+      Base = cast<Operator>(Base)->getOperand(0);
+    } else {
+      break;
+    }
+  }
+  int64_t K = Offset.getSExtValue();
+
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(Base)) {
+    // A load straight from a table reads exactly one entry.
+    if (!Tables.count(GV))
+      return false;
+    addTarget(GV, K, FTy, Targets);
+    Exact = true;
+  } else if (isa<LoadInst>(Base) && !isEscapedType(FTy)) {
+    // A vtable pointer loaded from an object points at an address point, if
+    // the object was built by code in this module.
+    Exact = false;
+    for (unsigned i = 0, e = AddressPoints.size(); i != e; ++i)
+      addTarget(AddressPoints[i].first, AddressPoints[i].second + K, FTy,
+                Targets);
+    for (unsigned i = 0, e = WholeTables.size(); i != e; ++i) {
+      SetVector<Function*> Fns;
+      collectFunctions(WholeTables[i]->getInitializer(), Fns);
+      for (SetVector<Function*>::iterator I = Fns.begin(), E = Fns.end();
+           I != E; ++I)
+        if (isCompatible(FTy, (*I)->getFunctionType()) &&
+            std::find(Targets.begin(), Targets.end(), *I) == Targets.end())
+          Targets.push_back(*I);
+    }
+  } else {
+    return false;
+  }
+  return !Targets.empty();
+}
+
+/// makeGuardedCalls - Compare the callee of CI against each of Targets in
+/// turn, calling the one that matches directly.  The indirect call is left
+/// as the last resort.
+void WholeProgramDevirt::makeGuardedCalls(CallInst *CI,
+                                          ArrayRef<Function*> Targets) {
+  BasicBlock *Head = CI->getParent();
+  Function *Caller = Head->getParent();
+  LLVMContext &Ctx = Caller->getContext();
+  BasicBlock *Fallback = Head->splitBasicBlock(CI, "devirt.indirect");
+  BasicBlock *Tail =
+    Fallback->splitBasicBlock(llvm::next(BasicBlock::iterator(CI)),
+                              "devirt.cont");
+
+  PHINode *PN = 0;
+  if (!CI->getType()->isVoidTy()) {
+    PN = PHINode::Create(CI->getType(), Targets.size() + 1, "", Tail->begin());
+    CI->replaceAllUsesWith(PN);
+    PN->takeName(CI);
+    PN->addIncoming(CI, Fallback);
+  }
+
+  Value *Callee = CI->getCalledValue();
+  Head->getTerminator()->eraseFromParent();
+  BasicBlock *Test = Head;
+  for (unsigned i = 0, e = Targets.size(); i != e; ++i) {
+    Constant *Target = Targets[i];
+    if (Target->getType() != Callee->getType())
+      Target = ConstantExpr::getBitCast(Target, Callee->getType());
+
+    BasicBlock *Direct = BasicBlock::Create(Ctx, "devirt.direct", Caller,
+                                            Fallback);
+    BasicBlock *Next = i + 1 == e ? Fallback :
+      BasicBlock::Create(Ctx, "devirt.next", Caller, Fallback);
+    Value *Cmp = new ICmpInst(*Test, ICmpInst::ICMP_EQ, Callee, Target,
+                              "devirt.cmp");
+    BranchInst::Create(Direct, Next, Cmp, Test);
+
+    CallInst *NewCI = cast<CallInst>(CI->clone());
+    NewCI->setCalledFunction(Target);
+    Direct->getInstList().push_back(NewCI);
+    BranchInst::Create(Tail, Direct);
+    if (PN)
+      PN->addIncoming(NewCI, Direct);
+    Test = Next;
+  }
+}
+
+bool WholeProgramDevirt::runOnModule(Module &M) {
+  TD = getAnalysisIfAvailable<DataLayout>();
+  if (!TD)
+    return false;
+
+  EscapedTypes.clear();
+  Tables.clear();
+  AddressPoints.clear();
+  WholeTables.clear();
+
+  findEscapes(M);
+  for (Module::global_iterator GV = M.global_begin(), E = M.global_end();
+       GV != E; ++GV)
+    if (GV->isConstant() && GV->hasDefinitiveInitializer() &&
+        containsFunction(GV->getInitializer())) {
+      Tables.insert(GV);
+      findAddressPoints(GV, GV, 0);
+    }
+  if (Tables.empty())
+    return false;
+
+  SmallVector<Instruction*, 64> Calls;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for (inst_iterator I = inst_begin(F), IE = inst_end(F); I != IE; ++I) {
+      CallSite CS(&*I);
+      if (CS && !CS.getCalledFunction())
+        Calls.push_back(&*I);
+    }
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Calls.size(); i != e; ++i) {
+    CallSite CS(Calls[i]);
+    SmallVector<Function*, 4> Targets;
+    bool Exact;
+    if (!findTargets(CS, Targets, Exact))
+      continue;
+
+    if (Exact) {
+      assert(Targets.size() == 1 && "A table entry is a single function");
+      DEBUG(dbgs() << "wholeprogramdevirt: call in "
+                   << CS.getCaller()->getName() << " always calls "
+                   << Targets[0]->getName() << '\n');
+      Constant *Target = Targets[0];
+      if (Target->getType() != CS.getCalledValue()->getType())
+        Target = ConstantExpr::getBitCast(Target,
+                                          CS.getCalledValue()->getType());
+      CS.setCalledFunction(Target);
+      ++NumSingleTarget;
+      Changed = true;
+      continue;
+    }
+
+    // Only a call can be given a fallback this way; an invoke keeps its
+    // successors to itself.
+    CallInst *CI = dyn_cast<CallInst>(Calls[i]);
+    if (!CI || Targets.size() > DevirtMaxTargets)
+      continue;
+    DEBUG(dbgs() << "wholeprogramdevirt: call in " << CS.getCaller()->getName()
+                 << " has " << Targets.size() << " targets\n");
+    makeGuardedCalls(CI, Targets);
+    ++NumGuarded;
+    Changed = true;
+  }
+  return Changed;
+}
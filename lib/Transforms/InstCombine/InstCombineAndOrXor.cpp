@@ -20,6 +20,8 @@
 using namespace llvm;
 using namespace PatternMatch;
 
+// MatchPeepholePatterns, generated from InstCombinePatterns.td.
+#include "InstCombinePatterns.inc"
 
 /// AddOne - Add one to a ConstantInt.
 static Constant *AddOne(ConstantInt *C) {
@@ -1139,20 +1141,12 @@ Instruction *InstCombiner::visitAnd(BinaryOperator &I) {
         return BinaryOperator::CreateNot(Or);
       }
 
-  {
-    Value *A = 0, *B = 0, *C = 0, *D = 0;
-    // (A|B) & ~(A&B) -> A^B
-    if (match(Op0, m_Or(m_Value(A), m_Value(B))) &&
-        match(Op1, m_Not(m_And(m_Value(C), m_Value(D)))) &&
-        ((A == C && B == D) || (A == D && B == C)))
-      return BinaryOperator::CreateXor(A, B);
-
-    // ~(A&B) & (A|B) -> A^B
-    if (match(Op1, m_Or(m_Value(A), m_Value(B))) &&
-        match(Op0, m_Not(m_And(m_Value(C), m_Value(D)))) &&
-        ((A == C && B == D) || (A == D && B == C)))
-      return BinaryOperator::CreateXor(A, B);
+  // Try the structural rewrites from InstCombinePatterns.td.
+  if (Instruction *R = MatchPeepholePatterns(I, Builder))
+    return R;
 
+  {
+    Value *A = 0, *B = 0;
     // A&(A^B) => A & ~B
     {
       Value *tmpOp0 = Op0;
@@ -1179,14 +1173,6 @@ Instruction *InstCombiner::visitAnd(BinaryOperator &I) {
           return BinaryOperator::CreateAnd(A, Builder->CreateNot(B));
       }
     }
-
-    // (A&((~A)|B)) -> A&B
-    if (match(Op0, m_Or(m_Not(m_Specific(Op1)), m_Value(A))) ||
-        match(Op0, m_Or(m_Value(A), m_Not(m_Specific(Op1)))))
-      return BinaryOperator::CreateAnd(A, Op1);
-    if (match(Op1, m_Or(m_Not(m_Specific(Op0)), m_Value(A))) ||
-        match(Op1, m_Or(m_Value(A), m_Not(m_Specific(Op0)))))
-      return BinaryOperator::CreateAnd(A, Op0);
   }
 
   if (ICmpInst *RHS = dyn_cast<ICmpInst>(Op1))
@@ -1964,6 +1950,10 @@ Instruction *InstCombiner::visitOr(BinaryOperator &I) {
         return BinaryOperator::CreateNot(And);
       }
 
+  // Try the structural rewrites from InstCombinePatterns.td.
+  if (Instruction *R = MatchPeepholePatterns(I, Builder))
+    return R;
+
   // Canonicalize xor to the RHS.
   bool SwappedForXor = false;
   if (match(Op0, m_Xor(m_Value(), m_Value()))) {
@@ -1971,17 +1961,8 @@ Instruction *InstCombiner::visitOr(BinaryOperator &I) {
     SwappedForXor = true;
   }
 
-  // A | ( A ^ B) -> A |  B
   // A | (~A ^ B) -> A | ~B
-  // (A & B) | (A ^ B)
   if (match(Op1, m_Xor(m_Value(A), m_Value(B)))) {
-    if (Op0 == A || Op0 == B)
-      return BinaryOperator::CreateOr(A, B);
-
-    if (match(Op0, m_And(m_Specific(A), m_Specific(B))) ||
-        match(Op0, m_And(m_Specific(B), m_Specific(A))))
-      return BinaryOperator::CreateOr(A, B);
-
     if (Op1->hasOneUse() && match(A, m_Not(m_Specific(Op0)))) {
       Value *Not = Builder->CreateNot(B, B->getName()+".not");
       return BinaryOperator::CreateOr(Not, Op0);
@@ -2301,21 +2282,9 @@ Instruction *InstCombiner::visitXor(BinaryOperator &I) {
                                   Op1I->getOperand(1));
   }
 
-  if (Op0I && Op1I) {
-    Value *A, *B, *C, *D;
-    // (A & B)^(A | B) -> A ^ B
-    if (match(Op0I, m_And(m_Value(A), m_Value(B))) &&
-        match(Op1I, m_Or(m_Value(C), m_Value(D)))) {
-      if ((A == C && B == D) || (A == D && B == C))
-        return BinaryOperator::CreateXor(A, B);
-    }
-    // (A | B)^(A & B) -> A ^ B
-    if (match(Op0I, m_Or(m_Value(A), m_Value(B))) &&
-        match(Op1I, m_And(m_Value(C), m_Value(D)))) {
-      if ((A == C && B == D) || (A == D && B == C))
-        return BinaryOperator::CreateXor(A, B);
-    }
-  }
+  // Try the structural rewrites from InstCombinePatterns.td.
+  if (Instruction *R = MatchPeepholePatterns(I, Builder))
+    return R;
 
   // (icmp1 A, B) ^ (icmp2 A, B) --> (icmp3 A, B)
   if (ICmpInst *RHS = dyn_cast<ICmpInst>(I.getOperand(1)))
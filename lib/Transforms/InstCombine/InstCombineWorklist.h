@@ -26,10 +26,18 @@ class LLVM_LIBRARY_VISIBILITY InstCombineWorklist {
   SmallVector<Instruction*, 256> Worklist;
   DenseMap<Instruction*, unsigned> WorklistMap;
 
+  /// Changed - When change tracking is enabled, every instruction added with
+  /// Add since the last call to takeChanged, i.e. every instruction that was
+  /// created or whose operands or users changed. Removed instructions are
+  /// nulled out.
+  SmallVector<Instruction*, 64> Changed;
+  DenseMap<Instruction*, unsigned> ChangedMap;
+  bool TrackChanges;
+
   void operator=(const InstCombineWorklist&RHS) LLVM_DELETED_FUNCTION;
   InstCombineWorklist(const InstCombineWorklist&) LLVM_DELETED_FUNCTION;
 public:
-  InstCombineWorklist() {}
+  InstCombineWorklist() : TrackChanges(false) {}
 
   bool isEmpty() const { return Worklist.empty(); }
 
@@ -40,6 +48,9 @@ public:
       DEBUG(errs() << "IC: ADD: " << *I << '\n');
       Worklist.push_back(I);
     }
+    if (TrackChanges &&
+        ChangedMap.insert(std::make_pair(I, Changed.size())).second)
+      Changed.push_back(I);
   }
 
   void AddValue(Value *V) {
@@ -62,8 +73,15 @@ public:
     }
   }
 
-  // Remove - remove I from the worklist if it exists.
+  // Remove - remove I from the worklist, and from the recorded changes, if it
+  // exists.
   void Remove(Instruction *I) {
+    DenseMap<Instruction*, unsigned>::iterator CI = ChangedMap.find(I);
+    if (CI != ChangedMap.end()) {
+      Changed[CI->second] = 0;
+      ChangedMap.erase(CI);
+    }
+
     DenseMap<Instruction*, unsigned>::iterator It = WorklistMap.find(I);
     if (It == WorklistMap.end()) return; // Not in worklist.
 
@@ -73,6 +91,26 @@ public:
     WorklistMap.erase(It);
   }
 
+  /// setTrackChanges - Start or stop recording the instructions that are
+  /// added to the worklist. Stopping drops what was recorded so far.
+  void setTrackChanges(bool Track) {
+    TrackChanges = Track;
+    if (!Track) {
+      Changed.clear();
+      ChangedMap.clear();
+    }
+  }
+
+  /// takeChanged - Move the instructions recorded since the last call into
+  /// List, in the order they were first added, and start a new record.
+  void takeChanged(SmallVectorImpl<Instruction*> &List) {
+    for (unsigned i = 0, e = Changed.size(); i != e; ++i)
+      if (Changed[i])
+        List.push_back(Changed[i]);
+    Changed.clear();
+    ChangedMap.clear();
+  }
+
   Instruction *RemoveOne() {
     Instruction *I = Worklist.back();
     Worklist.pop_back();
@@ -65,12 +65,26 @@ STATISTIC(NumSunkInst , "Number of instructions sunk");
 STATISTIC(NumExpand,    "Number of expansions");
 STATISTIC(NumFactor   , "Number of factorizations");
 STATISTIC(NumReassoc  , "Number of reassociations");
+STATISTIC(NumSweeps   , "Number of full sweeps over a function");
+STATISTIC(NumRevisited, "Number of insts revisited after a change");
+STATISTIC(NumCapped   , "Number of functions that hit the iteration limit");
 
 static cl::opt<bool> UnsafeFPShrink("enable-double-float-shrink", cl::Hidden,
                                    cl::init(false),
                                    cl::desc("Enable unsafe double to float "
                                             "shrinking for math lib calls"));
 
+static cl::opt<bool>
+IncrementalIterations("instcombine-incremental", cl::Hidden, cl::init(false),
+                      cl::desc("After the first sweep over a function, only "
+                               "revisit instructions whose operands or users "
+                               "changed"));
+
+static cl::opt<unsigned>
+MaxIterations("instcombine-max-iterations", cl::Hidden, cl::init(1000),
+              cl::desc("Maximum number of iterations over a function (0 for "
+                       "no limit)"));
+
 // Initialization Routines
 void llvm::initializeInstCombine(PassRegistry &Registry) {
   initializeInstCombinerPass(Registry);
@@ -2296,7 +2310,30 @@ bool InstCombiner::DoOneIteration(Function &F, unsigned Iteration) {
   DEBUG(errs() << "\n\nINSTCOMBINE ITERATION #" << Iteration << " on "
                << F.getName() << "\n");
 
-  {
+  // The previous iteration already visited everything it changed until
+  // nothing more happened. In incremental mode, give those instructions one
+  // more look instead of sweeping the whole function. A branch whose
+  // condition became constant still needs a sweep though: only that removes
+  // the code it no longer reaches.
+  bool Sweep = !IncrementalIterations || Iteration == 0;
+  SmallVector<Instruction*, 64> Revisit;
+  if (!Sweep) {
+    Worklist.takeChanged(Revisit);
+    if (Revisit.empty())
+      return false;
+    for (unsigned i = 0, e = Revisit.size(); i != e && !Sweep; ++i) {
+      if (BranchInst *BI = dyn_cast<BranchInst>(Revisit[i]))
+        Sweep = BI->isConditional() && isa<Constant>(BI->getCondition());
+      else if (SwitchInst *SI = dyn_cast<SwitchInst>(Revisit[i]))
+        Sweep = isa<Constant>(SI->getCondition());
+    }
+  }
+
+  if (!Sweep) {
+    NumRevisited += Revisit.size();
+    Worklist.AddInitialGroup(&Revisit[0], Revisit.size());
+  } else {
+    ++NumSweeps;
     // Do a depth-first traversal of the function, populate the worklist with
     // the reachable instructions.  Ignore blocks that are not reachable.  Keep
     // track of which blocks we visit.
@@ -2398,6 +2435,16 @@ bool InstCombiner::DoOneIteration(Function &F, unsigned Iteration) {
     DEBUG(raw_string_ostream SS(OrigI); I->print(SS); OrigI = SS.str(););
     DEBUG(errs() << "IC: Visiting: " << OrigI << '\n');
 
+    // In incremental mode, an instruction that loses a user must be revisited
+    // as it may now be dead. Remember the operands in case I is modified in
+    // place.
+    SmallVector<WeakVH, 4> OldOperands;
+    if (IncrementalIterations)
+      for (User::op_iterator OI = I->op_begin(), OE = I->op_end(); OI != OE;
+           ++OI)
+        if (isa<Instruction>(*OI))
+          OldOperands.push_back(WeakVH(*OI));
+
     if (Instruction *Result = visit(*I)) {
       ++NumCombined;
       // Should we replace the old instruction with a new one?
@@ -2443,6 +2490,9 @@ bool InstCombiner::DoOneIteration(Function &F, unsigned Iteration) {
           Worklist.Add(I);
           Worklist.AddUsersToWorkList(*I);
         }
+        for (unsigned i = 0, e = OldOperands.size(); i != e; ++i)
+          if (OldOperands[i])
+            Worklist.AddValue(OldOperands[i]);
       }
       MadeIRChange = true;
     }
@@ -2495,9 +2545,18 @@ bool InstCombiner::runOnFunction(Function &F) {
   EverMadeChange = LowerDbgDeclare(F);
 
   // Iterate while there is work to do.
+  Worklist.setTrackChanges(IncrementalIterations);
   unsigned Iteration = 0;
-  while (DoOneIteration(F, Iteration++))
+  while (DoOneIteration(F, Iteration++)) {
     EverMadeChange = true;
+    if (Iteration == MaxIterations) {
+      DEBUG(errs() << "IC: Giving up on " << F.getName() << " after "
+                   << Iteration << " iterations\n");
+      ++NumCapped;
+      break;
+    }
+  }
+  Worklist.setTrackChanges(false);
 
   Builder = 0;
   return EverMadeChange;
@@ -52,6 +52,10 @@ namespace {
 
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequired<LazyValueInfo>();
+      // Every change made here either replaces a value with an equal one or
+      // removes an edge that can never be taken, so whatever LazyValueInfo
+      // has cached stays correct for the next client.
+      AU.addPreserved<LazyValueInfo>();
     }
   };
 }
@@ -0,0 +1,393 @@
+//===- LoopDistribute.cpp - Loop Distribution Pass ------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass splits an innermost loop into a sequence of loops, one for each
+// group of stores, when some of the groups carry a dependence from one
+// iteration to the next and others do not. The loop vectorizer rejects a loop
+// as a whole if any of its memory accesses form a loop-carried dependence;
+// after distribution the independent part is a loop of its own and can be
+// vectorized.
+//
+// Each store starts a partition, which also owns the computation that feeds
+// it. Loads feeding several partitions are duplicated. DependenceAnalysis then
+// decides which partitions may run one after the other: a dependence that
+// would be reversed by running all iterations of one partition before the
+// other forces the two, and everything in between, into the same loop.
+// Finally, neighbouring partitions of the same kind are merged so that the
+// loop is split only where vectorizable and non-vectorizable code meet, and
+// where a carried dependence between two vectorizable partitions would make
+// their union non-vectorizable.
+//
+// Only loops made of a single block are handled, with one induction variable
+// and no other values carried between iterations or used after the loop.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-distribute"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/IntEqClasses.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumLoopsDistributed, "Number of loops distributed");
+STATISTIC(NumLoopsCreated,     "Number of loops created by distribution");
+
+static cl::opt<unsigned>
+MaxPartitions("loop-distribute-max-partitions", cl::init(8), cl::Hidden,
+              cl::desc("Maximum number of loops to distribute a loop into"));
+
+namespace {
+  /// A group of stores that will be placed in a loop of its own.
+  struct Partition {
+    SmallVector<StoreInst*, 4> Stores;
+    /// True if the partition carries a memory dependence across iterations.
+    bool Cyclic;
+    Partition() : Cyclic(false) {}
+  };
+
+  class LoopDistribute : public FunctionPass {
+    LoopInfo *LI;
+    ScalarEvolution *SE;
+    DependenceAnalysis *DA;
+
+  public:
+    static char ID; // Pass ID, replacement for typeid
+    LoopDistribute() : FunctionPass(ID) {
+      initializeLoopDistributePass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addRequired<DependenceAnalysis>();
+    }
+
+  private:
+    bool isDistributableLoop(Loop *L);
+    bool findPartitions(Loop *L, SmallVectorImpl<Partition> &Parts);
+    void distributeLoop(Loop *L, ArrayRef<Partition> Parts);
+  };
+}
+
+char LoopDistribute::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopDistribute, "loop-distribute", "Distribute loops",
+                      false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_DEPENDENCY(DependenceAnalysis)
+INITIALIZE_PASS_END(LoopDistribute, "loop-distribute", "Distribute loops",
+                    false, false)
+
+Pass *llvm::createLoopDistributePass() { return new LoopDistribute(); }
+
+/// isDistributableLoop - Return true if L is a single block innermost loop
+/// whose only cross-iteration value is an induction variable that controls
+/// the exit test, and that only touches memory through simple loads and
+/// stores.
+bool LoopDistribute::isDistributableLoop(Loop *L) {
+  if (!L->empty() || L->getNumBlocks() != 1 || !L->getLoopPreheader() ||
+      !L->getExitBlock())
+    return false;
+
+  BasicBlock *BB = L->getHeader();
+  BranchInst *BI = dyn_cast<BranchInst>(BB->getTerminator());
+  if (!BI || !BI->isConditional())
+    return false;
+
+  PHINode *IV = dyn_cast<PHINode>(BB->begin());
+  if (!IV || isa<PHINode>(IV->getNextNode()) ||
+      !isa<SCEVAddRecExpr>(SE->getSCEV(IV)))
+    return false;
+
+  // The exit test may only depend on the induction variable, so that every
+  // copy of the loop runs the same number of iterations.
+  ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!Cmp || Cmp->getParent() != BB)
+    return false;
+  for (unsigned i = 0; i != 2; ++i) {
+    Value *Op = Cmp->getOperand(i);
+    if (Op == IV || L->isLoopInvariant(Op))
+      continue;
+    BinaryOperator *Inc = dyn_cast<BinaryOperator>(Op);
+    if (!Inc || Inc->getOperand(0) != IV ||
+        !L->isLoopInvariant(Inc->getOperand(1)))
+      return false;
+  }
+
+  unsigned NumStores = 0;
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+    if (LoadInst *LD = dyn_cast<LoadInst>(I)) {
+      if (!LD->isSimple())
+        return false;
+    } else if (StoreInst *ST = dyn_cast<StoreInst>(I)) {
+      if (!ST->isSimple())
+        return false;
+      ++NumStores;
+    } else if (I->mayReadOrWriteMemory() || I->mayHaveSideEffects()) {
+      return false;
+    }
+
+    // Nothing may be live out of the loop.
+    for (Value::use_iterator UI = I->use_begin(), UE = I->use_end(); UI != UE;
+         ++UI)
+      if (cast<Instruction>(*UI)->getParent() != BB)
+        return false;
+  }
+  return NumStores > 1;
+}
+
+/// findPartitions - Split the stores of L into an ordered list of partitions
+/// that can each become a loop of their own. Return false if distributing L
+/// would not separate a vectorizable partition from a cyclic one.
+bool LoopDistribute::findPartitions(Loop *L,
+                                    SmallVectorImpl<Partition> &Parts) {
+  BasicBlock *BB = L->getHeader();
+  PHINode *IV = cast<PHINode>(BB->begin());
+  unsigned Level = L->getLoopDepth();
+
+  // Every store starts a partition. Record, for each memory access, the
+  // partitions whose stores it feeds.
+  SmallVector<StoreInst*, 8> Stores;
+  SmallVector<Instruction*, 16> MemInsts;
+  DenseMap<Instruction*, SmallVector<unsigned, 2> > Owners;
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+    if (StoreInst *ST = dyn_cast<StoreInst>(I)) {
+      Owners[ST].push_back(Stores.size());
+      Stores.push_back(ST);
+    }
+
+  for (unsigned P = 0, e = Stores.size(); P != e; ++P) {
+    SmallVector<Instruction*, 8> Worklist;
+    SmallPtrSet<Instruction*, 16> Visited;
+    Worklist.push_back(Stores[P]);
+    while (!Worklist.empty()) {
+      Instruction *I = Worklist.pop_back_val();
+      for (User::op_iterator OI = I->op_begin(), OE = I->op_end(); OI != OE;
+           ++OI) {
+        Instruction *Op = dyn_cast<Instruction>(*OI);
+        if (!Op || Op == IV || Op->getParent() != BB || !Visited.insert(Op))
+          continue;
+        if (isa<LoadInst>(Op))
+          Owners[Op].push_back(P);
+        Worklist.push_back(Op);
+      }
+    }
+  }
+
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+    if ((isa<LoadInst>(I) || isa<StoreInst>(I)) && Owners.count(I))
+      MemInsts.push_back(I);
+
+  // Join partitions that a dependence does not allow to run one after the
+  // other, together with everything in between to keep the order of the
+  // remaining ones. Remember which accesses carry a dependence.
+  IntEqClasses Classes(Stores.size());
+  SmallVector<std::pair<unsigned, unsigned>, 8> CarriedDeps;
+  for (unsigned i = 0, e = MemInsts.size(); i != e; ++i) {
+    for (unsigned j = i; j != e; ++j) {
+      Instruction *Src = MemInsts[i], *Dst = MemInsts[j];
+      if (!isa<StoreInst>(Src) && !isa<StoreInst>(Dst))
+        continue;
+      OwningPtr<Dependence> D(DA->depends(Src, Dst, true));
+      if (!D)
+        continue;
+
+      // Src comes first in the body. A dependence is carried if it can
+      // cross iterations; it runs backward if Dst can execute in an earlier
+      // iteration than Src.
+      bool Confused = D->isConfused() || D->getLevels() < Level;
+      unsigned Dir = Confused ? unsigned(Dependence::DVEntry::ALL) :
+        D->getDirection(Level);
+      bool Carried = Dir & (Dependence::DVEntry::LT | Dependence::DVEntry::GT);
+      if (Carried)
+        CarriedDeps.push_back(std::make_pair(i, j));
+
+      ArrayRef<unsigned> SrcParts = Owners[Src], DstParts = Owners[Dst];
+      for (unsigned a = 0, ae = SrcParts.size(); a != ae; ++a) {
+        for (unsigned b = 0, be = DstParts.size(); b != be; ++b) {
+          unsigned PA = SrcParts[a], PB = DstParts[b];
+          // Distribution runs all of PA before all of PB if PA < PB, and the
+          // other way round if PA > PB.
+          bool Reversed = PA < PB ? (Dir & Dependence::DVEntry::GT) :
+            PA > PB ? (Dir & (Dependence::DVEntry::LT |
+                              Dependence::DVEntry::EQ)) : false;
+          if (!Reversed)
+            continue;
+          DEBUG(dbgs() << "LDist: Keeping " << *Src << " and " << *Dst
+                       << " in one loop\n");
+          for (unsigned P = std::min(PA, PB), PE = std::max(PA, PB); P != PE;
+               ++P)
+            Classes.join(P, P + 1);
+        }
+      }
+    }
+  }
+  Classes.compress();
+  if (Classes.getNumClasses() < 2)
+    return false;
+
+  // A partition is cyclic if a carried dependence stays within it.
+  SmallVector<bool, 8> Cyclic(Classes.getNumClasses(), false);
+  for (unsigned i = 0, e = CarriedDeps.size(); i != e; ++i) {
+    ArrayRef<unsigned> SrcParts = Owners[MemInsts[CarriedDeps[i].first]];
+    ArrayRef<unsigned> DstParts = Owners[MemInsts[CarriedDeps[i].second]];
+    for (unsigned a = 0, ae = SrcParts.size(); a != ae; ++a)
+      for (unsigned b = 0, be = DstParts.size(); b != be; ++b)
+        if (Classes[SrcParts[a]] == Classes[DstParts[b]])
+          Cyclic[Classes[SrcParts[a]]] = true;
+  }
+
+  // Classes are contiguous ranges of stores. Fold neighbours of the same kind,
+  // except for two acyclic ones that a carried dependence runs between, as
+  // together they would be cyclic.
+  SmallVector<int, 8> PartOfClass(Classes.getNumClasses(), -1);
+  for (unsigned P = 0, e = Stores.size(); P != e; ++P) {
+    unsigned C = Classes[P];
+    bool IsCyclic = Cyclic[C];
+    bool NewPart = Parts.empty();
+    if (!NewPart && PartOfClass[C] < 0) {
+      int Last = Parts.size() - 1;
+      NewPart = Parts.back().Cyclic != IsCyclic;
+      for (unsigned i = 0, ie = CarriedDeps.size(); i != ie && !NewPart;
+           ++i) {
+        ArrayRef<unsigned> SrcParts = Owners[MemInsts[CarriedDeps[i].first]];
+        ArrayRef<unsigned> DstParts = Owners[MemInsts[CarriedDeps[i].second]];
+        for (unsigned a = 0, ae = SrcParts.size(); a != ae; ++a)
+          for (unsigned b = 0, be = DstParts.size(); b != be; ++b) {
+            unsigned CA = Classes[SrcParts[a]], CB = Classes[DstParts[b]];
+            if ((CA == C && PartOfClass[CB] == Last) ||
+                (CB == C && PartOfClass[CA] == Last))
+              NewPart = true;
+          }
+      }
+    }
+    if (NewPart)
+      Parts.push_back(Partition());
+    PartOfClass[C] = Parts.size() - 1;
+    Parts.back().Stores.push_back(Stores[P]);
+    Parts.back().Cyclic |= IsCyclic;
+  }
+
+  DEBUG(dbgs() << "LDist: Found " << Parts.size() << " partitions in loop at "
+               << BB->getName() << "\n");
+  return Parts.size() > 1 && Parts.size() <= MaxPartitions;
+}
+
+/// Erase the stores of BB that are not in Keep, along with the computation
+/// that only fed them.
+static void removeOtherStores(BasicBlock *BB,
+                              const SmallPtrSet<Instruction*, 8> &Keep) {
+  SmallVector<StoreInst*, 8> Dead;
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+    if (StoreInst *ST = dyn_cast<StoreInst>(I))
+      if (!Keep.count(ST))
+        Dead.push_back(ST);
+
+  for (unsigned i = 0, e = Dead.size(); i != e; ++i) {
+    SmallVector<Value*, 2> Ops(Dead[i]->op_begin(), Dead[i]->op_end());
+    Dead[i]->eraseFromParent();
+    for (unsigned j = 0, je = Ops.size(); j != je; ++j)
+      RecursivelyDeleteTriviallyDeadInstructions(Ops[j]);
+  }
+}
+
+/// distributeLoop - Emit a copy of L for each partition but the last in front
+/// of it, and keep only the stores of the matching partition in each copy:
+///
+///   preheader -> copy 0 -> ph -> copy 1 -> ... -> ph -> L -> exit
+///
+void LoopDistribute::distributeLoop(Loop *L, ArrayRef<Partition> Parts) {
+  BasicBlock *BB = L->getHeader();
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Exit = L->getExitBlock();
+  Function *F = BB->getParent();
+  PHINode *IV = cast<PHINode>(BB->begin());
+
+  BasicBlock *Pred = Preheader;
+  for (unsigned P = 0, e = Parts.size() - 1; P != e; ++P) {
+    ValueToValueMapTy VMap;
+    BasicBlock *Copy = CloneBasicBlock(BB, VMap, ".ldist", F);
+    Copy->moveBefore(BB);
+    VMap[BB] = Copy;
+    for (BasicBlock::iterator I = Copy->begin(), E = Copy->end(); I != E; ++I)
+      RemapInstruction(I, VMap, RF_IgnoreMissingEntries);
+
+    // Enter the copy from the previous loop and leave it to the next one.
+    Pred->getTerminator()->replaceUsesOfWith(BB, Copy);
+    PHINode *CopyIV = cast<PHINode>(VMap[IV]);
+    CopyIV->setIncomingBlock(CopyIV->getBasicBlockIndex(Preheader), Pred);
+    BasicBlock *NextPH = BasicBlock::Create(F->getContext(),
+                                            BB->getName() + ".ldist.ph", F, BB);
+    BranchInst::Create(BB, NextPH);
+    Copy->getTerminator()->replaceUsesOfWith(Exit, NextPH);
+    Pred = NextPH;
+
+    SmallPtrSet<Instruction*, 8> Keep;
+    for (unsigned i = 0, ie = Parts[P].Stores.size(); i != ie; ++i)
+      Keep.insert(cast<Instruction>(VMap[Parts[P].Stores[i]]));
+    removeOtherStores(Copy, Keep);
+  }
+
+  IV->setIncomingBlock(IV->getBasicBlockIndex(Preheader), Pred);
+  SmallPtrSet<Instruction*, 8> Keep(Parts.back().Stores.begin(),
+                                    Parts.back().Stores.end());
+  removeOtherStores(BB, Keep);
+}
+
+bool LoopDistribute::runOnFunction(Function &F) {
+  LI = &getAnalysis<LoopInfo>();
+  SE = &getAnalysis<ScalarEvolution>();
+  DA = &getAnalysis<DependenceAnalysis>();
+
+  // Collect the innermost loops first; distribution adds blocks that
+  // LoopInfo does not know about.
+  SmallVector<Loop*, 8> Worklist(LI->begin(), LI->end());
+  SmallVector<Loop*, 8> Innermost;
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    Worklist.append(L->begin(), L->end());
+    if (L->empty())
+      Innermost.push_back(L);
+  }
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Innermost.size(); i != e; ++i) {
+    Loop *L = Innermost[i];
+    SmallVector<Partition, 4> Parts;
+    if (!isDistributableLoop(L) || !findPartitions(L, Parts))
+      continue;
+
+    SE->forgetLoop(L);
+    distributeLoop(L, Parts);
+    ++NumLoopsDistributed;
+    NumLoopsCreated += Parts.size() - 1;
+    Changed = true;
+  }
+  return Changed;
+}
@@ -0,0 +1,285 @@
+//===- LoopFuse.cpp - Loop Fusion Pass ------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass merges two adjacent loops that run the same number of iterations
+// into one, so that data the first loop writes or reads is still in cache, or
+// even in a register, when the second loop uses it. It is the inverse of loop
+// distribution and pays off for loops bound by memory bandwidth.
+//
+// Fusion moves each iteration of the second loop up to just after the same
+// iteration of the first. DependenceAnalysis proves most pairs of accesses
+// independent; for the rest, the accesses must hit the same address in the
+// same iteration, so that fusion keeps their order and does not introduce a
+// loop-carried dependence that would stop the loop vectorizer.
+//
+// Only single block loops that directly follow each other are handled, and
+// the first loop may not have values that are live out of it. A loop is fused
+// at most once per run.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-fuse"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
+using namespace llvm;
+
+STATISTIC(NumLoopsFused, "Number of loops fused");
+
+namespace {
+  class LoopFuse : public FunctionPass {
+    LoopInfo *LI;
+    ScalarEvolution *SE;
+    DependenceAnalysis *DA;
+    DataLayout *TD;
+
+  public:
+    static char ID; // Pass ID, replacement for typeid
+    LoopFuse() : FunctionPass(ID) {
+      initializeLoopFusePass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addRequired<DependenceAnalysis>();
+    }
+
+  private:
+    bool isFusibleLoop(Loop *L, SmallVectorImpl<Instruction*> &MemInsts);
+    Loop *getNextLoop(Loop *L);
+    bool isSameAccess(Instruction *A, Loop *LA, Instruction *B, Loop *LB);
+    bool canFuse(Loop *L1, ArrayRef<Instruction*> Mem1,
+                 Loop *L2, ArrayRef<Instruction*> Mem2);
+    void fuseLoops(Loop *L1, Loop *L2);
+  };
+}
+
+char LoopFuse::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopFuse, "loop-fuse", "Fuse loops", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_DEPENDENCY(DependenceAnalysis)
+INITIALIZE_PASS_END(LoopFuse, "loop-fuse", "Fuse loops", false, false)
+
+Pass *llvm::createLoopFusePass() { return new LoopFuse(); }
+
+static Value *getPointerOperand(Instruction *I) {
+  if (LoadInst *LD = dyn_cast<LoadInst>(I))
+    return LD->getPointerOperand();
+  return cast<StoreInst>(I)->getPointerOperand();
+}
+
+/// isFusibleLoop - Return true if L is a single block innermost loop with a
+/// computable trip count that only touches memory through simple loads and
+/// stores, and collect those in MemInsts.
+bool LoopFuse::isFusibleLoop(Loop *L, SmallVectorImpl<Instruction*> &MemInsts) {
+  if (!L->empty() || L->getNumBlocks() != 1 || !L->getLoopPreheader() ||
+      !L->getExitBlock() ||
+      isa<SCEVCouldNotCompute>(SE->getBackedgeTakenCount(L)))
+    return false;
+
+  BasicBlock *BB = L->getHeader();
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+    if (LoadInst *LD = dyn_cast<LoadInst>(I)) {
+      if (!LD->isSimple())
+        return false;
+      MemInsts.push_back(LD);
+    } else if (StoreInst *ST = dyn_cast<StoreInst>(I)) {
+      if (!ST->isSimple())
+        return false;
+      MemInsts.push_back(ST);
+    } else if (I->mayReadOrWriteMemory() || I->mayHaveSideEffects()) {
+      return false;
+    }
+  }
+  return !MemInsts.empty();
+}
+
+/// getNextLoop - Return the sibling loop that L exits straight into, through
+/// a block that does nothing but branch to it, or null.
+Loop *LoopFuse::getNextLoop(Loop *L) {
+  BasicBlock *Exit = L->getExitBlock();
+  if (Exit->size() != 1 || Exit->getSinglePredecessor() != L->getHeader())
+    return 0;
+  BasicBlock *Succ = Exit->getTerminator()->getNumSuccessors() == 1 ?
+    Exit->getTerminator()->getSuccessor(0) : 0;
+  Loop *Next = Succ ? LI->getLoopFor(Succ) : 0;
+  if (!Next || Next->getHeader() != Succ ||
+      Next->getParentLoop() != L->getParentLoop() ||
+      Next->getLoopPreheader() != Exit)
+    return 0;
+  return Next;
+}
+
+/// isSameAccess - Return true if A in LA and B in LB access the same number of
+/// bytes at the same address in every iteration, and no other iteration
+/// touches any of these bytes.
+bool LoopFuse::isSameAccess(Instruction *A, Loop *LA, Instruction *B,
+                            Loop *LB) {
+  Value *PtrA = getPointerOperand(A), *PtrB = getPointerOperand(B);
+  if (!TD || PtrA->getType() != PtrB->getType())
+    return false;
+  const SCEVAddRecExpr *ARA = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(PtrA));
+  const SCEVAddRecExpr *ARB = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(PtrB));
+  if (!ARA || !ARB || ARA->getLoop() != LA || ARB->getLoop() != LB ||
+      !ARA->isAffine() || !ARB->isAffine())
+    return false;
+  if (ARA->getStart() != ARB->getStart() ||
+      ARA->getStepRecurrence(*SE) != ARB->getStepRecurrence(*SE))
+    return false;
+
+  // With a step smaller than the access, neighbouring iterations overlap and
+  // the second loop would see a partly written value.
+  const SCEVConstant *Step =
+    dyn_cast<SCEVConstant>(ARA->getStepRecurrence(*SE));
+  if (!Step)
+    return false;
+  Type *Ty = cast<PointerType>(PtrA->getType())->getElementType();
+  return Step->getValue()->getValue().abs().uge(TD->getTypeStoreSize(Ty));
+}
+
+/// canFuse - Return true if L1 and L2 can be fused, and doing so lets them
+/// share memory traffic.
+bool LoopFuse::canFuse(Loop *L1, ArrayRef<Instruction*> Mem1,
+                       Loop *L2, ArrayRef<Instruction*> Mem2) {
+  // Nothing computed in the first loop may be used after it.
+  BasicBlock *BB1 = L1->getHeader();
+  for (BasicBlock::iterator I = BB1->begin(), E = BB1->end(); I != E; ++I)
+    for (Value::use_iterator UI = I->use_begin(), UE = I->use_end(); UI != UE;
+         ++UI)
+      if (cast<Instruction>(*UI)->getParent() != BB1)
+        return false;
+
+  const SCEV *TC1 = SE->getBackedgeTakenCount(L1);
+  const SCEV *TC2 = SE->getBackedgeTakenCount(L2);
+  if (TC1->getType() != TC2->getType() || TC1 != TC2) {
+    DEBUG(dbgs() << "LFuse: Trip counts differ: " << *TC1 << " and " << *TC2
+                 << "\n");
+    return false;
+  }
+
+  bool SharesMemory = false;
+  for (unsigned i = 0, e = Mem1.size(); i != e; ++i) {
+    for (unsigned j = 0, je = Mem2.size(); j != je; ++j) {
+      Instruction *Src = Mem1[i], *Dst = Mem2[j];
+      if (GetUnderlyingObject(getPointerOperand(Src), TD) ==
+          GetUnderlyingObject(getPointerOperand(Dst), TD))
+        SharesMemory = true;
+      if (!isa<StoreInst>(Src) && !isa<StoreInst>(Dst))
+        continue;
+      OwningPtr<Dependence> D(DA->depends(Src, Dst, true));
+      if (D && !isSameAccess(Src, L1, Dst, L2)) {
+        DEBUG(dbgs() << "LFuse: Dependence prevents fusion: " << *Src
+                     << " and " << *Dst << "\n");
+        return false;
+      }
+    }
+  }
+  return SharesMemory;
+}
+
+/// fuseLoops - Append the body of L2 to that of L1, let L1's exit test
+/// control the fused loop, and delete what is left of L2.
+void LoopFuse::fuseLoops(Loop *L1, Loop *L2) {
+  BasicBlock *BB1 = L1->getHeader(), *BB2 = L2->getHeader();
+  BasicBlock *Preheader1 = L1->getLoopPreheader();
+  BasicBlock *Between = L1->getExitBlock();
+  BasicBlock *Exit2 = L2->getExitBlock();
+
+  // The phis of L2 go to the top of the fused body, everything else to the
+  // bottom.
+  Instruction *FirstNonPHI = BB1->getFirstNonPHI();
+  SmallVector<PHINode*, 4> PHIs2;
+  while (PHINode *PN = dyn_cast<PHINode>(BB2->begin())) {
+    PN->moveBefore(FirstNonPHI);
+    PN->setIncomingBlock(PN->getBasicBlockIndex(Between), Preheader1);
+    PN->setIncomingBlock(PN->getBasicBlockIndex(BB2), BB1);
+    PHIs2.push_back(PN);
+  }
+  TerminatorInst *Term2 = BB2->getTerminator();
+  Value *Cond2 = cast<BranchInst>(Term2)->isConditional() ?
+    cast<BranchInst>(Term2)->getCondition() : 0;
+  while (&BB2->front() != Term2)
+    BB2->front().moveBefore(BB1->getTerminator());
+
+  // Leave the fused loop to L2's exit.
+  BB1->getTerminator()->replaceUsesOfWith(Between, Exit2);
+  for (BasicBlock::iterator I = Exit2->begin(); PHINode *PN = dyn_cast<PHINode>(I);
+       ++I) {
+    int Idx = PN->getBasicBlockIndex(BB2);
+    if (Idx >= 0)
+      PN->setIncomingBlock(Idx, BB1);
+  }
+
+  Term2->eraseFromParent();
+  Between->eraseFromParent();
+  BB2->eraseFromParent();
+
+  // L2's exit test is now dead, and so is its induction variable unless the
+  // body uses it.
+  if (Cond2)
+    RecursivelyDeleteTriviallyDeadInstructions(Cond2);
+  for (unsigned i = 0, e = PHIs2.size(); i != e; ++i)
+    RecursivelyDeleteDeadPHINode(PHIs2[i]);
+}
+
+bool LoopFuse::runOnFunction(Function &F) {
+  LI = &getAnalysis<LoopInfo>();
+  SE = &getAnalysis<ScalarEvolution>();
+  DA = &getAnalysis<DependenceAnalysis>();
+  TD = getAnalysisIfAvailable<DataLayout>();
+
+  // Pick all pairs before fusing any, as fusion deletes blocks that
+  // LoopInfo still refers to.
+  SmallVector<Loop*, 8> Worklist(LI->begin(), LI->end());
+  SmallVector<std::pair<Loop*, Loop*>, 4> Pairs;
+  SmallPtrSet<Loop*, 8> Used;
+  while (!Worklist.empty()) {
+    Loop *L1 = Worklist.pop_back_val();
+    Worklist.append(L1->begin(), L1->end());
+
+    SmallVector<Instruction*, 8> Mem1, Mem2;
+    if (Used.count(L1) || !isFusibleLoop(L1, Mem1))
+      continue;
+    Loop *L2 = getNextLoop(L1);
+    if (!L2 || Used.count(L2) || !isFusibleLoop(L2, Mem2) ||
+        !canFuse(L1, Mem1, L2, Mem2))
+      continue;
+    Used.insert(L1);
+    Used.insert(L2);
+    Pairs.push_back(std::make_pair(L1, L2));
+  }
+
+  for (unsigned i = 0, e = Pairs.size(); i != e; ++i) {
+    DEBUG(dbgs() << "LFuse: Fusing " << Pairs[i].first->getHeader()->getName()
+                 << " and " << Pairs[i].second->getHeader()->getName() << "\n");
+    SE->forgetLoop(Pairs[i].first);
+    SE->forgetLoop(Pairs[i].second);
+    fuseLoops(Pairs[i].first, Pairs[i].second);
+    ++NumLoopsFused;
+  }
+  return !Pairs.empty();
+}
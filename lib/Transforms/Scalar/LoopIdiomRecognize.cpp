@@ -26,11 +26,6 @@
 // i64 and larger types when i64 is legal and the value has few bits set.  It
 // would be good to enhance isel to emit a loop for ctpop in this case.
 //
-// We should enhance the memset/memcpy recognition to handle multiple stores in
-// the loop.  This would handle things like:
-//   void foo(_Complex float *P)
-//     for (i) { __real__(*P) = 0;  __imag__(*P) = 0; }
-//
 // We should enhance this to handle negative strides through memory.
 // Alternatively (and perhaps better) we could rely on an earlier pass to force
 // forward iteration through memory, which is generally better for cache
@@ -43,6 +38,7 @@
 
 #define DEBUG_TYPE "loop-idiom"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/LoopPass.h"
@@ -62,6 +58,7 @@ using namespace llvm;
 
 STATISTIC(NumMemSet, "Number of memset's formed from loop stores");
 STATISTIC(NumMemCpy, "Number of memcpy's formed from loop load+stores");
+STATISTIC(NumStoreGroups, "Number of groups of adjacent stores merged");
 
 namespace {
 
@@ -148,6 +145,10 @@ namespace {
                         SmallVectorImpl<BasicBlock*> &ExitBlocks);
 
     bool processLoopStore(StoreInst *SI, const SCEV *BECount);
+    bool processLoopStoreGroups(BasicBlock *BB, const SCEV *BECount);
+    bool processLoopStoreGroup(ArrayRef<StoreInst*> Stores,
+                               const SCEVAddRecExpr *Ev, unsigned Stride,
+                               const SCEV *BECount);
     bool processLoopMemSet(MemSetInst *MSI, const SCEV *BECount);
 
     bool processLoopStridedStore(Value *DestPtr, unsigned StoreSize,
@@ -735,7 +736,10 @@ bool LoopIdiomRecognize::runOnLoopBlock(BasicBlock *BB, const SCEV *BECount,
     if (!DT->dominates(BB, ExitBlocks[i]))
       return false;
 
-  bool MadeChange = false;
+  // First look for stores that only cover the stride together, like the
+  // fields of a struct being initialized.
+  bool MadeChange = processLoopStoreGroups(BB, BECount);
+
   for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ) {
     Instruction *Inst = I++;
     // Look for store instructions, which may be optimized to memset/memcpy.
@@ -872,7 +876,7 @@ processLoopMemSet(MemSetInst *MSI, const SCEV *BECount) {
 static bool mayLoopAccessLocation(Value *Ptr,AliasAnalysis::ModRefResult Access,
                                   Loop *L, const SCEV *BECount,
                                   unsigned StoreSize, AliasAnalysis &AA,
-                                  Instruction *IgnoredStore) {
+                                  const SmallPtrSet<Instruction*, 8> &Ignored) {
   // Get the location that may be stored across the loop.  Since the access is
   // strided positively through memory, we say that the modified location starts
   // at the pointer and has infinite size.
@@ -892,7 +896,7 @@ static bool mayLoopAccessLocation(Value *Ptr,AliasAnalysis::ModRefResult Access,
   for (Loop::block_iterator BI = L->block_begin(), E = L->block_end(); BI != E;
        ++BI)
     for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end(); I != E; ++I)
-      if (&*I != IgnoredStore &&
+      if (!Ignored.count(I) &&
           (AA.getModRefInfo(I, StoreLoc) & Access))
         return true;
 
@@ -989,9 +993,11 @@ processLoopStridedStore(Value *DestPtr, unsigned StoreSize,
                            Preheader->getTerminator());
 
 
+  SmallPtrSet<Instruction*, 8> Ignored;
+  Ignored.insert(TheStore);
   if (mayLoopAccessLocation(BasePtr, AliasAnalysis::ModRef,
                             CurLoop, BECount,
-                            StoreSize, getAnalysis<AliasAnalysis>(), TheStore)){
+                            StoreSize, getAnalysis<AliasAnalysis>(), Ignored)){
     Expander.clear();
     // If we generated new code for the base pointer, clean up.
     deleteIfDeadInstruction(BasePtr, *SE, TLI);
@@ -1078,9 +1084,11 @@ processLoopStoreOfLoopLoad(StoreInst *SI, unsigned StoreSize,
                            Builder.getInt8PtrTy(SI->getPointerAddressSpace()),
                            Preheader->getTerminator());
 
+  SmallPtrSet<Instruction*, 8> Ignored;
+  Ignored.insert(SI);
   if (mayLoopAccessLocation(StoreBasePtr, AliasAnalysis::ModRef,
                             CurLoop, BECount, StoreSize,
-                            getAnalysis<AliasAnalysis>(), SI)) {
+                            getAnalysis<AliasAnalysis>(), Ignored)) {
     Expander.clear();
     // If we generated new code for the base pointer, clean up.
     deleteIfDeadInstruction(StoreBasePtr, *SE, TLI);
@@ -1095,7 +1103,7 @@ processLoopStoreOfLoopLoad(StoreInst *SI, unsigned StoreSize,
                            Preheader->getTerminator());
 
   if (mayLoopAccessLocation(LoadBasePtr, AliasAnalysis::Mod, CurLoop, BECount,
-                            StoreSize, getAnalysis<AliasAnalysis>(), SI)) {
+                            StoreSize, getAnalysis<AliasAnalysis>(), Ignored)) {
     Expander.clear();
     // If we generated new code for the base pointer, clean up.
     deleteIfDeadInstruction(LoadBasePtr, *SE, TLI);
@@ -1136,3 +1144,266 @@ processLoopStoreOfLoopLoad(StoreInst *SI, unsigned StoreSize,
   ++NumMemCpy;
   return true;
 }
+
+namespace {
+  /// StridedStore - A store through a pointer that advances by a constant
+  /// stride larger than the store itself on each iteration.
+  struct StridedStore {
+    StoreInst *SI;
+    const SCEVAddRecExpr *Ev;
+    unsigned Size;
+    int64_t Offset;
+
+    bool operator<(const StridedStore &RHS) const {
+      return Offset < RHS.Offset;
+    }
+  };
+}
+
+/// processLoopStoreGroups - Look for stores in BB that together write every
+/// byte of each stride, for example:
+///   for (i) { P[i].a = 0; P[i].b = 0; }
+/// and try to turn each such group into a single memset or memcpy.
+bool LoopIdiomRecognize::processLoopStoreGroups(BasicBlock *BB,
+                                                const SCEV *BECount) {
+  SmallVector<StridedStore, 8> Candidates;
+  for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+    StoreInst *SI = dyn_cast<StoreInst>(I);
+    if (SI == 0 || !SI->isSimple())
+      continue;
+
+    uint64_t SizeInBits = TD->getTypeSizeInBits(SI->getValueOperand()
+                                                  ->getType());
+    if ((SizeInBits & 7) || (SizeInBits >> 32) != 0)
+      continue;
+
+    const SCEVAddRecExpr *Ev =
+      dyn_cast<SCEVAddRecExpr>(SE->getSCEV(SI->getPointerOperand()));
+    if (Ev == 0 || Ev->getLoop() != CurLoop || !Ev->isAffine())
+      continue;
+
+    // Stores that cover the whole stride on their own are handled one at a
+    // time by processLoopStore.
+    const SCEVConstant *Stride = dyn_cast<SCEVConstant>(Ev->getOperand(1));
+    unsigned Size = (unsigned)SizeInBits >> 3;
+    if (Stride == 0 || Stride->getValue()->getValue().sle(Size))
+      continue;
+
+    StridedStore S = { SI, Ev, Size, 0 };
+    Candidates.push_back(S);
+  }
+  if (Candidates.size() < 2)
+    return false;
+
+  bool MadeChange = false;
+  SmallPtrSet<StoreInst*, 8> Visited;
+  for (unsigned i = 0, e = Candidates.size(); i != e; ++i) {
+    if (!Visited.insert(Candidates[i].SI))
+      continue;
+
+    // Gather the stores with the same stride whose start is a constant
+    // distance away from this one.
+    const SCEVAddRecExpr *Ev = Candidates[i].Ev;
+    SmallVector<StridedStore, 8> Group;
+    Group.push_back(Candidates[i]);
+    for (unsigned j = i + 1; j != e; ++j) {
+      StridedStore S = Candidates[j];
+      if (Visited.count(S.SI) || S.Ev->getOperand(1) != Ev->getOperand(1))
+        continue;
+      const SCEVConstant *Dist =
+        dyn_cast<SCEVConstant>(SE->getMinusSCEV(S.Ev->getStart(),
+                                                Ev->getStart()));
+      if (Dist == 0)
+        continue;
+      S.Offset = Dist->getValue()->getSExtValue();
+      Group.push_back(S);
+      Visited.insert(S.SI);
+    }
+    if (Group.size() < 2)
+      continue;
+
+    // The stores have to tile the stride exactly, without gaps or overlap.
+    std::stable_sort(Group.begin(), Group.end());
+    uint64_t Stride =
+      cast<SCEVConstant>(Ev->getOperand(1))->getValue()->getZExtValue();
+    int64_t End = Group[0].Offset;
+    bool Contiguous = true;
+    SmallVector<StoreInst*, 8> Stores;
+    for (unsigned j = 0, je = Group.size(); j != je && Contiguous; ++j) {
+      Contiguous = Group[j].Offset == End;
+      End += Group[j].Size;
+      Stores.push_back(Group[j].SI);
+    }
+    if (!Contiguous || (uint64_t)(End - Group[0].Offset) != Stride ||
+        (Stride >> 32) != 0)
+      continue;
+
+    if (processLoopStoreGroup(Stores, Group[0].Ev, (unsigned)Stride, BECount))
+      MadeChange = true;
+  }
+  return MadeChange;
+}
+
+/// processLoopStoreGroup - We see a group of strided stores, sorted by their
+/// offset, that together write every byte of each stride.  If they all store
+/// the same splattable value or constants, form a memset or memset_pattern16;
+/// if they store same-strided loads from the same layout, form a memcpy.
+bool LoopIdiomRecognize::
+processLoopStoreGroup(ArrayRef<StoreInst*> Stores, const SCEVAddRecExpr *Ev,
+                      unsigned Stride, const SCEV *BECount) {
+  StoreInst *First = Stores[0];
+
+  // See whether all of the stores write the same byte.
+  Value *SplatValue = isBytewiseValue(First->getValueOperand());
+  for (unsigned i = 1, e = Stores.size(); i != e && SplatValue; ++i)
+    if (isBytewiseValue(Stores[i]->getValueOperand()) != SplatValue)
+      SplatValue = 0;
+  if (SplatValue && (!TLI->has(LibFunc::memset) ||
+                     !CurLoop->isLoopInvariant(SplatValue)))
+    SplatValue = 0;
+
+  // Otherwise, if they store constants and the stride is a power of two that
+  // fits, the constants form a pattern for memset_pattern16.
+  Constant *PatternValue = 0;
+  if (!SplatValue && TLI->has(LibFunc::memset_pattern16) &&
+      !TD->isBigEndian() && Stride <= 16 && (Stride & (Stride - 1)) == 0) {
+    // The stores were tiled by their store size, but a packed struct lays
+    // its fields out by their alloc size (e.g. 4 bytes for an i24), so the
+    // two must agree.
+    SmallVector<Constant*, 8> Fields;
+    for (unsigned i = 0, e = Stores.size(); i != e; ++i)
+      if (Constant *C = dyn_cast<Constant>(Stores[i]->getValueOperand()))
+        if (TD->getTypeAllocSize(C->getType()) ==
+            TD->getTypeStoreSize(C->getType()))
+          Fields.push_back(C);
+    if (Fields.size() == Stores.size()) {
+      PatternValue = ConstantStruct::getAnon(Fields, /*Packed=*/true);
+      if (Stride != 16) {
+        ArrayType *AT = ArrayType::get(PatternValue->getType(), 16 / Stride);
+        PatternValue =
+          ConstantArray::get(AT, std::vector<Constant*>(16 / Stride,
+                                                        PatternValue));
+      }
+    }
+  }
+
+  // Otherwise, check for a field by field copy: every store stores a load
+  // with the same stride, at the same offset from the first load as the
+  // store's from the first store.
+  SmallVector<LoadInst*, 8> Loads;
+  const SCEVAddRecExpr *LoadEv = 0;
+  if (!SplatValue && !PatternValue && TLI->has(LibFunc::memcpy)) {
+    for (unsigned i = 0, e = Stores.size(); i != e; ++i) {
+      LoadInst *LI = dyn_cast<LoadInst>(Stores[i]->getValueOperand());
+      if (LI == 0 || !LI->isSimple())
+        break;
+      const SCEVAddRecExpr *Ev_i =
+        dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Stores[i]->getPointerOperand()));
+      const SCEVAddRecExpr *LEv =
+        dyn_cast<SCEVAddRecExpr>(SE->getSCEV(LI->getPointerOperand()));
+      if (LEv == 0 || LEv->getLoop() != CurLoop || !LEv->isAffine() ||
+          LEv->getOperand(1) != Ev->getOperand(1))
+        break;
+      if (i == 0) {
+        LoadEv = LEv;
+      } else if (SE->getMinusSCEV(LEv->getStart(), LoadEv->getStart()) !=
+                 SE->getMinusSCEV(Ev_i->getStart(), Ev->getStart())) {
+        break;
+      }
+      Loads.push_back(LI);
+    }
+    if (Loads.size() != Stores.size())
+      Loads.clear();
+  }
+
+  if (!SplatValue && !PatternValue && Loads.empty())
+    return false;
+
+  // The trip count of the loop and the base pointer of the addrec SCEV is
+  // guaranteed to be loop invariant, which means that it should dominate the
+  // header.  This allows us to insert code for it in the preheader.
+  BasicBlock *Preheader = CurLoop->getLoopPreheader();
+  IRBuilder<> Builder(Preheader->getTerminator());
+  SCEVExpander Expander(*SE, "loop-idiom");
+
+  // Nothing else in the loop may touch the region that the stores write, and
+  // for a memcpy nothing but the loads may read it.
+  SmallPtrSet<Instruction*, 8> Ignored(Stores.begin(), Stores.end());
+  AliasAnalysis &AA = getAnalysis<AliasAnalysis>();
+  Value *BasePtr =
+    Expander.expandCodeFor(Ev->getStart(),
+                           Builder.getInt8PtrTy(First->getPointerAddressSpace()),
+                           Preheader->getTerminator());
+  if (mayLoopAccessLocation(BasePtr, AliasAnalysis::ModRef, CurLoop, BECount,
+                            Stride, AA, Ignored)) {
+    Expander.clear();
+    deleteIfDeadInstruction(BasePtr, *SE, TLI);
+    return false;
+  }
+
+  Value *LoadBasePtr = 0;
+  if (!Loads.empty()) {
+    LoadBasePtr =
+      Expander.expandCodeFor(LoadEv->getStart(),
+                             Builder.getInt8PtrTy(
+                               Loads[0]->getPointerAddressSpace()),
+                             Preheader->getTerminator());
+    if (mayLoopAccessLocation(LoadBasePtr, AliasAnalysis::Mod, CurLoop,
+                              BECount, Stride, AA, Ignored)) {
+      Expander.clear();
+      deleteIfDeadInstruction(LoadBasePtr, *SE, TLI);
+      deleteIfDeadInstruction(BasePtr, *SE, TLI);
+      return false;
+    }
+  }
+
+  // The # stored bytes is (BECount+1)*Stride.  Expand the trip count out to
+  // pointer size if it isn't already.
+  Type *IntPtr = TD->getIntPtrType(First->getContext());
+  BECount = SE->getTruncateOrZeroExtend(BECount, IntPtr);
+  const SCEV *NumBytesS = SE->getAddExpr(BECount, SE->getConstant(IntPtr, 1),
+                                         SCEV::FlagNUW);
+  NumBytesS = SE->getMulExpr(NumBytesS, SE->getConstant(IntPtr, Stride),
+                             SCEV::FlagNUW);
+  Value *NumBytes =
+    Expander.expandCodeFor(NumBytesS, IntPtr, Preheader->getTerminator());
+
+  // The first store is at the start of each stride, so its alignment holds
+  // for the whole region.
+  CallInst *NewCall;
+  if (SplatValue) {
+    NewCall = Builder.CreateMemSet(BasePtr, SplatValue, NumBytes,
+                                   First->getAlignment());
+    ++NumMemSet;
+  } else if (PatternValue) {
+    Module *M = Preheader->getParent()->getParent();
+    Value *MSP = M->getOrInsertFunction("memset_pattern16",
+                                        Builder.getVoidTy(),
+                                        Builder.getInt8PtrTy(),
+                                        Builder.getInt8PtrTy(), IntPtr,
+                                        (void*)0);
+    GlobalVariable *GV = new GlobalVariable(*M, PatternValue->getType(), true,
+                                            GlobalValue::InternalLinkage,
+                                            PatternValue, ".memset_pattern");
+    GV->setUnnamedAddr(true); // Ok to merge these.
+    GV->setAlignment(16);
+    Value *PatternPtr = ConstantExpr::getBitCast(GV, Builder.getInt8PtrTy());
+    NewCall = Builder.CreateCall3(MSP, BasePtr, PatternPtr, NumBytes);
+    ++NumMemSet;
+  } else {
+    NewCall = Builder.CreateMemCpy(BasePtr, LoadBasePtr, NumBytes,
+                                   std::min(First->getAlignment(),
+                                            Loads[0]->getAlignment()));
+    ++NumMemCpy;
+  }
+  NewCall->setDebugLoc(First->getDebugLoc());
+
+  DEBUG(dbgs() << "  Formed " << *NewCall << "\n"
+               << "    from " << Stores.size() << " stores to: " << *Ev
+               << "\n");
+
+  for (unsigned i = 0, e = Stores.size(); i != e; ++i)
+    deleteDeadInstruction(Stores[i], *SE, TLI);
+  ++NumStoreGroups;
+  return true;
+}
@@ -0,0 +1,609 @@
+//===- LoopInterchange.cpp - Loop interchange and tiling ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements two transformations of perfectly nested loop pairs that
+// improve the locality of memory accesses:
+//
+//  * Loop interchange swaps the outer and the inner loop of a nest when the
+//    inner loop then walks memory with a smaller stride.
+//
+//  * Loop tiling strip-mines the inner loop of a nest and moves the new strip
+//    loop outside of the outer loop, so that the lines touched by one tile
+//    are reused before they are evicted.
+//
+// Both passes use DependenceAnalysis to prove that the new iteration order
+// preserves every dependence, and a simple cache model built on the cache
+// line size reported by TargetTransformInfo to decide whether to transform.
+//
+// Only nests of two loops are handled. Both loops must be in the rotated form
+// produced by -loop-rotate, with a single induction variable that is stepped by
+// a constant and compared against a bound that is invariant in the nest. The
+// outer loop may not contain any code besides the inner loop and its own
+// induction variable, and the inner loop may not carry scalar values across
+// iterations.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "loop-interchange"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumInterchanged, "Number of loop nests interchanged");
+STATISTIC(NumTiled,        "Number of loop nests tiled");
+
+static cl::opt<unsigned>
+TileSize("loop-tile-size", cl::init(0), cl::Hidden,
+         cl::desc("Number of inner loop iterations in one tile (zero derives "
+                  "it from the cache line size)"));
+
+namespace {
+
+/// The induction variable of a rotated loop: a header phi that starts at
+/// Start, is incremented by Step in the latch, and is compared against Bound
+/// to decide whether to take the backedge.
+struct LoopIV {
+  PHINode *Phi;
+  BinaryOperator *Next;
+  ICmpInst *Cmp;
+  BranchInst *Br;
+  Value *Start;
+  ConstantInt *Step;
+  Value *Bound;
+  /// True if the exit test compares Next rather than Phi.
+  bool CmpOnNext;
+  /// True if the backedge is taken when the exit test is true.
+  bool ContinueOnTrue;
+
+  LoopIV() : Phi(0), Next(0), Cmp(0), Br(0), Start(0), Step(0), Bound(0),
+             CmpOnNext(false), ContinueOnTrue(false) {}
+
+  /// The predicate under which the backedge is taken.
+  CmpInst::Predicate getContinuePredicate() const {
+    return ContinueOnTrue ? Cmp->getPredicate() : Cmp->getInversePredicate();
+  }
+};
+
+/// A perfectly nested pair of loops together with their induction variables.
+struct LoopNest {
+  Loop *Outer;
+  Loop *Inner;
+  LoopIV OuterIV;
+  LoopIV InnerIV;
+  SmallVector<Instruction*, 8> MemInsts;
+};
+
+/// Shared analysis of loop nests for the interchange and tiling passes.
+class LoopNestAnalyzer {
+  LoopInfo *LI;
+  ScalarEvolution *SE;
+  DependenceAnalysis *DA;
+  unsigned LineSize;
+
+public:
+  LoopNestAnalyzer(LoopInfo *LI, ScalarEvolution *SE, DependenceAnalysis *DA,
+                   unsigned LineSize)
+    : LI(LI), SE(SE), DA(DA), LineSize(LineSize) {}
+
+  /// Collect every perfect two-deep nest in the function.
+  void collectNests(SmallVectorImpl<LoopNest> &Nests);
+
+  /// \returns true if executing the nest with the two loops swapped preserves
+  /// all of its memory dependences.
+  bool isInterchangeLegal(LoopNest &N);
+
+  /// \returns the fraction of a cache line, scaled by the line size, that the
+  /// memory access \p I moves through in one iteration of \p L.
+  unsigned getAccessCost(Instruction *I, Loop *L);
+
+  /// \returns the number of cache lines, scaled by the line size, that one
+  /// iteration of \p L touches in the body of the nest.
+  unsigned getLineCost(LoopNest &N, Loop *L);
+
+private:
+  bool analyzeIV(Loop *L, LoopIV &IV);
+  bool analyzeNest(Loop *Outer, LoopNest &N);
+  const SCEV *getStride(const SCEV *S, const Loop *L);
+};
+
+} // end anonymous namespace
+
+bool LoopNestAnalyzer::analyzeIV(Loop *L, LoopIV &IV) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Latch = L->getLoopLatch();
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Latch || !Preheader || L->getExitingBlock() != Latch)
+    return false;
+
+  IV.Br = dyn_cast<BranchInst>(Latch->getTerminator());
+  if (!IV.Br || !IV.Br->isConditional())
+    return false;
+  IV.Cmp = dyn_cast<ICmpInst>(IV.Br->getCondition());
+  if (!IV.Cmp || !IV.Cmp->hasOneUse() || IV.Cmp->getParent() != Latch)
+    return false;
+  IV.ContinueOnTrue = IV.Br->getSuccessor(0) == Header;
+
+  // The only phi in the header must be the induction variable.
+  IV.Phi = dyn_cast<PHINode>(Header->begin());
+  if (!IV.Phi || isa<PHINode>(IV.Phi->getNextNode()) ||
+      !IV.Phi->getType()->isIntegerTy())
+    return false;
+  IV.Start = IV.Phi->getIncomingValueForBlock(Preheader);
+  IV.Next = dyn_cast<BinaryOperator>(IV.Phi->getIncomingValueForBlock(Latch));
+  if (!IV.Next || IV.Next->getOpcode() != Instruction::Add ||
+      IV.Next->getOperand(0) != IV.Phi)
+    return false;
+  IV.Step = dyn_cast<ConstantInt>(IV.Next->getOperand(1));
+  if (!IV.Step || IV.Step->isZero())
+    return false;
+
+  Value *Compared = IV.Cmp->getOperand(0);
+  IV.Bound = IV.Cmp->getOperand(1);
+  if (Compared != IV.Phi && Compared != IV.Next)
+    return false;
+  IV.CmpOnNext = Compared == IV.Next;
+
+  // The increment may only feed the phi and the exit test; the phi itself may
+  // be used anywhere in the loop.
+  for (Value::use_iterator UI = IV.Next->use_begin(), E = IV.Next->use_end();
+       UI != E; ++UI)
+    if (*UI != IV.Phi && *UI != IV.Cmp)
+      return false;
+  for (Value::use_iterator UI = IV.Phi->use_begin(), E = IV.Phi->use_end();
+       UI != E; ++UI)
+    if (!L->contains(cast<Instruction>(*UI)))
+      return false;
+  return true;
+}
+
+bool LoopNestAnalyzer::analyzeNest(Loop *Outer, LoopNest &N) {
+  if (Outer->getSubLoops().size() != 1)
+    return false;
+  Loop *Inner = Outer->getSubLoops()[0];
+  if (!Inner->empty())
+    return false;
+
+  N.Outer = Outer;
+  N.Inner = Inner;
+  if (!analyzeIV(Outer, N.OuterIV) || !analyzeIV(Inner, N.InnerIV))
+    return false;
+
+  // The bounds of the inner loop may not depend on the outer loop.
+  if (!Outer->isLoopInvariant(N.InnerIV.Start) ||
+      !Outer->isLoopInvariant(N.InnerIV.Bound) ||
+      !Outer->isLoopInvariant(N.OuterIV.Bound))
+    return false;
+
+  // Apart from the inner loop, the outer loop may only contain its induction
+  // variable and control flow.
+  for (Loop::block_iterator BI = Outer->block_begin(), BE = Outer->block_end();
+       BI != BE; ++BI) {
+    if (Inner->contains(*BI))
+      continue;
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end(); I != E;
+         ++I) {
+      if (&*I == N.OuterIV.Phi || &*I == N.OuterIV.Next ||
+          &*I == N.OuterIV.Cmp)
+        continue;
+      if (BranchInst *Br = dyn_cast<BranchInst>(I))
+        if (Br->isUnconditional() || Br == N.OuterIV.Br)
+          continue;
+      return false;
+    }
+  }
+
+  // The inner loop may only access memory through simple loads and stores,
+  // and none of its values may live past it.
+  for (Loop::block_iterator BI = Inner->block_begin(), BE = Inner->block_end();
+       BI != BE; ++BI) {
+    for (BasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end(); I != E;
+         ++I) {
+      if (LoadInst *LD = dyn_cast<LoadInst>(I)) {
+        if (!LD->isSimple())
+          return false;
+        N.MemInsts.push_back(LD);
+      } else if (StoreInst *ST = dyn_cast<StoreInst>(I)) {
+        if (!ST->isSimple())
+          return false;
+        N.MemInsts.push_back(ST);
+      } else if (I->mayReadOrWriteMemory() || I->mayHaveSideEffects()) {
+        return false;
+      }
+
+      for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+           UI != UE; ++UI)
+        if (!Inner->contains(cast<Instruction>(*UI)))
+          return false;
+    }
+  }
+  return !N.MemInsts.empty();
+}
+
+void LoopNestAnalyzer::collectNests(SmallVectorImpl<LoopNest> &Nests) {
+  SmallVector<Loop*, 8> Worklist(LI->begin(), LI->end());
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    Worklist.append(L->begin(), L->end());
+    LoopNest N;
+    if (analyzeNest(L, N))
+      Nests.push_back(N);
+  }
+}
+
+bool LoopNestAnalyzer::isInterchangeLegal(LoopNest &N) {
+  unsigned OuterLevel = N.Outer->getLoopDepth();
+  unsigned InnerLevel = OuterLevel + 1;
+
+  for (unsigned i = 0, e = N.MemInsts.size(); i != e; ++i) {
+    for (unsigned j = i; j != e; ++j) {
+      Instruction *Src = N.MemInsts[i], *Dst = N.MemInsts[j];
+      if (!isa<StoreInst>(Src) && !isa<StoreInst>(Dst))
+        continue;
+      OwningPtr<Dependence> D(DA->depends(Src, Dst, true));
+      if (!D)
+        continue;
+      if (D->isConfused() || D->getLevels() < InnerLevel) {
+        DEBUG(dbgs() << "LI: Unknown dependence between " << *Src << " and "
+                     << *Dst << "\n");
+        return false;
+      }
+      // Swapping the loops reverses a dependence that runs forward in one
+      // loop and backward in the other.
+      unsigned OuterDir = D->getDirection(OuterLevel);
+      unsigned InnerDir = D->getDirection(InnerLevel);
+      if (((OuterDir & Dependence::DVEntry::LT) &&
+           (InnerDir & Dependence::DVEntry::GT)) ||
+          ((OuterDir & Dependence::DVEntry::GT) &&
+           (InnerDir & Dependence::DVEntry::LT))) {
+        DEBUG(dbgs() << "LI: Interchange would reverse the dependence between "
+                     << *Src << " and " << *Dst << "\n");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// \returns the distance in bytes between the addresses that \p S computes in
+/// two consecutive iterations of \p L, or null if it is not known.
+const SCEV *LoopNestAnalyzer::getStride(const SCEV *S, const Loop *L) {
+  while (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    if (AR->getLoop() == L)
+      return AR->getStepRecurrence(*SE);
+    S = AR->getStart();
+  }
+  if (SE->isLoopInvariant(S, L))
+    return SE->getConstant(Type::getInt64Ty(L->getHeader()->getContext()), 0);
+  return 0;
+}
+
+unsigned LoopNestAnalyzer::getAccessCost(Instruction *I, Loop *L) {
+  Value *Ptr = isa<LoadInst>(I) ? cast<LoadInst>(I)->getPointerOperand() :
+    cast<StoreInst>(I)->getPointerOperand();
+  // An access whose stride is unknown or at least a line long touches a new
+  // line in every iteration; a shorter stride touches one every
+  // LineSize / Stride iterations.
+  const SCEVConstant *Stride =
+    dyn_cast_or_null<SCEVConstant>(getStride(SE->getSCEV(Ptr), L));
+  if (!Stride)
+    return LineSize;
+  uint64_t Bytes = Stride->getValue()->getValue().abs().getLimitedValue();
+  return std::min<uint64_t>(Bytes, LineSize);
+}
+
+unsigned LoopNestAnalyzer::getLineCost(LoopNest &N, Loop *L) {
+  unsigned Cost = 0;
+  for (unsigned i = 0, e = N.MemInsts.size(); i != e; ++i)
+    Cost += getAccessCost(N.MemInsts[i], L);
+  return Cost;
+}
+
+/// Swap the two loops of \p N. Both loops run at least once and neither trip
+/// count depends on the other loop, so exchanging the start, step and exit
+/// test of the two induction variables, and their roles in the body, visits
+/// the same iterations in the interchanged order.
+static void interchangeNest(LoopNest &N) {
+  LoopIV &OuterIV = N.OuterIV, &InnerIV = N.InnerIV;
+
+  // Swap the roles of the two induction variables in the body. Collect the
+  // uses first so that the second rewrite does not undo the first.
+  SmallVector<Use*, 8> OuterUses, InnerUses;
+  for (Value::use_iterator UI = OuterIV.Phi->use_begin(),
+       E = OuterIV.Phi->use_end(); UI != E; ++UI)
+    if (*UI != OuterIV.Next && *UI != OuterIV.Cmp)
+      OuterUses.push_back(&UI.getUse());
+  for (Value::use_iterator UI = InnerIV.Phi->use_begin(),
+       E = InnerIV.Phi->use_end(); UI != E; ++UI)
+    if (*UI != InnerIV.Next && *UI != InnerIV.Cmp)
+      InnerUses.push_back(&UI.getUse());
+  for (unsigned i = 0, e = OuterUses.size(); i != e; ++i)
+    OuterUses[i]->set(InnerIV.Phi);
+  for (unsigned i = 0, e = InnerUses.size(); i != e; ++i)
+    InnerUses[i]->set(OuterIV.Phi);
+
+  // Exchange the start values.
+  BasicBlock *OuterPH = N.Outer->getLoopPreheader();
+  BasicBlock *InnerPH = N.Inner->getLoopPreheader();
+  OuterIV.Phi->setIncomingValue(OuterIV.Phi->getBasicBlockIndex(OuterPH),
+                                InnerIV.Start);
+  InnerIV.Phi->setIncomingValue(InnerIV.Phi->getBasicBlockIndex(InnerPH),
+                                OuterIV.Start);
+
+  // Exchange the steps, along with the wrap flags they were proven under.
+  bool OuterNSW = OuterIV.Next->hasNoSignedWrap();
+  bool OuterNUW = OuterIV.Next->hasNoUnsignedWrap();
+  OuterIV.Next->setOperand(1, InnerIV.Step);
+  OuterIV.Next->setHasNoSignedWrap(InnerIV.Next->hasNoSignedWrap());
+  OuterIV.Next->setHasNoUnsignedWrap(InnerIV.Next->hasNoUnsignedWrap());
+  InnerIV.Next->setOperand(1, OuterIV.Step);
+  InnerIV.Next->setHasNoSignedWrap(OuterNSW);
+  InnerIV.Next->setHasNoUnsignedWrap(OuterNUW);
+
+  // Exchange the exit tests, keeping each branch's successor order.
+  CmpInst::Predicate OuterPred = OuterIV.getContinuePredicate();
+  CmpInst::Predicate InnerPred = InnerIV.getContinuePredicate();
+  OuterIV.Cmp->setPredicate(OuterIV.ContinueOnTrue ? InnerPred :
+                            CmpInst::getInversePredicate(InnerPred));
+  InnerIV.Cmp->setPredicate(InnerIV.ContinueOnTrue ? OuterPred :
+                            CmpInst::getInversePredicate(OuterPred));
+  OuterIV.Cmp->setOperand(1, InnerIV.Bound);
+  InnerIV.Cmp->setOperand(1, OuterIV.Bound);
+}
+
+/// \returns true if the inner loop of \p N can be strip-mined into tiles of
+/// \p T iterations: it counts up by one from a constant start to a constant
+/// bound more than one tile away.
+static bool canTileInnerLoop(LoopNest &N, unsigned T) {
+  LoopIV &IV = N.InnerIV;
+  if (!IV.Step->isOne() || !IV.CmpOnNext || !N.Outer->getExitBlock())
+    return false;
+  ConstantInt *Start = dyn_cast<ConstantInt>(IV.Start);
+  ConstantInt *Bound = dyn_cast<ConstantInt>(IV.Bound);
+  if (!Start || !Bound || !Start->getValue().slt(Bound->getValue()))
+    return false;
+
+  // Counting up by one from below the bound, these all mean "next < bound".
+  switch (IV.getContinuePredicate()) {
+  case CmpInst::ICMP_NE:
+  case CmpInst::ICMP_SLT:
+    break;
+  case CmpInst::ICMP_ULT:
+    if (Start->isNegative())
+      return false;
+    break;
+  default:
+    return false;
+  }
+
+  // The bound of the last tile must not overflow.
+  bool Overflow;
+  APInt TileAPInt(Bound->getBitWidth(), T);
+  Bound->getValue().sadd_ov(TileAPInt, Overflow);
+  if (Overflow)
+    return false;
+  return (Bound->getValue() - Start->getValue()).ugt(T);
+}
+
+/// Strip-mine the inner loop of \p N into tiles of \p T iterations and move
+/// the loop over the tiles outside of the outer loop:
+///
+///   for (jj = Start; jj < Bound; jj += T)
+///     for (i ...)
+///       for (j = jj; j < min(jj + T, Bound); ++j)
+///
+static void tileNest(LoopNest &N, unsigned T) {
+  LoopIV &IV = N.InnerIV;
+  BasicBlock *Preheader = N.Outer->getLoopPreheader();
+  BasicBlock *OuterHeader = N.Outer->getHeader();
+  BasicBlock *OuterLatch = N.Outer->getLoopLatch();
+  BasicBlock *Exit = N.Outer->getExitBlock();
+  Function *F = OuterHeader->getParent();
+  LLVMContext &Ctx = F->getContext();
+  Type *Ty = IV.Phi->getType();
+  Constant *TileStep = ConstantInt::get(Ty, T);
+
+  // The tile loop computes the bound of the current tile in its header.
+  BasicBlock *TileHeader = BasicBlock::Create(Ctx, "tile.header", F,
+                                              OuterHeader);
+  BasicBlock *TileLatch = BasicBlock::Create(Ctx, "tile.latch", F);
+  TileLatch->moveAfter(OuterLatch);
+
+  IRBuilder<> Builder(TileHeader);
+  PHINode *TileIV = Builder.CreatePHI(Ty, 2, "tile.iv");
+  Value *TileEnd = Builder.CreateNSWAdd(TileIV, TileStep, "tile.end");
+  Value *InTile = Builder.CreateICmpSLT(TileEnd, IV.Bound, "tile.cmp");
+  Value *TileBound = Builder.CreateSelect(InTile, TileEnd, IV.Bound,
+                                          "tile.bound");
+  Builder.CreateBr(OuterHeader);
+
+  Builder.SetInsertPoint(TileLatch);
+  Value *TileNext = Builder.CreateNSWAdd(TileIV, TileStep, "tile.next");
+  Value *MoreTiles = Builder.CreateICmpSLT(TileNext, IV.Bound, "tile.cond");
+  Builder.CreateCondBr(MoreTiles, TileHeader, Exit);
+
+  TileIV->addIncoming(IV.Start, Preheader);
+  TileIV->addIncoming(TileNext, TileLatch);
+
+  // Enter the tile loop instead of the outer loop, and leave the outer loop
+  // into the tile latch.
+  Preheader->getTerminator()->replaceUsesOfWith(OuterHeader, TileHeader);
+  int PHIdx = N.OuterIV.Phi->getBasicBlockIndex(Preheader);
+  N.OuterIV.Phi->setIncomingBlock(PHIdx, TileHeader);
+  N.OuterIV.Br->setSuccessor(N.OuterIV.ContinueOnTrue ? 1 : 0, TileLatch);
+  for (BasicBlock::iterator I = Exit->begin(); PHINode *PN = dyn_cast<PHINode>(I);
+       ++I) {
+    int Idx = PN->getBasicBlockIndex(OuterLatch);
+    if (Idx >= 0)
+      PN->setIncomingBlock(Idx, TileLatch);
+  }
+
+  // Run the inner loop over the current tile only.
+  BasicBlock *InnerPH = N.Inner->getLoopPreheader();
+  IV.Phi->setIncomingValue(IV.Phi->getBasicBlockIndex(InnerPH), TileIV);
+  IV.Cmp->setPredicate(IV.ContinueOnTrue ? CmpInst::ICMP_SLT :
+                       CmpInst::ICMP_SGE);
+  IV.Cmp->setOperand(1, TileBound);
+}
+
+namespace {
+  /// Interchange perfectly nested loops to shorten the stride of the inner
+  /// loop.
+  class LoopInterchange : public FunctionPass {
+  public:
+    static char ID; // Pass ID, replacement for typeid
+    LoopInterchange() : FunctionPass(ID) {
+      initializeLoopInterchangePass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addRequired<DependenceAnalysis>();
+      AU.addRequired<TargetTransformInfo>();
+      AU.setPreservesCFG();
+    }
+  };
+
+  /// Tile perfectly nested loops whose inner loop walks across cache lines
+  /// that the outer loop would reuse.
+  class LoopTiling : public FunctionPass {
+  public:
+    static char ID; // Pass ID, replacement for typeid
+    LoopTiling() : FunctionPass(ID) {
+      initializeLoopTilingPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addRequired<DependenceAnalysis>();
+      AU.addRequired<TargetTransformInfo>();
+    }
+  };
+}
+
+char LoopInterchange::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopInterchange, "loop-interchange",
+                      "Interchange loops", false, false)
+INITIALIZE_AG_DEPENDENCY(TargetTransformInfo)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_DEPENDENCY(DependenceAnalysis)
+INITIALIZE_PASS_END(LoopInterchange, "loop-interchange",
+                    "Interchange loops", false, false)
+
+Pass *llvm::createLoopInterchangePass() { return new LoopInterchange(); }
+
+char LoopTiling::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopTiling, "loop-tile", "Tile loops", false, false)
+INITIALIZE_AG_DEPENDENCY(TargetTransformInfo)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_DEPENDENCY(DependenceAnalysis)
+INITIALIZE_PASS_END(LoopTiling, "loop-tile", "Tile loops", false, false)
+
+Pass *llvm::createLoopTilingPass() { return new LoopTiling(); }
+
+bool LoopInterchange::runOnFunction(Function &F) {
+  ScalarEvolution *SE = &getAnalysis<ScalarEvolution>();
+  LoopNestAnalyzer Analyzer(&getAnalysis<LoopInfo>(), SE,
+                            &getAnalysis<DependenceAnalysis>(),
+                            getAnalysis<TargetTransformInfo>().getCacheLineSize());
+
+  SmallVector<LoopNest, 4> Nests;
+  Analyzer.collectNests(Nests);
+
+  // Decide for every nest before changing any of them.
+  SmallVector<LoopNest*, 4> Profitable;
+  for (unsigned i = 0, e = Nests.size(); i != e; ++i) {
+    LoopNest &N = Nests[i];
+    if (N.OuterIV.Phi->getType() != N.InnerIV.Phi->getType() ||
+        N.OuterIV.CmpOnNext != N.InnerIV.CmpOnNext)
+      continue;
+    unsigned Cost = Analyzer.getLineCost(N, N.Inner);
+    unsigned SwappedCost = Analyzer.getLineCost(N, N.Outer);
+    DEBUG(dbgs() << "LI: Nest at " << N.Outer->getHeader()->getName()
+                 << " has inner line cost " << Cost << ", " << SwappedCost
+                 << " if interchanged\n");
+    if (SwappedCost >= Cost || !Analyzer.isInterchangeLegal(N))
+      continue;
+    Profitable.push_back(&N);
+  }
+
+  for (unsigned i = 0, e = Profitable.size(); i != e; ++i) {
+    SE->forgetLoop(Profitable[i]->Outer);
+    interchangeNest(*Profitable[i]);
+    ++NumInterchanged;
+  }
+  return !Profitable.empty();
+}
+
+bool LoopTiling::runOnFunction(Function &F) {
+  ScalarEvolution *SE = &getAnalysis<ScalarEvolution>();
+  unsigned LineSize = getAnalysis<TargetTransformInfo>().getCacheLineSize();
+  LoopNestAnalyzer Analyzer(&getAnalysis<LoopInfo>(), SE,
+                            &getAnalysis<DependenceAnalysis>(), LineSize);
+
+  // With one new line per inner iteration, a tile of LineSize iterations
+  // keeps LineSize * LineSize bytes live, which fits in any first level data
+  // cache.
+  unsigned T = TileSize ? TileSize : LineSize;
+  if (T < 2)
+    return false;
+
+  SmallVector<LoopNest, 4> Nests;
+  Analyzer.collectNests(Nests);
+
+  SmallVector<LoopNest*, 4> Profitable;
+  for (unsigned i = 0, e = Nests.size(); i != e; ++i) {
+    LoopNest &N = Nests[i];
+    if (!canTileInnerLoop(N, T))
+      continue;
+
+    // Tiling pays off when the inner loop moves to a new line in every
+    // iteration while the outer loop would keep reusing the same lines.
+    bool HasReuse = false;
+    for (unsigned j = 0, je = N.MemInsts.size(); j != je && !HasReuse; ++j)
+      HasReuse = Analyzer.getAccessCost(N.MemInsts[j], N.Inner) >= LineSize &&
+                 Analyzer.getAccessCost(N.MemInsts[j], N.Outer) < LineSize;
+    if (!HasReuse || !Analyzer.isInterchangeLegal(N))
+      continue;
+    Profitable.push_back(&N);
+  }
+
+  for (unsigned i = 0, e = Profitable.size(); i != e; ++i) {
+    DEBUG(dbgs() << "LI: Tiling nest at "
+                 << Profitable[i]->Outer->getHeader()->getName() << " by "
+                 << T << "\n");
+    SE->forgetLoop(Profitable[i]->Outer);
+    tileNest(*Profitable[i], T);
+    ++NumTiled;
+  }
+  return !Profitable.empty();
+}
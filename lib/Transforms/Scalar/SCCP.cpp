@@ -15,6 +15,9 @@
 //   * Proves values to be constant, and replaces them with constants
 //   * Proves conditional branches to be unconditional
 //
+// Integer values that are not constant may still be known to lie in a range
+// (a ConstantRange), which is enough to fold comparisons against them.
+//
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "sccp"
@@ -33,6 +36,7 @@
 #include "llvm/InstVisitor.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/ConstantRange.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
@@ -49,6 +53,11 @@ STATISTIC(IPNumInstRemoved, "Number of instructions removed by IPSCCP");
 STATISTIC(IPNumArgsElimed ,"Number of arguments constant propagated by IPSCCP");
 STATISTIC(IPNumGlobalConst, "Number of globals found to be constant by IPSCCP");
 
+/// MaxRangeUpdates - The number of times the range of a value may grow before
+/// it is given up on.  Ranges carried around a loop would otherwise grow one
+/// step per trip.
+static const unsigned MaxRangeUpdates = 8;
+
 namespace {
 /// LatticeVal class - This class represents the different lattice values that
 /// an LLVM value may occupy.  It is a simple class with value semantics.
@@ -163,6 +172,11 @@ class SCCPSolver : public InstVisitor<SCCPSolver> {
   ///
   DenseMap<std::pair<Value*, unsigned>, LatticeVal> StructValueState;
 
+  /// ValueRanges - For overdefined integer values that are known to lie in a
+  /// range narrower than the full set, the range and the number of times it
+  /// has grown.  Overdefined values without an entry may be anything.
+  DenseMap<Value*, std::pair<ConstantRange, unsigned> > ValueRanges;
+
   /// GlobalValue - If we are tracking any values for the contents of a global
   /// variable, we keep a mapping from the constant accessor to the element of
   /// the global, to the currently known value.  If the value becomes
@@ -344,6 +358,55 @@ private:
     OverdefinedInstWorkList.push_back(V);
   }
 
+  // markOverdefinedRange - Mark V overdefined, but remember that its value is
+  // in R.  If V is already overdefined with a range, R is added to it, and the
+  // users of V are revisited when the range grows.
+  void markOverdefinedRange(Value *V, const ConstantRange &R) {
+    LatticeVal &IV = ValueState[V];
+    if (!IV.isOverdefined()) {
+      if (!R.isFullSet() && !R.isEmptySet())
+        ValueRanges.insert(std::make_pair(V, std::make_pair(R, 0u)));
+      markOverdefined(IV, V);
+      return;
+    }
+
+    DenseMap<Value*, std::pair<ConstantRange, unsigned> >::iterator It =
+      ValueRanges.find(V);
+    if (It == ValueRanges.end())
+      return;  // Already the full set.
+    ConstantRange NewRange = It->second.first.unionWith(R);
+    if (NewRange == It->second.first)
+      return;
+
+    DEBUG(dbgs() << "markOverdefinedRange: " << NewRange << ": " << *V
+                 << '\n');
+    if (NewRange.isFullSet() || ++It->second.second == MaxRangeUpdates)
+      ValueRanges.erase(It);
+    else
+      It->second.first = NewRange;
+    OverdefinedInstWorkList.push_back(V);
+  }
+
+  // isFullyOverdefined - Return true if V is overdefined and nothing more is
+  // known about it.
+  bool isFullyOverdefined(Value *V) {
+    return getValueState(V).isOverdefined() && !ValueRanges.count(V);
+  }
+
+  // getRange - Return the range of values the integer V may take.
+  ConstantRange getRange(Value *V) {
+    LatticeVal LV = getValueState(V);
+    if (ConstantInt *CI = LV.getConstantInt())
+      return ConstantRange(CI->getValue());
+    if (LV.isOverdefined()) {
+      DenseMap<Value*, std::pair<ConstantRange, unsigned> >::const_iterator
+        It = ValueRanges.find(V);
+      if (It != ValueRanges.end())
+        return It->second.first;
+    }
+    return ConstantRange(V->getType()->getIntegerBitWidth());
+  }
+
   void mergeInValue(LatticeVal &IV, Value *V, LatticeVal MergeWithV) {
     if (IV.isOverdefined() || MergeWithV.isUndefined())
       return;  // Noop.
@@ -451,10 +514,35 @@ private:
   // information, we need to update the specified user of this instruction.
   //
   void OperandChangedState(Instruction *I) {
-    if (BBExecutable.count(I->getParent()))   // Inst is executable?
+    if (BBExecutable.count(I->getParent()) &&   // Inst is executable?
+        !isSettledOverdefined(I))
       visit(*I);
   }
 
+  // isSettledOverdefined - Return true if I is already overdefined, with no
+  // range that could still grow, and visiting it again can have no effect.
+  // Only instructions whose visitor does nothing but update I's own lattice
+  // value qualify: terminators, calls and stores feed CFG edges and tracked
+  // globals, functions and arguments, and struct values are tracked per
+  // element.
+  //
+  bool isSettledOverdefined(Instruction *I) const {
+    if (I->getType()->isVoidTy() || I->getType()->isStructTy() ||
+        isa<TerminatorInst>(I) || isa<CallInst>(I))
+      return false;
+    DenseMap<Value*, LatticeVal>::const_iterator It = ValueState.find(I);
+    return It != ValueState.end() && It->second.isOverdefined() &&
+           !ValueRanges.count(I);
+  }
+
+  // getBinaryRange - Return the range of values the integer binary operator I
+  // may produce, given the ranges of its operands.
+  ConstantRange getBinaryRange(Instruction &I);
+
+  // getCompareFromRanges - Return the constant result of the integer compare
+  // I if the ranges of its operands decide it, and null otherwise.
+  Constant *getCompareFromRanges(CmpInst &I);
+
 private:
   friend class InstVisitor<SCCPSolver>;
 
@@ -654,7 +742,7 @@ void SCCPSolver::visitPHINode(PHINode &PN) {
   if (PN.getType()->isStructTy())
     return markAnythingOverdefined(&PN);
 
-  if (getValueState(&PN).isOverdefined())
+  if (isFullyOverdefined(&PN))
     return;  // Quick exit
 
   // Super-extra-high-degree PHI nodes are unlikely to ever be marked constant,
@@ -668,16 +756,20 @@ void SCCPSolver::visitPHINode(PHINode &PN) {
   // constant.  If they are constant and don't agree, the PHI is overdefined.
   // If there are no executable operands, the PHI remains undefined.
   //
+  bool Overdefined = getValueState(&PN).isOverdefined();
   Constant *OperandVal = 0;
-  for (unsigned i = 0, e = PN.getNumIncomingValues(); i != e; ++i) {
+  for (unsigned i = 0, e = PN.getNumIncomingValues();
+       i != e && !Overdefined; ++i) {
     LatticeVal IV = getValueState(PN.getIncomingValue(i));
     if (IV.isUndefined()) continue;  // Doesn't influence PHI node.
 
     if (!isEdgeFeasible(PN.getIncomingBlock(i), PN.getParent()))
       continue;
 
-    if (IV.isOverdefined())    // PHI node becomes overdefined!
-      return markOverdefined(&PN);
+    if (IV.isOverdefined()) {  // PHI node becomes overdefined!
+      Overdefined = true;
+      break;
+    }
 
     if (OperandVal == 0) {   // Grab the first value.
       OperandVal = IV.getConstant();
@@ -691,7 +783,25 @@ void SCCPSolver::visitPHINode(PHINode &PN) {
     // Check to see if there are two different constants merging, if so, the PHI
     // node is overdefined.
     if (IV.getConstant() != OperandVal)
+      Overdefined = true;
+  }
+
+  if (Overdefined) {
+    if (!PN.getType()->isIntegerTy())
       return markOverdefined(&PN);
+
+    // The PHI takes a value in the union of the ranges of its executable
+    // operands.
+    ConstantRange Range(PN.getType()->getIntegerBitWidth(),
+                        /*isFullSet=*/false);
+    for (unsigned i = 0, e = PN.getNumIncomingValues(); i != e; ++i) {
+      Value *V = PN.getIncomingValue(i);
+      if (getValueState(V).isUndefined() ||
+          !isEdgeFeasible(PN.getIncomingBlock(i), PN.getParent()))
+        continue;
+      Range = Range.unionWith(getRange(V));
+    }
+    return markOverdefinedRange(&PN, Range);
   }
 
   // If we exited the loop, this means that the PHI node only has constant
@@ -744,9 +854,22 @@ void SCCPSolver::visitTerminatorInst(TerminatorInst &TI) {
 
 void SCCPSolver::visitCastInst(CastInst &I) {
   LatticeVal OpSt = getValueState(I.getOperand(0));
-  if (OpSt.isOverdefined())          // Inherit overdefinedness of operand
-    markOverdefined(&I);
-  else if (OpSt.isConstant())        // Propagate constant value
+  if (OpSt.isOverdefined()) {        // Inherit overdefinedness of operand
+    Type *SrcTy = I.getOperand(0)->getType();
+    if (!SrcTy->isIntegerTy() || !I.getType()->isIntegerTy())
+      return markOverdefined(&I);
+
+    // Carry the range of the operand through extensions and truncations.
+    ConstantRange Range = getRange(I.getOperand(0));
+    unsigned BitWidth = I.getType()->getIntegerBitWidth();
+    switch (I.getOpcode()) {
+    case Instruction::ZExt:  Range = Range.zeroExtend(BitWidth); break;
+    case Instruction::SExt:  Range = Range.signExtend(BitWidth); break;
+    case Instruction::Trunc: Range = Range.truncate(BitWidth); break;
+    default:                 Range = ConstantRange(BitWidth); break;
+    }
+    markOverdefinedRange(&I, Range);
+  } else if (OpSt.isConstant())        // Propagate constant value
     markConstant(&I, ConstantExpr::getCast(I.getOpcode(),
                                            OpSt.getConstant(), I.getType()));
 }
@@ -812,6 +935,14 @@ void SCCPSolver::visitSelectInst(SelectInst &I) {
   if (I.getType()->isStructTy())
     return markAnythingOverdefined(&I);
 
+  // Once the select has a range, only the range of its operands can change.
+  if (getValueState(&I).isOverdefined()) {
+    if (ValueRanges.count(&I))
+      markOverdefinedRange(&I, getRange(I.getTrueValue()).unionWith(
+                                 getRange(I.getFalseValue())));
+    return;
+  }
+
   LatticeVal CondValue = getValueState(I.getCondition());
   if (CondValue.isUndefined())
     return;
@@ -837,6 +968,9 @@ void SCCPSolver::visitSelectInst(SelectInst &I) {
     return mergeInValue(&I, FVal);
   if (FVal.isUndefined())   // select ?, X, undef -> X.
     return mergeInValue(&I, TVal);
+  if (I.getType()->isIntegerTy())
+    return markOverdefinedRange(&I, getRange(I.getTrueValue()).unionWith(
+                                      getRange(I.getFalseValue())));
   markOverdefined(&I);
 }
 
@@ -846,7 +980,12 @@ void SCCPSolver::visitBinaryOperator(Instruction &I) {
   LatticeVal V2State = getValueState(I.getOperand(1));
 
   LatticeVal &IV = ValueState[&I];
-  if (IV.isOverdefined()) return;
+  if (IV.isOverdefined()) {
+    // Only the range can still change.
+    if (ValueRanges.count(&I))
+      markOverdefinedRange(&I, getBinaryRange(I));
+    return;
+  }
 
   if (V1State.isConstant() && V2State.isConstant())
     return markConstant(IV, &I,
@@ -894,10 +1033,45 @@ void SCCPSolver::visitBinaryOperator(Instruction &I) {
     }
   }
 
-
+  if (I.getType()->isIntegerTy())
+    return markOverdefinedRange(&I, getBinaryRange(I));
   markOverdefined(&I);
 }
 
+ConstantRange SCCPSolver::getBinaryRange(Instruction &I) {
+  ConstantRange LHS = getRange(I.getOperand(0));
+  ConstantRange RHS = getRange(I.getOperand(1));
+  switch (I.getOpcode()) {
+  case Instruction::Add:  return LHS.add(RHS);
+  case Instruction::Sub:  return LHS.sub(RHS);
+  case Instruction::Mul:  return LHS.multiply(RHS);
+  case Instruction::UDiv: return LHS.udiv(RHS);
+  case Instruction::Shl:  return LHS.shl(RHS);
+  case Instruction::LShr: return LHS.lshr(RHS);
+  case Instruction::And:  return LHS.binaryAnd(RHS);
+  case Instruction::Or:   return LHS.binaryOr(RHS);
+  default:
+    return ConstantRange(I.getType()->getIntegerBitWidth());
+  }
+}
+
+Constant *SCCPSolver::getCompareFromRanges(CmpInst &I) {
+  ConstantRange LHS = getRange(I.getOperand(0));
+  ConstantRange RHS = getRange(I.getOperand(1));
+  if (LHS.isEmptySet() || RHS.isEmptySet())
+    return 0;
+
+  // makeICmpRegion gives every LHS value for which the predicate holds for
+  // some RHS value; if LHS misses it, the predicate never holds.
+  CmpInst::Predicate Pred = I.getPredicate();
+  if (LHS.intersectWith(ConstantRange::makeICmpRegion(Pred, RHS)).isEmptySet())
+    return ConstantInt::getFalse(I.getType());
+  Pred = CmpInst::getInversePredicate(Pred);
+  if (LHS.intersectWith(ConstantRange::makeICmpRegion(Pred, RHS)).isEmptySet())
+    return ConstantInt::getTrue(I.getType());
+  return 0;
+}
+
 // Handle ICmpInst instruction.
 void SCCPSolver::visitCmpInst(CmpInst &I) {
   LatticeVal V1State = getValueState(I.getOperand(0));
@@ -915,6 +1089,14 @@ void SCCPSolver::visitCmpInst(CmpInst &I) {
   if (!V1State.isOverdefined() && !V2State.isOverdefined())
     return;
 
+  // The ranges of integer operands may still settle the compare.
+  if (isa<ICmpInst>(I) && I.getOperand(0)->getType()->isIntegerTy())
+    if (Constant *C = getCompareFromRanges(I)) {
+      LatticeVal &CmpIV = ValueState[&I];
+      if (!CmpIV.isConstant() || CmpIV.getConstant() == C)
+        return markConstant(CmpIV, &I, C);
+    }
+
   markOverdefined(&I);
 }
 
@@ -35,6 +35,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CFG.h"
+#include "llvm/Support/ValueHandle.h"
 #include "llvm/Transforms/Utils/Local.h"
 using namespace llvm;
 
@@ -298,24 +299,77 @@ static bool mergeEmptyReturnBlocks(Function &F) {
   return Changed;
 }
 
+/// getBlock - Return the block held by V, or null if it was deleted.
+static BasicBlock *getBlock(const WeakVH &V) {
+  return cast_or_null<BasicBlock>(static_cast<Value*>(V));
+}
+
+/// addNeighborhood - Add BB, then its current predecessors, then its
+/// successors to Dirty.  Returns the number of predecessors added.
+static unsigned addNeighborhood(BasicBlock *BB,
+                                SmallVectorImpl<WeakVH> &Dirty) {
+  Dirty.push_back(BB);
+  unsigned NumPreds = 0;
+  for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI) {
+    Dirty.push_back(*PI);
+    ++NumPreds;
+  }
+  for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI)
+    Dirty.push_back(*SI);
+  return NumPreds;
+}
+
 /// iterativelySimplifyCFG - Call SimplifyCFG on all the blocks in the function,
-/// iterating until no more changes are made.
+/// iterating until no more changes are made.  After the first sweep only the
+/// blocks around a change are visited again, since SimplifyCFG only looks at a
+/// block and its immediate neighbors.  Blocks are still visited in function
+/// order, so the result does not depend on where the blocks live in memory.
 static bool iterativelySimplifyCFG(Function &F, const TargetTransformInfo &TTI,
                                    const DataLayout *TD) {
   bool Changed = false;
-  bool LocalChange = true;
-  while (LocalChange) {
-    LocalChange = false;
-
-    // Loop over all of the basic blocks and remove them if they are unneeded...
-    //
-    for (Function::iterator BBIt = F.begin(); BBIt != F.end(); ) {
-      if (SimplifyCFG(BBIt++, TTI, TD)) {
-        LocalChange = true;
-        ++NumSimpl;
-      }
+
+  // Blocks may be deleted while a sweep is in progress, so hold them weakly.
+  SmallVector<WeakVH, 64> Worklist;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    Worklist.push_back(&*BB);
+
+  SmallVector<WeakVH, 64> Dirty;
+  SmallVector<WeakVH, 8> Neighborhood;
+  while (!Worklist.empty()) {
+    Dirty.clear();
+    for (unsigned i = 0, e = Worklist.size(); i != e; ++i) {
+      BasicBlock *BB = getBlock(Worklist[i]);
+      if (!BB)
+        continue;
+
+      // Remember what BB was connected to before it changes.
+      Neighborhood.clear();
+      unsigned NumPreds = addNeighborhood(BB, Neighborhood);
+      if (!SimplifyCFG(BB, TTI, TD))
+        continue;
+      ++NumSimpl;
+      Changed = true;
+
+      // Revisit the blocks around BB, both before and after the change. Only
+      // BB and its predecessors, whose terminators SimplifyCFG may rewrite,
+      // can have new neighbors.
+      Dirty.append(Neighborhood.begin(), Neighborhood.end());
+      for (unsigned n = 0; n <= NumPreds; ++n)
+        if (BasicBlock *N = getBlock(Neighborhood[n]))
+          addNeighborhood(N, Dirty);
     }
-    Changed |= LocalChange;
+
+    // Visit the dirty blocks that survived again, in function order.
+    SmallPtrSet<BasicBlock*, 32> DirtySet;
+    for (unsigned i = 0, e = Dirty.size(); i != e; ++i)
+      if (BasicBlock *BB = getBlock(Dirty[i]))
+        DirtySet.insert(BB);
+    Worklist.clear();
+    if (DirtySet.empty())
+      break;
+    for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+      if (DirtySet.count(BB))
+        Worklist.push_back(&*BB);
   }
   return Changed;
 }
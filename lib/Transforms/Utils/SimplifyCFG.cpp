@@ -14,6 +14,7 @@
 #define DEBUG_TYPE "simplifycfg"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -59,7 +60,19 @@ static cl::opt<bool>
 SinkCommon("simplifycfg-sink-common", cl::Hidden, cl::init(true),
        cl::desc("Sink common instructions down to the end block"));
 
+static cl::opt<unsigned>
+SwitchTableMinDensity("switch-table-min-density", cl::Hidden, cl::init(40),
+       cl::desc("Minimum percentage of a lookup table's entries that must "
+                "come from switch cases (default = 40)"));
+
+static cl::opt<unsigned>
+SwitchTablePackThreshold("switch-table-pack-threshold", cl::Hidden,
+       cl::init(64),
+       cl::desc("Pack the elements of lookup tables larger than this many "
+                "bytes into words when that makes them much smaller"));
+
 STATISTIC(NumBitMaps, "Number of switch instructions turned into bitmaps");
+STATISTIC(NumPackedTables, "Number of lookup tables with packed elements");
 STATISTIC(NumLookupTables, "Number of switch instructions turned into lookup tables");
 STATISTIC(NumSinkCommons, "Number of common instructions sunk down to the end block");
 STATISTIC(NumSpeculations, "Number of speculative executed instructions");
@@ -122,8 +135,11 @@ static bool SafeToMergeTerminators(TerminatorInst *SI1, TerminatorInst *SI2) {
   BasicBlock *SI2BB = SI2->getParent();
   SmallPtrSet<BasicBlock*, 16> SI1Succs(succ_begin(SI1BB), succ_end(SI1BB));
 
+  // A switch can reach the same successor through many cases; only look at
+  // its PHI nodes once.
+  SmallPtrSet<BasicBlock*, 16> Visited;
   for (succ_iterator I = succ_begin(SI2BB), E = succ_end(SI2BB); I != E; ++I)
-    if (SI1Succs.count(*I))
+    if (SI1Succs.count(*I) && Visited.insert(*I))
       for (BasicBlock::iterator BBI = (*I)->begin();
            isa<PHINode>(BBI); ++BBI) {
         PHINode *PN = cast<PHINode>(BBI);
@@ -177,17 +193,36 @@ static bool isProfitableToFoldUnconditional(BranchInst *SI1,
 }
 
 /// AddPredecessorToBlock - Update PHI nodes in Succ to indicate that there will
-/// now be entries in it from the 'NewPred' block.  The values that will be
-/// flowing into the PHI nodes will be the same as those coming in from
-/// ExistPred, an existing predecessor of Succ.
+/// now be entries in it from the 'NewPred' block, one for each of NumEdges
+/// edges.  The values that will be flowing into the PHI nodes will be the same
+/// as those coming in from ExistPred, an existing predecessor of Succ.
 static void AddPredecessorToBlock(BasicBlock *Succ, BasicBlock *NewPred,
-                                  BasicBlock *ExistPred) {
+                                  BasicBlock *ExistPred,
+                                  unsigned NumEdges = 1) {
   if (!isa<PHINode>(Succ->begin())) return; // Quick exit if nothing to do
 
   PHINode *PN;
   for (BasicBlock::iterator I = Succ->begin();
-       (PN = dyn_cast<PHINode>(I)); ++I)
-    PN->addIncoming(PN->getIncomingValueForBlock(ExistPred), NewPred);
+       (PN = dyn_cast<PHINode>(I)); ++I) {
+    Value *V = PN->getIncomingValueForBlock(ExistPred);
+    for (unsigned i = 0; i != NumEdges; ++i)
+      PN->addIncoming(V, NewPred);
+  }
+}
+
+/// AddPredecessorToSuccessors - Call AddPredecessorToBlock for each successor
+/// in Succs, which may list the same block many times when it is the
+/// destination of many switch cases.  Each block's PHI nodes are only
+/// searched once.
+static void AddPredecessorToSuccessors(ArrayRef<BasicBlock*> Succs,
+                                       BasicBlock *NewPred,
+                                       BasicBlock *ExistPred) {
+  MapVector<BasicBlock*, unsigned> NumEdges;
+  for (unsigned i = 0, e = Succs.size(); i != e; ++i)
+    ++NumEdges[Succs[i]];
+  for (MapVector<BasicBlock*, unsigned>::iterator I = NumEdges.begin(),
+       E = NumEdges.end(); I != E; ++I)
+    AddPredecessorToBlock(I->first, NewPred, ExistPred, I->second);
 }
 
 
@@ -977,8 +1012,7 @@ bool SimplifyCFGOpt::FoldValueComparisonIntoPredecessors(TerminatorInst *TI,
       // Okay, at this point, we know which new successor Pred will get.  Make
       // sure we update the number of entries in the PHI nodes for these
       // successors.
-      for (unsigned i = 0, e = NewSuccessors.size(); i != e; ++i)
-        AddPredecessorToBlock(NewSuccessors[i], Pred, BB);
+      AddPredecessorToSuccessors(NewSuccessors, Pred, BB);
 
       Builder.SetInsertPoint(PTI);
       // Convert pointer to int before we switch.
@@ -1132,7 +1166,11 @@ HoistTerminator:
   // them.  If they do, all PHI entries for BB1/BB2 must agree for all PHI
   // nodes, so we insert select instruction to compute the final result.
   std::map<std::pair<Value*,Value*>, SelectInst*> InsertedSelects;
+  SmallPtrSet<BasicBlock*, 16> Visited;
   for (succ_iterator SI = succ_begin(BB1), E = succ_end(BB1); SI != E; ++SI) {
+    // Each edge from BB1 to a successor has the same incoming values.
+    if (!Visited.insert(*SI))
+      continue;
     PHINode *PN;
     for (BasicBlock::iterator BBI = SI->begin();
          (PN = dyn_cast<PHINode>(BBI)); ++BBI) {
@@ -1156,8 +1194,8 @@ HoistTerminator:
   }
 
   // Update any PHI nodes in our new successors.
-  for (succ_iterator SI = succ_begin(BB1), E = succ_end(BB1); SI != E; ++SI)
-    AddPredecessorToBlock(*SI, BIParent, BB1);
+  SmallVector<BasicBlock*, 16> Succs(succ_begin(BB1), succ_end(BB1));
+  AddPredecessorToSuccessors(Succs, BIParent, BB1);
 
   EraseTerminatorInstAndDCECond(BI);
   return true;
@@ -3302,6 +3340,28 @@ static Constant *ConstantFold(Instruction *I,
   return 0;
 }
 
+namespace {
+  /// PHIIncomingValues - The incoming values of PHI nodes, by incoming block.
+  /// The common destination of a switch with thousands of cases has PHI nodes
+  /// with thousands of entries, and scanning them for every case would be
+  /// quadratic.
+  class PHIIncomingValues {
+    DenseMap<std::pair<PHINode*, BasicBlock*>, Value*> Values;
+    SmallPtrSet<PHINode*, 8> Scanned;
+  public:
+    /// get - Return the value of PN coming in from BB, or null if BB is not
+    /// an incoming block of PN.
+    Value *get(PHINode *PN, BasicBlock *BB) {
+      if (Scanned.insert(PN))
+        // Walk backwards, so the first entry for a block is the one kept.
+        for (unsigned i = PN->getNumIncomingValues(); i != 0; --i)
+          Values[std::make_pair(PN, PN->getIncomingBlock(i - 1))] =
+            PN->getIncomingValue(i - 1);
+      return Values.lookup(std::make_pair(PN, BB));
+    }
+  };
+}
+
 /// GetCaseResults - Try to determine the resulting constant values in phi nodes
 /// at the common destination basic block, *CommonDest, for one of the case
 /// destionations CaseDest corresponding to value CaseVal (0 for the default
@@ -3310,6 +3370,7 @@ static bool GetCaseResults(SwitchInst *SI,
                            ConstantInt *CaseVal,
                            BasicBlock *CaseDest,
                            BasicBlock **CommonDest,
+                           PHIIncomingValues &Incoming,
                            SmallVector<std::pair<PHINode*,Constant*>, 4> &Res) {
   // The block from which we enter the common destination.
   BasicBlock *Pred = SI->getParent();
@@ -3347,12 +3408,11 @@ static bool GetCaseResults(SwitchInst *SI,
   // Get the values for this case from phi nodes in the destination block.
   BasicBlock::iterator I = (*CommonDest)->begin();
   while (PHINode *PHI = dyn_cast<PHINode>(I++)) {
-    int Idx = PHI->getBasicBlockIndex(Pred);
-    if (Idx == -1)
+    Value *InValue = Incoming.get(PHI, Pred);
+    if (!InValue)
       continue;
 
-    Constant *ConstVal = LookupConstant(PHI->getIncomingValue(Idx),
-                                        ConstantPool);
+    Constant *ConstVal = LookupConstant(InValue, ConstantPool);
     if (!ConstVal)
       return false;
 
@@ -3379,13 +3439,14 @@ namespace {
   public:
     /// SwitchLookupTable - Create a lookup table to use as a switch replacement
     /// with the contents of Values, using DefaultValue to fill any holes in the
-    /// table.
+    /// table.  OptimizeForSize makes packing the table more attractive.
     SwitchLookupTable(Module &M,
                       uint64_t TableSize,
                       ConstantInt *Offset,
                const SmallVector<std::pair<ConstantInt*, Constant*>, 4>& Values,
                       Constant *DefaultValue,
-                      const DataLayout *TD);
+                      const DataLayout *TD,
+                      bool OptimizeForSize);
 
     /// BuildLookup - Build instructions with Builder to retrieve the value at
     /// the position given by Index in the lookup table.
@@ -3410,6 +3471,11 @@ namespace {
       // shift and mask operations.
       BitMapKind,
 
+      // For larger tables with integer elements that all fit in a few bits,
+      // several elements are packed into each word of an array. Values are
+      // retrieved by a load followed by shift and mask operations.
+      PackedArrayKind,
+
       // The table is stored as an array of values. Values are retrieved by load
       // instructions from the table.
       ArrayKind
@@ -3422,18 +3488,70 @@ namespace {
     ConstantInt *BitMap;
     IntegerType *BitMapElementTy;
 
-    // For ArrayKind, this is the array.
+    // For PackedArrayKind, this is the number of bits that each element takes
+    // in a word of the array, and BitMapElementTy is the element type.
+    unsigned PackedBits;
+
+    // For ArrayKind and PackedArrayKind, this is the array.
     GlobalVariable *Array;
   };
 }
 
+/// getLargestLegalIntWidth - Return the width of the largest legal integer
+/// type that is a power of two, or zero if there is none.
+static unsigned getLargestLegalIntWidth(const DataLayout *TD) {
+  for (unsigned Width = 64; Width >= 8; Width /= 2)
+    if (TD->isLegalInteger(Width))
+      return Width;
+  return 0;
+}
+
+/// GetPackedBits - If the integer elements of a table can be packed into
+/// words of a legal integer type, and that makes the table small enough to be
+/// worth the extra shift and mask per lookup, return the number of bits each
+/// element should take.  Otherwise return 0.
+static unsigned GetPackedBits(const DataLayout *TD,
+                              ArrayRef<Constant*> TableContents,
+                              Type *ElementTy, bool OptimizeForSize) {
+  IntegerType *IT = dyn_cast<IntegerType>(ElementTy);
+  if (!TD || !IT)
+    return 0;
+  unsigned WordBits = getLargestLegalIntWidth(TD);
+  if (WordBits == 0)
+    return 0;
+
+  unsigned ActiveBits = 1;
+  for (unsigned I = 0, E = TableContents.size(); I != E; ++I)
+    if (ConstantInt *CI = dyn_cast<ConstantInt>(TableContents[I]))
+      ActiveBits = std::max(ActiveBits, CI->getValue().getActiveBits());
+  // Round up to a power of two, so that an element never straddles words.
+  unsigned Bits = NextPowerOf2(ActiveBits - 1);
+  if (Bits >= IT->getBitWidth() || Bits > WordBits)
+    return 0;
+
+  uint64_t TableSize = TableContents.size();
+  uint64_t ArrayBytes = TableSize * TD->getTypeAllocSize(IT);
+  uint64_t PerWord = WordBits / Bits;
+  uint64_t PackedBytes = (TableSize + PerWord - 1) / PerWord * (WordBits / 8);
+
+  // When optimizing for size, halving the table pays for the extra code.
+  // Otherwise, only pack a table that takes up several cache lines and gets
+  // much smaller.
+  if (OptimizeForSize)
+    return PackedBytes * 2 <= ArrayBytes ? Bits : 0;
+  if (ArrayBytes <= SwitchTablePackThreshold)
+    return 0;
+  return PackedBytes * 4 <= ArrayBytes ? Bits : 0;
+}
+
 SwitchLookupTable::SwitchLookupTable(Module &M,
                                      uint64_t TableSize,
                                      ConstantInt *Offset,
                const SmallVector<std::pair<ConstantInt*, Constant*>, 4>& Values,
                                      Constant *DefaultValue,
-                                     const DataLayout *TD)
-    : SingleValue(0), BitMap(0), BitMapElementTy(0), Array(0) {
+                                     const DataLayout *TD,
+                                     bool OptimizeForSize)
+    : SingleValue(0), BitMap(0), BitMapElementTy(0), PackedBits(0), Array(0) {
   assert(Values.size() && "Can't build lookup table without values!");
   assert(TableSize >= Values.size() && "Can't fit values in table!");
 
@@ -3492,6 +3610,37 @@ SwitchLookupTable::SwitchLookupTable(Module &M,
     return;
   }
 
+  // If the values are small integers, pack several of them into each word.
+  PackedBits = GetPackedBits(TD, TableContents, DefaultValue->getType(),
+                             OptimizeForSize);
+  if (PackedBits) {
+    IntegerType *WordTy = Type::getIntNTy(M.getContext(),
+                                          getLargestLegalIntWidth(TD));
+    unsigned PerWord = WordTy->getBitWidth() / PackedBits;
+    SmallVector<Constant*, 64> Words;
+    for (uint64_t I = 0; I < TableSize; I += PerWord) {
+      APInt Word(WordTy->getBitWidth(), 0);
+      for (uint64_t J = std::min(I + PerWord, TableSize); J > I; --J) {
+        Word <<= PackedBits;
+        // Undef values are set to zero.
+        if (ConstantInt *Val = dyn_cast<ConstantInt>(TableContents[J - 1]))
+          Word |= Val->getValue().zextOrTrunc(WordTy->getBitWidth());
+      }
+      Words.push_back(ConstantInt::get(WordTy, Word));
+    }
+
+    ArrayType *ArrayTy = ArrayType::get(WordTy, Words.size());
+    Array = new GlobalVariable(M, ArrayTy, /*constant=*/ true,
+                               GlobalVariable::PrivateLinkage,
+                               ConstantArray::get(ArrayTy, Words),
+                               "switch.table");
+    Array->setUnnamedAddr(true);
+    BitMapElementTy = cast<IntegerType>(DefaultValue->getType());
+    Kind = PackedArrayKind;
+    ++NumPackedTables;
+    return;
+  }
+
   // Store the table in an array.
   ArrayType *ArrayTy = ArrayType::get(DefaultValue->getType(), TableSize);
   Constant *Initializer = ConstantArray::get(ArrayTy, TableContents);
@@ -3529,6 +3678,38 @@ Value *SwitchLookupTable::BuildLookup(Value *Index, IRBuilder<> &Builder) {
       return Builder.CreateTrunc(DownShifted, BitMapElementTy,
                                  "switch.masked");
     }
+    case PackedArrayKind: {
+      // Load the word that holds the element.
+      IntegerType *WordTy =
+        cast<IntegerType>(Array->getType()->getElementType()
+                          ->getArrayElementType());
+      unsigned PerWord = WordTy->getBitWidth() / PackedBits;
+
+      // Do the arithmetic in the word type, which is wide enough for the
+      // shift amounts even when the index is narrow (e.g. i4).
+      // Note: The Index is < the number of elements in the table, so
+      // truncating it to the width of the word is safe.
+      Index = Builder.CreateZExtOrTrunc(Index, WordTy, "switch.cast");
+      Value *WordIdx = Builder.CreateLShr(Index, Log2_32(PerWord),
+                                          "switch.wordidx");
+      Value *GEPIndices[] = { Builder.getInt32(0), WordIdx };
+      Value *GEP = Builder.CreateInBoundsGEP(Array, GEPIndices,
+                                             "switch.gep");
+      Value *Word = Builder.CreateLoad(GEP, "switch.load");
+
+      // Shift the element down and mask it off.
+      Value *ShiftAmt = Builder.CreateAnd(Index, PerWord - 1, "switch.pos");
+      if (PackedBits > 1)
+        ShiftAmt = Builder.CreateShl(ShiftAmt, Log2_32(PackedBits),
+                                     "switch.shiftamt");
+      Value *DownShifted = Builder.CreateLShr(Word, ShiftAmt,
+                                              "switch.downshift");
+      Value *Masked =
+        Builder.CreateTrunc(DownShifted,
+                            IntegerType::get(Builder.getContext(), PackedBits),
+                            "switch.masked");
+      return Builder.CreateZExt(Masked, BitMapElementTy, "switch.zext");
+    }
     case ArrayKind: {
       Value *GEPIndices[] = { Builder.getInt32(0), Index };
       Value *GEP = Builder.CreateInBoundsGEP(Array, GEPIndices,
@@ -3556,6 +3737,11 @@ bool SwitchLookupTable::WouldFitInRegister(const DataLayout *TD,
   return TD->fitsInLegalInteger(TableSize * IT->getBitWidth());
 }
 
+/// SwitchCaseCodeSize - The approximate number of bytes of code that lowering
+/// a switch takes per case: a compare and branch, or a jump table entry, plus
+/// the copy of the result in the case block.
+static const unsigned SwitchCaseCodeSize = 8;
+
 /// ShouldBuildLookupTable - Determine whether a lookup table should be built
 /// for this switch, based on the number of caes, size of the table and the
 /// types of the results.
@@ -3563,8 +3749,9 @@ static bool ShouldBuildLookupTable(SwitchInst *SI,
                                    uint64_t TableSize,
                                    const TargetTransformInfo &TTI,
                                    const DataLayout *TD,
-                            const SmallDenseMap<PHINode*, Type*>& ResultTypes) {
-  if (SI->getNumCases() > TableSize || TableSize >= UINT64_MAX / 10)
+                            const SmallDenseMap<PHINode*, Type*>& ResultTypes,
+                                   bool OptimizeForSize) {
+  if (SI->getNumCases() > TableSize || TableSize >= UINT64_MAX / 100)
     return false; // TableSize overflowed, or mul below might overflow.
 
   bool AllTablesFitInRegister = true;
@@ -3595,10 +3782,24 @@ static bool ShouldBuildLookupTable(SwitchInst *SI,
   if (HasIllegalType)
     return false;
 
-  // The table density should be at least 40%. This is the same criterion as for
-  // jump tables, see SelectionDAGBuilder::handleJTSwitchCase.
-  // FIXME: Find the best cut-off.
-  return SI->getNumCases() * 10 >= TableSize * 4;
+  // When optimizing for size, build the tables if their data takes no more
+  // space than the code they replace, however sparse they are.  Packing can
+  // only make them smaller than this estimate.
+  uint64_t CodeSize = SI->getNumCases() * SwitchCaseCodeSize;
+  if (OptimizeForSize && TD && TableSize <= CodeSize) {
+    uint64_t TableBytes = 0;
+    for (SmallDenseMap<PHINode*, Type*>::const_iterator I = ResultTypes.begin(),
+         E = ResultTypes.end(); I != E; ++I)
+      if (!SwitchLookupTable::WouldFitInRegister(TD, TableSize, I->second))
+        TableBytes += TableSize * TD->getTypeAllocSize(I->second);
+    if (TableBytes <= CodeSize)
+      return true;
+  }
+
+  // Otherwise the table density should be at least 40% by default. This is the
+  // same criterion as for jump tables, see
+  // SelectionDAGBuilder::handleJTSwitchCase.
+  return SI->getNumCases() * 100 >= TableSize * SwitchTableMinDensity;
 }
 
 /// SwitchToLookupTable - If the switch is only used to initialize one or more
@@ -3636,6 +3837,7 @@ static bool SwitchToLookupTable(SwitchInst *SI,
   ConstantInt *MaxCaseVal = CI.getCaseValue();
 
   BasicBlock *CommonDest = 0;
+  PHIIncomingValues Incoming;
   typedef SmallVector<std::pair<ConstantInt*, Constant*>, 4> ResultListTy;
   SmallDenseMap<PHINode*, ResultListTy> ResultLists;
   SmallDenseMap<PHINode*, Constant*> DefaultResults;
@@ -3653,7 +3855,7 @@ static bool SwitchToLookupTable(SwitchInst *SI,
     typedef SmallVector<std::pair<PHINode*, Constant*>, 4> ResultsTy;
     ResultsTy Results;
     if (!GetCaseResults(SI, CaseVal, CI.getCaseSuccessor(), &CommonDest,
-                        Results))
+                        Incoming, Results))
       return false;
 
     // Append the result from this case to the list for each phi.
@@ -3666,7 +3868,7 @@ static bool SwitchToLookupTable(SwitchInst *SI,
 
   // Get the resulting values for the default case.
   SmallVector<std::pair<PHINode*, Constant*>, 4> DefaultResultsList;
-  if (!GetCaseResults(SI, 0, SI->getDefaultDest(), &CommonDest,
+  if (!GetCaseResults(SI, 0, SI->getDefaultDest(), &CommonDest, Incoming,
                       DefaultResultsList))
     return false;
   for (size_t I = 0, E = DefaultResultsList.size(); I != E; ++I) {
@@ -3676,9 +3878,13 @@ static bool SwitchToLookupTable(SwitchInst *SI,
     ResultTypes[PHI] = Result->getType();
   }
 
+  Function *F = SI->getParent()->getParent();
+  bool OptimizeForSize = F->hasFnAttribute(Attribute::OptimizeForSize) ||
+                         F->hasFnAttribute(Attribute::MinSize);
   APInt RangeSpread = MaxCaseVal->getValue() - MinCaseVal->getValue();
   uint64_t TableSize = RangeSpread.getLimitedValue() + 1;
-  if (!ShouldBuildLookupTable(SI, TableSize, TTI, TD, ResultTypes))
+  if (!ShouldBuildLookupTable(SI, TableSize, TTI, TD, ResultTypes,
+                              OptimizeForSize))
     return false;
 
   // Create the BB that does the lookups.
@@ -3704,7 +3910,7 @@ static bool SwitchToLookupTable(SwitchInst *SI,
     PHINode *PHI = PHIs[I];
 
     SwitchLookupTable Table(Mod, TableSize, MinCaseVal, ResultLists[PHI],
-                            DefaultResults[PHI], TD);
+                            DefaultResults[PHI], TD, OptimizeForSize);
 
     Value *Result = Table.BuildLookup(TableIndex, Builder);
 
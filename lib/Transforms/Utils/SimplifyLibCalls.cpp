@@ -15,6 +15,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Transforms/Utils/SimplifyLibCalls.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Analysis/ValueTracking.h"
@@ -1682,6 +1683,14 @@ class LibCallSimplifierImpl {
   CosOpt Cos;
   PowOpt Pow;
   Exp2Opt Exp2;
+
+  /// Optimizations - The optimization for each callee seen so far, or null if
+  /// there is none.  The simplifier does not outlive the pass that owns it,
+  /// and no library call optimization deletes or renames a function, so the
+  /// entries stay valid.
+  DenseMap<const Function*, LibCallOptimization*> Optimizations;
+
+  LibCallOptimization *resolveOptimization(Function *Callee);
 public:
   LibCallSimplifierImpl(const DataLayout *TD, const TargetLibraryInfo *TLI,
                         const LibCallSimplifier *LCS,
@@ -1757,14 +1766,26 @@ static FWriteOpt FWrite;
 static FPutsOpt FPuts;
 static PutsOpt Puts;
 
+/// lookupOptimization - Return the optimization for the callee of CI, or null
+/// if there is none.  The callee is only looked up in the library function
+/// table the first time it is seen.
 LibCallOptimization *LibCallSimplifierImpl::lookupOptimization(CallInst *CI) {
-  LibFunc::Func Func;
   Function *Callee = CI->getCalledFunction();
+  DenseMap<const Function*, LibCallOptimization*>::iterator I =
+    Optimizations.find(Callee);
+  if (I != Optimizations.end())
+    return I->second;
+  return Optimizations[Callee] = resolveOptimization(Callee);
+}
+
+LibCallOptimization *
+LibCallSimplifierImpl::resolveOptimization(Function *Callee) {
+  LibFunc::Func Func;
   StringRef FuncName = Callee->getName();
 
-  // Next check for intrinsics.
-  if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(CI)) {
-    switch (II->getIntrinsicID()) {
+  // First check for intrinsics.
+  if (Callee->isIntrinsic()) {
+    switch (Callee->getIntrinsicID()) {
     case Intrinsic::pow:
        return &Pow;
     case Intrinsic::exp2:
@@ -1895,29 +1916,23 @@ LibCallOptimization *LibCallSimplifierImpl::lookupOptimization(CallInst *CI) {
         return 0;
       case LibFunc::memcpy_chk:
         return &MemCpyChk;
+      case LibFunc::memmove_chk:
+        return &MemMoveChk;
+      case LibFunc::memset_chk:
+        return &MemSetChk;
+      case LibFunc::strcpy_chk:
+        return &StrCpyChk;
+      case LibFunc::stpcpy_chk:
+        return &StpCpyChk;
+      case LibFunc::strncpy_chk:
+      case LibFunc::stpncpy_chk:
+        return &StrNCpyChk;
       default:
         return 0;
       }
   }
 
-  // Finally check for fortified library calls.
-  if (FuncName.endswith("_chk")) {
-    if (FuncName == "__memmove_chk")
-      return &MemMoveChk;
-    else if (FuncName == "__memset_chk")
-      return &MemSetChk;
-    else if (FuncName == "__strcpy_chk")
-      return &StrCpyChk;
-    else if (FuncName == "__stpcpy_chk")
-      return &StpCpyChk;
-    else if (FuncName == "__strncpy_chk")
-      return &StrNCpyChk;
-    else if (FuncName == "__stpncpy_chk")
-      return &StrNCpyChk;
-  }
-
   return 0;
-
 }
 
 Value *LibCallSimplifierImpl::optimizeCall(CallInst *CI) {
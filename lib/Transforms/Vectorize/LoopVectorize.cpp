@@ -85,6 +85,7 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include <algorithm>
+#include <climits>
 #include <map>
 
 using namespace llvm;
@@ -111,6 +112,30 @@ TinyTripCountVectorThreshold("vectorizer-min-trip-count", cl::init(16),
                                       "trip count that is smaller than this "
                                       "value."));
 
+static cl::opt<bool>
+EnableEpilogueVectorization("vectorize-epilogue", cl::init(true), cl::Hidden,
+                            cl::desc("Vectorize the remainder of a vectorized "
+                                     "loop with a smaller vector width when "
+                                     "the cost model finds it profitable."));
+
+static cl::opt<bool>
+EnableInterleavedMemAccesses("enable-interleaved-mem-accesses",
+                             cl::init(true), cl::Hidden,
+                             cl::desc("Enable vectorization of interleaved "
+                                      "groups of strided loads."));
+
+/// We vectorize an outer loop around an inner loop that runs the same constant
+/// number of iterations for every outer iteration, if it is no larger than
+/// this.
+static cl::opt<unsigned>
+MaxUniformInnerTripCount("vectorize-max-inner-trip-count", cl::init(8),
+                         cl::Hidden,
+                         cl::desc("Vectorize outer loops whose inner loop runs "
+                                  "at most this many iterations."));
+
+/// We don't form interleaved groups of loads with a larger stride than this.
+static const unsigned MaxInterleaveFactor = 8;
+
 /// We don't unroll loops with a known constant trip count below this number.
 static const unsigned TinyTripCountUnrollThreshold = 128;
 
@@ -124,6 +149,15 @@ static const unsigned RuntimeMemoryCheckThreshold = 4;
 static const char*
 AlreadyVectorizedMDName = "llvm.vectorizer.already_vectorized";
 
+/// We use a metadata with this name to ask for the scalar remainder of a
+/// vectorized loop to be vectorized again, with the width it holds.
+static const char*
+EpilogueWidthMDName = "llvm.vectorizer.epilogue_width";
+
+/// The cost of entering a vector epilogue loop: the check that enough
+/// iterations are left, and the branches around it.
+static const unsigned EpilogueEntryCost = 4;
+
 namespace {
 
 // Forward declarations.
@@ -139,6 +173,9 @@ class LoopVectorizationCostModel;
 /// * It handles the code generation for reduction variables.
 /// * Scalarization (implementation using scalars) of un-vectorizable
 ///   instructions.
+/// * It keeps the uniform inner loop of an outer loop as a loop inside the
+///   vector body, with scalar values for everything that is the same in all
+///   lanes.
 /// InnerLoopVectorizer does not perform any vectorization-legality
 /// checks, and relies on the caller to check for the different legality
 /// aspects. The InnerLoopVectorizer relies on the
@@ -194,6 +231,11 @@ private:
   void vectorizeBlockInLoop(LoopVectorizationLegality *Legal, BasicBlock *BB,
                             PhiVector *PV);
 
+  /// Create a loop inside the vector body for the uniform inner loop of the
+  /// loop we vectorize, and vectorize its body into it.
+  void vectorizeUniformInnerLoop(LoopVectorizationLegality *Legal,
+                                 PhiVector *PV);
+
   /// Insert the new loop to the loop hierarchy and pass manager
   /// and update the analysis passes.
   void updateAnalysis();
@@ -206,6 +248,11 @@ private:
   void vectorizeMemoryInstruction(Instruction *Instr,
                                   LoopVectorizationLegality *Legal);
 
+  /// Vectorize the interleaved group of loads that LI belongs to with a
+  /// single wide load per unroll part and one shuffle per member.
+  void vectorizeInterleaveGroup(LoadInst *LI,
+                                LoopVectorizationLegality *Legal);
+
   /// Create a broadcast instruction. This method generates a broadcast
   /// instruction (shuffle) for loop invariant values and for the induction
   /// value. If this is the induction variable then we extend it to N, N+1, ...
@@ -225,6 +272,10 @@ private:
   /// broadcast them into a vector.
   VectorParts &getVectorValue(Value *V);
 
+  /// Returns the scalar copy of a value that is uniform in the inner loop, or
+  /// the value itself if it is defined outside the loop.
+  Value *getScalarValue(Value *V);
+
   /// Generate a shuffle sequence that will reverse the vector Vec.
   Value *reverseVector(Value *Vec);
 
@@ -303,6 +354,10 @@ private:
   BasicBlock *LoopExitBlock;
   ///The vector loop body.
   BasicBlock *LoopVectorBody;
+  ///The inner loop of the vector loop, if we kept a uniform inner loop.
+  BasicBlock *LoopVectorInner;
+  ///The latch of the vector loop.
+  BasicBlock *LoopVectorLatch;
   ///The scalar loop body.
   BasicBlock *LoopScalarBody;
   /// A list of all bypass blocks. The first block is the entry of the loop.
@@ -314,6 +369,9 @@ private:
   PHINode *OldInduction;
   /// Maps scalars to widened vectors.
   ValueMap WidenMap;
+  /// Maps the values that are uniform in the inner loop to their scalar
+  /// copies.
+  DenseMap<Value*, Value*> ScalarMap;
 };
 
 /// LoopVectorizationLegality checks if it is legal to vectorize a loop, and
@@ -335,7 +393,7 @@ public:
                             DominatorTree *DT, TargetTransformInfo* TTI,
                             AliasAnalysis *AA, TargetLibraryInfo *TLI)
       : TheLoop(L), SE(SE), DL(DL), DT(DT), TTI(TTI), AA(AA), TLI(TLI),
-        Induction(0) {}
+        Induction(0), InnerLoop(0), InnerTripCount(0) {}
 
   /// This enum represents the kinds of reductions that we support.
   enum ReductionKind {
@@ -346,8 +404,10 @@ public:
     RK_IntegerAnd,  ///< Bitwise or logical AND of numbers.
     RK_IntegerXor,  ///< Bitwise or logical XOR of numbers.
     RK_IntegerMinMax, ///< Min/max implemented in terms of select(cmp()).
+    RK_IntegerFindLast, ///< Last induction value selected by a condition.
     RK_FloatAdd,    ///< Sum of floats.
-    RK_FloatMult    ///< Product of floats.
+    RK_FloatMult,   ///< Product of floats.
+    RK_FloatMinMax  ///< Min/max implemented in terms of select(fcmp()).
   };
 
   /// This enum represents the kinds of inductions that we support.
@@ -365,7 +425,9 @@ public:
     MRK_UIntMin,
     MRK_UIntMax,
     MRK_SIntMin,
-    MRK_SIntMax
+    MRK_SIntMax,
+    MRK_FloatMin,
+    MRK_FloatMax
   };
 
   /// This POD struct holds information about reduction variables.
@@ -431,6 +493,29 @@ public:
     SmallVector<const SCEV*, 2> Ends;
   };
 
+  /// An interleaved group of loads. The members are loads of the same type
+  /// whose addresses advance by Factor elements every iteration and that
+  /// together read every element of the Factor-element record at their
+  /// common base, e.g. the real and imaginary parts of an array of complex
+  /// numbers. The whole group is vectorized with one wide load of VF * Factor
+  /// elements followed by a shuffle per member.
+  struct InterleaveGroup {
+    InterleaveGroup() : InsertPos(0), Alignment(0) {}
+    /// Returns the stride (in elements) of the members.
+    unsigned getFactor() const { return Members.size(); }
+    /// Returns the offset (in elements) of LI within the record.
+    unsigned getIndex(LoadInst *LI) const {
+      return std::find(Members.begin(), Members.end(), LI) - Members.begin();
+    }
+    /// The members, indexed by their offset within the record.
+    SmallVector<LoadInst*, 4> Members;
+    /// The member that comes first in the loop body. The wide load is
+    /// emitted in its place.
+    LoadInst *InsertPos;
+    /// The alignment of the wide load.
+    unsigned Alignment;
+  };
+
   /// A POD for saving information about induction variables.
   struct InductionInfo {
     InductionInfo(Value *Start, InductionKind K) : StartValue(Start), IK(K) {}
@@ -471,6 +556,13 @@ public:
   /// Returns True if V is an induction variable in this loop.
   bool isInductionVariable(const Value *V);
 
+  /// Returns the inner loop of an outer loop that we vectorize, or null if
+  /// the loop is innermost.
+  Loop *getInnerLoop() { return InnerLoop; }
+
+  /// Returns the trip count of the inner loop.
+  unsigned getInnerTripCount() { return InnerTripCount; }
+
   /// Return true if the block BB needs to be predicated in order for the loop
   /// to be vectorized.
   bool blockNeedsPredication(BasicBlock *BB);
@@ -488,6 +580,14 @@ public:
   /// Returns true if the value V is uniform within the loop.
   bool isUniform(Value *V);
 
+  /// Returns the interleaved group that I is a member of, or null if I is not
+  /// part of an interleaved group.
+  const InterleaveGroup *getInterleaveGroup(Instruction *I) const {
+    DenseMap<Instruction*, unsigned>::const_iterator It =
+      InterleaveGroupIdx.find(I);
+    return It == InterleaveGroupIdx.end() ? 0 : &InterleaveGroups[It->second];
+  }
+
   /// Returns true if this instruction will remain scalar after vectorization.
   bool isUniformAfterVectorization(Instruction* I) { return Uniforms.count(I); }
 
@@ -514,9 +614,22 @@ private:
   /// transformation.
   bool canVectorizeWithIfConvert();
 
+  /// Return true if this outer loop has a single inner loop that runs the
+  /// same number of iterations in every lane, so that it can stay a loop in
+  /// the vector body. Collects the values that are uniform in the inner loop.
+  bool canVectorizeUniformInnerLoop();
+
+  /// Return true if no two lanes can store to the same location with ST, in
+  /// any iteration of the inner loop.
+  bool isLaneDisjointStore(StoreInst *ST);
+
   /// Collect the variables that need to stay uniform after vectorization.
   void collectLoopUniforms();
 
+  /// Find the groups of strided loads that can be vectorized together as one
+  /// wide load and a set of shuffles.
+  void collectInterleaveGroups();
+
   /// Return true if all of the instructions in the block can be speculatively
   /// executed.
   bool blockCanBePredicated(BasicBlock *BB);
@@ -535,6 +648,10 @@ private:
   /// pattern corresponding to a min(X, Y) or max(X, Y).
   static ReductionInstDesc isMinMaxSelectCmpPattern(Instruction *I,
                                                     ReductionInstDesc &Prev);
+  /// Returns true if the instruction is a Select(Cond, IV, Phi) instruction
+  /// that keeps the last value of an increasing induction for which Cond
+  /// held ("find last index where").
+  ReductionInstDesc isFindLastSelectPattern(Instruction *I);
   /// Returns the induction kind of Phi. This function may return NoInduction
   /// if the PHI is not an induction variable.
   InductionKind isInductionVariable(PHINode *Phi);
@@ -575,6 +692,10 @@ private:
   /// Notice that inductions don't need to start at zero and that induction
   /// variables can be pointers.
   InductionList Inductions;
+  /// The inner loop, if this is an outer loop with a uniform inner loop.
+  Loop *InnerLoop;
+  /// The constant trip count of the inner loop.
+  unsigned InnerTripCount;
 
   /// Allowed outside users. This holds the reduction
   /// vars which can be accessed from outside the loop.
@@ -585,6 +706,11 @@ private:
   /// We need to check that all of the pointers in this list are disjoint
   /// at runtime.
   RuntimePointerCheck PtrRtCheck;
+  /// Holds the interleaved groups of loads found in the loop.
+  SmallVector<InterleaveGroup, 2> InterleaveGroups;
+  /// Maps each member of an interleaved group to its index in
+  /// InterleaveGroups.
+  DenseMap<Instruction*, unsigned> InterleaveGroupIdx;
 };
 
 /// LoopVectorizationCostModel - estimates the expected speedups due to
@@ -614,6 +740,11 @@ public:
   VectorizationFactor selectVectorizationFactor(bool OptForSize,
                                                 unsigned UserVF);
 
+  /// \return The vectorization factor of an epilogue loop for the iterations
+  /// that a loop vectorized with \p VF and \p UF leaves over, or 1 if they
+  /// are best left to the scalar loop.
+  unsigned selectEpilogueFactor(unsigned VF, unsigned UF);
+
   /// \return The size (in bits) of the widest type in the code that
   /// needs to be vectorized. We ignore values that remain scalar such as
   /// 64 bit loop indices.
@@ -648,6 +779,17 @@ private:
   /// the factor width.
   unsigned expectedCost(unsigned VF);
 
+  /// Returns expectedCost(VF), computing it only once for each VF.
+  unsigned getCachedCost(unsigned VF);
+
+  /// Returns the expected cost of the iterations left over by a vector loop
+  /// that runs \p Step iterations at a time. With a known trip count \p TC
+  /// this is exact; with \p TC zero it is the average over all possible
+  /// remainders. The remainder may run in a vector epilogue of width at most
+  /// \p MaxEpilogueVF, whose width is returned in \p EpilogueVF (1 for none).
+  float getRemainderCost(unsigned Step, unsigned TC, unsigned MaxEpilogueVF,
+                         unsigned &EpilogueVF);
+
   /// Returns the execution time cost of an instruction for a given vector
   /// width. Vector width of one means scalar.
   unsigned getInstructionCost(Instruction *I, unsigned VF);
@@ -675,6 +817,8 @@ private:
   DataLayout *DL;
   /// Target Library Info.
   const TargetLibraryInfo *TLI;
+  /// The costs computed by getCachedCost.
+  DenseMap<unsigned, unsigned> CostCache;
 };
 
 /// The LoopVectorize Pass.
@@ -695,10 +839,6 @@ struct LoopVectorize : public LoopPass {
   TargetLibraryInfo *TLI;
 
   virtual bool runOnLoop(Loop *L, LPPassManager &LPM) {
-    // We only vectorize innermost loops.
-    if (!L->empty())
-      return false;
-
     SE = &getAnalysis<ScalarEvolution>();
     DL = getAnalysisIfAvailable<DataLayout>();
     LI = &getAnalysis<LoopInfo>();
@@ -710,10 +850,16 @@ struct LoopVectorize : public LoopPass {
     DEBUG(dbgs() << "LV: Checking a loop in \"" <<
           L->getHeader()->getParent()->getName() << "\"\n");
 
+    // The scalar remainder of a loop we vectorized may be vectorized again
+    // with the narrower width that the cost model picked for it.
+    unsigned EpilogueWidth = takeEpilogueWidth(L);
+
     // Check if it is legal to vectorize the loop.
     LoopVectorizationLegality LVL(L, SE, DL, DT, TTI, AA, TLI);
     if (!LVL.canVectorize()) {
       DEBUG(dbgs() << "LV: Not vectorizing.\n");
+      if (EpilogueWidth)
+        markAlreadyVectorized(L);
       return false;
     }
 
@@ -732,18 +878,24 @@ struct LoopVectorize : public LoopPass {
     if (NoFloat) {
       DEBUG(dbgs() << "LV: Can't vectorize when the NoImplicitFloat"
             "attribute is used.\n");
+      if (EpilogueWidth)
+        markAlreadyVectorized(L);
       return false;
     }
 
     // Select the optimal vectorization factor.
     LoopVectorizationCostModel::VectorizationFactor VF;
-    VF = CM.selectVectorizationFactor(OptForSize, VectorizationFactor);
+    VF = CM.selectVectorizationFactor(OptForSize, EpilogueWidth ?
+                                      EpilogueWidth : VectorizationFactor);
     // Select the unroll factor.
-    unsigned UF = CM.selectUnrollFactor(OptForSize, VectorizationUnroll,
+    unsigned UF = CM.selectUnrollFactor(OptForSize, EpilogueWidth ?
+                                        1 : VectorizationUnroll,
                                         VF.Width, VF.Cost);
 
     if (VF.Width == 1) {
       DEBUG(dbgs() << "LV: Vectorization is possible but not beneficial.\n");
+      if (EpilogueWidth)
+        markAlreadyVectorized(L);
       return false;
     }
 
@@ -751,14 +903,54 @@ struct LoopVectorize : public LoopPass {
           F->getParent()->getModuleIdentifier()<<"\n");
     DEBUG(dbgs() << "LV: Unroll Factor is " << UF << "\n");
 
+    // The iterations left over may be worth a narrower vector loop of their
+    // own.
+    unsigned EpilogueVF = 1;
+    if (!EpilogueWidth && !OptForSize)
+      EpilogueVF = CM.selectEpilogueFactor(VF.Width, UF);
+
     // If we decided that it is *legal* to vectorize the loop then do it.
     InnerLoopVectorizer LB(L, SE, LI, DT, DL, TLI, VF.Width, UF);
     LB.vectorize(&LVL);
 
+    // L is now the scalar remainder loop.  Ask for it to be vectorized again
+    // instead of leaving it alone.
+    if (EpilogueVF > 1) {
+      TerminatorInst *TI = L->getHeader()->getTerminator();
+      LLVMContext &Ctx = TI->getContext();
+      TI->setMetadata(AlreadyVectorizedMDName, 0);
+      TI->setMetadata(EpilogueWidthMDName,
+                      MDNode::get(Ctx, ConstantInt::get(Type::getInt32Ty(Ctx),
+                                                        EpilogueVF)));
+      LPM.redoLoop(L);
+    }
+
     DEBUG(verifyFunction(*L->getHeader()->getParent()));
     return true;
   }
 
+  /// If L is the remainder of a loop that was vectorized with a vector
+  /// epilogue in mind, drop the request and return the epilogue's width.
+  /// \return Zero for any other loop.
+  static unsigned takeEpilogueWidth(Loop *L) {
+    TerminatorInst *TI = L->getHeader()->getTerminator();
+    MDNode *MD = TI->getMetadata(EpilogueWidthMDName);
+    if (!MD)
+      return 0;
+    TI->setMetadata(EpilogueWidthMDName, 0);
+    ConstantInt *Width = dyn_cast<ConstantInt>(MD->getOperand(0));
+    return Width ? Width->getZExtValue() : 0;
+  }
+
+  /// Restore the marker that the vectorizer cleared on the remainder L when
+  /// it asked for L to be vectorized again, so that L is left alone if that
+  /// second attempt gives up.
+  static void markAlreadyVectorized(Loop *L) {
+    TerminatorInst *TI = L->getHeader()->getTerminator();
+    TI->setMetadata(AlreadyVectorizedMDName,
+                    MDNode::get(TI->getContext(), ArrayRef<Value*>()));
+  }
+
   virtual void getAnalysisUsage(AnalysisUsage &AU) const {
     LoopPass::getAnalysisUsage(AU);
     AU.addRequiredID(LoopSimplifyID);
@@ -799,7 +991,9 @@ Value *InnerLoopVectorizer::getBroadcastInstrs(Value *V) {
 
   // We need to place the broadcast of invariant variables outside the loop.
   Instruction *Instr = dyn_cast<Instruction>(V);
-  bool NewInstr = (Instr && Instr->getParent() == LoopVectorBody);
+  bool NewInstr = (Instr && (Instr->getParent() == LoopVectorBody ||
+                             Instr->getParent() == LoopVectorInner ||
+                             Instr->getParent() == LoopVectorLatch));
   bool Invariant = OrigLoop->isLoopInvariant(V) && !NewInstr;
 
   // Place the code for broadcasting invariant variables in the new preheader.
@@ -891,9 +1085,16 @@ int LoopVectorizationLegality::isConsecutivePtr(Value *Ptr) {
       return 0;
 
   // We can emit wide load/stores only if the last index is the induction
-  // variable.
+  // variable. In a uniform inner loop the lanes only differ in the outer
+  // induction, because the inner loop advances all of them alike.
   const SCEV *Last = SE->getSCEV(LastIndex);
+  if (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(Last))
+    if (InnerLoop && AR->getLoop() == InnerLoop &&
+        SE->isLoopInvariant(AR->getStepRecurrence(*SE), TheLoop))
+      Last = AR->getStart();
   if (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(Last)) {
+    if (AR->getLoop() != TheLoop)
+      return 0;
     const SCEV *Step = AR->getStepRecurrence(*SE);
 
     // The memory is consecutive because the last index is consecutive
@@ -921,11 +1122,17 @@ InnerLoopVectorizer::getVectorValue(Value *V) {
     return WidenMap.get(V);
 
   // If this scalar is unknown, assume that it is a constant or that it is
-  // loop invariant. Broadcast V and save the value for future uses.
-  Value *B = getBroadcastInstrs(V);
+  // loop invariant. Broadcast V and save the value for future uses. Values
+  // that are uniform in the inner loop are broadcast from their scalar copy.
+  Value *B = getBroadcastInstrs(getScalarValue(V));
   return WidenMap.splat(V, B);
 }
 
+Value *InnerLoopVectorizer::getScalarValue(Value *V) {
+  DenseMap<Value*, Value*>::iterator It = ScalarMap.find(V);
+  return It != ScalarMap.end() ? It->second : V;
+}
+
 Value *InnerLoopVectorizer::reverseVector(Value *Vec) {
   assert(Vec->getType()->isVectorTy() && "Invalid type");
   SmallVector<Constant*, 8> ShuffleMask;
@@ -946,6 +1153,11 @@ void InnerLoopVectorizer::vectorizeMemoryInstruction(Instruction *Instr,
 
   assert((LI || SI) && "Invalid Load/Store instruction");
 
+  // Interleaved loads are emitted together, in place of the first member of
+  // their group.
+  if (LI && Legal->getInterleaveGroup(LI))
+    return vectorizeInterleaveGroup(LI, Legal);
+
   Type *ScalarDataTy = LI ? LI->getType() : SI->getValueOperand()->getType();
   Type *DataTy = VectorType::get(ScalarDataTy, VF);
   Value *Ptr = LI ? LI->getPointerOperand() : SI->getPointerOperand();
@@ -987,8 +1199,11 @@ void InnerLoopVectorizer::vectorizeMemoryInstruction(Instruction *Instr,
     Value *LastIndex = GEPParts[0];
     LastIndex = Builder.CreateExtractElement(LastIndex, Zero);
 
-    // Create the new GEP with the new induction variable.
+    // Create the new GEP with the new induction variable. The other indices
+    // are the same in all lanes.
     GetElementPtrInst *Gep2 = cast<GetElementPtrInst>(Gep->clone());
+    for (unsigned i = 0; i < NumOperands - 1; ++i)
+      Gep2->setOperand(i, getScalarValue(Gep2->getOperand(i)));
     Gep2->setOperand(NumOperands - 1, LastIndex);
     Gep2->setName("gep.indvar.idx");
     Ptr = Builder.Insert(Gep2);
@@ -1042,6 +1257,47 @@ void InnerLoopVectorizer::vectorizeMemoryInstruction(Instruction *Instr,
   }
 }
 
+void InnerLoopVectorizer::vectorizeInterleaveGroup(LoadInst *LI,
+                                             LoopVectorizationLegality *Legal) {
+  const LoopVectorizationLegality::InterleaveGroup *Group =
+    Legal->getInterleaveGroup(LI);
+
+  // The whole group was already vectorized when we saw its first member.
+  if (Group->InsertPos != LI)
+    return;
+
+  unsigned Factor = Group->getFactor();
+  unsigned Index = Group->getIndex(LI);
+  Type *WideTy = VectorType::get(LI->getType(), VF * Factor);
+  unsigned AS = LI->getPointerAddressSpace();
+  Constant *Zero = Builder.getInt32(0);
+
+  // The other members may not have been widened yet, so compute the address
+  // of the record from the pointer of this member.
+  VectorParts &PtrParts = getVectorValue(LI->getPointerOperand());
+
+  for (unsigned Part = 0; Part < UF; ++Part) {
+    Value *Ptr = Builder.CreateExtractElement(PtrParts[Part], Zero);
+    Ptr = Builder.CreateGEP(Ptr, Builder.getInt32(-Index), "interleave.base");
+    Value *VecPtr = Builder.CreateBitCast(Ptr, WideTy->getPointerTo(AS));
+    LoadInst *WideLoad = Builder.CreateLoad(VecPtr, "wide.vec");
+    WideLoad->setAlignment(Group->Alignment);
+
+    // Pick the elements of each member out of the wide vector.
+    for (unsigned i = 0; i < Factor; ++i) {
+      SmallVector<Constant*, 8> ShuffleMask;
+      for (unsigned j = 0; j < VF; ++j)
+        ShuffleMask.push_back(Builder.getInt32(i + j * Factor));
+
+      Value *Strided =
+        Builder.CreateShuffleVector(WideLoad, UndefValue::get(WideTy),
+                                    ConstantVector::get(ShuffleMask),
+                                    "strided.vec");
+      WidenMap.get(Group->Members[i])[Part] = Strided;
+    }
+  }
+}
+
 void InnerLoopVectorizer::scalarizeInstruction(Instruction *Instr) {
   assert(!Instr->getType()->isAggregateType() && "Can't handle vectors");
   // Holds vector parameters or scalars, in case of uniform vals.
@@ -1060,6 +1316,14 @@ void InnerLoopVectorizer::scalarizeInstruction(Instruction *Instr) {
     // Try using previously calculated values.
     Instruction *SrcInst = dyn_cast<Instruction>(SrcOp);
 
+    // Values that are uniform in the inner loop have a scalar copy.
+    if (ScalarMap.count(SrcOp)) {
+      VectorParts Scalars;
+      Scalars.append(UF, ScalarMap[SrcOp]);
+      Params.push_back(Scalars);
+      continue;
+    }
+
     // If the src is an instruction that appeared earlier in the basic block
     // then it should already be vectorized.
     if (SrcInst && OrigLoop->contains(SrcInst)) {
@@ -1476,6 +1740,8 @@ InnerLoopVectorizer::createEmptyLoop(LoopVectorizationLegality *Legal) {
   LoopMiddleBlock = MiddleBlock;
   LoopExitBlock = ExitBlock;
   LoopVectorBody = VecBody;
+  LoopVectorInner = 0;
+  LoopVectorLatch = VecBody;
   LoopScalarBody = OldBasicBlock;
 }
 
@@ -1502,6 +1768,16 @@ LoopVectorizationLegality::getReductionIdentity(ReductionKind K, Type *Tp,
   case  RK_FloatAdd:
     // Adding zero to a number does not change it.
     return ConstantFP::get(Tp, 0.0L);
+  case  RK_FloatMinMax:
+    // Without NaNs nothing is below +inf or above -inf.
+    return ConstantFP::getInfinity(Tp, MinMaxK == MRK_FloatMax);
+  case  RK_IntegerFindLast: {
+    // The induction never takes the signed minimum value, so it marks lanes
+    // in which the condition never held.
+    unsigned BitWidth = Tp->getPrimitiveSizeInBits();
+    return ConstantInt::get(Tp->getContext(),
+                            APInt::getSignedMinValue(BitWidth));
+  }
   case  RK_IntegerMinMax:
     switch(MinMaxK) {
     default: llvm_unreachable("Unknown min/max predicate");
@@ -1648,7 +1924,10 @@ getReductionBinOp(LoopVectorizationLegality::ReductionKind Kind) {
     case LoopVectorizationLegality::RK_FloatAdd:
       return Instruction::FAdd;
     case LoopVectorizationLegality::RK_IntegerMinMax:
+    case LoopVectorizationLegality::RK_IntegerFindLast:
       return Instruction::ICmp;
+    case LoopVectorizationLegality::RK_FloatMinMax:
+      return Instruction::FCmp;
     default:
       llvm_unreachable("Unknown reduction operation");
   }
@@ -1673,8 +1952,18 @@ Value *createMinMaxOp(IRBuilder<> &Builder,
     break;
   case LoopVectorizationLegality::MRK_SIntMax:
     P = CmpInst::ICMP_SGT;
+    break;
+  case LoopVectorizationLegality::MRK_FloatMin:
+    P = CmpInst::FCMP_OLT;
+    break;
+  case LoopVectorizationLegality::MRK_FloatMax:
+    P = CmpInst::FCMP_OGT;
   }
-  Value *Cmp = Builder.CreateICmp(P, Left, Right, "rdx.minmax.cmp");
+  Value *Cmp;
+  if (CmpInst::isFPPredicate(P))
+    Cmp = Builder.CreateFCmp(P, Left, Right, "rdx.minmax.cmp");
+  else
+    Cmp = Builder.CreateICmp(P, Left, Right, "rdx.minmax.cmp");
   Value *Select = Builder.CreateSelect(Cmp, Left, Right, "rdx.minmax.select");
   return Select;
 }
@@ -1706,9 +1995,14 @@ InnerLoopVectorizer::vectorizeLoop(LoopVectorizationLegality *Legal) {
   DFS.perform(LI);
 
   // Vectorize all of the blocks in the original loop.
+  Loop *Inner = Legal->getInnerLoop();
   for (LoopBlocksDFS::RPOIterator bb = DFS.beginRPO(),
-       be = DFS.endRPO(); bb != be; ++bb)
-    vectorizeBlockInLoop(Legal, *bb, &RdxPHIsToFix);
+       be = DFS.endRPO(); bb != be; ++bb) {
+    if (Inner && Inner->contains(*bb))
+      vectorizeUniformInnerLoop(Legal, &RdxPHIsToFix);
+    else
+      vectorizeBlockInLoop(Legal, *bb, &RdxPHIsToFix);
+  }
 
   // At this point every instruction in the original loop is widened to
   // a vector form. We are almost done. Now, we need to fix the PHI nodes
@@ -1749,9 +2043,12 @@ InnerLoopVectorizer::vectorizeLoop(LoopVectorizationLegality *Legal) {
     Constant *Identity = ConstantVector::getSplat(VF, Iden);
 
     // This vector is the Identity vector where the first element is the
-    // incoming scalar reduction.
-    Value *VectorStart = Builder.CreateInsertElement(Identity,
-                                                     RdxDesc.StartValue, Zero);
+    // incoming scalar reduction. A find-last reduction keeps its start value
+    // out of the vector and only uses it if no lane selected an index.
+    Value *VectorStart = Identity;
+    if (RdxDesc.Kind != LoopVectorizationLegality::RK_IntegerFindLast)
+      VectorStart = Builder.CreateInsertElement(Identity, RdxDesc.StartValue,
+                                                Zero);
 
     // Fix the vector-loop phi.
     // We created the induction variable so we know that the
@@ -1769,7 +2066,7 @@ InnerLoopVectorizer::vectorizeLoop(LoopVectorizationLegality *Legal) {
       // first unroll part.
       Value *StartVal = (part == 0) ? VectorStart : Identity;
       cast<PHINode>(VecRdxPhi[part])->addIncoming(StartVal, VecPreheader);
-      cast<PHINode>(VecRdxPhi[part])->addIncoming(Val[part], LoopVectorBody);
+      cast<PHINode>(VecRdxPhi[part])->addIncoming(Val[part], LoopVectorLatch);
     }
 
     // Before each round, move the insertion point right between
@@ -1787,7 +2084,7 @@ InnerLoopVectorizer::vectorizeLoop(LoopVectorizationLegality *Legal) {
       Value *StartVal = (part == 0) ? VectorStart : Identity;
       for (unsigned I = 0, E = LoopBypassBlocks.size(); I != E; ++I)
         NewPhi->addIncoming(StartVal, LoopBypassBlocks[I]);
-      NewPhi->addIncoming(RdxExitVal[part], LoopVectorBody);
+      NewPhi->addIncoming(RdxExitVal[part], LoopVectorLatch);
       RdxParts.push_back(NewPhi);
     }
 
@@ -1795,7 +2092,7 @@ InnerLoopVectorizer::vectorizeLoop(LoopVectorizationLegality *Legal) {
     Value *ReducedPartRdx = RdxParts[0];
     unsigned Op = getReductionBinOp(RdxDesc.Kind);
     for (unsigned part = 1; part < UF; ++part) {
-      if (Op != Instruction::ICmp)
+      if (Op != Instruction::ICmp && Op != Instruction::FCmp)
         ReducedPartRdx = Builder.CreateBinOp((Instruction::BinaryOps)Op,
                                              RdxParts[part], ReducedPartRdx,
                                              "bin.rdx");
@@ -1826,7 +2123,7 @@ InnerLoopVectorizer::vectorizeLoop(LoopVectorizationLegality *Legal) {
                                     ConstantVector::get(ShuffleMask),
                                     "rdx.shuf");
 
-      if (Op != Instruction::ICmp)
+      if (Op != Instruction::ICmp && Op != Instruction::FCmp)
         TmpVec = Builder.CreateBinOp((Instruction::BinaryOps)Op, TmpVec, Shuf,
                                      "bin.rdx");
       else
@@ -1836,6 +2133,13 @@ InnerLoopVectorizer::vectorizeLoop(LoopVectorizationLegality *Legal) {
     // The result is in the first element of the vector.
     Value *Scalar0 = Builder.CreateExtractElement(TmpVec, Builder.getInt32(0));
 
+    // If the condition never held the reduction keeps its start value.
+    if (RdxDesc.Kind == LoopVectorizationLegality::RK_IntegerFindLast) {
+      Value *NotFound = Builder.CreateICmpEQ(Scalar0, Iden, "rdx.notfound");
+      Scalar0 = Builder.CreateSelect(NotFound, RdxDesc.StartValue, Scalar0,
+                                     "rdx.findlast");
+    }
+
     // Now, we need to fix the users of the reduction variable
     // inside and outside of the scalar remainder loop.
     // We know that the loop is in LCSSA form. We need to update the
@@ -1936,8 +2240,31 @@ InnerLoopVectorizer::createBlockInMask(BasicBlock *BB) {
 void
 InnerLoopVectorizer::vectorizeBlockInLoop(LoopVectorizationLegality *Legal,
                                           BasicBlock *BB, PhiVector *PV) {
+  Loop *Inner = Legal->getInnerLoop();
+  bool InInnerLoop = Inner && Inner->contains(BB);
+
   // For each instruction in the old loop.
   for (BasicBlock::iterator it = BB->begin(), e = BB->end(); it != e; ++it) {
+    // Values of a uniform inner loop that are the same in every lane stay
+    // scalar. The PHIs get their value from the back edge once the inner
+    // loop is complete.
+    if (InInnerLoop && Legal->isUniformAfterVectorization(it)) {
+      if (PHINode *P = dyn_cast<PHINode>(it)) {
+        PHINode *NewPhi = PHINode::Create(P->getType(), 2, P->getName(),
+                                          LoopVectorInner->getFirstNonPHI());
+        Value *Start =
+          P->getIncomingValueForBlock(Inner->getLoopPreheader());
+        NewPhi->addIncoming(getScalarValue(Start), LoopVectorBody);
+        ScalarMap[P] = NewPhi;
+        continue;
+      }
+      Instruction *Cloned = it->clone();
+      for (unsigned op = 0, e = it->getNumOperands(); op != e; ++op)
+        Cloned->setOperand(op, getScalarValue(it->getOperand(op)));
+      ScalarMap[it] = Builder.Insert(Cloned, it->getName());
+      continue;
+    }
+
     VectorParts &Entry = WidenMap.get(it);
     switch (it->getOpcode()) {
     case Instruction::Br:
@@ -1946,6 +2273,25 @@ InnerLoopVectorizer::vectorizeBlockInLoop(LoopVectorizationLegality *Legal,
       continue;
     case Instruction::PHI:{
       PHINode* P = cast<PHINode>(it);
+      // The PHIs of a uniform inner loop that differ between the lanes become
+      // vector PHIs.
+      if (InInnerLoop) {
+        Value *Start = P->getIncomingValueForBlock(Inner->getLoopPreheader());
+        VectorParts &StartParts = getVectorValue(Start);
+        Type *VecTy = VectorType::get(P->getType(), VF);
+        for (unsigned part = 0; part < UF; ++part) {
+          PHINode *NewPhi = PHINode::Create(VecTy, 2, "vec.phi",
+                                            LoopVectorInner->getFirstNonPHI());
+          NewPhi->addIncoming(StartParts[part], LoopVectorBody);
+          Entry[part] = NewPhi;
+        }
+        continue;
+      }
+
+      // The values that leave the inner loop were set up along with it.
+      if (Inner && P->getParent() == Inner->getExitBlock())
+        continue;
+
       // Handle reduction variables:
       if (Legal->getReductionVars()->count(P)) {
         for (unsigned part = 0; part < UF; ++part) {
@@ -2219,6 +2565,77 @@ InnerLoopVectorizer::vectorizeBlockInLoop(LoopVectorizationLegality *Legal,
   }// end of for_each instr.
 }
 
+void
+InnerLoopVectorizer::vectorizeUniformInnerLoop(LoopVectorizationLegality *Legal,
+                                               PhiVector *PV) {
+  Loop *Inner = Legal->getInnerLoop();
+  BasicBlock *BB = Inner->getHeader();
+  BasicBlock *ExitBB = Inner->getExitBlock();
+
+  // The code after the inner loop moves to a new latch block, and the inner
+  // loop goes between the two.
+  LoopVectorLatch = LoopVectorBody->splitBasicBlock(Builder.GetInsertPoint(),
+                                                    "vector.inner.exit");
+  LoopVectorInner = BasicBlock::Create(BB->getContext(), "vector.inner",
+                                       LoopVectorBody->getParent(),
+                                       LoopVectorLatch);
+  LoopVectorBody->getTerminator()->setSuccessor(0, LoopVectorInner);
+
+  Loop *VecLoop = LI->getLoopFor(LoopVectorBody);
+  VecLoop->addBasicBlockToLoop(LoopVectorLatch, LI->getBase());
+  Loop *VecInnerLoop = new Loop();
+  VecLoop->addChildLoop(VecInnerLoop);
+  VecInnerLoop->addBasicBlockToLoop(LoopVectorInner, LI->getBase());
+
+  // Leave the loop until its body is done.
+  BranchInst *InnerBr = BranchInst::Create(LoopVectorLatch, LoopVectorInner);
+  Builder.SetInsertPoint(InnerBr);
+  vectorizeBlockInLoop(Legal, BB, PV);
+
+  // Now that the body is done, add the values from the back edge.
+  for (BasicBlock::iterator it = BB->begin(), e = BB->getFirstNonPHI();
+       it != e; ++it) {
+    PHINode *P = cast<PHINode>(it);
+    Value *Next = P->getIncomingValueForBlock(BB);
+    if (ScalarMap.count(P)) {
+      cast<PHINode>(ScalarMap[P])->addIncoming(getScalarValue(Next),
+                                               LoopVectorInner);
+      continue;
+    }
+    VectorParts &Phis = WidenMap.get(P);
+    VectorParts &Vals = getVectorValue(Next);
+    for (unsigned part = 0; part < UF; ++part)
+      cast<PHINode>(Phis[part])->addIncoming(Vals[part], LoopVectorInner);
+  }
+
+  // Values that are used after the inner loop leave it through PHIs, as in
+  // the original loop.
+  for (BasicBlock::iterator it = ExitBB->begin(), e = ExitBB->getFirstNonPHI();
+       it != e; ++it) {
+    PHINode *P = cast<PHINode>(it);
+    VectorParts &Vals = getVectorValue(P->getIncomingValue(0));
+    VectorParts &Entry = WidenMap.get(P);
+    for (unsigned part = 0; part < UF; ++part) {
+      PHINode *Exit = PHINode::Create(Vals[part]->getType(), 1, P->getName(),
+                                      LoopVectorLatch->getFirstNonPHI());
+      Exit->addIncoming(Vals[part], LoopVectorInner);
+      Entry[part] = Exit;
+    }
+  }
+
+  // All lanes run the same number of inner iterations, so the scalar
+  // condition controls the loop.
+  BranchInst *Br = cast<BranchInst>(BB->getTerminator());
+  Value *Cond = getScalarValue(Br->getCondition());
+  if (Br->getSuccessor(0) == BB)
+    BranchInst::Create(LoopVectorInner, LoopVectorLatch, Cond, InnerBr);
+  else
+    BranchInst::Create(LoopVectorLatch, LoopVectorInner, Cond, InnerBr);
+  InnerBr->eraseFromParent();
+
+  Builder.SetInsertPoint(LoopVectorLatch->getFirstInsertionPt());
+}
+
 void InnerLoopVectorizer::updateAnalysis() {
   // Forget the original basic block.
   SE->forgetLoop(OrigLoop);
@@ -2231,6 +2648,10 @@ void InnerLoopVectorizer::updateAnalysis() {
     DT->addNewBlock(LoopBypassBlocks[I], LoopBypassBlocks[I-1]);
   DT->addNewBlock(LoopVectorPreHeader, LoopBypassBlocks.back());
   DT->addNewBlock(LoopVectorBody, LoopVectorPreHeader);
+  if (LoopVectorInner) {
+    DT->addNewBlock(LoopVectorInner, LoopVectorBody);
+    DT->addNewBlock(LoopVectorLatch, LoopVectorInner);
+  }
   DT->addNewBlock(LoopMiddleBlock, LoopBypassBlocks.front());
   DT->addNewBlock(LoopScalarPreHeader, LoopMiddleBlock);
   DT->changeImmediateDominator(LoopScalarBody, LoopScalarPreHeader);
@@ -2272,8 +2693,9 @@ bool LoopVectorizationLegality::canVectorizeWithIfConvert() {
 bool LoopVectorizationLegality::canVectorize() {
   assert(TheLoop->getLoopPreheader() && "No preheader!!");
 
-  // We can only vectorize innermost loops.
-  if (TheLoop->getSubLoopsVector().size())
+  // We can only vectorize innermost loops, and outer loops around a uniform
+  // inner loop.
+  if (TheLoop->getSubLoopsVector().size() && !canVectorizeUniformInnerLoop())
     return false;
 
   // We must have a single backedge.
@@ -2286,8 +2708,9 @@ bool LoopVectorizationLegality::canVectorize() {
 
   unsigned NumBlocks = TheLoop->getNumBlocks();
 
-  // Check if we can if-convert non single-bb loops.
-  if (NumBlocks != 1 && !canVectorizeWithIfConvert()) {
+  // Check if we can if-convert non single-bb loops. The blocks around a
+  // uniform inner loop run in every lane and need no predication.
+  if (NumBlocks != 1 && !InnerLoop && !canVectorizeWithIfConvert()) {
     DEBUG(dbgs() << "LV: Can't if-convert the loop.\n");
     return false;
   }
@@ -2327,6 +2750,9 @@ bool LoopVectorizationLegality::canVectorize() {
   // Collect all of the variables that remain uniform after vectorization.
   collectLoopUniforms();
 
+  // Find the strided loads that we can vectorize as interleaved groups.
+  collectInterleaveGroups();
+
   DEBUG(dbgs() << "LV: We can vectorize this loop" <<
         (PtrRtCheck.Need ? " (with a runtime bound check)" : "")
         <<"!\n");
@@ -2348,6 +2774,13 @@ bool LoopVectorizationLegality::canVectorizeInstrs() {
     return false;
   }
 
+  // Look for the attribute signaling the absence of NaNs.
+  Function &F = *Header->getParent();
+  bool HasFunNoNaNAttr = F.hasFnAttribute("no-nans-fp-math") &&
+    F.getAttributes().getAttribute(AttributeSet::FunctionIndex,
+                                   "no-nans-fp-math").getValueAsString() ==
+    "true";
+
   // For each block in the loop.
   for (Loop::block_iterator bb = TheLoop->block_begin(),
        be = TheLoop->block_end(); bb != be; ++bb) {
@@ -2357,8 +2790,10 @@ bool LoopVectorizationLegality::canVectorizeInstrs() {
          ++it) {
 
       if (PHINode *Phi = dyn_cast<PHINode>(it)) {
-        // This should not happen because the loop should be normalized.
-        if (Phi->getNumIncomingValues() != 2) {
+        // This should not happen because the loop should be normalized. The
+        // exit block of an inner loop has PHIs for the values that leave it.
+        if (Phi->getNumIncomingValues() != 2 &&
+            !(InnerLoop && *bb == InnerLoop->getExitBlock())) {
           DEBUG(dbgs() << "LV: Found an invalid PHI.\n");
           return false;
         }
@@ -2421,6 +2856,10 @@ bool LoopVectorizationLegality::canVectorizeInstrs() {
           DEBUG(dbgs() << "LV: Found a MINMAX reduction PHI."<< *Phi <<"\n");
           continue;
         }
+        if (AddReductionVar(Phi, RK_IntegerFindLast)) {
+          DEBUG(dbgs() << "LV: Found a FINDLAST reduction PHI."<< *Phi <<"\n");
+          continue;
+        }
         if (AddReductionVar(Phi, RK_FloatMult)) {
           DEBUG(dbgs() << "LV: Found an FMult reduction PHI."<< *Phi <<"\n");
           continue;
@@ -2429,6 +2868,12 @@ bool LoopVectorizationLegality::canVectorizeInstrs() {
           DEBUG(dbgs() << "LV: Found an FAdd reduction PHI."<< *Phi <<"\n");
           continue;
         }
+        // Reordering float min/max is only safe if there are no NaNs.
+        if (HasFunNoNaNAttr && AddReductionVar(Phi, RK_FloatMinMax)) {
+          DEBUG(dbgs() << "LV: Found an float MINMAX reduction PHI."<< *Phi <<
+                "\n");
+          continue;
+        }
 
         DEBUG(dbgs() << "LV: Found an unidentified PHI."<< *Phi <<"\n");
         return false;
@@ -2481,6 +2926,104 @@ bool LoopVectorizationLegality::canVectorizeInstrs() {
   return true;
 }
 
+bool LoopVectorizationLegality::canVectorizeUniformInnerLoop() {
+  // We handle a single inner loop of a single block, between the header and
+  // the latch of the outer loop.
+  if (TheLoop->getSubLoops().size() != 1)
+    return false;
+  Loop *Inner = TheLoop->getSubLoops()[0];
+  BasicBlock *Body = Inner->getHeader();
+  BasicBlock *Latch = TheLoop->getLoopLatch();
+  if (!Inner->empty() || Inner->getNumBlocks() != 1 ||
+      TheLoop->getNumBlocks() != 3 ||
+      Inner->getLoopPreheader() != TheLoop->getHeader() ||
+      Inner->getExitBlock() != Latch || Latch->getSinglePredecessor() != Body)
+    return false;
+
+  unsigned TC = SE->getSmallConstantTripCount(Inner, Body);
+  if (TC == 0 || TC > MaxUniformInnerTripCount) {
+    DEBUG(dbgs() << "LV: The inner loop does not have a small constant "
+          "trip count.\n");
+    return false;
+  }
+
+  // Find the values that are the same in every lane: those that only depend
+  // on each other and on values from outside the outer loop. Start with all
+  // candidates and drop the ones that use a varying value until nothing
+  // changes.
+  SmallPtrSet<Instruction*, 16> InnerUniforms;
+  for (BasicBlock::iterator it = Body->begin(), e = Body->end(); it != e; ++it)
+    if (isa<PHINode>(it) || isa<BinaryOperator>(it) || isa<CastInst>(it) ||
+        isa<CmpInst>(it) || isa<SelectInst>(it) ||
+        isa<GetElementPtrInst>(it) || isa<LoadInst>(it))
+      InnerUniforms.insert(it);
+
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (BasicBlock::iterator it = Body->begin(), e = Body->end(); it != e;
+         ++it) {
+      if (!InnerUniforms.count(it))
+        continue;
+      for (unsigned op = 0, oe = it->getNumOperands(); op != oe; ++op) {
+        Instruction *I = dyn_cast<Instruction>(it->getOperand(op));
+        if (I && TheLoop->contains(I) && !InnerUniforms.count(I)) {
+          InnerUniforms.erase(it);
+          Changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // The inner loop must exit at the same iteration in every lane.
+  BranchInst *Br = dyn_cast<BranchInst>(Body->getTerminator());
+  Instruction *Cond = Br && Br->isConditional() ?
+    dyn_cast<Instruction>(Br->getCondition()) : 0;
+  if (!Cond || !InnerUniforms.count(Cond)) {
+    DEBUG(dbgs() << "LV: The inner loop exit differs between the lanes.\n");
+    return false;
+  }
+
+  DEBUG(dbgs() << "LV: Found a uniform inner loop with trip count " << TC <<
+        ".\n");
+  InnerLoop = Inner;
+  InnerTripCount = TC;
+  Uniforms.insert(InnerUniforms.begin(), InnerUniforms.end());
+  return true;
+}
+
+bool LoopVectorizationLegality::isLaneDisjointStore(StoreInst *ST) {
+  if (!DL)
+    return false;
+
+  // The address is Start + LaneStride * i + InnerStride * j, where i is the
+  // outer and j the inner induction. Peel off the inner loop first.
+  const SCEV *S = SE->getSCEV(ST->getPointerOperand());
+  int64_t InnerStride = 0;
+  const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S);
+  if (AR && AR->getLoop() == InnerLoop) {
+    const SCEVConstant *Step =
+      dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+    if (!AR->isAffine() || !Step)
+      return false;
+    InnerStride = Step->getValue()->getSExtValue();
+    AR = dyn_cast<SCEVAddRecExpr>(AR->getStart());
+  }
+  if (!AR || AR->getLoop() != TheLoop || !AR->isAffine())
+    return false;
+  const SCEVConstant *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+  if (!Step)
+    return false;
+  int64_t LaneStride = Step->getValue()->getSExtValue();
+
+  // The bytes that one lane stores to over the whole inner loop must not
+  // reach those of the next lane.
+  int64_t Size = DL->getTypeStoreSize(ST->getValueOperand()->getType());
+  int64_t Span = abs64(InnerStride) * (InnerTripCount - 1) + Size;
+  return abs64(LaneStride) >= Span;
+}
+
 void LoopVectorizationLegality::collectLoopUniforms() {
   // We now know that the loop is vectorizable!
   // Collect variables that will remain uniform after vectorization.
@@ -2510,6 +3053,132 @@ void LoopVectorizationLegality::collectLoopUniforms() {
   }
 }
 
+void LoopVectorizationLegality::collectInterleaveGroups() {
+  InterleaveGroups.clear();
+  InterleaveGroupIdx.clear();
+
+  // We need the size of the elements to relate the strided addresses.
+  if (!EnableInterleavedMemAccesses || !DL)
+    return;
+
+  for (Loop::block_iterator bb = TheLoop->block_begin(),
+       be = TheLoop->block_end(); bb != be; ++bb) {
+    // A load in a predicated block does not execute on every iteration, so
+    // reading the whole record is not safe.
+    if (blockNeedsPredication(*bb))
+      continue;
+
+    // Collect the strided loads of the block, in program order.
+    SmallVector<LoadInst*, 8> Loads;
+    SmallVector<unsigned, 8> Factors;
+    for (BasicBlock::iterator it = (*bb)->begin(), e = (*bb)->end(); it != e;
+         ++it) {
+      LoadInst *LI = dyn_cast<LoadInst>(it);
+      if (!LI || !LI->isSimple())
+        continue;
+
+      Type *Ty = LI->getType();
+      if (!VectorType::isValidElementType(Ty) ||
+          DL->getTypeAllocSize(Ty) != DL->getTypeStoreSize(Ty))
+        continue;
+
+      Value *Ptr = LI->getPointerOperand();
+      if (isConsecutivePtr(Ptr) || isUniform(Ptr))
+        continue;
+
+      const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Ptr));
+      if (!AR || !AR->isAffine() || AR->getLoop() != TheLoop)
+        continue;
+      const SCEVConstant *Step =
+        dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+      if (!Step)
+        continue;
+
+      int64_t StepVal = Step->getValue()->getSExtValue();
+      int64_t Size = DL->getTypeAllocSize(Ty);
+      if (StepVal <= 0 || StepVal % Size)
+        continue;
+      int64_t Factor = StepVal / Size;
+      if (Factor < 2 || Factor > MaxInterleaveFactor)
+        continue;
+
+      Loads.push_back(LI);
+      Factors.push_back(Factor);
+    }
+
+    // Try each load as the first element of a record, and look for a load of
+    // every other element of the same record.
+    SmallPtrSet<LoadInst*, 8> Grouped;
+    for (unsigned i = 0, e = Loads.size(); i != e; ++i) {
+      LoadInst *Base = Loads[i];
+      if (Grouped.count(Base))
+        continue;
+
+      Type *Ty = Base->getType();
+      int64_t Size = DL->getTypeAllocSize(Ty);
+      const SCEV *BaseSCEV = SE->getSCEV(Base->getPointerOperand());
+
+      InterleaveGroup Group;
+      Group.Members.assign(Factors[i], 0);
+      Group.Members[0] = Base;
+      unsigned NumMembers = 1;
+      for (unsigned j = 0; j != e; ++j) {
+        LoadInst *LI = Loads[j];
+        if (Grouped.count(LI) || Factors[j] != Factors[i] ||
+            LI->getType() != Ty)
+          continue;
+        const SCEVConstant *Dist = dyn_cast<SCEVConstant>(
+          SE->getMinusSCEV(SE->getSCEV(LI->getPointerOperand()), BaseSCEV));
+        if (!Dist)
+          continue;
+        int64_t DistVal = Dist->getValue()->getSExtValue();
+        if (DistVal <= 0 || DistVal % Size || DistVal / Size >= Factors[i] ||
+            Group.Members[DistVal / Size])
+          continue;
+        Group.Members[DistVal / Size] = LI;
+        ++NumMembers;
+      }
+
+      // We only read whole records: a gap could be past the end of the
+      // object.
+      if (NumMembers != Factors[i])
+        continue;
+
+      // The wide load is emitted in place of the first member, so no store
+      // may come between the members.
+      LoadInst *First = 0;
+      for (unsigned j = 0; !First; ++j)
+        if (std::find(Group.Members.begin(), Group.Members.end(), Loads[j]) !=
+            Group.Members.end())
+          First = Loads[j];
+      bool HasWrite = false;
+      unsigned Seen = 0;
+      for (BasicBlock::iterator it = First; Seen != NumMembers; ++it) {
+        if (std::find(Group.Members.begin(), Group.Members.end(), it) !=
+            Group.Members.end())
+          ++Seen;
+        else if (it->mayWriteToMemory())
+          HasWrite = true;
+      }
+      if (HasWrite)
+        continue;
+
+      Group.InsertPos = First;
+      Group.Alignment = Base->getAlignment();
+      if (!Group.Alignment)
+        Group.Alignment = DL->getABITypeAlignment(Ty);
+
+      DEBUG(dbgs() << "LV: Found an interleaved group of " << NumMembers <<
+            " loads starting at:" << *Base << "\n");
+      for (unsigned k = 0; k != NumMembers; ++k) {
+        Grouped.insert(Group.Members[k]);
+        InterleaveGroupIdx[Group.Members[k]] = InterleaveGroups.size();
+      }
+      InterleaveGroups.push_back(Group);
+    }
+  }
+}
+
 AliasAnalysis::Location
 LoopVectorizationLegality::getLoadStoreLocation(Instruction *Inst) {
   if (StoreInst *Store = dyn_cast<StoreInst>(Inst))
@@ -2630,6 +3299,14 @@ bool LoopVectorizationLegality::canVectorizeMemory() {
       return false;
     }
 
+    // The lanes run the inner loop in lockstep, so a store of one lane must
+    // not overwrite what another lane stores.
+    if (InnerLoop && !isLaneDisjointStore(ST)) {
+      DEBUG(dbgs() << "LV: Found a store that the lanes may share:" << *ST <<
+            "\n");
+      return false;
+    }
+
     // If we did *not* see this pointer before, insert it to
     // the read-write list. At this phase it is only a 'write' list.
     if (Seen.insert(Ptr))
@@ -2646,8 +3323,10 @@ bool LoopVectorizationLegality::canVectorizeMemory() {
     // pointer. This only works if the index of A[i] is consecutive.
     // If the address of i is unknown (for example A[B[i]]) then we may
     // read a few words, modify, and write a few words, and some of the
-    // words may be written to the same address.
-    if (Seen.insert(Ptr) || 0 == isConsecutivePtr(Ptr))
+    // words may be written to the same address. Around a uniform inner loop
+    // each lane stores to its own locations, so a lane can only read back
+    // what it wrote itself.
+    if (Seen.insert(Ptr) || (!InnerLoop && 0 == isConsecutivePtr(Ptr)))
       Reads.insert(std::make_pair(Ptr, LD));
   }
 
@@ -2732,8 +3411,9 @@ bool LoopVectorizationLegality::canVectorizeMemory() {
         WriteObjects[*UI].push_back(Inst);
         continue;
       }
-      // Direct alias found.
-      if (!AA || dyn_cast<GlobalValue>(*UI) == NULL) {
+      // Direct alias found. The accesses of an inner loop range beyond what
+      // hasPossibleGlobalWriteReorder looks at.
+      if (!AA || dyn_cast<GlobalValue>(*UI) == NULL || InnerLoop) {
         DEBUG(dbgs() << "LV: Found a possible write-write reorder:"
               << **UI <<"\n");
         return false;
@@ -2776,7 +3456,7 @@ bool LoopVectorizationLegality::canVectorizeMemory() {
       if (WriteObjects[*UI].empty())
         continue;
       // Direct alias found.
-      if (!AA || dyn_cast<GlobalValue>(*UI) == NULL) {
+      if (!AA || dyn_cast<GlobalValue>(*UI) == NULL || InnerLoop) {
         DEBUG(dbgs() << "LV: Found a possible write-write reorder:"
               << **UI <<"\n");
         return false;
@@ -2800,6 +3480,14 @@ bool LoopVectorizationLegality::canVectorizeMemory() {
     TempObjects.clear();
   }
 
+  // The bounds of the pointers that an inner loop advances are not computed.
+  if (NeedRTCheck && InnerLoop) {
+    DEBUG(dbgs() << "LV: We can't check the pointers of a loop nest at " <<
+          "runtime.\n");
+    PtrRtCheck.reset();
+    return false;
+  }
+
   PtrRtCheck.Need = NeedRTCheck;
   if (NeedRTCheck && !CanDoRT) {
     DEBUG(dbgs() << "LV: We can't vectorize because we can't find " <<
@@ -2903,14 +3591,14 @@ bool LoopVectorizationLegality::AddReductionVar(PHINode *Phi,
       if (!ReduxDesc.IsReduction)
         return false;
 
-      if (Kind == RK_IntegerMinMax && (isa<ICmpInst>(U) ||
-                                       isa<SelectInst>(U)))
+      if ((Kind == RK_IntegerMinMax || Kind == RK_FloatMinMax) &&
+          (isa<CmpInst>(U) || isa<SelectInst>(U)))
           ++NumICmpSelectPatternInst;
 
       // Reductions of instructions such as Div, and Sub is only
       // possible if the LHS is the reduction variable.
       if (!U->isCommutative() && !isa<PHINode>(U) && !isa<SelectInst>(U) &&
-          !isa<ICmpInst>(U) && U->getOperand(0) != Iter)
+          !isa<CmpInst>(U) && U->getOperand(0) != Iter)
         return false;
 
       Iter = ReduxDesc.PatternLastInst;
@@ -2918,7 +3606,8 @@ bool LoopVectorizationLegality::AddReductionVar(PHINode *Phi,
 
     // This means we have seen one but not the other instruction of the
     // pattern or more than just a select and cmp.
-    if (Kind == RK_IntegerMinMax && NumICmpSelectPatternInst != 2)
+    if ((Kind == RK_IntegerMinMax || Kind == RK_FloatMinMax) &&
+        NumICmpSelectPatternInst != 2)
       return false;
 
     // We found a reduction var if we have reached the original
@@ -2946,14 +3635,14 @@ bool LoopVectorizationLegality::AddReductionVar(PHINode *Phi,
 LoopVectorizationLegality::ReductionInstDesc
 LoopVectorizationLegality::isMinMaxSelectCmpPattern(Instruction *I, ReductionInstDesc &Prev) {
 
-  assert((isa<ICmpInst>(I) || isa<SelectInst>(I)) &&
+  assert((isa<CmpInst>(I) || isa<SelectInst>(I)) &&
          "Expect a select instruction");
-  ICmpInst *Cmp = 0;
+  CmpInst *Cmp = 0;
   SelectInst *Select = 0;
 
   // We must handle the select(cmp()) as a single instruction. Advance to the
   // select.
-  if ((Cmp = dyn_cast<ICmpInst>(I))) {
+  if ((Cmp = dyn_cast<CmpInst>(I))) {
     if (!Cmp->hasOneUse() || !(Select = dyn_cast<SelectInst>(*I->use_begin())))
       return ReductionInstDesc(false, I);
     return ReductionInstDesc(Select, Prev.MinMaxKind);
@@ -2962,7 +3651,7 @@ LoopVectorizationLegality::isMinMaxSelectCmpPattern(Instruction *I, ReductionIns
   // Only handle single use cases for now.
   if (!(Select = dyn_cast<SelectInst>(I)))
     return ReductionInstDesc(false, I);
-  if (!(Cmp = dyn_cast<ICmpInst>(I->getOperand(0))))
+  if (!(Cmp = dyn_cast<CmpInst>(I->getOperand(0))))
     return ReductionInstDesc(false, I);
   if (!Cmp->hasOneUse())
     return ReductionInstDesc(false, I);
@@ -2970,6 +3659,31 @@ LoopVectorizationLegality::isMinMaxSelectCmpPattern(Instruction *I, ReductionIns
   Value *CmpLeft = Cmp->getOperand(0);
   Value *CmpRight = Cmp->getOperand(1);
 
+  // Look for a floating point min/max pattern. Whether the compare is ordered
+  // does not matter as the caller made sure that there are no NaNs.
+  if (isa<FCmpInst>(Cmp)) {
+    bool IsLess;
+    switch (Cmp->getPredicate()) {
+    default:
+      return ReductionInstDesc(false, I);
+    case CmpInst::FCMP_OLT: case CmpInst::FCMP_OLE:
+    case CmpInst::FCMP_ULT: case CmpInst::FCMP_ULE:
+      IsLess = true;
+      break;
+    case CmpInst::FCMP_OGT: case CmpInst::FCMP_OGE:
+    case CmpInst::FCMP_UGT: case CmpInst::FCMP_UGE:
+      IsLess = false;
+      break;
+    }
+    Value *TrueVal = Select->getTrueValue();
+    Value *FalseVal = Select->getFalseValue();
+    if (TrueVal == CmpLeft && FalseVal == CmpRight)
+      return ReductionInstDesc(Select, IsLess ? MRK_FloatMin : MRK_FloatMax);
+    if (TrueVal == CmpRight && FalseVal == CmpLeft)
+      return ReductionInstDesc(Select, IsLess ? MRK_FloatMax : MRK_FloatMin);
+    return ReductionInstDesc(false, I);
+  }
+
   // Look for a min/max pattern.
   if (m_UMin(m_Value(CmpLeft), m_Value(CmpRight)).match(Select))
     return ReductionInstDesc(Select, MRK_UIntMin);
@@ -2983,6 +3697,54 @@ LoopVectorizationLegality::isMinMaxSelectCmpPattern(Instruction *I, ReductionIns
   return ReductionInstDesc(false, I);
 }
 
+LoopVectorizationLegality::ReductionInstDesc
+LoopVectorizationLegality::isFindLastSelectPattern(Instruction *I) {
+  SelectInst *Select = dyn_cast<SelectInst>(I);
+  if (!Select || !Select->getType()->isIntegerTy() ||
+      !SE->isSCEVable(Select->getType()))
+    return ReductionInstDesc(false, I);
+
+  // One side of the select is the reduction phi, the other one has to be an
+  // induction that increases on every iteration. This makes the last selected
+  // value the largest one, so the lanes can be combined with a signed max.
+  // The induction must never reach the signed minimum, which is the value we
+  // use for lanes that never selected anything.
+  unsigned BitWidth = Select->getType()->getPrimitiveSizeInBits();
+  APInt NotFound = APInt::getSignedMinValue(BitWidth);
+  for (unsigned i = 0; i < 2; ++i) {
+    Value *IV = i ? Select->getFalseValue() : Select->getTrueValue();
+    Value *Other = i ? Select->getTrueValue() : Select->getFalseValue();
+    if (!isa<PHINode>(Other))
+      continue;
+    const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(IV));
+    if (!AR || AR->getLoop() != TheLoop)
+      continue;
+    const SCEVConstant *Step =
+      dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+    if (!Step || !Step->getValue()->getValue().isStrictlyPositive())
+      continue;
+    if (SE->getSignedRange(AR).contains(NotFound)) {
+      // SCEV gives up on the range if the trip count is wider than the
+      // induction, as for a truncated 64 bit induction. Bound the last value
+      // ourselves.
+      const SCEVConstant *MaxBE =
+        dyn_cast<SCEVConstant>(SE->getMaxBackedgeTakenCount(TheLoop));
+      ConstantRange StartRange = SE->getSignedRange(AR->getStart());
+      if (!MaxBE || StartRange.contains(NotFound) ||
+          MaxBE->getValue()->getValue().getActiveBits() > BitWidth)
+        continue;
+      unsigned ExtBitWidth = 2 * BitWidth + 1;
+      APInt Last = StartRange.getSignedMax().sext(ExtBitWidth) +
+        Step->getValue()->getValue().sext(ExtBitWidth) *
+        MaxBE->getValue()->getValue().zextOrTrunc(ExtBitWidth);
+      if (Last.sgt(APInt::getSignedMaxValue(BitWidth).sext(ExtBitWidth)))
+        continue;
+    }
+    return ReductionInstDesc(Select, MRK_SIntMax);
+  }
+  return ReductionInstDesc(false, I);
+}
+
 LoopVectorizationLegality::ReductionInstDesc
 LoopVectorizationLegality::isReductionInstr(Instruction *I,
                                             ReductionKind Kind,
@@ -2993,7 +3755,8 @@ LoopVectorizationLegality::isReductionInstr(Instruction *I,
   default:
     return ReductionInstDesc(false, I);
   case Instruction::PHI:
-      if (FP && (Kind != RK_FloatMult && Kind != RK_FloatAdd))
+      if (FP && (Kind != RK_FloatMult && Kind != RK_FloatAdd &&
+                 Kind != RK_FloatMinMax))
         return ReductionInstDesc(false, I);
     return ReductionInstDesc(I, Prev.MinMaxKind);
   case Instruction::Sub:
@@ -3011,9 +3774,13 @@ LoopVectorizationLegality::isReductionInstr(Instruction *I,
     return ReductionInstDesc(Kind == RK_FloatMult && FastMath, I);
   case Instruction::FAdd:
     return ReductionInstDesc(Kind == RK_FloatAdd && FastMath, I);
-  case Instruction::ICmp:
   case Instruction::Select:
-    if (Kind != RK_IntegerMinMax)
+    if (Kind == RK_IntegerFindLast)
+      return isFindLastSelectPattern(I);
+    // Fall through.
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+    if (Kind != RK_IntegerMinMax && Kind != RK_FloatMinMax)
       return ReductionInstDesc(false, I);
     return isMinMaxSelectCmpPattern(I, Prev);
   }
@@ -3165,14 +3932,35 @@ LoopVectorizationCostModel::selectVectorizationFactor(bool OptForSize,
     return Factor;
   }
 
-  float Cost = expectedCost(1);
+  // The iterations that don't fill a whole vector are left to the remainder.
+  // With a known trip count they are counted exactly.  With only a bound on
+  // the trip count, the average remainder is spread over that many
+  // iterations.  With no bound at all, it is amortized over a long loop.
+  unsigned EstimatedTC = TC;
+  if (EstimatedTC == 0) {
+    const SCEV *MaxBTC = SE->getMaxBackedgeTakenCount(TheLoop);
+    if (const SCEVConstant *C = dyn_cast<SCEVConstant>(MaxBTC))
+      if (C->getValue()->getValue().ult(UINT_MAX))
+        EstimatedTC = C->getValue()->getZExtValue() + 1;
+  }
+
+  float Cost = getCachedCost(1);
   unsigned Width = 1;
   DEBUG(dbgs() << "LV: Scalar loop costs: "<< (int)Cost << ".\n");
   for (unsigned i=2; i <= VF; i*=2) {
     // Notice that the vector loop needs to be executed less times, so
     // we need to divide the cost of the vector loops by the width of
     // the vector elements.
-    float VectorCost = expectedCost(i) / (float)i;
+    float VectorCost = getCachedCost(i) / (float)i;
+
+    // For short loops a wide vector can leave most of the work to the
+    // remainder, which may itself be vectorized with a narrower width.
+    if (EstimatedTC > 0) {
+      unsigned EpilogueVF;
+      float RemainderCost = getRemainderCost(i, TC, i / 2, EpilogueVF);
+      VectorCost = ((EstimatedTC / i) * getCachedCost(i) + RemainderCost) /
+        EstimatedTC;
+    }
     DEBUG(dbgs() << "LV: Vector loop of width "<< i << " costs: " <<
           (int)VectorCost << ".\n");
     if (VectorCost < Cost) {
@@ -3183,10 +3971,79 @@ LoopVectorizationCostModel::selectVectorizationFactor(bool OptForSize,
 
   DEBUG(dbgs() << "LV: Selecting VF = : "<< Width << ".\n");
   Factor.Width = Width;
-  Factor.Cost = Width * Cost;
+  Factor.Cost = getCachedCost(Width);
   return Factor;
 }
 
+unsigned LoopVectorizationCostModel::getCachedCost(unsigned VF) {
+  DenseMap<unsigned, unsigned>::iterator It = CostCache.find(VF);
+  if (It != CostCache.end())
+    return It->second;
+  unsigned Cost = expectedCost(VF);
+  CostCache[VF] = Cost;
+  return Cost;
+}
+
+float LoopVectorizationCostModel::getRemainderCost(unsigned Step, unsigned TC,
+                                                   unsigned MaxEpilogueVF,
+                                                   unsigned &EpilogueVF) {
+  // The remainders to average over: the one we know, or all of them.
+  unsigned First = TC ? TC % Step : 0;
+  unsigned Last = TC ? First : Step - 1;
+  unsigned NumRemainders = Last - First + 1;
+  float ScalarCost = getCachedCost(1);
+
+  float Best = 0;
+  for (unsigned R = First; R <= Last; ++R)
+    Best += R * ScalarCost;
+  Best /= NumRemainders;
+  EpilogueVF = 1;
+  if (!EnableEpilogueVectorization)
+    return Best;
+
+  // An epilogue loop repeats the runtime pointer checks of the vector loop.
+  unsigned EntryCost = EpilogueEntryCost;
+  if (Legal->getRuntimePointerCheck()->Need) {
+    unsigned NumPtrs = Legal->getRuntimePointerCheck()->Pointers.size();
+    EntryCost += 2 * NumPtrs * (NumPtrs - 1);
+  }
+
+  for (unsigned VF = 2; VF <= MaxEpilogueVF && VF < Step; VF *= 2) {
+    float VectorCost = getCachedCost(VF);
+    float Cost = 0;
+    for (unsigned R = First; R <= Last; ++R)
+      Cost += (R / VF) * VectorCost + (R % VF) * ScalarCost;
+    Cost = Cost / NumRemainders + EntryCost;
+    if (Cost < Best) {
+      Best = Cost;
+      EpilogueVF = VF;
+    }
+  }
+  return Best;
+}
+
+/// The vectorization factor was chosen for the iterations it leaves to the
+/// remainder of a loop with trip count \p TC.  Don't unroll so far that more
+/// of them are left over.
+static unsigned clampUnrollToTripCount(unsigned UF, unsigned VF, unsigned TC) {
+  if (TC > 1)
+    while (UF > 1 && TC % (VF * UF) > TC % VF)
+      --UF;
+  return UF;
+}
+
+unsigned LoopVectorizationCostModel::selectEpilogueFactor(unsigned VF,
+                                                          unsigned UF) {
+  if (!EnableEpilogueVectorization || VF * UF <= 2)
+    return 1;
+
+  unsigned TC = SE->getSmallConstantTripCount(TheLoop, TheLoop->getLoopLatch());
+  unsigned EpilogueVF;
+  getRemainderCost(VF * UF, TC, VF, EpilogueVF);
+  DEBUG(dbgs() << "LV: Selecting epilogue VF = " << EpilogueVF << ".\n");
+  return EpilogueVF;
+}
+
 unsigned LoopVectorizationCostModel::getWidestType() {
   unsigned MaxWidth = 8;
 
@@ -3295,7 +4152,7 @@ LoopVectorizationCostModel::selectUnrollFactor(bool OptForSize,
 
   if (Legal->getReductionVars()->size()) {
     DEBUG(dbgs() << "LV: Unrolling because of reductions. \n");
-    return UF;
+    return clampUnrollToTripCount(UF, VF, TC);
   }
 
   // We want to unroll tiny loops in order to reduce the loop overhead.
@@ -3306,7 +4163,7 @@ LoopVectorizationCostModel::selectUnrollFactor(bool OptForSize,
   if (LoopCost < 20) {
     DEBUG(dbgs() << "LV: Unrolling to reduce branch cost. \n");
     unsigned NewUF = 20/LoopCost + 1;
-    return std::min(NewUF, UF);
+    return clampUnrollToTripCount(std::min(NewUF, UF), VF, TC);
   }
 
   DEBUG(dbgs() << "LV: Not Unrolling. \n");
@@ -3435,13 +4292,18 @@ unsigned LoopVectorizationCostModel::expectedCost(unsigned VF) {
     unsigned BlockCost = 0;
     BasicBlock *BB = *bb;
 
+    // The body of a uniform inner loop runs once per inner iteration.
+    Loop *Inner = Legal->getInnerLoop();
+    unsigned Weight = Inner && Inner->contains(BB) ?
+      Legal->getInnerTripCount() : 1;
+
     // For each instruction in the old loop.
     for (BasicBlock::iterator it = BB->begin(), e = BB->end(); it != e; ++it) {
       // Skip dbg intrinsics.
       if (isa<DbgInfoIntrinsic>(it))
         continue;
 
-      unsigned C = getInstructionCost(it, VF);
+      unsigned C = getInstructionCost(it, VF) * Weight;
       Cost += C;
       DEBUG(dbgs() << "LV: Found an estimated cost of "<< C <<" for VF " <<
             VF << " For instruction: "<< *it << "\n");
@@ -3548,6 +4410,19 @@ LoopVectorizationCostModel::getInstructionCost(Instruction *I, unsigned VF) {
       return TTI.getAddressComputationCost(VectorTy) +
         TTI.getMemoryOpCost(I->getOpcode(), VectorTy, Alignment, AS);
 
+    // Interleaved loads. The cost of the whole group is charged to the
+    // member that the wide load is emitted for.
+    if (LI)
+      if (const LoopVectorizationLegality::InterleaveGroup *Group =
+            Legal->getInterleaveGroup(LI)) {
+        if (Group->InsertPos != LI)
+          return 0;
+        return TTI.getAddressComputationCost(VectorTy) +
+          TTI.getInterleavedMemoryOpCost(I->getOpcode(), VectorTy,
+                                         Group->getFactor(), Group->Alignment,
+                                         AS);
+      }
+
     // Scalarized loads/stores.
     int Stride = Legal->isConsecutivePtr(Ptr);
     bool Reverse = Stride < 0;
@@ -9,7 +9,9 @@
 // This pass implements the Bottom Up SLP vectorizer. It detects consecutive
 // stores that can be put together into vector-stores. Next, it attempts to
 // construct vectorizable tree using the use-def chains. If a profitable tree
-// was found, the SLP vectorizer performs vectorization on the tree.
+// was found, the SLP vectorizer performs vectorization on the tree. Trees are
+// also seeded from horizontal reductions and from insertelement sequences
+// that build a whole vector.
 //
 // The pass is inspired by the work described in the paper:
 //  "Loop-Aware SLP in GCC" by Ira Rosen, Dorit Nuzman, Ayal Zaks.
@@ -25,7 +27,9 @@
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
@@ -35,6 +39,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <map>
 
 using namespace llvm;
@@ -43,6 +48,10 @@ static cl::opt<int>
 SLPCostThreshold("slp-threshold", cl::init(0), cl::Hidden,
                  cl::desc("Only vectorize trees if the gain is above this "
                           "number. (gain = -cost of vectorization)"));
+
+/// Limits the depth of the reduction trees that we look at.
+static const unsigned ReductionMaxDepth = 32;
+
 namespace {
 
 /// The SLPVectorizer Pass.
@@ -144,6 +153,15 @@ private:
   /// vectorization chain.
   bool vectorizeReductions(BasicBlock *BB, BoUpSLP &R);
 
+  /// \brief Try to vectorize the leaves of the horizontal reduction (such as
+  /// a[0] + a[1] + ... + a[7]) whose last operation is \p Root, and to reduce
+  /// them with log2(VF) vector operations.
+  bool vectorizeHorReduction(BinaryOperator *Root, BoUpSLP &R);
+
+  /// \brief Try to vectorize the scalars that the insertelement sequence ending
+  /// at \p IE puts into a vector.
+  bool vectorizeBuildVector(InsertElementInst *IE, BoUpSLP &R);
+
 private:
   StoreListMap StoreRefs;
 };
@@ -260,6 +278,19 @@ bool SLPVectorizer::vectorizeReductions(BasicBlock *BB, BoUpSLP &R) {
       continue;
     }
 
+    // Try to vectorize horizontal reductions.
+    if (BinaryOperator *BI = dyn_cast<BinaryOperator>(it)) {
+      Changed |= vectorizeHorReduction(BI, R);
+      continue;
+    }
+
+    // Try to vectorize the scalars of a vector that is built element by
+    // element.
+    if (InsertElementInst *IE = dyn_cast<InsertElementInst>(it)) {
+      Changed |= vectorizeBuildVector(IE, R);
+      continue;
+    }
+
     // Try to vectorize trees that start at compare instructions.
     if (CmpInst *CI = dyn_cast<CmpInst>(it)) {
       if (tryToVectorizePair(CI->getOperand(0), CI->getOperand(1), R)) {
@@ -276,6 +307,173 @@ bool SLPVectorizer::vectorizeReductions(BasicBlock *BB, BoUpSLP &R) {
   return Changed;
 }
 
+/// \returns true if \p V is an operation of a reduction with \p Opcode in
+/// \p BB that may be reassociated.
+static bool isReductionOp(Value *V, unsigned Opcode, BasicBlock *BB) {
+  BinaryOperator *BI = dyn_cast<BinaryOperator>(V);
+  return BI && BI->getOpcode() == Opcode && BI->getParent() == BB &&
+    BI->isAssociative() && BI->isCommutative();
+}
+
+/// \brief Collect the values that the reduction tree at \p BI combines, from
+/// left to right.
+static void collectReductionLeaves(BinaryOperator *BI, unsigned Depth,
+                                   SmallVectorImpl<Value *> &Leaves) {
+  for (unsigned i = 0; i < 2; ++i) {
+    Value *Op = BI->getOperand(i);
+    if (Depth < ReductionMaxDepth && Op->hasOneUse() &&
+        isReductionOp(Op, BI->getOpcode(), BI->getParent()))
+      collectReductionLeaves(cast<BinaryOperator>(Op), Depth + 1, Leaves);
+    else
+      Leaves.push_back(Op);
+  }
+}
+
+/// \brief Emit one step of the reduction with the same operation and
+/// fast-math flags as \p Root.
+static Value *createReductionOp(IRBuilder<> &Builder, BinaryOperator *Root,
+                                Value *LHS, Value *RHS) {
+  Value *V = Builder.CreateBinOp(Root->getOpcode(), LHS, RHS, "bin.rdx");
+  if (isa<FPMathOperator>(Root))
+    if (Instruction *I = dyn_cast<Instruction>(V))
+      I->setFastMathFlags(Root->getFastMathFlags());
+  return V;
+}
+
+bool SLPVectorizer::vectorizeHorReduction(BinaryOperator *Root, BoUpSLP &R) {
+  unsigned Opcode = Root->getOpcode();
+  BasicBlock *BB = Root->getParent();
+  if (!isReductionOp(Root, Opcode, BB))
+    return false;
+
+  // Only start at the last operation of the reduction.
+  if (Root->hasOneUse() && isReductionOp(*Root->use_begin(), Opcode, BB))
+    return false;
+
+  Type *Ty = Root->getType();
+  if (Ty->isVectorTy())
+    return false;
+  unsigned Sz = DL->getTypeSizeInBits(Ty);
+  unsigned VF = BoUpSLP::MinVecRegSize / Sz;
+  if (!isPowerOf2_32(Sz) || VF < 2)
+    return false;
+
+  SmallVector<Value *, 16> Leaves;
+  collectReductionLeaves(Root, 0, Leaves);
+  // The first operation of a chain often has its operands swapped, as in
+  // a[1] + a[0] + a[2]. Restore the order of consecutive loads.
+  if (R.isConsecutiveAccess(Leaves[1], Leaves[0]))
+    std::swap(Leaves[0], Leaves[1]);
+  unsigned NumGroups = Leaves.size() / VF;
+  if (!NumGroups)
+    return false;
+
+  DEBUG(dbgs() << "SLP: Found a reduction of " << Leaves.size() <<
+        " values at " << *Root << "\n");
+
+  // Calculate the cost of vectorizing every group of VF leaves, and of
+  // reducing the vectors instead of the scalars.
+  int Cost = 0;
+  for (unsigned g = 0; g < NumGroups; ++g) {
+    Cost += R.getTreeCost(makeArrayRef(Leaves).slice(g * VF, VF));
+    if (Cost >= BoUpSLP::max_cost)
+      return false;
+  }
+
+  VectorType *VecTy = VectorType::get(Ty, VF);
+  unsigned NumShuffles = Log2_32(VF);
+  int VecRdxCost = (NumGroups - 1 + NumShuffles) *
+    TTI->getArithmeticInstrCost(Opcode, VecTy) + NumShuffles *
+    TTI->getShuffleCost(TargetTransformInfo::SK_ExtractSubvector, VecTy,
+                        VF / 2) +
+    TTI->getVectorInstrCost(Instruction::ExtractElement, VecTy, 0);
+  int ScalarRdxCost = (NumGroups * VF - 1) *
+    TTI->getArithmeticInstrCost(Opcode, Ty);
+  Cost += VecRdxCost - ScalarRdxCost;
+  DEBUG(dbgs() << "SLP: Found cost=" << Cost << " for the reduction.\n");
+  if (Cost >= -SLPCostThreshold)
+    return false;
+
+  // Vectorize the groups. The tree has to be analyzed again right before
+  // it is vectorized.
+  SmallVector<Value *, 4> Vecs;
+  for (unsigned g = 0; g < NumGroups; ++g) {
+    ArrayRef<Value *> Group = makeArrayRef(Leaves).slice(g * VF, VF);
+    R.getTreeCost(Group);
+    Vecs.push_back(R.vectorizeTree(Group, VF));
+  }
+
+  IRBuilder<> Builder(Root);
+  Value *TmpVec = Vecs[0];
+  for (unsigned g = 1; g < NumGroups; ++g)
+    TmpVec = createReductionOp(Builder, Root, TmpVec, Vecs[g]);
+
+  // Reduce the vector using log2(VF) shuffles, moving the upper half of the
+  // live elements to the lower half each round.
+  SmallVector<Constant *, 16> ShuffleMask(VF, 0);
+  for (unsigned i = VF; i != 1; i >>= 1) {
+    for (unsigned j = 0; j != i/2; ++j)
+      ShuffleMask[j] = Builder.getInt32(i/2 + j);
+    std::fill(&ShuffleMask[i/2], ShuffleMask.end(),
+              UndefValue::get(Builder.getInt32Ty()));
+    Value *Shuf =
+      Builder.CreateShuffleVector(TmpVec, UndefValue::get(VecTy),
+                                  ConstantVector::get(ShuffleMask),
+                                  "rdx.shuf");
+    TmpVec = createReductionOp(Builder, Root, TmpVec, Shuf);
+  }
+  Value *Res = Builder.CreateExtractElement(TmpVec, Builder.getInt32(0));
+
+  // Add the leaves that did not fill a whole vector.
+  for (unsigned i = NumGroups * VF, e = Leaves.size(); i < e; ++i)
+    Res = createReductionOp(Builder, Root, Res, Leaves[i]);
+
+  Root->replaceAllUsesWith(Res);
+  return true;
+}
+
+bool SLPVectorizer::vectorizeBuildVector(InsertElementInst *IE, BoUpSLP &R) {
+  // Only start at the last insertelement of the sequence.
+  if (IE->hasOneUse() && isa<InsertElementInst>(*IE->use_begin()))
+    return false;
+
+  VectorType *VecTy = IE->getType();
+  unsigned VF = VecTy->getNumElements();
+  if (VF < 2 || VecTy->getElementType()->isVectorTy())
+    return false;
+
+  // Walk up the sequence. Every lane must be written exactly once, by an
+  // instruction from this block, and the sequence must start with undef.
+  SmallVector<Value *, 16> Scalars(VF, (Value *)0);
+  Value *V = IE;
+  for (unsigned i = 0; i < VF; ++i) {
+    InsertElementInst *Ins = dyn_cast<InsertElementInst>(V);
+    if (!Ins || (Ins != IE && !Ins->hasOneUse()))
+      return false;
+    ConstantInt *Idx = dyn_cast<ConstantInt>(Ins->getOperand(2));
+    if (!Idx || Idx->getZExtValue() >= VF || Scalars[Idx->getZExtValue()])
+      return false;
+    Instruction *Scalar = dyn_cast<Instruction>(Ins->getOperand(1));
+    if (!Scalar || Scalar->getParent() != IE->getParent())
+      return false;
+    Scalars[Idx->getZExtValue()] = Scalar;
+    V = Ins->getOperand(0);
+  }
+  if (!isa<UndefValue>(V))
+    return false;
+
+  // We save the cost of the insertelement instructions.
+  int Cost = R.getTreeCost(Scalars) - R.getScalarizationCost(Scalars);
+  DEBUG(dbgs() << "SLP: Found cost=" << Cost << " for a vector built from " <<
+        VF << " scalars.\n");
+  if (Cost >= -SLPCostThreshold)
+    return false;
+
+  DEBUG(dbgs() << "SLP: Vectorizing the build vector.\n");
+  IE->replaceAllUsesWith(R.vectorizeTree(Scalars, VF));
+  return true;
+}
+
 bool SLPVectorizer::vectorizeStoreChains(BoUpSLP &R) {
   bool Changed = false;
   // Attempt to sort and vectorize each of the store-groups.
@@ -38,10 +38,40 @@
 
 using namespace llvm;
 
-static const unsigned MinVecRegSize = 128;
-
 static const unsigned RecursionMaxDepth = 6;
 
+/// \returns the opcode that can be combined with \p Opcode in an alternating
+/// add/sub sequence, or zero.
+static unsigned getAltOpcode(unsigned Opcode) {
+  switch (Opcode) {
+  case Instruction::Add:  return Instruction::Sub;
+  case Instruction::Sub:  return Instruction::Add;
+  case Instruction::FAdd: return Instruction::FSub;
+  case Instruction::FSub: return Instruction::FAdd;
+  default: return 0;
+  }
+}
+
+/// \returns the opcode of the instructions in \p VL if they all have the same
+/// one, or zero. Lists of mixed add and sub (or fadd and fsub) instructions
+/// are also accepted and return the opcode of the first element. In that case
+/// \p AltOpcode is set to the other opcode, otherwise it is zero.
+static unsigned getSameOpcode(ArrayRef<Value *> VL, unsigned &AltOpcode) {
+  AltOpcode = 0;
+  Instruction *I0 = dyn_cast<Instruction>(VL[0]);
+  if (!I0) return 0;
+  unsigned Opcode = I0->getOpcode();
+  for (unsigned i = 1, e = VL.size(); i < e; ++i) {
+    Instruction *I = dyn_cast<Instruction>(VL[i]);
+    if (!I) return 0;
+    unsigned Op = I->getOpcode();
+    if (Op == Opcode || Op == AltOpcode) continue;
+    if (AltOpcode || Op != getAltOpcode(Opcode)) return 0;
+    AltOpcode = Op;
+  }
+  return Opcode;
+}
+
 namespace llvm {
 
 BoUpSLP::BoUpSLP(BasicBlock *Bb, ScalarEvolution *S, DataLayout *Dl,
@@ -304,12 +334,10 @@ void BoUpSLP::getTreeUses_rec(ArrayRef<Value *> VL, unsigned Depth) {
   Instruction *VL0 = dyn_cast<Instruction>(VL[0]);
   if (!VL0) return;
 
-  unsigned Opcode = VL0->getOpcode();
-  for (unsigned i = 0, e = VL.size(); i < e; ++i) {
-    Instruction *I = dyn_cast<Instruction>(VL[i]);
-    // If not all of the instructions are identical then we have to scalarize.
-    if (!I || Opcode != I->getOpcode()) return;
-  }
+  // If not all of the instructions are identical then we have to scalarize.
+  unsigned AltOpcode;
+  unsigned Opcode = getSameOpcode(VL, AltOpcode);
+  if (!Opcode) return;
 
   // Mark instructions with multiple users.
   for (unsigned i = 0, e = VL.size(); i < e; ++i) {
@@ -431,12 +459,10 @@ int BoUpSLP::getTreeCost_rec(ArrayRef<Value *> VL, unsigned Depth) {
   if (!VL0) return getScalarizationCost(VecTy);
   assert(VL0->getParent() == BB && "Wrong BB");
 
-  unsigned Opcode = VL0->getOpcode();
-  for (unsigned i = 0, e = VL.size(); i < e; ++i) {
-    Instruction *I = dyn_cast<Instruction>(VL[i]);
-    // If not all of the instructions are identical then we have to scalarize.
-    if (!I || Opcode != I->getOpcode()) return getScalarizationCost(VecTy);
-  }
+  // If not all of the instructions are identical then we have to scalarize.
+  unsigned AltOpcode;
+  unsigned Opcode = getSameOpcode(VL, AltOpcode);
+  if (!Opcode) return getScalarizationCost(VecTy);
 
   // Check if it is safe to sink the loads or the stores.
   if (Opcode == Instruction::Load || Opcode == Instruction::Store) {
@@ -523,10 +549,17 @@ int BoUpSLP::getTreeCost_rec(ArrayRef<Value *> VL, unsigned Depth) {
     }
 
     // Calculate the cost of this instruction.
-    int ScalarCost = VecTy->getNumElements() *
-      TTI->getArithmeticInstrCost(Opcode, ScalarTy);
+    int ScalarCost = 0;
+    for (unsigned j = 0; j < VL.size(); ++j)
+      ScalarCost += TTI->getArithmeticInstrCost(
+        cast<Instruction>(VL[j])->getOpcode(), ScalarTy);
 
+    // Alternating add/sub lanes are computed with both vector opcodes and
+    // blended together with a shuffle.
     int VecCost = TTI->getArithmeticInstrCost(Opcode, VecTy);
+    if (AltOpcode)
+      VecCost += TTI->getArithmeticInstrCost(AltOpcode, VecTy) +
+        TTI->getShuffleCost(TargetTransformInfo::SK_Alternate, VecTy, 0);
     Cost += (VecCost - ScalarCost);
     return Cost;
   }
@@ -592,6 +625,7 @@ Value *BoUpSLP::vectorizeTree(ArrayRef<Value *> VL, int VF) {
   // before we can do any analysis.
   numberInstructions();
   MustScalarize.clear();
+  VectorizedValues.clear();
   return V;
 }
 
@@ -622,12 +656,10 @@ Value *BoUpSLP::vectorizeTree_rec(ArrayRef<Value *> VL, int VF) {
 
   if (VectorizedValues.count(VL0)) return VectorizedValues[VL0];
 
-  unsigned Opcode = VL0->getOpcode();
-  for (unsigned i = 0, e = VF; i < e; ++i) {
-    Instruction *I = dyn_cast<Instruction>(VL[i]);
-    // If not all of the instructions are identical then we have to scalarize.
-    if (!I || Opcode != I->getOpcode()) return Scalarize(VL, VecTy);
-  }
+  // If not all of the instructions are identical then we have to scalarize.
+  unsigned AltOpcode;
+  unsigned Opcode = getSameOpcode(VL.slice(0, VF), AltOpcode);
+  if (!Opcode) return Scalarize(VL, VecTy);
 
   switch (Opcode) {
   case Instruction::ZExt:
@@ -681,6 +713,16 @@ Value *BoUpSLP::vectorizeTree_rec(ArrayRef<Value *> VL, int VF) {
     IRBuilder<> Builder(GetLastInstr(VL, VF));
     BinaryOperator *BinOp = cast<BinaryOperator>(VL0);
     Value *V = Builder.CreateBinOp(BinOp->getOpcode(), RHS,LHS);
+    if (AltOpcode) {
+      // Take each lane from the vector that matches its scalar opcode.
+      Value *AltV = Builder.CreateBinOp((Instruction::BinaryOps)AltOpcode,
+                                        RHS, LHS);
+      SmallVector<Constant*, 8> Mask;
+      for (int i = 0; i < VF; ++i)
+        Mask.push_back(Builder.getInt32(
+          cast<Instruction>(VL[i])->getOpcode() == Opcode ? i : VF + i));
+      V = Builder.CreateShuffleVector(V, AltV, ConstantVector::get(Mask));
+    }
     VectorizedValues[VL0] = V;
     return V;
   }
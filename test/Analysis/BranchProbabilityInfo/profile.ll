@@ -0,0 +1,29 @@
+; Edge counts for @test1: 10 entries, 10 exits and 20 back edges.
+; RUN: printf '\004\000\000\000\004\000\000\000\012\000\000\000\012\000\000\000\012\000\000\000\024\000\000\000' > %t.prof
+; RUN: opt < %s -profile-loader -profile-info-file %t.prof -analyze -branch-prob \
+; RUN:     | FileCheck %s
+
+; Check that the edge counts of a loaded profile take precedence over the loop
+; branch heuristics.
+
+define i32 @test1(i32 %i, i32* %a) {
+; CHECK: Printing analysis {{.*}} for function 'test1'
+entry:
+  br label %body
+; CHECK: edge entry -> body probability is 16 / 16 = 100%
+
+body:
+  %iv = phi i32 [ 0, %entry ], [ %next, %body ]
+  %base = phi i32 [ 0, %entry ], [ %sum, %body ]
+  %arrayidx = getelementptr inbounds i32* %a, i32 %iv
+  %0 = load i32* %arrayidx
+  %sum = add nsw i32 %0, %base
+  %next = add i32 %iv, 1
+  %exitcond = icmp eq i32 %next, %i
+  br i1 %exitcond, label %exit, label %body
+; CHECK: edge body -> exit probability is 10 / 30
+; CHECK: edge body -> body probability is 20 / 30
+
+exit:
+  ret i32 %sum
+}
@@ -179,6 +179,18 @@ define void @f30() "cpu"="cortex-a8"
         ret void;
 }
 
+define void @f31() cold
+; CHECK: define void @f31() #21
+{
+        ret void;
+}
+
+define void @f32() hot
+; CHECK: define void @f32() #22
+{
+        ret void;
+}
+
 ; CHECK: attributes #0 = { noreturn }
 ; CHECK: attributes #1 = { nounwind }
 ; CHECK: attributes #2 = { readnone }
@@ -200,3 +212,5 @@ define void @f30() "cpu"="cortex-a8"
 ; CHECK: attributes #18 = { sanitize_thread }
 ; CHECK: attributes #19 = { sanitize_memory }
 ; CHECK: attributes #20 = { "cpu"="cortex-a8" }
+; CHECK: attributes #21 = { cold }
+; CHECK: attributes #22 = { hot }
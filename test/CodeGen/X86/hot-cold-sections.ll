@@ -0,0 +1,46 @@
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-linux-gnu -ffunction-sections \
+; RUN:     | FileCheck %s -check-prefix=SECTIONS
+
+; Check that functions marked hot or cold are grouped in .text.hot and
+; .text.unlikely on ELF targets.
+
+define void @plain() {
+  ret void
+}
+; CHECK: .text
+; CHECK-NOT: .section
+; CHECK: plain:
+; SECTIONS: .section .text.plain,"ax",@progbits
+; SECTIONS: plain:
+
+define void @hot() hot {
+  ret void
+}
+; CHECK: .section .text.hot,"ax",@progbits
+; CHECK: hot:
+; SECTIONS: .section .text.hot.hot,"ax",@progbits
+; SECTIONS: hot:
+
+define void @cold() cold {
+  ret void
+}
+; CHECK: .section .text.unlikely,"ax",@progbits
+; CHECK: cold:
+; SECTIONS: .section .text.unlikely.cold,"ax",@progbits
+; SECTIONS: cold:
+
+define linkonce_odr void @cold_odr() cold {
+  ret void
+}
+; CHECK: .section .text.unlikely.cold_odr,"axG",@progbits,cold_odr,comdat
+; CHECK: cold_odr:
+; SECTIONS: .section .text.unlikely.cold_odr,"axG",@progbits,cold_odr,comdat
+; SECTIONS: cold_odr:
+
+; An explicit section wins.
+define void @cold_explicit() cold section ".text.mine" {
+  ret void
+}
+; CHECK: .section .text.mine,"ax",@progbits
+; CHECK: cold_explicit:
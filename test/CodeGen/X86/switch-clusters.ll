@@ -0,0 +1,136 @@
+; RUN: llc -mtriple=x86_64-linux-gnu < %s | FileCheck %s
+
+; The cases are partitioned into three jump tables and three single cases,
+; and the search tree only splits between those clusters.  Without branch
+; weights, it is balanced by the number of clusters.
+
+; CHECK: clusters:
+; CHECK: cmpl $149, %edi
+; CHECK: .LJTI0_0
+; CHECK: .LJTI0_1
+; CHECK: .LJTI0_2
+; CHECK-NOT: .LJTI0_3
+
+define void @clusters(i32 %x) nounwind {
+entry:
+  switch i32 %x, label %return [
+    i32 0, label %bb0
+    i32 1, label %bb1
+    i32 2, label %bb2
+    i32 3, label %bb3
+    i32 4, label %bb4
+    i32 5, label %bb5
+    i32 6, label %bb6
+    i32 7, label %bb0
+    i32 50, label %bb1
+    i32 100, label %bb2
+    i32 101, label %bb3
+    i32 102, label %bb4
+    i32 103, label %bb5
+    i32 104, label %bb6
+    i32 105, label %bb0
+    i32 106, label %bb1
+    i32 107, label %bb2
+    i32 150, label %bb3
+    i32 200, label %bb4
+    i32 300, label %bb5
+    i32 301, label %bb6
+    i32 302, label %bb0
+    i32 303, label %bb1
+    i32 304, label %bb2
+    i32 305, label %bb3
+    i32 306, label %bb4
+    i32 307, label %bb5
+  ]
+bb0:
+  tail call void @g(i32 0)
+  br label %return
+bb1:
+  tail call void @g(i32 1)
+  br label %return
+bb2:
+  tail call void @g(i32 2)
+  br label %return
+bb3:
+  tail call void @g(i32 3)
+  br label %return
+bb4:
+  tail call void @g(i32 4)
+  br label %return
+bb5:
+  tail call void @g(i32 5)
+  br label %return
+bb6:
+  tail call void @g(i32 6)
+  br label %return
+return:
+  ret void
+}
+
+; With branch weights, the tree is balanced by weight instead, and the hot
+; case 50 moves closer to the root.
+
+; CHECK: weighted:
+; CHECK: cmpl $99, %edi
+; CHECK-NEXT: ja
+; CHECK: cmpl $49, %edi
+
+define void @weighted(i32 %x) nounwind {
+entry:
+  switch i32 %x, label %return [
+    i32 0, label %bb0
+    i32 1, label %bb1
+    i32 2, label %bb2
+    i32 3, label %bb3
+    i32 4, label %bb4
+    i32 5, label %bb5
+    i32 6, label %bb6
+    i32 7, label %bb0
+    i32 50, label %bb1
+    i32 100, label %bb2
+    i32 101, label %bb3
+    i32 102, label %bb4
+    i32 103, label %bb5
+    i32 104, label %bb6
+    i32 105, label %bb0
+    i32 106, label %bb1
+    i32 107, label %bb2
+    i32 150, label %bb3
+    i32 200, label %bb4
+    i32 300, label %bb5
+    i32 301, label %bb6
+    i32 302, label %bb0
+    i32 303, label %bb1
+    i32 304, label %bb2
+    i32 305, label %bb3
+    i32 306, label %bb4
+    i32 307, label %bb5
+  ], !prof !0
+bb0:
+  tail call void @g(i32 0)
+  br label %return
+bb1:
+  tail call void @g(i32 1)
+  br label %return
+bb2:
+  tail call void @g(i32 2)
+  br label %return
+bb3:
+  tail call void @g(i32 3)
+  br label %return
+bb4:
+  tail call void @g(i32 4)
+  br label %return
+bb5:
+  tail call void @g(i32 5)
+  br label %return
+bb6:
+  tail call void @g(i32 6)
+  br label %return
+return:
+  ret void
+}
+
+declare void @g(i32)
+
+!0 = metadata !{metadata !"branch_weights", i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1000, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1, i32 1}
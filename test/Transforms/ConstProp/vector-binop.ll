@@ -0,0 +1,32 @@
+; RUN: opt < %s -constprop -S | FileCheck %s
+
+; Binary operators on two constant data vectors are folded in bulk; elements
+; that don't fold to a plain value fall back to the elementwise folder.
+
+define <4 x i32> @add() {
+; CHECK: @add
+; CHECK: ret <4 x i32> <i32 6, i32 8, i32 0, i32 -2>
+  %r = add <4 x i32> <i32 1, i32 2, i32 -1, i32 -1>, <i32 5, i32 6, i32 1, i32 -1>
+  ret <4 x i32> %r
+}
+
+define <4 x i8> @ashr() {
+; CHECK: @ashr
+; CHECK: ret <4 x i8> <i8 -64, i8 1, i8 -1, i8 0>
+  %r = ashr <4 x i8> <i8 -128, i8 2, i8 -1, i8 127>, <i8 1, i8 1, i8 7, i8 7>
+  ret <4 x i8> %r
+}
+
+define <2 x i16> @udiv_by_zero() {
+; CHECK: @udiv_by_zero
+; CHECK: ret <2 x i16> <i16 3, i16 undef>
+  %r = udiv <2 x i16> <i16 7, i16 7>, <i16 2, i16 0>
+  ret <2 x i16> %r
+}
+
+define <2 x double> @fmul() {
+; CHECK: @fmul
+; CHECK: ret <2 x double> <double 3.000000e+00, double -1.000000e+00>
+  %r = fmul <2 x double> <double 1.5, double 0.5>, <double 2.0, double -2.0>
+  ret <2 x double> %r
+}
@@ -0,0 +1,29 @@
+; RUN: opt < %s -correlated-propagation -S | FileCheck %s
+; RUN: opt < %s -correlated-propagation -lvi-max-solver-steps=1 -S \
+; RUN:     | FileCheck %s -check-prefix=BUDGET
+
+; Proving %c true requires solving the value of %x in %b2, which in turn needs
+; its value in %b1.  The solver must come back to %b2 once %b1 is known.  With
+; a budget of one step the query gives up and %c is left alone.
+define i1 @chain(i32 %x) {
+; CHECK: @chain
+; BUDGET: @chain
+entry:
+  %cmp = icmp eq i32 %x, 0
+  br i1 %cmp, label %b1, label %out
+
+b1:
+  br label %b2
+
+b2:
+  br label %b3
+
+b3:
+  %c = icmp eq i32 %x, 0
+; CHECK: ret i1 true
+; BUDGET: ret i1 %c
+  ret i1 %c
+
+out:
+  ret i1 false
+}
@@ -0,0 +1,57 @@
+; Block counts for @loop, @helper, @warm, @never and @marked, in module order.
+; RUN: printf '\003\000\000\000\007\000\000\000\001\000\000\000\350\003\000\000\001\000\000\000\364\001\000\000\005\000\000\000\000\000\000\000\350\003\000\000' > %t.prof
+; RUN: opt -S -profile-loader -profile-info-file %t.prof -function-hotness \
+; RUN:     -function-order-file %t.order < %s | FileCheck %s
+; RUN: FileCheck %s -check-prefix=ORDER < %t.order
+; RUN: opt -S -function-hotness < %s | FileCheck %s -check-prefix=NOPROF
+
+; Check that functions are marked hot or cold relative to the hottest block
+; in the module, and that the hot ones are listed hottest first.
+
+; The loop body is the hottest block in the module.
+define void @loop(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  call void @helper()
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+; CHECK: define void @loop(i32 %n) #0
+
+define void @helper() {
+  ret void
+}
+; CHECK: define void @helper() #0
+
+; Neither hot nor cold.
+define void @warm() {
+  ret void
+}
+; CHECK: define void @warm() {
+
+define void @never() {
+  ret void
+}
+; CHECK: define void @never() #1
+
+; The profile does not override an attribute that is already there.
+define void @marked() cold {
+  ret void
+}
+; CHECK: define void @marked() #1
+
+; CHECK: attributes #0 = { hot }
+; CHECK: attributes #1 = { cold }
+
+; ORDER: loop
+; ORDER-NEXT: helper
+; ORDER-NOT: {{.}}
+
+; NOPROF-NOT: hot
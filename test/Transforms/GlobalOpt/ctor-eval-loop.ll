@@ -0,0 +1,80 @@
+; RUN: opt < %s -globalopt -S | FileCheck %s
+; RUN: opt < %s -globalopt -globalopt-eval-budget=20 -S | FileCheck %s -check-prefix=BUDGET
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+@llvm.global_ctors = appending global [4 x { i32, void ()* }] [
+  { i32, void ()* } { i32 65535, void ()* @squares },
+  { i32, void ()* } { i32 65535, void ()* @vector },
+  { i32, void ()* } { i32 65535, void ()* @copy },
+  { i32, void ()* } { i32 65535, void ()* @clear }
+]
+
+; Only the constructor with a loop runs out of a small budget.
+; CHECK: @llvm.global_ctors = appending global [0 x { i32, void ()* }] zeroinitializer
+; BUDGET: @llvm.global_ctors = appending global [1 x { i32, void ()* }] [{ i32, void ()* } { i32 65535, void ()* @squares }]
+
+; Constructors with loops are evaluated as long as they fit in the budget.
+; CHECK: @table = global [8 x i32] [i32 0, i32 1, i32 4, i32 9, i32 16, i32 25, i32 36, i32 49]
+; BUDGET: @table = global [8 x i32] zeroinitializer
+@table = global [8 x i32] zeroinitializer
+
+; Vector operations, foldable intrinsics, memcpy and memset are evaluated too.
+; CHECK: @v = global i32 7
+@v = global i32 0
+
+; CHECK: @dst = global { i32, [2 x i16] } { i32 1, [2 x i16] [i16 2, i16 3] }
+@src = internal constant { i32, [2 x i16] } { i32 1, [2 x i16] [i16 2, i16 3] }
+@dst = global { i32, [2 x i16] } zeroinitializer
+
+; CHECK: @bytes = global [4 x i8] c"\01\01\01\01"
+@bytes = global [4 x i8] zeroinitializer
+
+define internal i32 @square(i32 %x) {
+  %r = mul i32 %x, %x
+  ret i32 %r
+}
+
+define internal void @squares() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %sq = call i32 @square(i32 %i)
+  %idx = sext i32 %i to i64
+  %p = getelementptr inbounds [8 x i32]* @table, i64 0, i64 %idx
+  store i32 %sq, i32* %p
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, 8
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define internal void @vector() {
+  %a = insertelement <4 x i32> <i32 1, i32 2, i32 3, i32 4>, i32 10, i32 0
+  %b = shufflevector <4 x i32> %a, <4 x i32> undef, <4 x i32> <i32 3, i32 0, i32 1, i32 2>
+  %c = extractelement <4 x i32> %b, i32 1
+  %d = call i32 @llvm.ctpop.i32(i32 %c)
+  %s = call { i32, i1 } @llvm.uadd.with.overflow.i32(i32 %d, i32 5)
+  %e = extractvalue { i32, i1 } %s, 0
+  store i32 %e, i32* @v
+  ret void
+}
+
+define internal void @copy() {
+  call void @llvm.memcpy.p0i8.p0i8.i64(i8* bitcast ({ i32, [2 x i16] }* @dst to i8*), i8* bitcast ({ i32, [2 x i16] }* @src to i8*), i64 8, i32 4, i1 false)
+  ret void
+}
+
+define internal void @clear() {
+  call void @llvm.memset.p0i8.i64(i8* getelementptr inbounds ([4 x i8]* @bytes, i64 0, i64 0), i8 1, i64 4, i32 1, i1 false)
+  ret void
+}
+
+declare i32 @llvm.ctpop.i32(i32)
+declare { i32, i1 } @llvm.uadd.with.overflow.i32(i32, i32)
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i32, i1)
+declare void @llvm.memset.p0i8.i64(i8*, i8, i64, i32, i1)
@@ -0,0 +1,32 @@
+; RUN: opt < %s -globalopt -S | FileCheck %s
+; RUN: opt < %s -globalopt -stats -disable-output 2>&1 | FileCheck %s -check-prefix=STATS
+; REQUIRES: asserts
+
+; A call that does not touch memory is only interpreted once per set of
+; arguments.
+
+; STATS: 2 globalopt - Number of calls evaluated from memoized results
+
+@llvm.global_ctors = appending global [1 x { i32, void ()* }] [{ i32, void ()* } { i32 65535, void ()* @ctor }]
+
+; CHECK: @a = global i32 25
+; CHECK: @b = global i32 25
+; CHECK: @c = global i32 25
+@a = global i32 0
+@b = global i32 0
+@c = global i32 0
+
+define internal i32 @square(i32 %x) {
+  %r = mul i32 %x, %x
+  ret i32 %r
+}
+
+define internal void @ctor() {
+  %1 = call i32 @square(i32 5)
+  store i32 %1, i32* @a
+  %2 = call i32 @square(i32 5)
+  store i32 %2, i32* @b
+  %3 = call i32 @square(i32 5)
+  store i32 %3, i32* @c
+  ret void
+}
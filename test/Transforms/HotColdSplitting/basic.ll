@@ -0,0 +1,59 @@
+; RUN: opt -hotcoldsplit -S < %s | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-unknown-linux-gnu"
+
+@msg = private constant [6 x i8] c"error\00"
+
+declare void @log(i8*, i32)
+declare void @abort() noreturn nounwind
+
+; The error path ends in unreachable, so it is moved out of line.
+; CHECK: define i32 @checked_div(i32 %a, i32 %b)
+; CHECK: br i1 %iszero, label %codeRepl, label %ok
+; CHECK: codeRepl:
+; CHECK-NEXT: call void @checked_div_error(i32 %a) [[NORETURN:#[0-9]+]]
+; CHECK-NEXT: unreachable
+; CHECK: ok:
+; CHECK-NEXT: %q = sdiv i32 %a, %b
+define i32 @checked_div(i32 %a, i32 %b) {
+entry:
+  %iszero = icmp eq i32 %b, 0
+  br i1 %iszero, label %error, label %ok
+
+error:
+  %msg = getelementptr [6 x i8]* @msg, i64 0, i64 0
+  %code = add i32 %a, 1
+  call void @log(i8* %msg, i32 %code)
+  call void @abort()
+  unreachable
+
+ok:
+  %q = sdiv i32 %a, %b
+  ret i32 %q
+}
+
+; Blocks that may run as often as the entry stay where they are.
+; CHECK: define i32 @warm(i32 %a, i32 %b)
+; CHECK-NOT: codeRepl
+; CHECK: ret i32
+define i32 @warm(i32 %a, i32 %b) {
+entry:
+  %c = icmp eq i32 %b, 0
+  br i1 %c, label %then, label %join
+
+then:
+  %x = add i32 %a, 1
+  %y = mul i32 %x, %a
+  %z = xor i32 %y, %b
+  br label %join
+
+join:
+  %r = phi i32 [ %z, %then ], [ %a, %entry ]
+  ret i32 %r
+}
+
+; CHECK: define internal void @checked_div_error(i32 %a) [[ATTR:#[0-9]+]] section ".text.unlikely"
+; CHECK: call void @abort()
+; CHECK-NEXT: unreachable
+; CHECK: attributes [[ATTR]] = { noinline noreturn optsize cold }
+; CHECK: attributes [[NORETURN]] = { noreturn }
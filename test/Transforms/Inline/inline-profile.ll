@@ -0,0 +1,61 @@
+; Block counts for @inner, @hot, @warm and @cold, in module order.
+; RUN: printf '\003\000\000\000\004\000\000\000\151\000\000\000\144\000\000\000\005\000\000\000\000\000\000\000' > %t.prof
+; RUN: opt -S -profile-loader -profile-info-file %t.prof -inline \
+; RUN:     -inline-threshold=25 < %s | FileCheck %s -check-prefix=LOW
+; RUN: opt -S -profile-loader -profile-info-file %t.prof -inline < %s \
+; RUN:     | FileCheck %s -check-prefix=DEFAULT
+
+; Check that execution counts loaded from a profile raise the threshold of hot
+; call sites and stop cold call sites from being inlined at all.
+
+@a = global i32 4
+
+; This function should be larger than the inline threshold of 25, but smaller
+; than the default threshold.
+define i32 @inner() {
+  %a1 = load volatile i32* @a
+  %x1 = add i32 %a1,  %a1
+  %a2 = load volatile i32* @a
+  %x2 = add i32 %x1, %a2
+  %a3 = load volatile i32* @a
+  %x3 = add i32 %x2, %a3
+  %a4 = load volatile i32* @a
+  %x4 = add i32 %x3, %a4
+  %a5 = load volatile i32* @a
+  %x5 = add i32 %x3, %a5
+  ret i32 %x5
+}
+
+; @hot runs 100 times: it gets the hot threshold even when the static one is
+; low.
+; LOW: define i32 @hot
+; LOW-NOT: call
+; LOW: ret
+; DEFAULT: define i32 @hot
+; DEFAULT-NOT: call
+; DEFAULT: ret
+define i32 @hot() {
+  %r = call i32 @inner()
+  ret i32 %r
+}
+
+; @warm runs 5 times: neither hot nor cold, so the static threshold decides.
+; LOW: define i32 @warm
+; LOW: call i32 @inner
+; DEFAULT: define i32 @warm
+; DEFAULT-NOT: call
+; DEFAULT: ret
+define i32 @warm() {
+  %r = call i32 @inner()
+  ret i32 %r
+}
+
+; @cold never runs: inlining would only grow the code.
+; LOW: define i32 @cold
+; LOW: call i32 @inner
+; DEFAULT: define i32 @cold
+; DEFAULT: call i32 @inner
+define i32 @cold() {
+  %r = call i32 @inner()
+  ret i32 %r
+}
@@ -0,0 +1,31 @@
+; RUN: opt < %s -instcombine -instcombine-incremental -S | FileCheck %s
+; RUN: opt < %s -instcombine -instcombine-incremental -disable-output -stats \
+; RUN:     -info-output-file - | FileCheck %s -check-prefix=STATS
+; RUN: opt < %s -instcombine -disable-output -stats -info-output-file - \
+; RUN:     | FileCheck %s -check-prefix=FULL
+; REQUIRES: asserts
+
+; Each function is swept once. After that only the instructions that changed
+; in @chain are visited again, where the default mode sweeps @chain twice.
+; STATS: 2 instcombine - Number of full sweeps over a function
+; STATS: 2 instcombine - Number of insts revisited after a change
+; FULL: 3 instcombine - Number of full sweeps over a function
+
+; CHECK: @chain
+; CHECK-NEXT: %c = and i32 %x, 255
+; CHECK-NEXT: ret i32 %c
+define i32 @chain(i32 %x) {
+  %a = add i32 %x, 0
+  %b = and i32 %a, 65535
+  %c = and i32 %b, 255
+  %d = or i32 %c, 0
+  ret i32 %d
+}
+
+; CHECK: @unrelated
+; CHECK-NEXT: %r = mul i32 %x, %y
+; CHECK-NEXT: ret i32 %r
+define i32 @unrelated(i32 %x, i32 %y) {
+  %r = mul i32 %x, %y
+  ret i32 %r
+}
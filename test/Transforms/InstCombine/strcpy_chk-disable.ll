@@ -0,0 +1,26 @@
+; Test that the __strcpy_chk simplification honors -disable-simplify-libcalls.
+;
+; RUN: opt < %s -instcombine -S | FileCheck %s
+; RUN: opt < %s -instcombine -disable-simplify-libcalls -S | FileCheck %s --check-prefix=DISABLE
+
+target datalayout = "e-p:32:32:32-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:32:64-v64:64:64-v128:128:128-a0:0:64-f80:128:128"
+
+@a = common global [60 x i8] zeroinitializer, align 1
+@.str = private constant [12 x i8] c"abcdefghijk\00"
+
+define void @test_simplify() {
+; CHECK: @test_simplify
+; DISABLE: @test_simplify
+  %dst = getelementptr inbounds [60 x i8]* @a, i32 0, i32 0
+  %src = getelementptr inbounds [12 x i8]* @.str, i32 0, i32 0
+
+; CHECK-NEXT: call void @llvm.memcpy.p0i8.p0i8.i32
+; CHECK-NOT: __strcpy_chk
+; DISABLE-NEXT: call i8* @__strcpy_chk
+  call i8* @__strcpy_chk(i8* %dst, i8* %src, i32 60)
+  ret void
+; CHECK: ret void
+; DISABLE-NEXT: ret void
+}
+
+declare i8* @__strcpy_chk(i8*, i8*, i32) nounwind
@@ -0,0 +1,106 @@
+; RUN: opt < %s -basicaa -loop-vectorize -mcpu=corei7 -S | FileCheck %s -check-prefix=NODIST
+; RUN: opt < %s -basicaa -loop-distribute -loop-vectorize -mcpu=corei7 -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+@A = common global [1025 x i32] zeroinitializer, align 16
+@B = common global [1024 x i32] zeroinitializer, align 16
+@C = common global [1024 x i32] zeroinitializer, align 16
+@D = common global [1024 x i32] zeroinitializer, align 16
+@E = common global [1024 x i32] zeroinitializer, align 16
+@F = common global [1025 x i32] zeroinitializer, align 16
+
+; for (i = 0; i < 1024; ++i) {
+;   A[i + 1] = A[i] * B[i];
+;   C[i] = D[i] + E[i];
+; }
+;
+; The recurrence on A stops the whole loop from being vectorized. Once it is
+; split off, the loop computing C vectorizes on its own.
+; NODIST: @recurrence
+; NODIST-NOT: <4 x i32>
+; NODIST: ret void
+
+; CHECK: @recurrence
+; CHECK: for.body.ldist:
+; CHECK-NOT: <4 x i32>
+; CHECK: for.body.ldist.ph:
+; CHECK: vector.body:
+; CHECK: add nsw <4 x i32>
+; CHECK: ret void
+define void @recurrence() nounwind ssp uwtable {
+entry:
+  br label %for.body
+
+for.body:
+  %indvars.iv = phi i64 [ 0, %entry ], [ %indvars.iv.next, %for.body ]
+  %arrayidx = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv
+  %0 = load i32* %arrayidx, align 4
+  %arrayidx2 = getelementptr inbounds [1024 x i32]* @B, i64 0, i64 %indvars.iv
+  %1 = load i32* %arrayidx2, align 4
+  %mul = mul nsw i32 %1, %0
+  %indvars.iv.next = add i64 %indvars.iv, 1
+  %arrayidx5 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv.next
+  store i32 %mul, i32* %arrayidx5, align 4
+  %arrayidx7 = getelementptr inbounds [1024 x i32]* @D, i64 0, i64 %indvars.iv
+  %2 = load i32* %arrayidx7, align 4
+  %arrayidx9 = getelementptr inbounds [1024 x i32]* @E, i64 0, i64 %indvars.iv
+  %3 = load i32* %arrayidx9, align 4
+  %add = add nsw i32 %3, %2
+  %arrayidx11 = getelementptr inbounds [1024 x i32]* @C, i64 0, i64 %indvars.iv
+  store i32 %add, i32* %arrayidx11, align 4
+  %exitcond = icmp eq i64 %indvars.iv.next, 1024
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; for (i = 0; i < 1024; ++i) {
+;   A[i + 1] = E[i];
+;   C[i] = A[i];
+;   F[i + 1] = F[i] * 2;
+; }
+;
+; The stores to A and C are each fine on their own, but the dependence
+; between them is carried, so they must not share a loop.
+; NODIST: @forward_between
+; NODIST-NOT: <4 x i32>
+; NODIST: ret void
+
+; CHECK: @forward_between
+; CHECK: store <4 x i32>
+; CHECK: for.body.ldist:
+; CHECK: vector.body:
+; CHECK: store <4 x i32>
+; CHECK: for.body:
+; CHECK-NOT: <4 x i32>
+; CHECK: store i32 %mul
+; CHECK: ret void
+define void @forward_between() nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %indvars.iv = phi i64 [ 0, %entry ], [ %indvars.iv.next, %for.body ]
+  %indvars.iv.next = add i64 %indvars.iv, 1
+  %arrayidx = getelementptr inbounds [1024 x i32]* @E, i64 0, i64 %indvars.iv
+  %0 = load i32* %arrayidx, align 4
+  %arrayidx2 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv.next
+  store i32 %0, i32* %arrayidx2, align 4
+  %arrayidx4 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv
+  %1 = load i32* %arrayidx4, align 4
+  %arrayidx6 = getelementptr inbounds [1024 x i32]* @C, i64 0, i64 %indvars.iv
+  store i32 %1, i32* %arrayidx6, align 4
+  %arrayidx8 = getelementptr inbounds [1025 x i32]* @F, i64 0, i64 %indvars.iv
+  %2 = load i32* %arrayidx8, align 4
+  %mul = shl nsw i32 %2, 1
+  %arrayidx10 = getelementptr inbounds [1025 x i32]* @F, i64 0, i64 %indvars.iv.next
+  store i32 %mul, i32* %arrayidx10, align 4
+  %exitcond = icmp eq i64 %indvars.iv.next, 1024
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
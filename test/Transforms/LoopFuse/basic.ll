@@ -0,0 +1,162 @@
+; RUN: opt < %s -basicaa -loop-fuse -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+@A = common global [1025 x i32] zeroinitializer, align 16
+@B = common global [1024 x i32] zeroinitializer, align 16
+@C = common global [1024 x i32] zeroinitializer, align 16
+
+; for (i = 0; i < 1024; ++i)
+;   A[i] = B[i] + 1;
+; for (i = 0; i < 1024; ++i)
+;   C[i] = A[i] * 2;
+;
+; The second loop reads A[i] right after the first loop wrote it.
+; CHECK: @same_iteration
+; CHECK: for.body:
+; CHECK: store i32 %add, i32* %arrayidx2
+; CHECK: load i32* %arrayidx6
+; CHECK: store i32 %mul
+; CHECK: br i1 %exitcond, label %for.end9, label %for.body
+; CHECK-NOT: for.body4:
+; CHECK: ret void
+define void @same_iteration() nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %indvars.iv = phi i64 [ 0, %entry ], [ %indvars.iv.next, %for.body ]
+  %arrayidx = getelementptr inbounds [1024 x i32]* @B, i64 0, i64 %indvars.iv
+  %0 = load i32* %arrayidx, align 4
+  %add = add nsw i32 %0, 1
+  %arrayidx2 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv
+  store i32 %add, i32* %arrayidx2, align 4
+  %indvars.iv.next = add i64 %indvars.iv, 1
+  %exitcond = icmp eq i64 %indvars.iv.next, 1024
+  br i1 %exitcond, label %for.body4.preheader, label %for.body
+
+for.body4.preheader:
+  br label %for.body4
+
+for.body4:
+  %indvars.iv2 = phi i64 [ %indvars.iv.next3, %for.body4 ], [ 0, %for.body4.preheader ]
+  %arrayidx6 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv2
+  %1 = load i32* %arrayidx6, align 4
+  %mul = shl nsw i32 %1, 1
+  %arrayidx8 = getelementptr inbounds [1024 x i32]* @C, i64 0, i64 %indvars.iv2
+  store i32 %mul, i32* %arrayidx8, align 4
+  %indvars.iv.next3 = add i64 %indvars.iv2, 1
+  %exitcond4 = icmp eq i64 %indvars.iv.next3, 1024
+  br i1 %exitcond4, label %for.end9, label %for.body4
+
+for.end9:
+  ret void
+}
+
+; The second loop reads A[i + 1], which the first loop only writes in the
+; next iteration.
+; CHECK: @next_iteration
+; CHECK: for.body4:
+; CHECK: ret void
+define void @next_iteration() nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %indvars.iv = phi i64 [ 0, %entry ], [ %indvars.iv.next, %for.body ]
+  %arrayidx = getelementptr inbounds [1024 x i32]* @B, i64 0, i64 %indvars.iv
+  %0 = load i32* %arrayidx, align 4
+  %arrayidx2 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv
+  store i32 %0, i32* %arrayidx2, align 4
+  %indvars.iv.next = add i64 %indvars.iv, 1
+  %exitcond = icmp eq i64 %indvars.iv.next, 1024
+  br i1 %exitcond, label %for.body4.preheader, label %for.body
+
+for.body4.preheader:
+  br label %for.body4
+
+for.body4:
+  %indvars.iv2 = phi i64 [ %indvars.iv.next3, %for.body4 ], [ 0, %for.body4.preheader ]
+  %indvars.iv.next3 = add i64 %indvars.iv2, 1
+  %arrayidx6 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv.next3
+  %1 = load i32* %arrayidx6, align 4
+  %arrayidx8 = getelementptr inbounds [1024 x i32]* @C, i64 0, i64 %indvars.iv2
+  store i32 %1, i32* %arrayidx8, align 4
+  %exitcond4 = icmp eq i64 %indvars.iv.next3, 1024
+  br i1 %exitcond4, label %for.end9, label %for.body4
+
+for.end9:
+  ret void
+}
+
+; The loops run a different number of iterations.
+; CHECK: @different_trip_count
+; CHECK: for.body4:
+; CHECK: ret void
+define void @different_trip_count() nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %indvars.iv = phi i64 [ 0, %entry ], [ %indvars.iv.next, %for.body ]
+  %arrayidx = getelementptr inbounds [1024 x i32]* @B, i64 0, i64 %indvars.iv
+  %0 = load i32* %arrayidx, align 4
+  %arrayidx2 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv
+  store i32 %0, i32* %arrayidx2, align 4
+  %indvars.iv.next = add i64 %indvars.iv, 1
+  %exitcond = icmp eq i64 %indvars.iv.next, 1024
+  br i1 %exitcond, label %for.body4.preheader, label %for.body
+
+for.body4.preheader:
+  br label %for.body4
+
+for.body4:
+  %indvars.iv2 = phi i64 [ %indvars.iv.next3, %for.body4 ], [ 0, %for.body4.preheader ]
+  %arrayidx6 = getelementptr inbounds [1025 x i32]* @A, i64 0, i64 %indvars.iv2
+  %1 = load i32* %arrayidx6, align 4
+  %arrayidx8 = getelementptr inbounds [1024 x i32]* @C, i64 0, i64 %indvars.iv2
+  store i32 %1, i32* %arrayidx8, align 4
+  %indvars.iv.next3 = add i64 %indvars.iv2, 1
+  %exitcond4 = icmp eq i64 %indvars.iv.next3, 512
+  br i1 %exitcond4, label %for.end9, label %for.body4
+
+for.end9:
+  ret void
+}
+
+; Both loops access an i32 at P + i, so every store overlaps the one of the
+; next iteration and the second loop must see the bytes the last ones wrote.
+; CHECK: @overlapping_step
+; CHECK: for.body4:
+; CHECK: ret void
+define void @overlapping_step(i8* noalias %P, i32* noalias %Q) nounwind {
+entry:
+  br label %for.body
+
+for.body:
+  %indvars.iv = phi i64 [ 0, %entry ], [ %indvars.iv.next, %for.body ]
+  %arrayidx = getelementptr inbounds i8* %P, i64 %indvars.iv
+  %ptr = bitcast i8* %arrayidx to i32*
+  %0 = trunc i64 %indvars.iv to i32
+  store i32 %0, i32* %ptr, align 1
+  %indvars.iv.next = add i64 %indvars.iv, 1
+  %exitcond = icmp eq i64 %indvars.iv.next, 1024
+  br i1 %exitcond, label %for.body4.preheader, label %for.body
+
+for.body4.preheader:
+  br label %for.body4
+
+for.body4:
+  %indvars.iv2 = phi i64 [ %indvars.iv.next3, %for.body4 ], [ 0, %for.body4.preheader ]
+  %arrayidx6 = getelementptr inbounds i8* %P, i64 %indvars.iv2
+  %ptr6 = bitcast i8* %arrayidx6 to i32*
+  %1 = load i32* %ptr6, align 1
+  %arrayidx8 = getelementptr inbounds i32* %Q, i64 %indvars.iv2
+  store i32 %1, i32* %arrayidx8, align 4
+  %indvars.iv.next3 = add i64 %indvars.iv2, 1
+  %exitcond4 = icmp eq i64 %indvars.iv.next3, 1024
+  br i1 %exitcond4, label %for.end9, label %for.body4
+
+for.end9:
+  ret void
+}
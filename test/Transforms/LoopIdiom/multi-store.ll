@@ -0,0 +1,162 @@
+; RUN: opt -basicaa -loop-idiom < %s -S | FileCheck %s
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64"
+target triple = "x86_64-apple-darwin10.0.0"
+
+%struct.pair = type { i32, i32 }
+%struct.rec = type { i32, i16, i16 }
+
+; void test1(_Complex float *P, long n)
+;   for (i) { __real__(P[i]) = 0;  __imag__(P[i]) = 0; }
+define void @test1({ float, float }* %P, i64 %n) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %re = getelementptr { float, float }* %P, i64 %i, i32 0
+  %im = getelementptr { float, float }* %P, i64 %i, i32 1
+  store float 0.0, float* %re, align 4
+  store float 0.0, float* %im, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test1
+; CHECK: %P1 = bitcast { float, float }* %P to i8*
+; CHECK: %0 = mul i64 %n, 8
+; CHECK: call void @llvm.memset.p0i8.i64(i8* %P1, i8 0, i64 %0, i32 4, i1 false)
+; CHECK-NOT: store
+}
+
+; The fields are written out of order and hold different constants, so
+; this becomes a memset_pattern16 of { 1, 2, 1, 2 }.
+define void @test2(%struct.pair* %P, i64 %n) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %b = getelementptr %struct.pair* %P, i64 %i, i32 1
+  store i32 2, i32* %b, align 4
+  %a = getelementptr %struct.pair* %P, i64 %i, i32 0
+  store i32 1, i32* %a, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test2
+; CHECK: call void @memset_pattern16(i8* {{.*}}, i8* bitcast ([2 x <{ i32, i32 }>]* @.memset_pattern to i8*), i64
+; CHECK-NOT: store
+}
+
+; Field by field struct copy: for (i) { D[i].a = S[i].a; D[i].b = S[i].b; ... }
+define void @test3(%struct.rec* noalias %D, %struct.rec* noalias %S,
+                   i64 %n) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %sa = getelementptr %struct.rec* %S, i64 %i, i32 0
+  %sb = getelementptr %struct.rec* %S, i64 %i, i32 1
+  %sc = getelementptr %struct.rec* %S, i64 %i, i32 2
+  %da = getelementptr %struct.rec* %D, i64 %i, i32 0
+  %db = getelementptr %struct.rec* %D, i64 %i, i32 1
+  %dc = getelementptr %struct.rec* %D, i64 %i, i32 2
+  %va = load i32* %sa, align 4
+  store i32 %va, i32* %da, align 4
+  %vb = load i16* %sb, align 4
+  store i16 %vb, i16* %db, align 4
+  %vc = load i16* %sc, align 2
+  store i16 %vc, i16* %dc, align 2
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test3
+; CHECK: call void @llvm.memcpy.p0i8.p0i8.i64(i8* %{{.*}}, i8* %{{.*}}, i64 %{{.*}}, i32 4, i1 false)
+; CHECK-NOT: store
+}
+
+; Only the first field is written, so the stride is not covered.
+define void @test4(%struct.pair* %P, i64 %n) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %a = getelementptr %struct.pair* %P, i64 %i, i32 0
+  store i32 0, i32* %a, align 4
+  %c = getelementptr %struct.pair* %P, i64 %i, i32 0
+  store i32 0, i32* %c, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test4
+; CHECK-NOT: memset
+; CHECK: store i32 0
+; CHECK: ret void
+}
+
+; The copy reads a field that the loop overwrites in a later iteration.
+define void @test5(%struct.pair* %P, i64 %n) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %i.1 = add i64 %i, 1
+  %sa = getelementptr %struct.pair* %P, i64 %i.1, i32 0
+  %sb = getelementptr %struct.pair* %P, i64 %i.1, i32 1
+  %da = getelementptr %struct.pair* %P, i64 %i, i32 0
+  %db = getelementptr %struct.pair* %P, i64 %i, i32 1
+  %va = load i32* %sa, align 4
+  store i32 %va, i32* %da, align 4
+  %vb = load i32* %sb, align 4
+  store i32 %vb, i32* %db, align 4
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test5
+; CHECK-NOT: memcpy
+; CHECK: ret void
+}
+
+; An i24 takes four bytes in a struct but only stores three, so the constants
+; can't simply be packed into a pattern.
+define void @test_i24(i8* %P, i64 %n) nounwind ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %off = shl i64 %i, 2
+  %p0 = getelementptr i8* %P, i64 %off
+  %a = bitcast i8* %p0 to i24*
+  store i24 1, i24* %a, align 1
+  %off3 = add i64 %off, 3
+  %b = getelementptr i8* %P, i64 %off3
+  store i8 2, i8* %b, align 1
+  %i.next = add i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+; CHECK: @test_i24
+; CHECK-NOT: memset_pattern16
+; CHECK: store i24 1
+; CHECK: store i8 2
+}
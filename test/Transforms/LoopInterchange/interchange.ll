@@ -0,0 +1,113 @@
+; RUN: opt < %s -basicaa -loop-interchange -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+@A = common global [100 x [100 x i32]] zeroinitializer, align 16
+
+; for (j = 0; j < 50; ++j)
+;   for (i = 0; i < 100; ++i)
+;     A[i][j] += 1;
+;
+; The inner loop walks down a column. After interchange it walks along a row,
+; with the trip counts of the two loops swapped.
+; CHECK: @column_walk
+; CHECK: %j = phi i64 [ 0, %entry ], [ %j.next, %for.latch ]
+; CHECK: %i = phi i64 [ 0, %for.outer ], [ %i.next, %for.inner ]
+; CHECK: getelementptr inbounds [100 x [100 x i32]]* @A, i64 0, i64 %j, i64 %i
+; CHECK: %exitcond = icmp eq i64 %i.next, 50
+; CHECK: %exitcond2 = icmp eq i64 %j.next, 100
+define void @column_walk() nounwind {
+entry:
+  br label %for.outer
+
+for.outer:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %for.latch ]
+  br label %for.inner
+
+for.inner:
+  %i = phi i64 [ 0, %for.outer ], [ %i.next, %for.inner ]
+  %arrayidx = getelementptr inbounds [100 x [100 x i32]]* @A, i64 0, i64 %i, i64 %j
+  %0 = load i32* %arrayidx, align 4
+  %add = add nsw i32 %0, 1
+  store i32 %add, i32* %arrayidx, align 4
+  %i.next = add nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 100
+  br i1 %exitcond, label %for.latch, label %for.inner
+
+for.latch:
+  %j.next = add nsw i64 %j, 1
+  %exitcond2 = icmp eq i64 %j.next, 50
+  br i1 %exitcond2, label %for.end, label %for.outer
+
+for.end:
+  ret void
+}
+
+; The inner loop already walks along a row.
+; CHECK: @row_walk
+; CHECK: getelementptr inbounds [100 x [100 x i32]]* @A, i64 0, i64 %i, i64 %j
+; CHECK: ret void
+define void @row_walk() nounwind {
+entry:
+  br label %for.outer
+
+for.outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.latch ]
+  br label %for.inner
+
+for.inner:
+  %j = phi i64 [ 0, %for.outer ], [ %j.next, %for.inner ]
+  %arrayidx = getelementptr inbounds [100 x [100 x i32]]* @A, i64 0, i64 %i, i64 %j
+  %0 = load i32* %arrayidx, align 4
+  %add = add nsw i32 %0, 1
+  store i32 %add, i32* %arrayidx, align 4
+  %j.next = add nsw i64 %j, 1
+  %exitcond = icmp eq i64 %j.next, 100
+  br i1 %exitcond, label %for.latch, label %for.inner
+
+for.latch:
+  %i.next = add nsw i64 %i, 1
+  %exitcond2 = icmp eq i64 %i.next, 100
+  br i1 %exitcond2, label %for.end, label %for.outer
+
+for.end:
+  ret void
+}
+
+; for (j = 0; j < 99; ++j)
+;   for (i = 1; i < 100; ++i)
+;     A[i][j] = A[i-1][j+1];
+;
+; The dependence has direction (<, >), which interchange would reverse.
+; CHECK: @reversed_dependence
+; CHECK: %arrayidx = getelementptr inbounds [100 x [100 x i32]]* @A, i64 0, i64 %i, i64 %j
+; CHECK: %exitcond = icmp eq i64 %i.next, 100
+; CHECK: ret void
+define void @reversed_dependence() nounwind {
+entry:
+  br label %for.outer
+
+for.outer:
+  %j = phi i64 [ 0, %entry ], [ %j.next, %for.latch ]
+  br label %for.inner
+
+for.inner:
+  %i = phi i64 [ 1, %for.outer ], [ %i.next, %for.inner ]
+  %j.1 = add nsw i64 %j, 1
+  %i.m1 = add nsw i64 %i, -1
+  %src = getelementptr inbounds [100 x [100 x i32]]* @A, i64 0, i64 %i.m1, i64 %j.1
+  %0 = load i32* %src, align 4
+  %arrayidx = getelementptr inbounds [100 x [100 x i32]]* @A, i64 0, i64 %i, i64 %j
+  store i32 %0, i32* %arrayidx, align 4
+  %i.next = add nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 100
+  br i1 %exitcond, label %for.latch, label %for.inner
+
+for.latch:
+  %j.next = add nsw i64 %j, 1
+  %exitcond2 = icmp eq i64 %j.next, 99
+  br i1 %exitcond2, label %for.end, label %for.outer
+
+for.end:
+  ret void
+}
@@ -0,0 +1,85 @@
+; RUN: opt < %s -basicaa -loop-tile -loop-tile-size=16 -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+@A = common global [100 x [100 x float]] zeroinitializer, align 16
+@B = common global [100 x [100 x float]] zeroinitializer, align 16
+
+; for (i = 0; i < 100; ++i)
+;   for (j = 0; j < 100; ++j)
+;     B[j][i] = A[i][j];
+;
+; Every iteration of the inner loop stores to a new line of B, which the next
+; iteration of the outer loop would use again. Interchange does not help as
+; A then has the same problem, so run the inner loop in tiles of 16.
+; CHECK: @transpose
+; CHECK: tile.header:
+; CHECK: %tile.iv = phi i64 [ 0, %entry ], [ %tile.next, %tile.latch ]
+; CHECK: %tile.end = add nsw i64 %tile.iv, 16
+; CHECK: %tile.bound = select i1 %tile.cmp, i64 %tile.end, i64 100
+; CHECK: %i = phi i64 [ 0, %tile.header ], [ %i.next, %for.latch ]
+; CHECK: %j = phi i64 [ %tile.iv, %for.outer ], [ %j.next, %for.inner ]
+; CHECK: %exitcond = icmp sge i64 %j.next, %tile.bound
+; CHECK: br i1 %exitcond2, label %tile.latch, label %for.outer
+; CHECK: tile.latch:
+; CHECK: %tile.next = add nsw i64 %tile.iv, 16
+; CHECK: %tile.cond = icmp slt i64 %tile.next, 100
+; CHECK: br i1 %tile.cond, label %tile.header, label %for.end
+define void @transpose() nounwind {
+entry:
+  br label %for.outer
+
+for.outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.latch ]
+  br label %for.inner
+
+for.inner:
+  %j = phi i64 [ 0, %for.outer ], [ %j.next, %for.inner ]
+  %src = getelementptr inbounds [100 x [100 x float]]* @A, i64 0, i64 %i, i64 %j
+  %0 = load float* %src, align 4
+  %dst = getelementptr inbounds [100 x [100 x float]]* @B, i64 0, i64 %j, i64 %i
+  store float %0, float* %dst, align 4
+  %j.next = add nsw i64 %j, 1
+  %exitcond = icmp eq i64 %j.next, 100
+  br i1 %exitcond, label %for.latch, label %for.inner
+
+for.latch:
+  %i.next = add nsw i64 %i, 1
+  %exitcond2 = icmp eq i64 %i.next, 100
+  br i1 %exitcond2, label %for.end, label %for.outer
+
+for.end:
+  ret void
+}
+
+; Both accesses walk along a row, so the lines are used up before the inner
+; loop moves on.
+; CHECK: @copy
+; CHECK-NOT: tile.header
+; CHECK: ret void
+define void @copy() nounwind {
+entry:
+  br label %for.outer
+
+for.outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.latch ]
+  br label %for.inner
+
+for.inner:
+  %j = phi i64 [ 0, %for.outer ], [ %j.next, %for.inner ]
+  %src = getelementptr inbounds [100 x [100 x float]]* @A, i64 0, i64 %i, i64 %j
+  %0 = load float* %src, align 4
+  %dst = getelementptr inbounds [100 x [100 x float]]* @B, i64 0, i64 %i, i64 %j
+  store float %0, float* %dst, align 4
+  %j.next = add nsw i64 %j, 1
+  %exitcond = icmp eq i64 %j.next, 100
+  br i1 %exitcond, label %for.latch, label %for.inner
+
+for.latch:
+  %i.next = add nsw i64 %i, 1
+  %exitcond2 = icmp eq i64 %i.next, 100
+  br i1 %exitcond2, label %for.end, label %for.outer
+
+for.end:
+  ret void
+}
@@ -0,0 +1,52 @@
+; RUN: opt < %s  -loop-vectorize -mtriple=x86_64-apple-macosx10.8.0 -mcpu=corei7-avx -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+; With 20 iterations, a VF of 8 leaves 4 iterations to the scalar remainder
+; loop. A VF of 4 has no remainder at all.
+;CHECK: @short_trip_count
+;CHECK: load <4 x float>
+;CHECK-NOT: <8 x float>
+;CHECK: ret void
+define void @short_trip_count(float* noalias nocapture %a, float* noalias nocapture %b) nounwind uwtable ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %iv = phi i64 [ 0, %entry ], [ %iv.next, %for.body ]
+  %b.ptr = getelementptr inbounds float* %b, i64 %iv
+  %0 = load float* %b.ptr, align 4
+  %mul = fmul float %0, 3.000000e+00
+  %a.ptr = getelementptr inbounds float* %a, i64 %iv
+  store float %mul, float* %a.ptr, align 4
+  %iv.next = add i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, 20
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; 32 iterations are a multiple of the widest vector.
+;CHECK: @long_trip_count
+;CHECK: load <8 x float>
+;CHECK: ret void
+define void @long_trip_count(float* noalias nocapture %a, float* noalias nocapture %b) nounwind uwtable ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %iv = phi i64 [ 0, %entry ], [ %iv.next, %for.body ]
+  %b.ptr = getelementptr inbounds float* %b, i64 %iv
+  %0 = load float* %b.ptr, align 4
+  %mul = fmul float %0, 3.000000e+00
+  %a.ptr = getelementptr inbounds float* %a, i64 %iv
+  store float %mul, float* %a.ptr, align 4
+  %iv.next = add i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, 32
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
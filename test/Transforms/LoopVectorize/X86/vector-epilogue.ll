@@ -0,0 +1,89 @@
+; RUN: opt < %s -loop-vectorize -mtriple=x86_64-apple-macosx10.8.0 -mcpu=corei7-avx -S | FileCheck %s
+; RUN: opt < %s -loop-vectorize -vectorize-epilogue=false -mtriple=x86_64-apple-macosx10.8.0 -mcpu=corei7-avx -S | FileCheck %s --check-prefix=NOEPI
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+; 44 = 5 * 8 + 4: the remainder of the <8 x float> loop is run by a narrower
+; vector loop before falling back to scalar code.
+; CHECK: @tc44
+; CHECK: load <8 x float>
+; CHECK: load <4 x float>
+; CHECK: store <4 x float>
+; CHECK: ret void
+; NOEPI: @tc44
+; NOEPI: load <8 x float>
+; NOEPI-NOT: <4 x float>
+; NOEPI: ret void
+define void @tc44(float* noalias nocapture %a, float* noalias nocapture %b) nounwind uwtable ssp {
+entry:
+  br label %for.body
+
+for.body:
+  %iv = phi i64 [ 0, %entry ], [ %iv.next, %for.body ]
+  %b.ptr = getelementptr inbounds float* %b, i64 %iv
+  %0 = load float* %b.ptr, align 4
+  %mul = fmul float %0, 3.000000e+00
+  %a.ptr = getelementptr inbounds float* %a, i64 %iv
+  store float %mul, float* %a.ptr, align 4
+  %iv.next = add i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, 44
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; With an unknown trip count the expected remainder is still worth a vector
+; epilogue.
+; CHECK: @runtime
+; CHECK: load <8 x float>
+; CHECK: load <4 x float>
+; CHECK: ret void
+define void @runtime(float* noalias nocapture %a, float* noalias nocapture %b, i64 %n) nounwind uwtable ssp {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %iv = phi i64 [ 0, %entry ], [ %iv.next, %for.body ]
+  %b.ptr = getelementptr inbounds float* %b, i64 %iv
+  %0 = load float* %b.ptr, align 4
+  %mul = fmul float %0, 3.000000e+00
+  %add = fadd float %mul, 1.000000e+00
+  %a.ptr = getelementptr inbounds float* %a, i64 %iv
+  store float %add, float* %a.ptr, align 4
+  %iv.next = add i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; A remainder that was handed back for a vector epilogue but can no longer be
+; vectorized keeps the marker that stops it from being vectorized again.
+; CHECK: @remainder_noimplicitfloat
+; CHECK-NOT: <4 x float>
+; CHECK: br i1 %exitcond, label %for.end, label %for.body, !llvm.vectorizer.already_vectorized
+; CHECK: ret void
+define void @remainder_noimplicitfloat(float* noalias nocapture %a, float* noalias nocapture %b) nounwind uwtable ssp noimplicitfloat {
+entry:
+  br label %for.body
+
+for.body:
+  %iv = phi i64 [ 0, %entry ], [ %iv.next, %for.body ]
+  %b.ptr = getelementptr inbounds float* %b, i64 %iv
+  %0 = load float* %b.ptr, align 4
+  %mul = fmul float %0, 3.000000e+00
+  %a.ptr = getelementptr inbounds float* %a, i64 %iv
+  store float %mul, float* %a.ptr, align 4
+  %iv.next = add i64 %iv, 1
+  %exitcond = icmp eq i64 %iv.next, 44
+  br i1 %exitcond, label %for.end, label %for.body, !llvm.vectorizer.epilogue_width !0
+
+for.end:
+  ret void
+}
+
+!0 = metadata !{i32 4}
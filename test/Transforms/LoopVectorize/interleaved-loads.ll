@@ -0,0 +1,87 @@
+; RUN: opt < %s -loop-vectorize -force-vector-unroll=1 -force-vector-width=4 -dce -instcombine -S | FileCheck %s
+; RUN: opt < %s -loop-vectorize -force-vector-unroll=1 -force-vector-width=4 -enable-interleaved-mem-accesses=false -dce -instcombine -S | FileCheck %s -check-prefix=OFF
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+%struct.rgb = type { i32, i32, i32 }
+
+; Reading every field of an array of structs is one wide load per iteration,
+; split into the fields with shuffles.
+; void luma(struct rgb *A, int *Out, int n) {
+;   for (int i = 0; i < n; ++i)
+;     Out[i] = A[i].r + A[i].g + A[i].b;
+; }
+
+;CHECK: @luma
+;CHECK: load <12 x i32>* {{.*}}, align 4
+;CHECK-DAG: shufflevector <12 x i32> %{{.*}}, <12 x i32> undef, <4 x i32> <i32 0, i32 3, i32 6, i32 9>
+;CHECK-DAG: shufflevector <12 x i32> %{{.*}}, <12 x i32> undef, <4 x i32> <i32 1, i32 4, i32 7, i32 10>
+;CHECK-DAG: shufflevector <12 x i32> %{{.*}}, <12 x i32> undef, <4 x i32> <i32 2, i32 5, i32 8, i32 11>
+;CHECK: store <4 x i32>
+;CHECK: ret void
+;OFF: @luma
+;OFF-NOT: load <12 x i32>
+;OFF: ret void
+define void @luma(%struct.rgb* noalias nocapture %A, i32* noalias nocapture %Out, i32 %n) nounwind uwtable ssp {
+entry:
+  %cmp = icmp sgt i32 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %iv = phi i64 [ %iv.next, %for.body ], [ 0, %entry ]
+  %r.ptr = getelementptr inbounds %struct.rgb* %A, i64 %iv, i32 0
+  %r = load i32* %r.ptr, align 4
+  %g.ptr = getelementptr inbounds %struct.rgb* %A, i64 %iv, i32 1
+  %g = load i32* %g.ptr, align 4
+  %b.ptr = getelementptr inbounds %struct.rgb* %A, i64 %iv, i32 2
+  %b = load i32* %b.ptr, align 4
+  %add = add nsw i32 %g, %r
+  %add1 = add nsw i32 %add, %b
+  %out.ptr = getelementptr inbounds i32* %Out, i64 %iv
+  store i32 %add1, i32* %out.ptr, align 4
+  %iv.next = add i64 %iv, 1
+  %lftr.wideiv = trunc i64 %iv.next to i32
+  %exitcond = icmp eq i32 %lftr.wideiv, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; When a field is never read we can't load the whole record: the last field
+; may be past the end of the object.
+; int sum_rg(struct rgb *A, int n) {
+;   int sum = 0;
+;   for (int i = 0; i < n; ++i)
+;     sum += A[i].r + A[i].g;
+;   return sum;
+; }
+
+;CHECK: @sum_rg
+;CHECK-NOT: load <12 x i32>
+;CHECK-NOT: load <8 x i32>
+;CHECK: ret i32
+define i32 @sum_rg(%struct.rgb* nocapture %A, i32 %n) nounwind uwtable readonly ssp {
+entry:
+  %cmp = icmp sgt i32 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %iv = phi i64 [ %iv.next, %for.body ], [ 0, %entry ]
+  %sum = phi i32 [ %add1, %for.body ], [ 0, %entry ]
+  %r.ptr = getelementptr inbounds %struct.rgb* %A, i64 %iv, i32 0
+  %r = load i32* %r.ptr, align 4
+  %g.ptr = getelementptr inbounds %struct.rgb* %A, i64 %iv, i32 1
+  %g = load i32* %g.ptr, align 4
+  %add = add nsw i32 %g, %r
+  %add1 = add nsw i32 %add, %sum
+  %iv.next = add i64 %iv, 1
+  %lftr.wideiv = trunc i64 %iv.next to i32
+  %exitcond = icmp eq i32 %lftr.wideiv, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  %sum.lcssa = phi i32 [ 0, %entry ], [ %add1, %for.body ]
+  ret i32 %sum.lcssa
+}
@@ -0,0 +1,170 @@
+; RUN: opt < %s -loop-vectorize -force-vector-unroll=1 -force-vector-width=4 -dce -instcombine -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+; The inner loop has four iterations, too few to vectorize. It is the same for
+; every iteration of the outer loop, so the outer loop is vectorized instead.
+; void mat4_vec(float (*A)[4], float *x, float *Out, long n) {
+;   for (long i = 0; i < n; ++i) {
+;     float sum = 0;
+;     for (long j = 0; j < 4; ++j)
+;       sum += A[i][j] * x[j];
+;     Out[i] = sum;
+;   }
+; }
+
+;CHECK: @mat4_vec
+;CHECK: vector.inner:
+;CHECK: phi i64 [ 0, %vector.body ]
+;CHECK: phi <4 x float> [ zeroinitializer, %vector.body ]
+;CHECK: load float*
+;CHECK: fmul <4 x float>
+;CHECK: fadd <4 x float>
+;CHECK: br i1 {{.*}}, label %vector.inner.exit, label %vector.inner
+;CHECK: vector.inner.exit:
+;CHECK: store <4 x float>
+;CHECK: ret void
+define void @mat4_vec([4 x float]* noalias nocapture %A, float* noalias nocapture %x, float* noalias nocapture %Out, i64 %n) nounwind uwtable ssp {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %outer, label %exit
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %sum = phi float [ 0.000000e+00, %outer ], [ %add, %inner ]
+  %a.ptr = getelementptr inbounds [4 x float]* %A, i64 %i, i64 %j
+  %a = load float* %a.ptr, align 4
+  %x.ptr = getelementptr inbounds float* %x, i64 %j
+  %xv = load float* %x.ptr, align 4
+  %mul = fmul float %a, %xv
+  %add = fadd float %sum, %mul
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 4
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %add.lcssa = phi float [ %add, %inner ]
+  %out.ptr = getelementptr inbounds float* %Out, i64 %i
+  store float %add.lcssa, float* %out.ptr, align 4
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, %n
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; An inner loop with twelve iterations is left alone.
+;CHECK: @mat12_vec
+;CHECK-NOT: <4 x float>
+;CHECK: icmp eq i64 %j.next, 12
+;CHECK: ret void
+define void @mat12_vec([12 x float]* noalias nocapture %A, float* noalias nocapture %x, float* noalias nocapture %Out, i64 %n) nounwind uwtable ssp {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %outer, label %exit
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %sum = phi float [ 0.000000e+00, %outer ], [ %add, %inner ]
+  %a.ptr = getelementptr inbounds [12 x float]* %A, i64 %i, i64 %j
+  %a = load float* %a.ptr, align 4
+  %x.ptr = getelementptr inbounds float* %x, i64 %j
+  %xv = load float* %x.ptr, align 4
+  %mul = fmul float %a, %xv
+  %add = fadd float %sum, %mul
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 12
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %add.lcssa = phi float [ %add, %inner ]
+  %out.ptr = getelementptr inbounds float* %Out, i64 %i
+  store float %add.lcssa, float* %out.ptr, align 4
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, %n
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; Every lane of the outer loop would store to the same Acc[j].
+;CHECK: @shared_store
+;CHECK-NOT: <4 x float>
+;CHECK: ret void
+define void @shared_store([4 x float]* noalias nocapture %A, float* noalias nocapture %Acc, i64 %n) nounwind uwtable ssp {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %outer, label %exit
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a.ptr = getelementptr inbounds [4 x float]* %A, i64 %i, i64 %j
+  %a = load float* %a.ptr, align 4
+  %acc.ptr = getelementptr inbounds float* %Acc, i64 %j
+  %acc = load float* %acc.ptr, align 4
+  %add = fadd float %acc, %a
+  store float %add, float* %acc.ptr, align 4
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, 4
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add i64 %i, 1
+  %outer.cond = icmp eq i64 %i.next, %n
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; The trip count of the inner loop depends on the outer induction, so the
+; lanes would leave the inner loop at different times.
+;CHECK: @triangle
+;CHECK-NOT: <4 x float>
+;CHECK: icmp eq i64 %j.next, %i.next
+;CHECK: ret void
+define void @triangle([4 x float]* noalias nocapture %A, float* noalias nocapture %Out, i64 %n) nounwind uwtable ssp {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %outer, label %exit
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %i.next = add i64 %i, 1
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %sum = phi float [ 0.000000e+00, %outer ], [ %add, %inner ]
+  %a.ptr = getelementptr inbounds [4 x float]* %A, i64 %i, i64 %j
+  %a = load float* %a.ptr, align 4
+  %add = fadd float %sum, %a
+  %j.next = add i64 %j, 1
+  %inner.cond = icmp eq i64 %j.next, %i.next
+  br i1 %inner.cond, label %outer.latch, label %inner
+
+outer.latch:
+  %add.lcssa = phi float [ %add, %inner ]
+  %out.ptr = getelementptr inbounds float* %Out, i64 %i
+  store float %add.lcssa, float* %out.ptr, align 4
+  %outer.cond = icmp eq i64 %i.next, %n
+  br i1 %outer.cond, label %exit, label %outer
+
+exit:
+  ret void
+}
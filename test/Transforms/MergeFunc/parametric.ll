@@ -0,0 +1,169 @@
+; REQUIRES: asserts
+; RUN: opt -mergefunc -mergefunc-parametric -stats -S < %s 2>&1 | FileCheck %s
+
+; @scale3 and @scale5 only differ in a constant, and @log_a and @log_b only
+; in the function they call. Each pair shares one body that takes the
+; differing value as a parameter. The internal functions are only called
+; directly, so their callers are redirected and they are deleted; the
+; external ones keep a thunk.
+
+; @small1 and @small2 are too small to pay for two thunks.
+; CHECK: define i32 @small1(
+; CHECK-NEXT: mul i32 %x, 3
+define i32 @small1(i32 %x) {
+  %a = mul i32 %x, 3
+  %b = add i32 %a, 1
+  ret i32 %b
+}
+
+; CHECK: define i32 @small2(
+; CHECK-NEXT: mul i32 %x, 5
+define i32 @small2(i32 %x) {
+  %a = mul i32 %x, 5
+  %b = add i32 %a, 1
+  ret i32 %b
+}
+
+declare void @sink(i32)
+declare void @sink2(i32)
+
+; CHECK: define i32 @scale3(i32 %x)
+; CHECK-NEXT: tail call i32 @scale3.merged(i32 %x, i32 3)
+; CHECK-NEXT: ret i32
+define i32 @scale3(i32 %x) {
+  %a = mul i32 %x, 3
+  %b = add i32 %a, 1
+  %c = xor i32 %b, %x
+  %d = lshr i32 %c, 2
+  %e = and i32 %d, %b
+  %f = or i32 %e, %a
+  %g = sub i32 %f, %c
+  %h = shl i32 %g, 3
+  %i = xor i32 %h, %d
+  %j = add i32 %i, %e
+  ret i32 %j
+}
+
+; CHECK: define i32 @scale5(i32 %x)
+; CHECK-NEXT: tail call i32 @scale3.merged(i32 %x, i32 5)
+define i32 @scale5(i32 %x) {
+  %a = mul i32 %x, 5
+  %b = add i32 %a, 1
+  %c = xor i32 %b, %x
+  %d = lshr i32 %c, 2
+  %e = and i32 %d, %b
+  %f = or i32 %e, %a
+  %g = sub i32 %f, %c
+  %h = shl i32 %g, 3
+  %i = xor i32 %h, %d
+  %j = add i32 %i, %e
+  ret i32 %j
+}
+
+; CHECK-NOT: define internal void @log_a
+; CHECK-NOT: define internal void @log_b
+define internal void @log_a(i32 %x) {
+  %a = add i32 %x, 1
+  call void @sink(i32 %a)
+  %b = add i32 %x, 2
+  call void @sink(i32 %b)
+  %c = add i32 %x, 3
+  call void @sink(i32 %c)
+  ret void
+}
+
+define internal void @log_b(i32 %x) {
+  %a = add i32 %x, 1
+  call void @sink2(i32 %a)
+  %b = add i32 %x, 2
+  call void @sink2(i32 %b)
+  %c = add i32 %x, 3
+  call void @sink2(i32 %c)
+  ret void
+}
+
+; CHECK: define void @caller(i32 %x)
+; CHECK-NEXT: call void @log_a.merged(i32 %x, void (i32)* @sink)
+; CHECK-NEXT: call void @log_a.merged(i32 %x, void (i32)* @sink2)
+define void @caller(i32 %x) {
+  call void @log_a(i32 %x)
+  call void @log_b(i32 %x)
+  ret void
+}
+
+; The switch case values have to stay constant.
+; CHECK: define i32 @switch1(
+; CHECK-NEXT: switch
+; CHECK: define i32 @switch2(
+; CHECK-NEXT: switch
+define i32 @switch1(i32 %x) {
+  switch i32 %x, label %d [ i32 1, label %a ]
+a:
+  ret i32 0
+d:
+  ret i32 1
+}
+
+define i32 @switch2(i32 %x) {
+  switch i32 %x, label %d [ i32 2, label %a ]
+a:
+  ret i32 0
+d:
+  ret i32 1
+}
+
+; @ping and @pong only differ in a constant, but call each other. In a shared
+; body the call would always go to the same one of them.
+; CHECK: define internal i32 @ping(
+; CHECK: call i32 @pong(
+; CHECK: define internal i32 @pong(
+; CHECK: call i32 @ping(
+; CHECK: define i32 @use_ping_pong(
+; CHECK-NEXT: call i32 @ping(
+; CHECK-NEXT: call i32 @pong(
+define internal i32 @ping(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %done, label %rec
+rec:
+  %y = sub i32 %x, 1
+  %r = call i32 @pong(i32 %y)
+  %s = add i32 %r, 10
+  %t = mul i32 %s, %x
+  %u = xor i32 %t, %y
+  ret i32 %u
+done:
+  ret i32 1
+}
+
+define internal i32 @pong(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 0
+  br i1 %c, label %done, label %rec
+rec:
+  %y = sub i32 %x, 1
+  %r = call i32 @ping(i32 %y)
+  %s = add i32 %r, 20
+  %t = mul i32 %s, %x
+  %u = xor i32 %t, %y
+  ret i32 %u
+done:
+  ret i32 1
+}
+
+define i32 @use_ping_pong(i32 %x) {
+  %a = call i32 @ping(i32 %x)
+  %b = call i32 @pong(i32 %x)
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+; CHECK: define internal void @log_a.merged(i32 %x, void (i32)*)
+; CHECK-NEXT: %a = add i32 %x, 1
+; CHECK-NEXT: call void %0(i32 %a)
+
+; CHECK: define internal i32 @scale3.merged(i32 %x, i32)
+; CHECK-NEXT: %a = mul i32 %x, %0
+
+; CHECK: 2 mergefunc - Number of functions merged with extra parameters
+; CHECK: 2 mergefunc - Number of parameters added to merged functions
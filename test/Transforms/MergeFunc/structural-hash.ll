@@ -0,0 +1,48 @@
+; REQUIRES: asserts
+; RUN: opt -mergefunc -stats -S < %s 2>&1 | FileCheck %s
+
+; Functions that share a signature but differ in their bodies should be told
+; apart by the hash without a full comparison. Only @add_twice needs to be
+; compared against @add, and it is merged.
+
+; CHECK: define i32 @add(i32 %x, i32 %y)
+; CHECK: define i32 @sub(i32 %x, i32 %y)
+; CHECK: define i32 @mul(i32 %x, i32 %y)
+; CHECK: define i32 @select(i32 %x, i32 %y)
+; CHECK: define i32 @add_twice(i32, i32)
+; CHECK-NEXT: tail call i32 @add
+; CHECK: 1 mergefunc - Number of full function comparisons
+; CHECK: 1 mergefunc - Number of functions merged
+
+define i32 @add(i32 %x, i32 %y) {
+  %a = add i32 %x, %y
+  %b = add i32 %a, %y
+  ret i32 %b
+}
+
+define i32 @sub(i32 %x, i32 %y) {
+  %a = sub i32 %x, %y
+  %b = sub i32 %a, %y
+  ret i32 %b
+}
+
+define i32 @mul(i32 %x, i32 %y) {
+  %a = mul nsw i32 %x, %y
+  %b = mul nsw i32 %a, %y
+  ret i32 %b
+}
+
+define i32 @select(i32 %x, i32 %y) {
+  %c = icmp slt i32 %x, %y
+  br i1 %c, label %t, label %f
+t:
+  ret i32 %x
+f:
+  ret i32 %y
+}
+
+define i32 @add_twice(i32 %x, i32 %y) {
+  %a = add i32 %x, %y
+  %b = add i32 %a, %y
+  ret i32 %b
+}
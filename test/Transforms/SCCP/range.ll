@@ -0,0 +1,52 @@
+; RUN: opt < %s -sccp -S | FileCheck %s
+
+; Values that are not constant still have a range, which can decide compares.
+
+define i1 @phi_range(i1 %c) {
+entry:
+  br i1 %c, label %a, label %b
+a:
+  br label %m
+b:
+  br label %m
+m:
+  %p = phi i32 [ 1, %a ], [ 2, %b ]
+  %x = add i32 %p, 10
+  %r = icmp ult i32 %x, 20
+  ret i1 %r
+}
+; CHECK: @phi_range
+; CHECK: %x = add i32 %p, 10
+; CHECK-NEXT: ret i1 true
+
+define i32 @masked(i32 %a) {
+entry:
+  %m = and i32 %a, 15
+  %z = zext i32 %m to i64
+  %c = icmp ugt i64 %z, 15
+  br i1 %c, label %dead, label %live
+dead:
+  ret i32 1
+live:
+  ret i32 0
+}
+; CHECK: @masked
+; CHECK: br i1 false, label %dead, label %live
+
+; The range of a value carried around a loop is given up on after a few
+; steps, so nothing is known about %i here.
+define i32 @loop(i32 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %big = icmp ult i32 %i, 100
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+exit:
+  %r = zext i1 %big to i32
+  ret i32 %r
+}
+; CHECK: @loop
+; CHECK: %big = icmp ult i32 %i, 100
@@ -0,0 +1,76 @@
+; RUN: opt < %s -basicaa -slp-vectorizer -dce -S -mtriple=x86_64-apple-macosx10.8.0 -mcpu=corei7-avx | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+; c[0] = a[0] + b[0]; c[1] = a[1] - b[1]; c[2] = a[2] + b[2]; c[3] = a[3] - b[3];
+; The lanes are computed with a vector add and a vector sub and blended.
+; CHECK: @addsub
+; CHECK: %[[ADD:.*]] = fadd <4 x float>
+; CHECK: %[[SUB:.*]] = fsub <4 x float>
+; CHECK: shufflevector <4 x float> %[[ADD]], <4 x float> %[[SUB]], <4 x i32> <i32 0, i32 5, i32 2, i32 7>
+; CHECK: store <4 x float>
+; CHECK: ret void
+define void @addsub(float* noalias nocapture %a, float* noalias nocapture %b, float* noalias nocapture %c) {
+entry:
+  %a0 = load float* %a, align 4
+  %b0 = load float* %b, align 4
+  %r0 = fadd float %a0, %b0
+  store float %r0, float* %c, align 4
+  %pa1 = getelementptr inbounds float* %a, i64 1
+  %pb1 = getelementptr inbounds float* %b, i64 1
+  %pc1 = getelementptr inbounds float* %c, i64 1
+  %a1 = load float* %pa1, align 4
+  %b1 = load float* %pb1, align 4
+  %r1 = fsub float %a1, %b1
+  store float %r1, float* %pc1, align 4
+  %pa2 = getelementptr inbounds float* %a, i64 2
+  %pb2 = getelementptr inbounds float* %b, i64 2
+  %pc2 = getelementptr inbounds float* %c, i64 2
+  %a2 = load float* %pa2, align 4
+  %b2 = load float* %pb2, align 4
+  %r2 = fadd float %a2, %b2
+  store float %r2, float* %pc2, align 4
+  %pa3 = getelementptr inbounds float* %a, i64 3
+  %pb3 = getelementptr inbounds float* %b, i64 3
+  %pc3 = getelementptr inbounds float* %c, i64 3
+  %a3 = load float* %pa3, align 4
+  %b3 = load float* %pb3, align 4
+  %r3 = fsub float %a3, %b3
+  store float %r3, float* %pc3, align 4
+  ret void
+}
+
+; Other mixes of opcodes are not vectorized.
+; CHECK: @addmul
+; CHECK-NOT: <4 x float>
+; CHECK: ret void
+define void @addmul(float* noalias nocapture %a, float* noalias nocapture %b, float* noalias nocapture %c) {
+entry:
+  %a0 = load float* %a, align 4
+  %b0 = load float* %b, align 4
+  %r0 = fadd float %a0, %b0
+  store float %r0, float* %c, align 4
+  %pa1 = getelementptr inbounds float* %a, i64 1
+  %pb1 = getelementptr inbounds float* %b, i64 1
+  %pc1 = getelementptr inbounds float* %c, i64 1
+  %a1 = load float* %pa1, align 4
+  %b1 = load float* %pb1, align 4
+  %r1 = fmul float %a1, %b1
+  store float %r1, float* %pc1, align 4
+  %pa2 = getelementptr inbounds float* %a, i64 2
+  %pb2 = getelementptr inbounds float* %b, i64 2
+  %pc2 = getelementptr inbounds float* %c, i64 2
+  %a2 = load float* %pa2, align 4
+  %b2 = load float* %pb2, align 4
+  %r2 = fadd float %a2, %b2
+  store float %r2, float* %pc2, align 4
+  %pa3 = getelementptr inbounds float* %a, i64 3
+  %pb3 = getelementptr inbounds float* %b, i64 3
+  %pc3 = getelementptr inbounds float* %c, i64 3
+  %a3 = load float* %pa3, align 4
+  %b3 = load float* %pb3, align 4
+  %r3 = fmul float %a3, %b3
+  store float %r3, float* %pc3, align 4
+  ret void
+}
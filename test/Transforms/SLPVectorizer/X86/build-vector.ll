@@ -0,0 +1,54 @@
+; RUN: opt < %s -basicaa -slp-vectorizer -dce -S -mtriple=x86_64-apple-macosx10.8.0 -mcpu=corei7-avx | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+; The scalars that are inserted into the vector are computed with vector
+; operations, which makes the insertelement instructions dead.
+; CHECK: @build_vec
+; CHECK: load <4 x float>
+; CHECK: load <4 x float>
+; CHECK: fmul <4 x float>
+; CHECK-NOT: insertelement
+; CHECK: ret <4 x float>
+define <4 x float> @build_vec(float* nocapture %a, float* nocapture %b) {
+entry:
+  %a0 = load float* %a, align 4
+  %b0 = load float* %b, align 4
+  %m0 = fmul float %a0, %b0
+  %pa1 = getelementptr inbounds float* %a, i64 1
+  %pb1 = getelementptr inbounds float* %b, i64 1
+  %a1 = load float* %pa1, align 4
+  %b1 = load float* %pb1, align 4
+  %m1 = fmul float %a1, %b1
+  %pa2 = getelementptr inbounds float* %a, i64 2
+  %pb2 = getelementptr inbounds float* %b, i64 2
+  %a2 = load float* %pa2, align 4
+  %b2 = load float* %pb2, align 4
+  %m2 = fmul float %a2, %b2
+  %pa3 = getelementptr inbounds float* %a, i64 3
+  %pb3 = getelementptr inbounds float* %b, i64 3
+  %a3 = load float* %pa3, align 4
+  %b3 = load float* %pb3, align 4
+  %m3 = fmul float %a3, %b3
+  %v0 = insertelement <4 x float> undef, float %m0, i32 0
+  %v1 = insertelement <4 x float> %v0, float %m1, i32 1
+  %v2 = insertelement <4 x float> %v1, float %m2, i32 2
+  %v3 = insertelement <4 x float> %v2, float %m3, i32 3
+  ret <4 x float> %v3
+}
+
+; Only part of the vector is written.
+; CHECK: @partial
+; CHECK-NOT: fmul <
+; CHECK: ret <4 x float>
+define <4 x float> @partial(float %a, float %b, float %c) {
+entry:
+  %m0 = fmul float %a, %b
+  %m1 = fmul float %a, %c
+  %m2 = fmul float %b, %c
+  %v0 = insertelement <4 x float> undef, float %m0, i32 0
+  %v1 = insertelement <4 x float> %v0, float %m1, i32 1
+  %v2 = insertelement <4 x float> %v1, float %m2, i32 2
+  ret <4 x float> %v2
+}
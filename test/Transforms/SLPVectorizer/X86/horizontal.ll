@@ -0,0 +1,85 @@
+; RUN: opt < %s -basicaa -slp-vectorizer -dce -S -mtriple=x86_64-apple-macosx10.8.0 -mcpu=corei7-avx | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.8.0"
+
+; int sum8(int *a) {
+;   return a[0] + a[1] + a[2] + a[3] + a[4] + a[5] + a[6] + a[7];
+; }
+
+; CHECK: @sum8
+; CHECK: load <4 x i32>
+; CHECK: load <4 x i32>
+; CHECK: add <4 x i32>
+; CHECK: shufflevector <4 x i32>
+; CHECK: add <4 x i32>
+; CHECK: shufflevector <4 x i32>
+; CHECK: add <4 x i32>
+; CHECK: extractelement <4 x i32>
+; CHECK-NOT: add i32
+; CHECK: ret i32
+define i32 @sum8(i32* nocapture %a) {
+entry:
+  %0 = load i32* %a, align 4
+  %arrayidx1 = getelementptr inbounds i32* %a, i64 1
+  %1 = load i32* %arrayidx1, align 4
+  %add = add nsw i32 %1, %0
+  %arrayidx2 = getelementptr inbounds i32* %a, i64 2
+  %2 = load i32* %arrayidx2, align 4
+  %add3 = add nsw i32 %add, %2
+  %arrayidx4 = getelementptr inbounds i32* %a, i64 3
+  %3 = load i32* %arrayidx4, align 4
+  %add5 = add nsw i32 %add3, %3
+  %arrayidx6 = getelementptr inbounds i32* %a, i64 4
+  %4 = load i32* %arrayidx6, align 4
+  %add7 = add nsw i32 %add5, %4
+  %arrayidx8 = getelementptr inbounds i32* %a, i64 5
+  %5 = load i32* %arrayidx8, align 4
+  %add9 = add nsw i32 %add7, %5
+  %arrayidx10 = getelementptr inbounds i32* %a, i64 6
+  %6 = load i32* %arrayidx10, align 4
+  %add11 = add nsw i32 %add9, %6
+  %arrayidx12 = getelementptr inbounds i32* %a, i64 7
+  %7 = load i32* %arrayidx12, align 4
+  %add13 = add nsw i32 %add11, %7
+  ret i32 %add13
+}
+
+; Floating point additions may only be reassociated under fast-math.
+; CHECK: @fsum4_fast
+; CHECK: load <4 x float>
+; CHECK: shufflevector <4 x float>
+; CHECK: fadd fast <4 x float>
+; CHECK: ret float
+define float @fsum4_fast(float* nocapture %a) {
+entry:
+  %0 = load float* %a, align 4
+  %arrayidx1 = getelementptr inbounds float* %a, i64 1
+  %1 = load float* %arrayidx1, align 4
+  %add = fadd fast float %0, %1
+  %arrayidx2 = getelementptr inbounds float* %a, i64 2
+  %2 = load float* %arrayidx2, align 4
+  %add3 = fadd fast float %add, %2
+  %arrayidx4 = getelementptr inbounds float* %a, i64 3
+  %3 = load float* %arrayidx4, align 4
+  %add5 = fadd fast float %add3, %3
+  ret float %add5
+}
+
+; CHECK: @fsum4
+; CHECK-NOT: <4 x float>
+; CHECK: ret float
+define float @fsum4(float* nocapture %a) {
+entry:
+  %0 = load float* %a, align 4
+  %arrayidx1 = getelementptr inbounds float* %a, i64 1
+  %1 = load float* %arrayidx1, align 4
+  %add = fadd float %0, %1
+  %arrayidx2 = getelementptr inbounds float* %a, i64 2
+  %2 = load float* %arrayidx2, align 4
+  %add3 = fadd float %add, %2
+  %arrayidx4 = getelementptr inbounds float* %a, i64 3
+  %3 = load float* %arrayidx4, align 4
+  %add5 = fadd float %add3, %3
+  ret float %add5
+}
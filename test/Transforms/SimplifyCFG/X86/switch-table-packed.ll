@@ -0,0 +1,351 @@
+; RUN: opt < %s -simplifycfg -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; Tables of small values are packed several elements to a word when that
+; makes them much smaller.
+; CHECK: @switch.table = private unnamed_addr constant [2 x i64] [i64 7053846767346982966, i64 53284]
+; A small table is left alone unless optimizing for size.
+; CHECK: @switch.table1 = private unnamed_addr constant [12 x i32]
+; CHECK: @switch.table2 = private unnamed_addr constant [1 x i64] [i64 14768891]
+
+; CHECK: @packed
+; CHECK: switch.lookup:
+; CHECK-NEXT: %switch.cast = zext i32 %switch.tableidx to i64
+; CHECK-NEXT: %switch.wordidx = lshr i64 %switch.cast, 5
+; CHECK-NEXT: %switch.gep = getelementptr inbounds [2 x i64]* @switch.table, i32 0, i64 %switch.wordidx
+; CHECK-NEXT: %switch.load = load i64* %switch.gep
+; CHECK-NEXT: %switch.pos = and i64 %switch.cast, 31
+; CHECK-NEXT: %switch.shiftamt = shl i64 %switch.pos, 1
+; CHECK-NEXT: %switch.downshift = lshr i64 %switch.load, %switch.shiftamt
+; CHECK-NEXT: %switch.masked = trunc i64 %switch.downshift to i2
+; CHECK-NEXT: %switch.zext = zext i2 %switch.masked to i32
+; CHECK-NEXT: ret i32 %switch.zext
+
+; CHECK: @speed
+; CHECK: %switch.gep = getelementptr inbounds [12 x i32]* @switch.table1, i32 0, i32 %switch.tableidx
+; CHECK-NEXT: %switch.load = load i32* %switch.gep
+; CHECK-NEXT: ret i32 %switch.load
+
+; CHECK: @size
+; CHECK: %switch.gep = getelementptr inbounds [1 x i64]* @switch.table2, i32 0, i64 %switch.wordidx
+; CHECK: %switch.zext = zext i2 %switch.masked to i32
+; CHECK-NEXT: ret i32 %switch.zext
+
+define i32 @packed(i32 %c) {
+entry:
+  switch i32 %c, label %sw.default [
+    i32 0, label %sw.bb0
+    i32 1, label %sw.bb1
+    i32 2, label %sw.bb2
+    i32 3, label %sw.bb3
+    i32 4, label %sw.bb4
+    i32 5, label %sw.bb5
+    i32 6, label %sw.bb6
+    i32 7, label %sw.bb7
+    i32 8, label %sw.bb8
+    i32 9, label %sw.bb9
+    i32 10, label %sw.bb10
+    i32 11, label %sw.bb11
+    i32 12, label %sw.bb12
+    i32 13, label %sw.bb13
+    i32 14, label %sw.bb14
+    i32 15, label %sw.bb15
+    i32 16, label %sw.bb16
+    i32 17, label %sw.bb17
+    i32 18, label %sw.bb18
+    i32 19, label %sw.bb19
+    i32 20, label %sw.bb20
+    i32 21, label %sw.bb21
+    i32 22, label %sw.bb22
+    i32 23, label %sw.bb23
+    i32 24, label %sw.bb24
+    i32 25, label %sw.bb25
+    i32 26, label %sw.bb26
+    i32 27, label %sw.bb27
+    i32 28, label %sw.bb28
+    i32 29, label %sw.bb29
+    i32 30, label %sw.bb30
+    i32 31, label %sw.bb31
+    i32 32, label %sw.bb32
+    i32 33, label %sw.bb33
+    i32 34, label %sw.bb34
+    i32 35, label %sw.bb35
+    i32 36, label %sw.bb36
+    i32 37, label %sw.bb37
+    i32 38, label %sw.bb38
+    i32 39, label %sw.bb39
+  ]
+sw.bb0:
+  br label %return
+sw.bb1:
+  br label %return
+sw.bb2:
+  br label %return
+sw.bb3:
+  br label %return
+sw.bb4:
+  br label %return
+sw.bb5:
+  br label %return
+sw.bb6:
+  br label %return
+sw.bb7:
+  br label %return
+sw.bb8:
+  br label %return
+sw.bb9:
+  br label %return
+sw.bb10:
+  br label %return
+sw.bb11:
+  br label %return
+sw.bb12:
+  br label %return
+sw.bb13:
+  br label %return
+sw.bb14:
+  br label %return
+sw.bb15:
+  br label %return
+sw.bb16:
+  br label %return
+sw.bb17:
+  br label %return
+sw.bb18:
+  br label %return
+sw.bb19:
+  br label %return
+sw.bb20:
+  br label %return
+sw.bb21:
+  br label %return
+sw.bb22:
+  br label %return
+sw.bb23:
+  br label %return
+sw.bb24:
+  br label %return
+sw.bb25:
+  br label %return
+sw.bb26:
+  br label %return
+sw.bb27:
+  br label %return
+sw.bb28:
+  br label %return
+sw.bb29:
+  br label %return
+sw.bb30:
+  br label %return
+sw.bb31:
+  br label %return
+sw.bb32:
+  br label %return
+sw.bb33:
+  br label %return
+sw.bb34:
+  br label %return
+sw.bb35:
+  br label %return
+sw.bb36:
+  br label %return
+sw.bb37:
+  br label %return
+sw.bb38:
+  br label %return
+sw.bb39:
+  br label %return
+sw.default:
+  br label %return
+return:
+  %retval.0 = phi i32 [ 2, %sw.bb0 ], [ 1, %sw.bb1 ], [ 3, %sw.bb2 ], [ 0, %sw.bb3 ], [ 0, %sw.bb4 ], [ 0, %sw.bb5 ], [ 2, %sw.bb6 ], [ 0, %sw.bb7 ], [ 1, %sw.bb8 ], [ 0, %sw.bb9 ], [ 0, %sw.bb10 ], [ 3, %sw.bb11 ], [ 3, %sw.bb12 ], [ 0, %sw.bb13 ], [ 1, %sw.bb14 ], [ 0, %sw.bb15 ], [ 3, %sw.bb16 ], [ 0, %sw.bb17 ], [ 0, %sw.bb18 ], [ 1, %sw.bb19 ], [ 0, %sw.bb20 ], [ 3, %sw.bb21 ], [ 0, %sw.bb22 ], [ 1, %sw.bb23 ], [ 0, %sw.bb24 ], [ 1, %sw.bb25 ], [ 2, %sw.bb26 ], [ 3, %sw.bb27 ], [ 1, %sw.bb28 ], [ 0, %sw.bb29 ], [ 2, %sw.bb30 ], [ 1, %sw.bb31 ], [ 0, %sw.bb32 ], [ 1, %sw.bb33 ], [ 2, %sw.bb34 ], [ 0, %sw.bb35 ], [ 0, %sw.bb36 ], [ 0, %sw.bb37 ], [ 1, %sw.bb38 ], [ 3, %sw.bb39 ], [ 0, %sw.default ]
+  ret i32 %retval.0
+}
+
+define i32 @speed(i32 %c) {
+entry:
+  switch i32 %c, label %sw.default [
+    i32 0, label %sw.bb0
+    i32 1, label %sw.bb1
+    i32 2, label %sw.bb2
+    i32 3, label %sw.bb3
+    i32 4, label %sw.bb4
+    i32 5, label %sw.bb5
+    i32 6, label %sw.bb6
+    i32 7, label %sw.bb7
+    i32 8, label %sw.bb8
+    i32 9, label %sw.bb9
+    i32 10, label %sw.bb10
+    i32 11, label %sw.bb11
+  ]
+sw.bb0:
+  br label %return
+sw.bb1:
+  br label %return
+sw.bb2:
+  br label %return
+sw.bb3:
+  br label %return
+sw.bb4:
+  br label %return
+sw.bb5:
+  br label %return
+sw.bb6:
+  br label %return
+sw.bb7:
+  br label %return
+sw.bb8:
+  br label %return
+sw.bb9:
+  br label %return
+sw.bb10:
+  br label %return
+sw.bb11:
+  br label %return
+sw.default:
+  br label %return
+return:
+  %retval.0 = phi i32 [ 3, %sw.bb0 ], [ 2, %sw.bb1 ], [ 3, %sw.bb2 ], [ 3, %sw.bb3 ], [ 2, %sw.bb4 ], [ 2, %sw.bb5 ], [ 1, %sw.bb6 ], [ 1, %sw.bb7 ], [ 1, %sw.bb8 ], [ 0, %sw.bb9 ], [ 2, %sw.bb10 ], [ 3, %sw.bb11 ], [ 0, %sw.default ]
+  ret i32 %retval.0
+}
+
+define i32 @size(i32 %c) optsize {
+entry:
+  switch i32 %c, label %sw.default [
+    i32 0, label %sw.bb0
+    i32 1, label %sw.bb1
+    i32 2, label %sw.bb2
+    i32 3, label %sw.bb3
+    i32 4, label %sw.bb4
+    i32 5, label %sw.bb5
+    i32 6, label %sw.bb6
+    i32 7, label %sw.bb7
+    i32 8, label %sw.bb8
+    i32 9, label %sw.bb9
+    i32 10, label %sw.bb10
+    i32 11, label %sw.bb11
+  ]
+sw.bb0:
+  br label %return
+sw.bb1:
+  br label %return
+sw.bb2:
+  br label %return
+sw.bb3:
+  br label %return
+sw.bb4:
+  br label %return
+sw.bb5:
+  br label %return
+sw.bb6:
+  br label %return
+sw.bb7:
+  br label %return
+sw.bb8:
+  br label %return
+sw.bb9:
+  br label %return
+sw.bb10:
+  br label %return
+sw.bb11:
+  br label %return
+sw.default:
+  br label %return
+return:
+  %retval.0 = phi i32 [ 3, %sw.bb0 ], [ 2, %sw.bb1 ], [ 3, %sw.bb2 ], [ 3, %sw.bb3 ], [ 2, %sw.bb4 ], [ 2, %sw.bb5 ], [ 1, %sw.bb6 ], [ 1, %sw.bb7 ], [ 1, %sw.bb8 ], [ 0, %sw.bb9 ], [ 2, %sw.bb10 ], [ 3, %sw.bb11 ], [ 0, %sw.default ]
+  ret i32 %retval.0
+}
+
+; The index is widened before it is shifted by more than its own width.
+; CHECK: @narrow_index
+; CHECK: switch.lookup:
+; CHECK-NEXT: %switch.cast = zext i4 %switch.tableidx to i64
+; CHECK-NEXT: %switch.wordidx = lshr i64 %switch.cast, 5
+; CHECK: %switch.pos = and i64 %switch.cast, 31
+define i32 @narrow_index(i4 %c) optsize {
+entry:
+  switch i4 %c, label %sw.default [
+    i4 0, label %sw.bb0
+    i4 1, label %sw.bb1
+    i4 2, label %sw.bb2
+    i4 3, label %sw.bb3
+    i4 4, label %sw.bb4
+    i4 5, label %sw.bb5
+    i4 6, label %sw.bb6
+  ]
+sw.bb0:
+  br label %return
+sw.bb1:
+  br label %return
+sw.bb2:
+  br label %return
+sw.bb3:
+  br label %return
+sw.bb4:
+  br label %return
+sw.bb5:
+  br label %return
+sw.bb6:
+  br label %return
+sw.default:
+  br label %return
+return:
+  %retval.0 = phi i32 [ 3, %sw.bb0 ], [ 2, %sw.bb1 ], [ 3, %sw.bb2 ], [ 3, %sw.bb3 ], [ 2, %sw.bb4 ], [ 2, %sw.bb5 ], [ 1, %sw.bb6 ], [ 0, %sw.default ]
+  ret i32 %retval.0
+}
+; A sparse switch is turned into a table when optimizing for size, as long as
+; the table is smaller than the code it replaces.
+; CHECK: @sparse_size
+; CHECK-NOT: switch i32
+; CHECK: switch.lookup:
+define i32 @sparse_size(i32 %c) optsize {
+entry:
+  switch i32 %c, label %sw.default [
+    i32 0, label %sw.bb0
+    i32 4, label %sw.bb1
+    i32 9, label %sw.bb2
+    i32 12, label %sw.bb3
+  ]
+sw.bb0:
+  br label %return
+sw.bb1:
+  br label %return
+sw.bb2:
+  br label %return
+sw.bb3:
+  br label %return
+sw.default:
+  br label %return
+return:
+  %retval.0 = phi i8 [ 7, %sw.bb0 ], [ 11, %sw.bb1 ], [ -3, %sw.bb2 ], [ 5, %sw.bb3 ], [ 0, %sw.default ]
+  %r = sext i8 %retval.0 to i32
+  ret i32 %r
+}
+
+; CHECK: @sparse_speed
+; CHECK: switch i32
+define i32 @sparse_speed(i32 %c) {
+entry:
+  switch i32 %c, label %sw.default [
+    i32 0, label %sw.bb0
+    i32 4, label %sw.bb1
+    i32 9, label %sw.bb2
+    i32 12, label %sw.bb3
+  ]
+sw.bb0:
+  br label %return
+sw.bb1:
+  br label %return
+sw.bb2:
+  br label %return
+sw.bb3:
+  br label %return
+sw.default:
+  br label %return
+return:
+  %retval.0 = phi i8 [ 7, %sw.bb0 ], [ 11, %sw.bb1 ], [ -3, %sw.bb2 ], [ 5, %sw.bb3 ], [ 0, %sw.default ]
+  %r = sext i8 %retval.0 to i32
+  ret i32 %r
+}
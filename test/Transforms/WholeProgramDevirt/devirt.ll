@@ -0,0 +1,179 @@
+; RUN: opt < %s -wholeprogramdevirt -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+%struct.A = type { i32 (...)** }
+
+; Two classes: B overrides f and h, and inherits g from A.
+@vtA = internal unnamed_addr constant [5 x i8*] [i8* null, i8* null, i8* bitcast (i32 (%struct.A*)* @A_f to i8*), i8* bitcast (i32 (%struct.A*)* @A_g to i8*), i8* bitcast (i64 (%struct.A*, i64)* @A_h to i8*)]
+@vtB = internal unnamed_addr constant [5 x i8*] [i8* null, i8* null, i8* bitcast (i32 (%struct.A*)* @B_f to i8*), i8* bitcast (i32 (%struct.A*)* @A_g to i8*), i8* bitcast (i64 (%struct.A*, i64)* @B_h to i8*)]
+
+; A function of the same type as h escapes, so calls to h are left alone.
+@hook = global i64 (%struct.A*, i64)* @other_h
+
+define void @ctorA(%struct.A* %this) {
+  %vptr = getelementptr inbounds %struct.A* %this, i64 0, i32 0
+  store i32 (...)** bitcast (i8** getelementptr inbounds ([5 x i8*]* @vtA, i64 0, i64 2) to i32 (...)**), i32 (...)*** %vptr
+  ret void
+}
+
+define void @ctorB(%struct.A* %this) {
+  %vptr = getelementptr inbounds %struct.A* %this, i64 0, i32 0
+  store i32 (...)** bitcast (i8** getelementptr inbounds ([5 x i8*]* @vtB, i64 0, i64 2) to i32 (...)**), i32 (...)*** %vptr
+  ret void
+}
+
+define internal i32 @A_f(%struct.A* %this) {
+  ret i32 1
+}
+
+define internal i32 @B_f(%struct.A* %this) {
+  ret i32 2
+}
+
+define internal i32 @A_g(%struct.A* %this) {
+  ret i32 3
+}
+
+define internal i64 @A_h(%struct.A* %this, i64 %x) {
+  ret i64 %x
+}
+
+define internal i64 @B_h(%struct.A* %this, i64 %x) {
+  ret i64 0
+}
+
+define internal i64 @other_h(%struct.A* %this, i64 %x) {
+  ret i64 1
+}
+
+; g has a single implementation in this module, but the object may have been
+; built elsewhere, so the indirect call stays as the fallback.
+define void @call_g(%struct.A* %a, i32* %out) {
+entry:
+  %0 = bitcast %struct.A* %a to i32 (%struct.A*)***
+  %vtable = load i32 (%struct.A*)*** %0
+  %vfn = getelementptr inbounds i32 (%struct.A*)** %vtable, i64 1
+  %fp = load i32 (%struct.A*)** %vfn
+  %call = call i32 %fp(%struct.A* %a)
+  store i32 %call, i32* %out
+  ret void
+}
+; CHECK: define void @call_g(
+; CHECK: %devirt.cmp = icmp eq i32 (%struct.A*)* %fp, @A_g
+; CHECK-NEXT: br i1 %devirt.cmp, label %devirt.direct, label %devirt.indirect
+; CHECK: devirt.direct:
+; CHECK-NEXT: %{{.*}} = call i32 @A_g(%struct.A* %a)
+; CHECK: devirt.indirect:
+; CHECK-NEXT: call i32 %fp(%struct.A* %a)
+
+; f has two, so each gets a direct call behind a compare.
+define void @call_f(%struct.A* %a, i32* %out) {
+entry:
+  %0 = bitcast %struct.A* %a to i32 (%struct.A*)***
+  %vtable = load i32 (%struct.A*)*** %0
+  %fp = load i32 (%struct.A*)** %vtable
+  %call = call i32 %fp(%struct.A* %a)
+  store i32 %call, i32* %out
+  ret void
+}
+; CHECK: define void @call_f(
+; CHECK: %devirt.cmp = icmp eq i32 (%struct.A*)* %fp, @A_f
+; CHECK-NEXT: br i1 %devirt.cmp, label %devirt.direct, label %devirt.next
+; CHECK: devirt.direct:
+; CHECK-NEXT: %{{.*}} = call i32 @A_f(%struct.A* %a)
+; CHECK-NEXT: br label %devirt.cont
+; CHECK: devirt.next:
+; CHECK-NEXT: %devirt.cmp{{.*}} = icmp eq i32 (%struct.A*)* %fp, @B_f
+; CHECK: call i32 @B_f(%struct.A* %a)
+; CHECK: devirt.indirect:
+; CHECK-NEXT: call i32 %fp(%struct.A* %a)
+; CHECK: devirt.cont:
+; CHECK-NEXT: %call = phi i32
+
+define void @call_h(%struct.A* %a, i64* %out) {
+entry:
+  %0 = bitcast %struct.A* %a to i64 (%struct.A*, i64)***
+  %vtable = load i64 (%struct.A*, i64)*** %0
+  %vfn = getelementptr inbounds i64 (%struct.A*, i64)** %vtable, i64 2
+  %fp = load i64 (%struct.A*, i64)** %vfn
+  %call = call i64 %fp(%struct.A* %a, i64 5)
+  store i64 %call, i64* %out
+  ret void
+}
+; CHECK: define void @call_h(
+; CHECK-NOT: devirt
+; CHECK: %call = call i64 %fp(%struct.A* %a, i64 5)
+; CHECK: ret void
+
+; Reading a table directly gives exactly one entry.
+define i64 @call_direct(%struct.A* %a) {
+entry:
+  %fp = load i64 (%struct.A*, i64)** bitcast (i8** getelementptr inbounds ([5 x i8*]* @vtB, i64 0, i64 4) to i64 (%struct.A*, i64)**)
+  %call = call i64 %fp(%struct.A* %a, i64 7)
+  ret i64 %call
+}
+; CHECK: define i64 @call_direct(
+; CHECK: %call = call i64 @B_h(%struct.A* %a, i64 7)
+
+; An object from a factory outside the module may have a vtable that is not
+; among the address points here.
+declare %struct.A* @lib_make_exception()
+
+define i32 @call_external() {
+entry:
+  %a = call %struct.A* @lib_make_exception()
+  %0 = bitcast %struct.A* %a to i32 (%struct.A*)***
+  %vtable = load i32 (%struct.A*)*** %0
+  %vfn = getelementptr inbounds i32 (%struct.A*)** %vtable, i64 1
+  %fp = load i32 (%struct.A*)** %vfn
+  %call = call i32 %fp(%struct.A* %a)
+  ret i32 %call
+}
+; CHECK: define i32 @call_external(
+; CHECK: %devirt.cmp = icmp eq i32 (%struct.A*)* %fp, @A_g
+; CHECK: call i32 @A_g(%struct.A* %a)
+; CHECK: devirt.indirect:
+; CHECK-NEXT: call i32 %fp(%struct.A* %a)
+; CHECK: devirt.cont:
+; CHECK-NEXT: %call = phi i32
+; CHECK-NEXT: ret i32 %call
+
+; @vtW is indexed with a variable, so a call through a vtable pointer may reach
+; any entry of it. The targets are tried in the order of the table.
+@vtW = internal unnamed_addr constant [3 x i8*] [i8* bitcast (i8 (%struct.A*)* @W_c to i8*), i8* bitcast (i8 (%struct.A*)* @W_a to i8*), i8* bitcast (i8 (%struct.A*)* @W_b to i8*)]
+
+define internal i8 @W_a(%struct.A* %this) {
+  ret i8 1
+}
+
+define internal i8 @W_b(%struct.A* %this) {
+  ret i8 2
+}
+
+define internal i8 @W_c(%struct.A* %this) {
+  ret i8 3
+}
+
+define void @ctorW(%struct.A* %this, i64 %i) {
+  %vptr = getelementptr inbounds %struct.A* %this, i64 0, i32 0
+  %entry = getelementptr inbounds [3 x i8*]* @vtW, i64 0, i64 %i
+  %vt = bitcast i8** %entry to i32 (...)**
+  store i32 (...)** %vt, i32 (...)*** %vptr
+  ret void
+}
+
+define void @call_w(%struct.A* %a, i8* %out) {
+entry:
+  %0 = bitcast %struct.A* %a to i8 (%struct.A*)***
+  %vtable = load i8 (%struct.A*)*** %0
+  %fp = load i8 (%struct.A*)** %vtable
+  %call = call i8 %fp(%struct.A* %a)
+  store i8 %call, i8* %out
+  ret void
+}
+; CHECK: define void @call_w(
+; CHECK: icmp eq i8 (%struct.A*)* %fp, @W_c
+; CHECK: icmp eq i8 (%struct.A*)* %fp, @W_a
+; CHECK: icmp eq i8 (%struct.A*)* %fp, @W_b
+; CHECK: devirt.indirect:
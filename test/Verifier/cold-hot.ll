@@ -0,0 +1,6 @@
+; RUN: not llvm-as < %s -o /dev/null 2>&1 | FileCheck %s
+
+; CHECK: Attributes 'cold and hot' are incompatible!
+define void @f() cold hot {
+  ret void
+}
@@ -0,0 +1,435 @@
+//===- PeepholeEmitter.cpp - Generate IR peephole matchers ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This tablegen backend compiles the Peephole records described by
+// include/llvm/IR/Peephole.td into a matcher function.  Every pattern is
+// expanded for its commuted forms and flattened into a sequence of checks;
+// the sequences are merged into a tree so that a check shared by several
+// patterns is only performed once.  The tree is emitted as nested ifs below
+// a switch on the opcode of the root.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "peephole-emitter"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TableGen/Error.h"
+#include "llvm/TableGen/Record.h"
+#include "llvm/TableGen/TableGenBackend.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+using namespace llvm;
+
+namespace {
+
+/// PatternNode - A node of a pattern or of a result: a binary operator, a
+/// named operand or an integer literal.
+struct PatternNode {
+  Record *Op;
+  std::string Name;
+  bool IsLiteral;
+  int64_t Literal;
+  bool Commuted;    // The operands are swapped from the pattern as written.
+  std::vector<PatternNode> Children;
+
+  PatternNode() : Op(0), IsLiteral(false), Literal(0), Commuted(false) {}
+};
+
+/// PatternVariant - A pattern, or one of its commuted forms.  Swaps has one
+/// entry per operator, in the order the matcher visits them, telling whether
+/// its operands were swapped.
+struct PatternVariant {
+  unsigned Index;   // Index of the pattern in the file.
+  PatternNode Node;
+  unsigned NumSwaps;
+  std::string Swaps;
+
+  PatternVariant(unsigned I, const PatternNode &N)
+    : Index(I), Node(N), NumSwaps(0) {
+    addSwaps(N);
+  }
+
+  /// Forms with fewer swaps come first; among those, the ones that keep the
+  /// operators visited first as written, since they bind the operand names.
+  bool operator<(const PatternVariant &RHS) const {
+    if (NumSwaps != RHS.NumSwaps)
+      return NumSwaps < RHS.NumSwaps;
+    return Swaps < RHS.Swaps;
+  }
+
+private:
+  void addSwaps(const PatternNode &N) {
+    if (!N.Op)
+      return;
+    Swaps += N.Commuted ? '1' : '0';
+    NumSwaps += N.Commuted;
+    for (unsigned i = 0, e = N.Children.size(); i != e; ++i)
+      addSwaps(N.Children[i]);
+  }
+};
+
+/// MatcherNode - A node of the decision tree.  Each child is entered when its
+/// condition holds.  Action is the code returned once every check on the path
+/// to this node has passed, if some pattern ends here.
+struct MatcherNode {
+  std::vector<std::pair<std::string, MatcherNode*> > Children;
+  std::string Action;
+  std::string Comment;
+
+  ~MatcherNode() {
+    for (unsigned i = 0, e = Children.size(); i != e; ++i)
+      delete Children[i].second;
+  }
+
+  MatcherNode *getChild(const std::string &Cond) {
+    for (unsigned i = 0, e = Children.size(); i != e; ++i)
+      if (Children[i].first == Cond)
+        return Children[i].second;
+    Children.push_back(std::make_pair(Cond, new MatcherNode()));
+    return Children.back().second;
+  }
+};
+
+typedef std::map<std::string, std::string> BindingMap;
+
+class PeepholeEmitter {
+  RecordKeeper &Records;
+
+  /// BuildsInstructions - True if the results create new instructions, as
+  /// InstCombine does, rather than naming existing values.
+  bool BuildsInstructions;
+
+  unsigned NumVariants;
+  unsigned NumChecks;
+
+public:
+  PeepholeEmitter(RecordKeeper &R)
+    : Records(R), BuildsInstructions(false), NumVariants(0), NumChecks(0) {}
+
+  void run(raw_ostream &OS);
+
+private:
+  PatternNode parseNode(Record *R, Init *I, const std::string &Name);
+  void addChecks(const PatternNode &N, const std::string &Val,
+                 const std::string &Path, std::vector<std::string> &Checks,
+                 BindingMap &Bound);
+  std::string getConstantCode(int64_t Value);
+  std::string getResultCode(Record *R, const PatternNode &N,
+                            const BindingMap &Bound, bool IsRoot);
+  MatcherNode *addPattern(MatcherNode *Root,
+                          const std::vector<std::string> &Checks);
+  void emitMatcher(const MatcherNode *N, unsigned Indent, raw_ostream &OS);
+};
+
+} // End anonymous namespace.
+
+static void printNode(const PatternNode &N, raw_ostream &OS) {
+  if (N.IsLiteral) {
+    OS << N.Literal;
+    return;
+  }
+  if (!N.Op) {
+    OS << '$' << N.Name;
+    return;
+  }
+  OS << '(' << N.Op->getName();
+  for (unsigned i = 0, e = N.Children.size(); i != e; ++i) {
+    OS << (i ? ", " : " ");
+    printNode(N.Children[i], OS);
+  }
+  OS << ')';
+}
+
+/// expandCommuted - Append to Out every form of N that is reachable by
+/// swapping the operands of commutative operators.
+static void expandCommuted(const PatternNode &N,
+                           std::vector<PatternNode> &Out) {
+  if (!N.Op) {
+    Out.push_back(N);
+    return;
+  }
+
+  std::vector<PatternNode> LHS, RHS;
+  expandCommuted(N.Children[0], LHS);
+  expandCommuted(N.Children[1], RHS);
+  bool Commutable = N.Op->getValueAsBit("Commutable");
+  for (unsigned i = 0, e = LHS.size(); i != e; ++i)
+    for (unsigned j = 0, je = RHS.size(); j != je; ++j) {
+      PatternNode V = N;
+      V.Children[0] = LHS[i];
+      V.Children[1] = RHS[j];
+      Out.push_back(V);
+      if (Commutable) {
+        std::swap(V.Children[0], V.Children[1]);
+        V.Commuted = true;
+        Out.push_back(V);
+      }
+    }
+}
+
+PatternNode PeepholeEmitter::parseNode(Record *R, Init *I,
+                                       const std::string &Name) {
+  PatternNode N;
+  if (DagInit *D = dyn_cast<DagInit>(I)) {
+    DefInit *OpDef = dyn_cast<DefInit>(D->getOperator());
+    if (!OpDef || !OpDef->getDef()->isSubClassOf("PeepholeOp"))
+      PrintFatalError(R->getLoc(), "Unknown operator in '" +
+                      D->getAsString() + "'");
+    if (D->getNumArgs() != 2)
+      PrintFatalError(R->getLoc(), "Operator '" + OpDef->getDef()->getName() +
+                      "' takes two operands");
+    N.Op = OpDef->getDef();
+    for (unsigned i = 0; i != 2; ++i)
+      N.Children.push_back(parseNode(R, D->getArg(i), D->getArgName(i)));
+  } else if (IntInit *II = dyn_cast<IntInit>(I)) {
+    N.IsLiteral = true;
+    N.Literal = II->getValue();
+  } else if (isa<UnsetInit>(I) && !Name.empty()) {
+    N.Name = Name;
+  } else {
+    PrintFatalError(R->getLoc(), "Unsupported operand '" + I->getAsString() +
+                    "'");
+  }
+  return N;
+}
+
+/// addChecks - Append the checks needed for Val, found at Path in the
+/// pattern, to match N.  Bound maps the operand names seen so far to the code
+/// that reads them.
+void PeepholeEmitter::addChecks(const PatternNode &N, const std::string &Val,
+                                const std::string &Path,
+                                std::vector<std::string> &Checks,
+                                BindingMap &Bound) {
+  if (N.IsLiteral) {
+    std::string Matcher;
+    switch (N.Literal) {
+    case 0:  Matcher = "PatternMatch::m_Zero()"; break;
+    case 1:  Matcher = "PatternMatch::m_One()"; break;
+    case -1: Matcher = "PatternMatch::m_AllOnes()"; break;
+    default:
+      Matcher = "PatternMatch::m_ConstantInt<" + itostr(N.Literal) + ">()";
+      break;
+    }
+    Checks.push_back("PatternMatch::match(" + Val + ", " + Matcher + ")");
+    return;
+  }
+
+  if (!N.Op) {
+    BindingMap::iterator I = Bound.find(N.Name);
+    if (I == Bound.end())
+      Bound[N.Name] = Val;
+    else
+      Checks.push_back(Val + " == " + I->second);
+    return;
+  }
+
+  // The operands of the root are passed in directly.
+  if (Path.empty()) {
+    addChecks(N.Children[0], "Op0", "0", Checks, Bound);
+    addChecks(N.Children[1], "Op1", "1", Checks, Bound);
+    return;
+  }
+
+  std::string Var = "N" + Path;
+  Checks.push_back("Operator *" + Var + " = dyn_cast<Operator>(" + Val + ")");
+  Checks.push_back(Var + "->getOpcode() == Instruction::" +
+                   N.Op->getValueAsString("Opcode"));
+  for (unsigned i = 0; i != 2; ++i)
+    addChecks(N.Children[i], Var + "->getOperand(" + utostr(i) + ")",
+              Path + utostr(i), Checks, Bound);
+}
+
+std::string PeepholeEmitter::getConstantCode(int64_t Value) {
+  if (Value == 0)
+    return "Constant::getNullValue(Op0->getType())";
+  if (Value == -1)
+    return "Constant::getAllOnesValue(Op0->getType())";
+  return "ConstantInt::getSigned(Op0->getType(), " + itostr(Value) + ")";
+}
+
+std::string PeepholeEmitter::getResultCode(Record *R, const PatternNode &N,
+                                           const BindingMap &Bound,
+                                           bool IsRoot) {
+  if (N.IsLiteral)
+    return getConstantCode(N.Literal);
+
+  if (!N.Op) {
+    BindingMap::const_iterator I = Bound.find(N.Name);
+    if (I == Bound.end())
+      PrintFatalError(R->getLoc(), "Result uses unbound operand '$" + N.Name +
+                      "'");
+    return I->second;
+  }
+
+  std::string Opcode = "Instruction::" + N.Op->getValueAsString("Opcode");
+  std::string LHS = getResultCode(R, N.Children[0], Bound, false);
+  std::string RHS = getResultCode(R, N.Children[1], Bound, false);
+  if (IsRoot)
+    return "BinaryOperator::Create(" + Opcode + ", " + LHS + ", " + RHS + ")";
+  return "Builder->CreateBinOp(" + Opcode + ", " + LHS + ", " + RHS + ")";
+}
+
+/// addPattern - Walk the tree along Checks, adding nodes as needed, and
+/// return the node that is reached once all of them have passed.
+MatcherNode *
+PeepholeEmitter::addPattern(MatcherNode *Root,
+                            const std::vector<std::string> &Checks) {
+  MatcherNode *N = Root;
+  for (unsigned i = 0, e = Checks.size(); i != e; ++i) {
+    MatcherNode *Parent = N;
+    unsigned NumChildren = Parent->Children.size();
+    N = Parent->getChild(Checks[i]);
+    if (Parent->Children.size() != NumChildren)
+      ++NumChecks;
+  }
+  return N;
+}
+
+void PeepholeEmitter::emitMatcher(const MatcherNode *N, unsigned Indent,
+                                  raw_ostream &OS) {
+  // Try the more specific patterns first.
+  for (unsigned i = 0, e = N->Children.size(); i != e; ++i) {
+    OS.indent(Indent) << "if (" << N->Children[i].first << ") {\n";
+    emitMatcher(N->Children[i].second, Indent + 2, OS);
+    OS.indent(Indent) << "}\n";
+  }
+  if (!N->Action.empty()) {
+    OS.indent(Indent) << "// " << N->Comment << "\n";
+    OS.indent(Indent) << "return " << N->Action << ";\n";
+  }
+}
+
+void PeepholeEmitter::run(raw_ostream &OS) {
+  std::vector<Record*> Patterns = Records.getAllDerivedDefinitions("Peephole");
+  std::sort(Patterns.begin(), Patterns.end(), LessRecordByID());
+
+  // Parse everything up front: the signature of the matcher depends on
+  // whether the results build instructions.
+  std::vector<std::pair<PatternNode, PatternNode> > Parsed;
+  for (unsigned i = 0, e = Patterns.size(); i != e; ++i) {
+    Record *R = Patterns[i];
+    DagInit *Pattern = R->getValueAsDag("Pattern");
+    DagInit *Result = R->getValueAsDag("Result");
+
+    PatternNode Root = parseNode(R, Pattern, "");
+    PatternNode Res;
+    DefInit *ResOp = dyn_cast<DefInit>(Result->getOperator());
+    bool IsUse = ResOp && ResOp->getDef()->getName() == "use";
+    if (IsUse) {
+      if (Result->getNumArgs() != 1)
+        PrintFatalError(R->getLoc(), "'use' takes one operand");
+      Res = parseNode(R, Result->getArg(0), Result->getArgName(0));
+      if (Res.Op)
+        PrintFatalError(R->getLoc(), "'use' takes an operand or a literal");
+    } else {
+      Res = parseNode(R, Result, "");
+    }
+
+    if (i == 0)
+      BuildsInstructions = !IsUse;
+    else if (BuildsInstructions == IsUse)
+      PrintFatalError(R->getLoc(), "Cannot mix simplifications and rewrites "
+                      "in one file");
+    Parsed.push_back(std::make_pair(Root, Res));
+  }
+
+  // One tree per opcode of the root, in the order they are first seen.
+  std::vector<std::pair<Record*, MatcherNode*> > Roots;
+  std::vector<MatcherNode*> RootOf;
+  std::vector<PatternVariant> Variants;
+  for (unsigned i = 0, e = Parsed.size(); i != e; ++i) {
+    const PatternNode &Pattern = Parsed[i].first;
+    MatcherNode *Root = 0;
+    for (unsigned j = 0, je = Roots.size(); j != je && !Root; ++j)
+      if (Roots[j].first == Pattern.Op)
+        Root = Roots[j].second;
+    if (!Root) {
+      Roots.push_back(std::make_pair(Pattern.Op, new MatcherNode()));
+      Root = Roots.back().second;
+    }
+    RootOf.push_back(Root);
+
+    std::vector<PatternNode> Forms;
+    expandCommuted(Pattern, Forms);
+    for (unsigned v = 0, ve = Forms.size(); v != ve; ++v)
+      Variants.push_back(PatternVariant(i, Forms[v]));
+  }
+
+  // Patterns as written come first, then the forms with the fewest commuted
+  // operators.  When two forms need the same checks, the first one wins, so
+  // a pattern can spell out the operand order of its result for a form that
+  // would otherwise be covered by commuting another pattern.
+  std::stable_sort(Variants.begin(), Variants.end());
+  for (unsigned v = 0, ve = Variants.size(); v != ve; ++v) {
+    unsigned Index = Variants[v].Index;
+    const PatternNode &Form = Variants[v].Node;
+    std::vector<std::string> Checks;
+    BindingMap Bound;
+    addChecks(Form, "", "", Checks, Bound);
+
+    MatcherNode *N = addPattern(RootOf[Index], Checks);
+    if (!N->Action.empty())
+      continue;
+    ++NumVariants;
+    N->Action = getResultCode(Patterns[Index], Parsed[Index].second, Bound,
+                              true);
+    raw_string_ostream Comment(N->Comment);
+    printNode(Form, Comment);
+    Comment << " -> ";
+    printNode(Parsed[Index].second, Comment);
+  }
+
+  emitSourceFileHeader("IR Peephole Pattern Matcher", OS);
+
+  OS << "// " << Patterns.size() << " patterns (" << NumVariants
+     << " forms with commuted operands) in " << NumChecks << " checks.\n\n";
+  if (BuildsInstructions) {
+    OS << "/// MatchPeepholePatterns - Try the patterns against the binary "
+          "operator I.\n"
+       << "/// Returns the instruction to replace it with, or null.\n"
+       << "template <typename BuilderTy>\n"
+       << "static Instruction *MatchPeepholePatterns(BinaryOperator &I,\n"
+       << "                                          BuilderTy *Builder) {\n"
+       << "  unsigned Opcode = I.getOpcode();\n"
+       << "  Value *Op0 = I.getOperand(0), *Op1 = I.getOperand(1);\n"
+       << "  (void)Builder;\n";
+  } else {
+    OS << "/// MatchPeepholePatterns - Try the patterns against a binary "
+          "operator with\n"
+       << "/// the given opcode and operands.  Returns the value it "
+          "simplifies to, or\n"
+       << "/// null.\n"
+       << "static Value *MatchPeepholePatterns(unsigned Opcode, Value *Op0,\n"
+       << "                                    Value *Op1) {\n";
+  }
+
+  OS << "  switch (Opcode) {\n"
+     << "  default: break;\n";
+  for (unsigned i = 0, e = Roots.size(); i != e; ++i) {
+    OS << "  case Instruction::" << Roots[i].first->getValueAsString("Opcode")
+       << ":\n";
+    emitMatcher(Roots[i].second, 4, OS);
+    OS << "    break;\n";
+    delete Roots[i].second;
+  }
+  OS << "  }\n"
+     << "  return 0;\n"
+     << "}\n";
+}
+
+namespace llvm {
+
+void EmitPeephole(RecordKeeper &RK, raw_ostream &OS) {
+  PeepholeEmitter(RK).run(OS);
+}
+
+} // End llvm namespace.
@@ -41,6 +41,7 @@ enum ActionType {
   PrintEnums,
   PrintSets,
   GenOptParserDefs,
+  GenPeephole,
   GenCTags
 };
 
@@ -83,6 +84,8 @@ namespace {
                                "Print expanded sets for testing DAG exprs"),
                     clEnumValN(GenOptParserDefs, "gen-opt-parser-defs",
                                "Generate option definitions"),
+                    clEnumValN(GenPeephole, "gen-peephole-patterns",
+                               "Generate IR peephole pattern matchers"),
                     clEnumValN(GenCTags, "gen-ctags",
                                "Generate ctags-compatible index"),
                     clEnumValEnd));
@@ -141,6 +144,9 @@ bool LLVMTableGenMain(raw_ostream &OS, RecordKeeper &Records) {
   case GenOptParserDefs:
     EmitOptParser(Records, OS);
     break;
+  case GenPeephole:
+    EmitPeephole(Records, OS);
+    break;
   case PrintEnums:
   {
     std::vector<Record*> Recs = Records.getAllDerivedDefinitions(Class);
@@ -0,0 +1,379 @@
+#!/usr/bin/env python
+
+"""Check the vectorizer cost model against measured throughput.
+
+The loop and SLP vectorizers decide what to vectorize based on the costs that
+TargetTransformInfo reports. This script generates a small kernel loop for
+each instruction class, writes it out at several vectorization (VF) and
+unroll (UF) factors, and compares the speedup that the cost model predicts
+with the speedup measured on the host:
+
+  * The predicted cost of a kernel is the sum of the costs that
+    'opt -cost-model -analyze' reports for the instructions of its loop body,
+    divided by the number of elements that one iteration processes.
+  * The measured cost is the time per element of the kernel compiled with
+    llc, linked with a generated C driver and run locally.
+
+Kernels are written directly in vector IR, so the numbers check the cost
+tables themselves and not the decisions of a particular vectorizer.
+
+usage:
+
+  utils/vectorizer-cost-check.py --opt <build>/bin/opt --llc <build>/bin/llc \\
+      --mcpu=corei7-avx [--vf 2,4,8] [--uf 1,2] [--classes add.i32,fmul]
+
+Rows whose predicted and measured speedups differ by more than the tolerance
+are marked with '*'. Rows where the cost model predicts a win but the
+measurement shows a loss (or the other way around) are marked with '!'. With
+--check, the script exits with a non-zero status if any row is marked.
+"""
+
+import argparse
+import math
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+# IR type name -> (C type, size in bytes, is floating point).
+TYPES = {
+  'i8': ('signed char', 1, False),
+  'i16': ('short', 2, False),
+  'i32': ('int', 4, False),
+  'i64': ('long long', 8, False),
+  'float': ('float', 4, True),
+  'double': ('double', 8, True),
+}
+
+class Kernel(object):
+  """An instruction class: c[i] = op(a[i], b[i])."""
+
+  def __init__(self, name, src, dst, body):
+    self.name = name
+    self.src = src
+    self.dst = dst
+    # A format string that computes %r.N from %x.N and %y.N. It may use
+    # {src} and {dst} for the (vector) operand and result types.
+    self.body = body
+
+def make_kernels():
+  kernels = []
+  for op in ['add', 'sub', 'mul', 'sdiv', 'udiv', 'shl', 'lshr', 'ashr',
+             'and', 'or', 'xor']:
+    for ty in ['i8', 'i16', 'i32', 'i64']:
+      kernels.append(Kernel('%s.%s' % (op, ty), ty, ty,
+                            ['%%r.{n} = %s {src} %%x.{n}, %%y.{n}' % op]))
+  for op in ['fadd', 'fsub', 'fmul', 'fdiv']:
+    for ty in ['float', 'double']:
+      kernels.append(Kernel('%s.%s' % (op, ty), ty, ty,
+                            ['%%r.{n} = %s {src} %%x.{n}, %%y.{n}' % op]))
+  for op, src, dst in [('sext', 'i8', 'i32'), ('zext', 'i8', 'i32'),
+                       ('sext', 'i16', 'i32'), ('zext', 'i16', 'i32'),
+                       ('sext', 'i32', 'i64'), ('zext', 'i32', 'i64'),
+                       ('trunc', 'i32', 'i8'), ('trunc', 'i32', 'i16'),
+                       ('trunc', 'i64', 'i32'),
+                       ('sitofp', 'i32', 'float'), ('sitofp', 'i32', 'double'),
+                       ('sitofp', 'i64', 'double'),
+                       ('uitofp', 'i32', 'float'),
+                       ('fptosi', 'float', 'i32'), ('fptosi', 'double', 'i32'),
+                       ('fpext', 'float', 'double'),
+                       ('fptrunc', 'double', 'float')]:
+    kernels.append(Kernel('%s.%s.%s' % (op, src, dst), src, dst,
+                          ['%%r.{n} = %s {src} %%x.{n} to {dst}' % op]))
+  for ty, cmp in [('i32', 'icmp sgt'), ('i64', 'icmp sgt'),
+                  ('float', 'fcmp ogt'), ('double', 'fcmp ogt')]:
+    kernels.append(Kernel('select.%s' % ty, ty, ty,
+                          ['%%c.{n} = %s {src} %%x.{n}, %%y.{n}' % cmp,
+                           '%r.{n} = select {cond} %c.{n}, '
+                           '{src} %x.{n}, {src} %y.{n}']))
+  return kernels
+
+def vec_type(ty, vf):
+  if vf == 1:
+    return ty
+  return '<%d x %s>' % (vf, ty)
+
+def generate_ir(kernel, vf, uf):
+  """Return the IR of the kernel and the range of the loop body instructions
+  in the cost model output."""
+  src = vec_type(kernel.src, vf)
+  dst = vec_type(kernel.dst, vf)
+  cond = vec_type('i1', vf)
+  src_align = TYPES[kernel.src][1]
+  dst_align = TYPES[kernel.dst][1]
+  lines = []
+  lines.append('define void @kernel(%s* noalias %%a, %s* noalias %%b, '
+               '%s* noalias %%c, i64 %%n) {' %
+               (kernel.src, kernel.src, kernel.dst))
+  lines.append('entry:')
+  lines.append('  br label %loop')
+  lines.append('loop:')
+  body = []
+  body.append('%i = phi i64 [ 0, %entry ], [ %i.next, %loop ]')
+  for n in range(uf):
+    body.append('%%idx.%d = add i64 %%i, %d' % (n, n * vf))
+    for arr, var, ty, vty, align in [('a', 'x', kernel.src, src, src_align),
+                                     ('b', 'y', kernel.src, src, src_align)]:
+      body.append('%%p%s.%d = getelementptr %s* %%%s, i64 %%idx.%d' %
+                  (arr, n, ty, arr, n))
+      ptr = '%%p%s.%d' % (arr, n)
+      if vf != 1:
+        body.append('%%v%s.%d = bitcast %s* %s to %s*' %
+                    (arr, n, ty, ptr, vty))
+        ptr = '%%v%s.%d' % (arr, n)
+      body.append('%%%s.%d = load %s* %s, align %d' %
+                  (var, n, vty, ptr, align))
+    for b in kernel.body:
+      body.append(b.format(n=n, src=src, dst=dst, cond=cond))
+    body.append('%%pc.%d = getelementptr %s* %%c, i64 %%idx.%d' %
+                (n, kernel.dst, n))
+    ptr = '%%pc.%d' % n
+    if vf != 1:
+      body.append('%%vc.%d = bitcast %s* %s to %s*' %
+                  (n, kernel.dst, ptr, dst))
+      ptr = '%%vc.%d' % n
+    body.append('store %s %%r.%d, %s* %s, align %d' %
+                (dst, n, dst, ptr, dst_align))
+  body.append('%%i.next = add i64 %%i, %d' % (vf * uf))
+  body.append('%done = icmp uge i64 %i.next, %n')
+  body.append('br i1 %done, label %exit, label %loop')
+  lines.extend('  ' + b for b in body)
+  lines.append('exit:')
+  lines.append('  ret void')
+  lines.append('}')
+  # The entry block has a single instruction.
+  return '\n'.join(lines) + '\n', (1, 1 + len(body))
+
+DRIVER = r'''
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void kernel(SRC *a, SRC *b, DST *c, long long n);
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+  long long n = atoll(argv[1]), i;
+  int reps = atoi(argv[2]), trials = atoi(argv[3]), r, t;
+  SRC *a = malloc(n * sizeof(SRC)), *b = malloc(n * sizeof(SRC));
+  DST *c = malloc(n * sizeof(DST));
+  double best = 1e30;
+  for (i = 0; i < n; ++i) {
+    a[i] = (SRC)(i % 13 + 1);
+    b[i] = (SRC)(i % 7 + 1);
+  }
+  /* Warm up the caches. */
+  kernel(a, b, c, n);
+  for (t = 0; t < trials; ++t) {
+    double start = now(), elapsed;
+    for (r = 0; r < reps; ++r)
+      kernel(a, b, c, n);
+    elapsed = now() - start;
+    if (elapsed < best)
+      best = elapsed;
+  }
+  printf("%g\n", best * 1e9 / ((double)n * reps));
+  return 0;
+}
+'''
+
+COST_RE = re.compile(r'^Cost Model: (?:Found an estimated cost of (\d+)|'
+                     r'(Unknown cost))')
+
+def run(args, **kwargs):
+  proc = subprocess.Popen(args, stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE, **kwargs)
+  out, err = proc.communicate()
+  if proc.returncode != 0:
+    raise RuntimeError('%s failed:\n%s' % (' '.join(args),
+                                           err.decode('utf-8', 'replace')))
+  return out.decode('utf-8', 'replace')
+
+def target_flags(opts):
+  flags = []
+  if opts.mtriple:
+    flags.append('-mtriple=' + opts.mtriple)
+  if opts.mcpu:
+    flags.append('-mcpu=' + opts.mcpu)
+  if opts.mattr:
+    flags.append('-mattr=' + opts.mattr)
+  return flags
+
+def predict(opts, ir_file, body_range, elements):
+  """Return the predicted cost per element."""
+  out = run([opts.opt, '-cost-model', '-analyze'] + target_flags(opts) +
+            [ir_file])
+  costs = []
+  for line in out.splitlines():
+    m = COST_RE.match(line)
+    if m:
+      costs.append(None if m.group(2) else int(m.group(1)))
+  body = costs[body_range[0]:body_range[1]]
+  if None in body:
+    return None
+  return float(sum(body)) / elements
+
+def measure(opts, workdir, kernel, ir_file):
+  """Return the measured time per element, in nanoseconds."""
+  obj = ir_file.replace('.ll', '.o')
+  exe = ir_file.replace('.ll', '.exe')
+  run([opts.llc, '-O3', '-filetype=obj', '-o', obj] + target_flags(opts) +
+      [ir_file])
+  driver = os.path.join(workdir, 'driver-%s.c' % kernel.name)
+  if not os.path.exists(driver):
+    with open(driver, 'w') as f:
+      f.write('#define SRC %s\n#define DST %s\n' %
+              (TYPES[kernel.src][0], TYPES[kernel.dst][0]))
+      f.write(DRIVER)
+  run([opts.cc, '-O2', '-o', exe, driver, obj] + opts.ldflags)
+  out = run([exe, str(opts.n), str(opts.reps), str(opts.trials)])
+  return float(out.strip())
+
+def check_kernel(opts, workdir, kernel):
+  """Return a list of (vf, uf, predicted speedup, measured speedup)."""
+  results = []
+  scalar = None
+  configs = [(1, 1)] + [(vf, uf) for vf in opts.vf for uf in opts.uf]
+  for vf, uf in configs:
+    ir, body_range = generate_ir(kernel, vf, uf)
+    ir_file = os.path.join(workdir, '%s.vf%d.uf%d.ll' % (kernel.name, vf, uf))
+    with open(ir_file, 'w') as f:
+      f.write(ir)
+    predicted = predict(opts, ir_file, body_range, vf * uf)
+    measured = None if opts.no_run else measure(opts, workdir, kernel,
+                                                ir_file)
+    if scalar is None:
+      scalar = (predicted, measured)
+      continue
+    pred_speedup = None
+    if predicted and scalar[0] is not None:
+      pred_speedup = scalar[0] / predicted
+    meas_speedup = None
+    if measured and scalar[1] is not None:
+      meas_speedup = scalar[1] / measured
+    results.append((vf, uf, pred_speedup, meas_speedup))
+  return results
+
+def classify(opts, pred, meas):
+  """Return the marker for a row."""
+  if pred is None or meas is None:
+    return ''
+  if (pred > 1.0) != (meas > 1.0) and abs(math.log(pred / meas)) > 0.05:
+    return '!'
+  if max(pred / meas, meas / pred) > opts.tolerance:
+    return '*'
+  return ''
+
+def fmt(x):
+  return '%9s' % ('-' if x is None else '%.2f' % x)
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+  parser.add_argument('--opt', default='opt', help='path to opt')
+  parser.add_argument('--llc', default='llc', help='path to llc')
+  parser.add_argument('--cc', default='cc',
+                      help='host C compiler used to build the driver')
+  parser.add_argument('--ldflags', default='',
+                      help='extra flags for linking the driver')
+  parser.add_argument('--mtriple', default='',
+                      help='target triple (default: the one of llc)')
+  parser.add_argument('--mcpu', default='', help='target cpu')
+  parser.add_argument('--mattr', default='', help='target attributes')
+  parser.add_argument('--vf', default='2,4,8',
+                      help='comma separated vectorization factors')
+  parser.add_argument('--uf', default='1,2',
+                      help='comma separated unroll factors')
+  parser.add_argument('--classes', default='',
+                      help='comma separated kernel name prefixes to check')
+  parser.add_argument('--n', type=int, default=4096,
+                      help='number of elements per kernel call')
+  parser.add_argument('--reps', type=int, default=2000,
+                      help='kernel calls per timed trial')
+  parser.add_argument('--trials', type=int, default=5,
+                      help='timed trials; the fastest one is used')
+  parser.add_argument('--tolerance', type=float, default=1.5,
+                      help='largest accepted ratio between the predicted '
+                      'and the measured speedup')
+  parser.add_argument('--no-run', action='store_true',
+                      help='only report the predicted speedups')
+  parser.add_argument('--check', action='store_true',
+                      help='exit with an error if any row is marked')
+  parser.add_argument('--keep-temps', action='store_true',
+                      help='keep the generated files')
+  parser.add_argument('--list', action='store_true',
+                      help='list the kernels and exit')
+  opts = parser.parse_args()
+  opts.vf = [int(x) for x in opts.vf.split(',') if x]
+  opts.uf = [int(x) for x in opts.uf.split(',') if x]
+  opts.ldflags = opts.ldflags.split()
+  # Without a triple the cost model knows nothing about the target.
+  if not opts.mtriple:
+    # 'llc -version' exits with a non-zero status, so don't use run().
+    proc = subprocess.Popen([opts.llc, '-version'], stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    version = proc.communicate()[0].decode('utf-8', 'replace')
+    m = re.search(r'Default target: (\S+)', version)
+    if m:
+      opts.mtriple = m.group(1)
+
+  kernels = make_kernels()
+  if opts.classes:
+    prefixes = opts.classes.split(',')
+    kernels = [k for k in kernels
+               if any(k.name.startswith(p) for p in prefixes)]
+  if opts.list:
+    for k in kernels:
+      print(k.name)
+    return 0
+  for vf in opts.vf:
+    if opts.n % (vf * max(opts.uf)) != 0:
+      parser.error('--n must be a multiple of every VF * UF')
+
+  workdir = tempfile.mkdtemp(prefix='vectorizer-cost-check-')
+  marked = 0
+  # Per class geometric mean of measured / predicted speedup.
+  summary = []
+  try:
+    print('%-24s %3s %3s %9s %9s %9s' %
+          ('kernel', 'VF', 'UF', 'predicted', 'measured', 'ratio'))
+    for kernel in kernels:
+      logs = []
+      for vf, uf, pred, meas in check_kernel(opts, workdir, kernel):
+        ratio = None
+        if pred and meas:
+          ratio = meas / pred
+          logs.append(math.log(ratio))
+        mark = classify(opts, pred, meas)
+        if mark:
+          marked += 1
+        print('%-24s %3d %3d %s %s %s %s' %
+              (kernel.name, vf, uf, fmt(pred), fmt(meas), fmt(ratio), mark))
+      sys.stdout.flush()
+      if logs:
+        summary.append((kernel.name, math.exp(sum(logs) / len(logs))))
+  finally:
+    if opts.keep_temps:
+      print('Generated files are in ' + workdir)
+    else:
+      shutil.rmtree(workdir)
+
+  if summary:
+    print('')
+    print('Classes whose costs are furthest off (measured / predicted):')
+    summary.sort(key=lambda s: -abs(math.log(s[1])))
+    for name, ratio in summary[:10]:
+      print('  %-24s %6.2f' % (name, ratio))
+
+  if opts.check and marked:
+    return 1
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())